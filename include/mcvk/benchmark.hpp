@@ -0,0 +1,55 @@
+#ifndef MCVK_BENCHMARK_HPP
+#define MCVK_BENCHMARK_HPP
+
+// CPU-side benchmarks that can be run from the command line ('--benchmark=<name>'). None of them
+// require a window or a Vulkan device, so they can run on any build machine.
+namespace Benchmark
+{
+    // Returns false if no benchmark with that name exists
+    extern bool run(const char *name) noexcept;
+
+    // 'world': bytes per loaded chunk and block get/set throughput of the chunk store
+    extern void world_storage() noexcept;
+
+    // 'mesher': sections per second through the greedy mesher, on terrain and on a worst case section
+    extern void mesher() noexcept;
+
+    // 'jobs': chunk generation, meshing and staging on the job system from 1 up to every hardware thread,
+    // then checks that main thread jobs run without the main thread waiting on them
+    extern void jobs() noexcept;
+
+    // 'logger': messages per second through the logger from 1 up to 8 (or every hardware) threads,
+    // against building a std::string and calling fprintf
+    extern void logger() noexcept;
+
+    // 'terrain': chunks per second through the terrain generator for every supported instruction set
+    // from 1 up to every hardware thread. Every run is checked against a golden hash of the
+    // generated blocks, a mismatch is a fatal error.
+    extern void terrain() noexcept;
+
+    // 'region': save and load throughput of region files and the bytes every chunk takes on disk,
+    // for a range of compression levels. Loaded chunks are checked against the saved ones.
+    extern void region() noexcept;
+
+    // 'lighting': chunk columns lit per second, and light updates per second for placing and then
+    // breaking light sources on the surface, one per batch and many per batch. Breaking every
+    // placed source has to restore the light exactly, a mismatch is a fatal error.
+    extern void lighting() noexcept;
+
+    // 'simulation': the fixed timestep simulation ticking next to a render loop of short frames,
+    // with steady ticks, with occasional ticks that take several tick lengths and with a stall.
+    // Shows the tick rate that is kept, the ticks that are dropped and the longest frame.
+    extern void simulation() noexcept;
+
+    // 'entities': nanoseconds per entity to integrate the position of 100k entities, with every
+    // entity's state in one struct against the entity component store, serially and on the job
+    // system, and again after entities have come and gone. The results are checked against each other.
+    extern void entities() noexcept;
+
+    // 'collision': 10k entities on generated terrain. Spatial hash updates and box queries per
+    // second (queries also by testing every entity, and checked against that), raycasts per second
+    // and swept boxes per second against the blocks. Swept boxes must never end up inside a block.
+    extern void collision() noexcept;
+}
+
+#endif // MCVK_BENCHMARK_HPP
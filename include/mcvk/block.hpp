@@ -0,0 +1,98 @@
+#ifndef MCVK_BLOCK_HPP
+#define MCVK_BLOCK_HPP
+
+#include <array>
+#include "mcvk/types.hpp"
+
+namespace World
+{
+    using BlockId = u16;
+
+    enum Block : BlockId
+    {
+        Air,
+        Stone,
+        Dirt,
+        Grass,
+        Sand,
+        Gravel,
+        Water,
+        Bedrock,
+        Log,
+        Leaves,
+        Glass,
+        Planks,
+        Cobblestone,
+        Snow,
+        Glowstone,
+        BlockCount
+    };
+
+    // Layers of the block texture array, in order. Blocks refer to these instead of owning a
+    // texture, so blocks can share textures and a face's texture is a plain index.
+    enum class Texture : u16
+    {
+        Stone,
+        Dirt,
+        GrassTop,
+        GrassSide,
+        Sand,
+        Gravel,
+        Water,
+        Bedrock,
+        LogTop,
+        LogSide,
+        Leaves,
+        Glass,
+        Planks,
+        Cobblestone,
+        Snow,
+        Glowstone,
+        Count
+    };
+
+    struct BlockProperties
+    {
+        const char *name {};
+        bool opaque {}; // opaque blocks hide the faces of their neighbours and stop light
+        u8 emission {}; // block light level the block gives off, at most 15
+        Texture top {};
+        Texture side {};
+        Texture bottom {};
+    };
+
+    // indexed by block id
+    inline constexpr std::array<BlockProperties, BlockCount> BLOCK_PROPERTIES {{
+        {.name = "air", .opaque = false},
+        {.name = "stone", .opaque = true, .top = Texture::Stone, .side = Texture::Stone, .bottom = Texture::Stone},
+        {.name = "dirt", .opaque = true, .top = Texture::Dirt, .side = Texture::Dirt, .bottom = Texture::Dirt},
+        {.name = "grass", .opaque = true, .top = Texture::GrassTop, .side = Texture::GrassSide, .bottom = Texture::Dirt},
+        {.name = "sand", .opaque = true, .top = Texture::Sand, .side = Texture::Sand, .bottom = Texture::Sand},
+        {.name = "gravel", .opaque = true, .top = Texture::Gravel, .side = Texture::Gravel, .bottom = Texture::Gravel},
+        {.name = "water", .opaque = false, .top = Texture::Water, .side = Texture::Water, .bottom = Texture::Water},
+        {.name = "bedrock", .opaque = true, .top = Texture::Bedrock, .side = Texture::Bedrock, .bottom = Texture::Bedrock},
+        {.name = "log", .opaque = true, .top = Texture::LogTop, .side = Texture::LogSide, .bottom = Texture::LogTop},
+        {.name = "leaves", .opaque = false, .top = Texture::Leaves, .side = Texture::Leaves, .bottom = Texture::Leaves},
+        {.name = "glass", .opaque = false, .top = Texture::Glass, .side = Texture::Glass, .bottom = Texture::Glass},
+        {.name = "planks", .opaque = true, .top = Texture::Planks, .side = Texture::Planks, .bottom = Texture::Planks},
+        {.name = "cobblestone", .opaque = true, .top = Texture::Cobblestone, .side = Texture::Cobblestone, .bottom = Texture::Cobblestone},
+        {.name = "snow", .opaque = true, .top = Texture::Snow, .side = Texture::Snow, .bottom = Texture::Snow},
+        {.name = "glowstone", .opaque = true, .emission = 15, .top = Texture::Glowstone, .side = Texture::Glowstone, .bottom = Texture::Glowstone},
+    }};
+
+    constexpr bool is_opaque(BlockId id) noexcept
+    {
+        return id < BlockCount && BLOCK_PROPERTIES[id].opaque;
+    }
+    // Entities collide with solid blocks and rays stop at them
+    constexpr bool is_solid(BlockId id) noexcept
+    {
+        return id != Air && id != Water;
+    }
+    constexpr u8 emission_of(BlockId id) noexcept
+    {
+        return (id < BlockCount) ? BLOCK_PROPERTIES[id].emission : 0;
+    }
+}
+
+#endif // MCVK_BLOCK_HPP
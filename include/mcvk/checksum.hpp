@@ -0,0 +1,32 @@
+#ifndef MCVK_CHECKSUM_HPP
+#define MCVK_CHECKSUM_HPP
+
+#include <span>
+#include "mcvk/types.hpp"
+
+// Non-cryptographic hashes, used to detect corrupted files and changed data in memory
+namespace Checksum
+{
+    inline constexpr u64 FNV1A_BASIS {0xcbf29ce484222325};
+    inline constexpr u64 FNV1A_PRIME {0x100000001b3};
+
+    // FNV-1a, corruption has to be detected, not tampering. Data hashed in pieces passes the hash
+    // of the previous pieces as 'hash'.
+    constexpr u64 fnv1a(std::span<const u8> data, u64 hash = FNV1A_BASIS) noexcept
+    {
+        for (const auto byte : data) {
+            hash ^= byte;
+            hash *= FNV1A_PRIME;
+        }
+        return hash;
+    }
+
+    // FNV-1a step over a whole value instead of its bytes, so the hash doesn't depend on byte
+    // order. The terrain's golden hash is built from these.
+    constexpr u64 fnv1a_value(u64 value, u64 hash = FNV1A_BASIS) noexcept
+    {
+        return (hash ^ value) * FNV1A_PRIME;
+    }
+}
+
+#endif // MCVK_CHECKSUM_HPP
@@ -0,0 +1,70 @@
+#ifndef MCVK_CHUNK_HPP
+#define MCVK_CHUNK_HPP
+
+#include <array>
+#include <functional>
+#include "mcvk/types.hpp"
+#include "mcvk/section.hpp"
+
+namespace World
+{
+    struct ChunkPos
+    {
+        i32 x {}, z {};
+        constexpr bool operator==(const ChunkPos &) const noexcept = default;
+    };
+
+    struct ChunkPosHash
+    {
+        usize operator()(const ChunkPos &pos) const noexcept
+        {
+            // pack both coordinates into one word and let a multiplicative hash spread the bits,
+            // std::hash<u64> is the identity on common standard libraries
+            const auto packed = (static_cast<u64>(static_cast<u32>(pos.x)) << 32) | static_cast<u32>(pos.z);
+            return static_cast<usize>((packed * 0x9E3779B97F4A7C15ull) >> 16);
+        }
+    };
+
+    // A column of sections spanning the whole world height
+    class Chunk
+    {
+        public:
+            static constexpr i32 SECTION_COUNT {16};
+            static constexpr i32 HEIGHT {SECTION_COUNT * Section::SIZE};
+        private:
+            ChunkPos pos {};
+            std::array<Section, SECTION_COUNT> sections {};
+        public:
+            explicit Chunk(ChunkPos chunk_pos) noexcept : pos {chunk_pos} {}
+
+            // 'x' and 'z' are local to the chunk, 'y' is in [0, HEIGHT)
+            BlockId get(i32 x, i32 y, i32 z) const noexcept
+            {
+                return sections[static_cast<usize>(y / Section::SIZE)].get(x, y % Section::SIZE, z);
+            }
+            void set(i32 x, i32 y, i32 z, BlockId id) noexcept
+            {
+                sections[static_cast<usize>(y / Section::SIZE)].set(x, y % Section::SIZE, z, id);
+            }
+
+            auto &section(i32 index) noexcept { return sections[static_cast<usize>(index)]; }
+            const auto &section(i32 index) const noexcept { return sections[static_cast<usize>(index)]; }
+            constexpr auto get_pos() const noexcept { return pos; }
+
+            void compact() noexcept
+            {
+                for (auto &s : sections)
+                    s.compact();
+            }
+
+            usize memory_usage() const noexcept
+            {
+                usize bytes {sizeof(Chunk) - sizeof(sections)};
+                for (const auto &s : sections)
+                    bytes += s.memory_usage();
+                return bytes;
+            }
+    };
+}
+
+#endif // MCVK_CHUNK_HPP
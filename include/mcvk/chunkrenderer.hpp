@@ -0,0 +1,313 @@
+#ifndef MCVK_CHUNKRENDERER_HPP
+#define MCVK_CHUNKRENDERER_HPP
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/device.hpp"
+#include "mcvk/renderer.hpp"
+#include "mcvk/upload.hpp"
+#include "mcvk/jobs.hpp"
+#include "mcvk/mesher.hpp"
+#include "mcvk/math.hpp"
+#include "mcvk/world.hpp"
+#include "mcvk/textures.hpp"
+
+// Draws section meshes. Every mesh lives in one large arena buffer and every drawable section
+// owns a slot in a storage buffer describing where its mesh is and where the section is.
+//
+// If the device supports 'multiDrawIndirect', a compute pass frustum culls all slots on the GPU
+// and writes the indirect draw commands, so the CPU cost of a frame no longer depends on the
+// number of sections. With VK_KHR_draw_indirect_count the visible draws are also compacted.
+//
+// Otherwise sections are culled on the CPU and grouped into regions of REGION_SIZE x REGION_SIZE
+// chunks. Every region records its draws into its own secondary command buffer on the job system.
+// These buffers are cached per frame in flight and only re-recorded when the region's meshes or
+// the set of its visible sections changed, so a still camera costs almost no recording time.
+//
+// On both paths, sections hidden behind terrain are culled on the CPU beforehand by walking the
+// sections' connectivity (see Meshing::Connectivity) outwards from the camera. A section is only
+// drawn if it can be reached through the faces of the sections in between, without ever stepping
+// back towards the camera, which removes most of the caves below the surface.
+class ChunkRenderer
+{
+    public:
+        static constexpr i32 REGION_SIZE {4};
+        static constexpr i32 SECTIONS_PER_REGION {REGION_SIZE * REGION_SIZE * World::Chunk::SECTION_COUNT};
+        static constexpr VkDeviceSize DEFAULT_ARENA_SIZE {128ull * 1024 * 1024};
+        // the smallest 'maxDrawIndirectCount' a device with 'multiDrawIndirect' may report
+        static constexpr u32 MAX_SECTIONS {65535};
+
+        enum class DrawPath : u8
+        {
+            Direct,       // CPU culling, one vkCmdDrawIndexed per visible section
+            Indirect,     // GPU culling, one draw command per slot
+            IndirectCount // GPU culling, visible draw commands compacted and counted on the GPU
+        };
+
+        struct FrameStatistics
+        {
+            // sections drawn, or with GPU culling the sections handed to the culling pass
+            u32 visible_sections {};
+            u32 visible_regions {};
+            u32 recorded_regions {}; // regions whose secondary command buffer had to be re-recorded
+            double record_ms {};     // CPU time spent culling and recording
+            double occlusion_ms {};  // part of 'record_ms' spent walking the section connectivity
+        };
+    private:
+        using RegionPos = World::ChunkPos;
+
+        static constexpr u32 INVALID_SLOT {~0u};
+
+        // A range of the arena holding the vertices of a mesh. Every mesh is drawn with the shared
+        // quad indices (see Meshing::write_quad_indices) starting at the first one.
+        struct GpuMesh
+        {
+            VkDeviceSize arena_offset {};
+            u32 index_count {};
+            i32 vertex_offset {}; // in vertices from the start of the arena
+            constexpr bool is_valid() const noexcept { return index_count != 0; }
+        };
+
+        struct SectionMesh
+        {
+            GpuMesh current {};
+            // replaces 'current' once its upload has finished, so sections never disappear while
+            // they are being re-meshed
+            GpuMesh pending {};
+            Uploader::Ticket ticket {Uploader::INVALID_TICKET};
+            u32 slot {INVALID_SLOT}; // assigned with the first mesh upload, released once the section is empty
+            // sections that were never handed to the renderer don't hide anything behind them
+            Meshing::Connectivity connectivity {Meshing::Connectivity::all()};
+            Meshing::Connectivity pending_connectivity {}; // of 'pending'
+        };
+
+        // Per slot data read by the culling pass and the vertex shader (std430 layout)
+        struct SectionRecord
+        {
+            std::array<i32, 4> origin {};
+            u32 index_count {}; // zero for unused slots
+            i32 vertex_offset {};
+            std::array<u32, 2> padding {};
+        };
+        static_assert(sizeof(SectionRecord) == 32);
+
+        // std140 layout, see the 'CameraData' block in the shaders
+        struct CameraData
+        {
+            Math::Mat4 view_projection {};
+            std::array<Math::Vec4, 6> frustum_planes {};
+            u32 section_count {};
+            u32 occlusion_culling {}; // whether the culling pass reads the reachable sections
+            std::array<u32, 2> padding {};
+        };
+        static_assert(sizeof(CameraData) == 176);
+
+        // a secondary command buffer and what it was recorded for
+        struct CachedCommands
+        {
+            VkCommandPool command_pool {VK_NULL_HANDLE};
+            VkCommandBuffer command_buffer {VK_NULL_HANDLE};
+            u32 version {};
+            u64 visibility_hash {};
+            VkExtent2D extent {};
+            bool valid {false};
+        };
+
+        struct Region
+        {
+            RegionPos pos {};
+            std::array<SectionMesh, SECTIONS_PER_REGION> sections {};
+            u32 version {1}; // bumped whenever a drawable mesh changes
+            std::vector<u16> visible {};
+            u64 visibility_hash {};
+            std::vector<CachedCommands> caches {}; // one per frame in flight
+            u16 chunks {}; // a bit per chunk of the region that was handed to the renderer and not removed since
+        };
+
+        // a region left without chunks, whose command buffers may still be executed by frames in flight
+        struct RetiredRegion
+        {
+            u64 frame {};
+            std::unique_ptr<Region> region {};
+        };
+
+        struct PendingUpload
+        {
+            Region *region {nullptr};
+            u16 section {};
+        };
+
+        struct RetiredMesh
+        {
+            u64 frame {};
+            GpuMesh mesh {};
+        };
+
+        // a pending mesh replaced before its upload finished, the transfer queue may still be
+        // copying into its range
+        struct SupersededMesh
+        {
+            u64 frame {};
+            GpuMesh mesh {};
+            Uploader::Ticket ticket {Uploader::INVALID_TICKET};
+        };
+
+        // a section reached while walking the connectivity, in chunks and sections relative to the region grid
+        struct GraphStep
+        {
+            i32 x {}, y {}, z {};
+            u8 entered_through {}; // face of this section, FaceCount for the camera's section
+            u8 directions {};      // faces stepped through on the way here, one bit each
+        };
+
+        VkDevice device {VK_NULL_HANDLE};
+        Memory::Allocator *allocator {nullptr};
+        VkPipelineCache pipeline_cache {VK_NULL_HANDLE};
+        Renderer *renderer {nullptr};
+        Jobs::JobSystem *job_system {nullptr};
+        u32 graphics_family {};
+        DrawPath path {DrawPath::Direct};
+        PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count {nullptr};
+        BlockTextures textures; // bound as set 1 of the graphics pipeline
+
+        VkDescriptorSetLayout descriptor_set_layout {VK_NULL_HANDLE};
+        VkPipelineLayout pipeline_layout {VK_NULL_HANDLE};
+        VkPipeline pipeline {VK_NULL_HANDLE};
+        VkPipeline cull_pipeline {VK_NULL_HANDLE};
+        VkDescriptorPool descriptor_pool {VK_NULL_HANDLE};
+        VkDescriptorSet descriptor_set {VK_NULL_HANDLE};
+        VkBuffer camera_buffer {VK_NULL_HANDLE};
+        Memory::Allocation camera_allocation {};
+
+        VkBuffer arena_buffer {VK_NULL_HANDLE};
+        Memory::Allocation arena_allocation {};
+        Memory::Block arena {}; // only the range bookkeeping, the memory is 'arena_allocation'
+        VkBuffer quad_index_buffer {VK_NULL_HANDLE};
+        Memory::Allocation quad_index_allocation {};
+        Uploader::Ticket quad_index_ticket {Uploader::INVALID_TICKET};
+
+        VkBuffer section_buffer {VK_NULL_HANDLE};
+        Memory::Allocation section_allocation {};
+        std::vector<SectionRecord> section_records {}; // CPU copy, written to the GPU when dirty
+        std::vector<u32> dirty_slots {};
+        std::vector<u32> free_slots {};
+        u32 live_sections {}; // slots in use
+
+        // only created for the indirect paths
+        VkBuffer draw_command_buffer {VK_NULL_HANDLE};
+        Memory::Allocation draw_command_allocation {};
+        VkBuffer draw_count_buffer {VK_NULL_HANDLE};
+        Memory::Allocation draw_count_allocation {};
+        VkBuffer reachable_buffer {VK_NULL_HANDLE}; // a bit per slot
+        Memory::Allocation reachable_allocation {};
+        std::vector<u32> reachable_slots {};
+
+        std::unordered_map<RegionPos, std::unique_ptr<Region>, World::ChunkPosHash> regions {};
+        std::vector<PendingUpload> pending_uploads {};
+        // meshes that may still be referenced by frames in flight
+        std::deque<RetiredMesh> retired_meshes {};
+        // also wait for their upload, which doesn't finish in the order they were superseded
+        std::vector<SupersededMesh> superseded_meshes {};
+        std::deque<RetiredRegion> retired_regions {};
+        u64 frame_number {};
+        FrameStatistics statistics {};
+        double pipeline_creation_ms {};
+
+        bool occlusion_culling {true};
+        // scratch for walking the connectivity, a dense grid over every region
+        std::vector<Region *> region_grid {};
+        std::vector<u8> reached {}; // one per section of the grid
+        std::vector<GraphStep> graph_queue {};
+
+        static constexpr RegionPos region_of(World::ChunkPos chunk) noexcept
+        {
+            return {.x = chunk.x >> 2, .z = chunk.z >> 2};
+        }
+        static constexpr u16 section_slot(World::ChunkPos chunk, i32 section) noexcept
+        {
+            return static_cast<u16>(((section * REGION_SIZE) + (chunk.z & (REGION_SIZE - 1))) * REGION_SIZE + (chunk.x & (REGION_SIZE - 1)));
+        }
+        static constexpr u16 chunk_bit(World::ChunkPos chunk) noexcept
+        {
+            return static_cast<u16>(1u << ((chunk.z & (REGION_SIZE - 1)) * REGION_SIZE + (chunk.x & (REGION_SIZE - 1))));
+        }
+        static_assert(REGION_SIZE == 4, "region_of assumes regions of 4x4 chunks");
+
+        VkBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, Memory::Allocation &allocation) const noexcept;
+        void create_pipeline(VkRenderPass render_pass) noexcept;
+        void create_cull_pipeline() noexcept;
+        void create_buffers(VkDeviceSize arena_size) noexcept;
+        void create_descriptors() noexcept;
+        void create_pipelines() noexcept;
+        // stages the quad indices on first use, true once they have been uploaded
+        bool quad_indices_ready() noexcept;
+        Region &get_or_create_region(RegionPos pos) noexcept;
+        void destroy_region(Region &region) const noexcept;
+        void retire(GpuMesh &mesh) noexcept;
+        void drop_meshes(Region &region, World::ChunkPos chunk) noexcept;
+        // drops the pending mesh and its upload
+        void supersede(SectionMesh &section_mesh) noexcept;
+        void free_mesh(GpuMesh &mesh) noexcept;
+        [[nodiscard]] bool acquire_slot(SectionMesh &section_mesh) noexcept;
+        void write_record(const SectionMesh &section_mesh, World::ChunkPos chunk, i32 section) noexcept;
+        void release_slot(SectionMesh &section_mesh) noexcept;
+        void finish_uploads() noexcept;
+        void write_section_records(VkCommandBuffer command_buffer) noexcept;
+        void cull(const Math::Camera &camera, const Math::Frustum &frustum) noexcept;
+        void cull_frustum(const Math::Frustum &frustum) noexcept;
+        // false if the camera is not inside any region, nothing is culled then
+        [[nodiscard]] bool cull_occluded(const Math::Camera &camera, const Math::Frustum &frustum) noexcept;
+        void write_reachable_slots(VkCommandBuffer command_buffer) noexcept;
+        void record_region(Region &region, CachedCommands &cache, VkCommandBufferInheritanceInfo inheritance, VkExtent2D extent) const noexcept;
+        void draw_direct(VkCommandBuffer command_buffer, VkExtent2D extent) noexcept;
+        void draw_indirect(VkCommandBuffer command_buffer, VkExtent2D extent) noexcept;
+    public:
+        // The indirect paths are used whenever the device supports them, unless 'allow_gpu_culling'
+        // is false
+        ChunkRenderer(const Device::LogicalDevice &logical_device, Renderer &renderer, Jobs::JobSystem &job_system,
+                      bool allow_gpu_culling = true, VkDeviceSize arena_size = DEFAULT_ARENA_SIZE) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(ChunkRenderer)
+        ~ChunkRenderer() noexcept;
+
+        // Uploads the mesh of a section, replacing the previous one once the upload has finished.
+        // Returns false if the upload could not be staged this frame and has to be retried. Meshes
+        // that do not fit into the arena (or beyond MAX_SECTIONS) are dropped with an error.
+        [[nodiscard]] bool update_section(World::ChunkPos chunk, i32 section, const Meshing::MeshData &mesh) noexcept;
+        // Frees the meshes of a chunk that stays loaded. Its sections keep their connectivity, so
+        // the chunk still hides what is behind it.
+        void drop_chunk_meshes(World::ChunkPos chunk) noexcept;
+        // Regions are destroyed once every chunk handed to the renderer has been removed again
+        void remove_chunk(World::ChunkPos chunk) noexcept;
+        // whether every mesh handed to 'update_section' for the chunk has finished uploading
+        bool is_chunk_uploaded(World::ChunkPos chunk) const noexcept;
+
+        // Records the frame's chunk draws. Must be called between 'Renderer::begin_frame' and
+        // 'Renderer::end_frame', outside of the render pass, which is begun here. Nothing is drawn
+        // until the block textures and quad indices have been uploaded, a few frames after construction.
+        void draw(VkCommandBuffer command_buffer, const Math::Camera &camera) noexcept;
+
+        // Forces every region to be re-recorded on the next frame, for benchmarking
+        void invalidate_cache() noexcept;
+
+        // Occlusion culling is enabled by default
+        void set_occlusion_culling(bool enabled) noexcept { occlusion_culling = enabled; }
+        constexpr bool uses_occlusion_culling() const noexcept { return occlusion_culling; }
+
+        constexpr const auto &get_statistics() const noexcept { return statistics; }
+        constexpr auto get_draw_path() const noexcept { return path; }
+        // wall time spent creating the pipelines, mostly shader compilation unless the cache was warm
+        constexpr auto get_pipeline_creation_ms() const noexcept { return pipeline_creation_ms; }
+        // bytes of the arena in use by meshes, including retired ones
+        constexpr auto arena_usage() const noexcept { return arena.used; }
+        constexpr auto arena_capacity() const noexcept { return arena.size; }
+        auto region_count() const noexcept { return regions.size(); }
+        bool has_pending_uploads() const noexcept { return !pending_uploads.empty(); }
+};
+
+#endif // MCVK_CHUNKRENDERER_HPP
@@ -0,0 +1,186 @@
+#ifndef MCVK_CHUNKSTREAMER_HPP
+#define MCVK_CHUNKSTREAMER_HPP
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/world.hpp"
+#include "mcvk/region.hpp"
+#include "mcvk/terrain.hpp"
+#include "mcvk/mesher.hpp"
+#include "mcvk/jobs.hpp"
+#include "mcvk/math.hpp"
+#include "mcvk/chunkrenderer.hpp"
+
+// Decides which chunks are loaded (or generated), meshed, uploaded and evicted as the camera
+// moves. Every chunk within the view distance moves through these stages in order of priority:
+// its distance to the camera, with chunks behind the camera counting as further away.
+//
+// Only a few jobs are handed to the job system at a time, everything else waits in the streamer
+// and is reordered on every update, so turning around immediately changes what is worked on next.
+// Jobs that have not started yet are cancelled once enough better work is waiting, or once their
+// chunk is out of range.
+//
+// Loaded blocks and meshes waiting for upload count against the RAM budget, meshes in the chunk
+// renderer's arena against the VRAM budget. When either is exceeded the lowest priority chunks are
+// evicted and no chunk of that priority or lower is started again until usage has dropped.
+//
+// Sections beyond the LOD distance are meshed at reduced detail (see Meshing::select_lod). Once
+// the camera has moved far enough for a visible chunk's sections to need another level, the chunk
+// is meshed again and its new meshes replace the old ones as they finish uploading.
+class ChunkStreamer
+{
+    public:
+        struct Settings
+        {
+            i32 view_distance {8}; // in chunks, chunks are meshed and drawn up to this distance
+            float lod_distance {8.0f}; // in chunks, beyond it sections are meshed at reduced detail, 0 disables this
+            usize ram_budget {512ull * 1024 * 1024};
+            VkDeviceSize vram_budget {ChunkRenderer::DEFAULT_ARENA_SIZE};
+            u32 max_jobs {}; // in flight on the job system at once, 0 uses two per thread
+        };
+
+        struct Statistics
+        {
+            // chunks in every stage after the last update
+            u32 waiting_for_load {};
+            u32 loading {};
+            u32 waiting_for_mesh {}; // loaded, but meshing has not started (or waits for neighbours)
+            u32 meshing {};
+            u32 waiting_for_upload {};
+            u32 uploading {};
+            u32 visible {};
+            u32 deferred {}; // in range, but held back by the budget
+            // since the streamer was created
+            u64 cancelled_jobs {};
+            u64 evicted_chunks {};
+            u64 lod_changes {}; // visible chunks meshed again for another level of detail
+            usize ram_usage {};
+            VkDeviceSize vram_usage {};
+        };
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // time to visible is kept for this many of the most recent chunks
+        static constexpr usize TIME_TO_VISIBLE_HISTORY {1024};
+
+        enum class Stage : u8
+        {
+            Wanted,    // waiting for a load job
+            Loading,
+            Loaded,    // waiting for a mesh job
+            Meshing,
+            Meshed,    // waiting to be uploaded
+            Uploading, // every section was handed to the chunk renderer
+            Visible
+        };
+
+        struct Entry
+        {
+            World::ChunkPos pos {};
+            Stage stage {Stage::Wanted};
+            float distance {}; // to the camera in chunks
+            float priority {};
+            Clock::time_point requested {};
+            World::Chunk *chunk {nullptr}; // created once the chunk is first loaded
+            std::unique_ptr<std::array<Meshing::MeshData, World::Chunk::SECTION_COUNT>> meshes {};
+            std::array<u8, World::Chunk::SECTION_COUNT> lods {}; // level of detail of every section's latest mesh
+            usize chunk_bytes {}; // blocks, measured when the chunk was loaded
+            usize mesh_bytes {};
+            VkDeviceSize gpu_bytes {}; // meshes handed to the chunk renderer
+            std::array<u32, World::Chunk::SECTION_COUNT> section_gpu_bytes {};
+            i32 next_upload {}; // section to hand to the chunk renderer next
+            u32 readers {};     // mesh jobs of neighbouring chunks reading the blocks
+            bool has_job {false};
+            bool evict {false}; // evicted as soon as its job has finished
+            bool in_renderer {false}; // some section was handed to the chunk renderer, until evicted
+            bool remeshing {false};   // visible before, meshed again for another level of detail
+            std::atomic<bool> cancelled {false}; // checked by the job before it starts
+        };
+
+        struct Completion
+        {
+            Entry *entry {};
+            bool finished {}; // false if the job was cancelled before doing anything
+        };
+
+        World::ChunkStore *store {};
+        ChunkRenderer *chunk_renderer {};
+        Jobs::JobSystem *job_system {};
+        World::RegionStorage *storage {};
+        const Terrain::Generator *generator {};
+        Settings settings {};
+        float camera_section_y {}; // camera height in sections, for the distance of every section
+
+        std::unordered_map<World::ChunkPos, Entry, World::ChunkPosHash> entries {};
+        std::vector<Entry *> candidates {}; // scratch, entries sorted by priority
+        std::vector<Entry *> running {};    // scratch, entries with a job
+        std::vector<Meshing::GreedyMesher> meshers {}; // one per worker
+
+        // finished jobs, only touched by the main thread once they have been taken from here
+        std::mutex completions_mutex {};
+        std::vector<Completion> completions {};
+        std::vector<Completion> completions_scratch {};
+
+        Jobs::Counter jobs {};
+        u32 jobs_in_flight {};
+        // totals over all entries, the budgets are checked against these
+        usize chunk_bytes {};
+        usize mesh_bytes {};
+        VkDeviceSize gpu_bytes {};
+        // chunks with a worse priority are not started, lowered when the budget is exceeded
+        float priority_limit {std::numeric_limits<float>::infinity()};
+        Statistics statistics {};
+        std::vector<float> time_to_visible_ms {}; // ring of TIME_TO_VISIBLE_HISTORY entries
+        usize time_to_visible_next {};
+
+        static void prioritize(Entry &entry, const Math::Camera &camera) noexcept;
+        // of every section, given the level it is meshed at now
+        std::array<u8, World::Chunk::SECTION_COUNT> select_lods(const Entry &entry) const noexcept;
+        void request(const Math::Camera &camera) noexcept;
+        void process_completions() noexcept;
+        void enforce_budget() noexcept;
+        void schedule() noexcept;
+        void upload() noexcept;
+        // called when the VRAM budget has no room left for the next mesh of 'entry'
+        void make_room(Entry &entry) noexcept;
+        void update_statistics() noexcept;
+        void start_load(Entry &entry) noexcept;
+        bool neighbours_loaded(const Entry &entry) const noexcept;
+        // every neighbour has to be loaded
+        void start_mesh(Entry &entry) noexcept;
+        void evict(Entry &entry) noexcept;
+        void release_meshes(Entry &entry) noexcept;
+        void complete(Entry &entry, bool finished) noexcept;
+    public:
+        // 'storage' may be null, chunks are always generated then and never saved. Everything
+        // passed in has to outlive the streamer.
+        ChunkStreamer(World::ChunkStore &sstore, ChunkRenderer &cchunk_renderer, Jobs::JobSystem &jjob_system,
+                      World::RegionStorage *sstorage, const Terrain::Generator &ggenerator, const Settings &ssettings) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(ChunkStreamer)
+        // Waits for every job in flight
+        ~ChunkStreamer() noexcept;
+
+        // Requests chunks around the camera, evicts chunks out of range or over budget, starts jobs
+        // and hands finished meshes to the chunk renderer. Must be called every frame between
+        // 'Renderer::begin_frame' and 'ChunkRenderer::draw'.
+        void update(const Math::Camera &camera) noexcept;
+
+        // whether every chunk in range the budget allows for is visible
+        bool is_idle() const noexcept;
+
+        constexpr const auto &get_statistics() const noexcept { return statistics; }
+
+        // Prints the queue depths, memory usage and time to visible percentiles to stdout
+        void report() const noexcept;
+};
+
+#endif // MCVK_CHUNKSTREAMER_HPP
@@ -0,0 +1,101 @@
+#ifndef MCVK_COLLISION_HPP
+#define MCVK_COLLISION_HPP
+
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/math.hpp"
+#include "mcvk/world.hpp"
+#include "mcvk/entities.hpp"
+
+// Collision queries against the blocks of the world and against entities. Block queries walk the
+// blocks they cross in the chunk store itself, only looking a chunk up again when they leave the
+// previous one, so nothing is gathered or copied up front.
+namespace Collision
+{
+    struct RayHit
+    {
+        i32 x {}, y {}, z {};           // the block that was hit
+        std::array<i32, 3> normal {};   // of the face the ray entered through, zero if it started inside the block
+        float distance {};              // along the ray, in units of 'direction'
+        World::BlockId block {};
+    };
+
+    // First solid block (see World::is_solid) along the ray, stepping from block to block along
+    // whichever axis reaches its next block boundary first. Unloaded chunks end the ray without a hit.
+    extern std::optional<RayHit> raycast(const World::ChunkStore &store, const Math::Vec3 &origin, const Math::Vec3 &direction, float max_distance) noexcept;
+
+    struct Sweep
+    {
+        Math::Vec3 motion {};             // how far the box could move
+        std::array<bool, 3> blocked {};   // the axes along which it was stopped short
+    };
+
+    // Moves 'box' by 'motion' until it runs into a solid block, one axis after another (y first,
+    // so walking into a step of ground doesn't catch on it). Blocks the box already overlaps don't
+    // stop it, so it can always move out of them. Unloaded chunks and everything below the world
+    // are solid.
+    extern Sweep sweep(const World::ChunkStore &store, const Math::Aabb &box, const Math::Vec3 &motion) noexcept;
+
+    // Broadphase for entities: a uniform grid of cubic cells, of which only the occupied ones are
+    // stored in a hash map. An entity is listed in every cell its box touches. Moving an entity only
+    // touches the map when its box enters or leaves a cell, so updating every moving entity once per
+    // tick is cheap.
+    class SpatialHash
+    {
+        public:
+            static constexpr float DEFAULT_CELL_SIZE {4.0f};
+        private:
+            struct CellRange
+            {
+                std::array<i32, 3> min {}, max {};
+                constexpr bool operator==(const CellRange &) const noexcept = default;
+            };
+
+            struct Entry
+            {
+                Entities::Entity entity {};
+                Math::Aabb box {};
+                CellRange cells {};
+            };
+
+            struct CellHash
+            {
+                usize operator()(u64 key) const noexcept { return static_cast<usize>((key * 0x9E3779B97F4A7C15ull) >> 16); }
+            };
+
+            static constexpr u32 ABSENT {~0u};
+
+            float inverse_cell_size {};
+            std::vector<Entry> entries {};
+            std::vector<u32> slots {}; // entry of every entity index, ABSENT if it isn't in the hash
+            std::unordered_map<u64, std::vector<u32>, CellHash> cells {}; // entity indices in every occupied cell
+
+            static constexpr u64 cell_key(i32 x, i32 y, i32 z) noexcept
+            {
+                constexpr u64 MASK {(1u << 21) - 1};
+                return (static_cast<u64>(x) & MASK) | ((static_cast<u64>(y) & MASK) << 21) | ((static_cast<u64>(z) & MASK) << 42);
+            }
+            CellRange cells_of(const Math::Aabb &box) const noexcept;
+            void insert_into_cells(u32 index, const CellRange &range) noexcept;
+            void remove_from_cells(u32 index, const CellRange &range) noexcept;
+        public:
+            explicit SpatialHash(float cell_size = DEFAULT_CELL_SIZE) noexcept : inverse_cell_size {1.0f / cell_size} {}
+
+            // Inserts the entity, or moves it to 'box' if it is already in the hash
+            void update(Entities::Entity entity, const Math::Aabb &box) noexcept;
+            void remove(Entities::Entity entity) noexcept;
+
+            // Appends every entity whose box intersects 'box' to 'out', each of them once. Doesn't
+            // modify the hash, so any number of threads can query at once.
+            void query(const Math::Aabb &box, std::vector<Entities::Entity> &out) const noexcept;
+
+            usize size() const noexcept { return entries.size(); }
+            usize cell_count() const noexcept { return cells.size(); }
+    };
+}
+
+#endif // MCVK_COLLISION_HPP
@@ -0,0 +1,31 @@
+#ifndef MCVK_COMPRESSION_HPP
+#define MCVK_COMPRESSION_HPP
+
+#include <span>
+#include <vector>
+#include "mcvk/types.hpp"
+
+// LZ4 block format codec. Streams are compatible with LZ4_decompress_safe, but there is no frame
+// format around them: the decompressed size has to be stored by the caller.
+namespace Compression
+{
+    // Level 1 only tries the last match found for every hash, which is close to LZ4's fast mode.
+    // Every further level doubles how many earlier matches are searched, trading compression
+    // speed for a smaller output. Decompression speed does not depend on the level.
+    static constexpr i32 MIN_LEVEL {1};
+    static constexpr i32 MAX_LEVEL {9};
+    static constexpr i32 DEFAULT_LEVEL {1};
+
+    // Worst case size of compressing 'size' bytes (incompressible data)
+    constexpr usize max_compressed_size(usize size) noexcept { return size + size / 255 + 16; }
+
+    // Appends the compressed stream to 'out', returns its size. 'level' is clamped to
+    // [MIN_LEVEL, MAX_LEVEL]. Thread-safe, every thread keeps its own match tables.
+    extern usize compress(std::span<const u8> input, std::vector<u8> &out, i32 level = DEFAULT_LEVEL) noexcept;
+
+    // Returns false if 'input' is malformed or does not decompress to exactly 'out.size()' bytes.
+    // Never reads or writes out of bounds, whatever 'input' contains.
+    [[nodiscard]] extern bool decompress(std::span<const u8> input, std::span<u8> out) noexcept;
+}
+
+#endif // MCVK_COMPRESSION_HPP
@@ -4,11 +4,12 @@
 #include <vulkan/vulkan.h>
 #include "mcvk/queue.hpp"
 #include "mcvk/vkcomponents.hpp"
+#include "mcvk/memory.hpp"
+#include "mcvk/pipelinecache.hpp"
 #include <GLFW/glfw3.h>
-#ifndef NDEBUG
-    #include <string>
-#endif
+#include <string>
 #include <set>
+#include <memory>
 
 namespace Device
 {
@@ -18,7 +19,9 @@ namespace Device
         VkPhysicalDeviceProperties properties {};
         VkPhysicalDeviceFeatures features {};
         VkMemoryHeap memory_heap {};
+        VkPhysicalDeviceMemoryProperties memory_properties {};
         Queue::QueueFamilyIndices queue_family_indices {};
+        bool draw_indirect_count {false}; // VK_KHR_draw_indirect_count is supported and will be enabled
     };
 
     class LogicalDevice
@@ -26,23 +29,55 @@ namespace Device
         private:
             inline static std::set<VkDevice> devices_in_use {};
             VkDevice device {VK_NULL_HANDLE};
+            VkPhysicalDevice physical_device {VK_NULL_HANDLE};
             VkQueue graphics_queue {};
             VkQueue presentation_queue {};
+            VkQueue transfer_queue {};
+            Queue::QueueFamilyIndices queue_family_indices {};
+            VkPhysicalDeviceFeatures features {};
+            VkPhysicalDeviceLimits limits {};
+            VkMemoryHeap memory_heap {};
+            bool draw_indirect_count {false};
+            u32 graphics_timestamp_bits {};
+            std::unique_ptr<Memory::Allocator> allocator {};
+            std::unique_ptr<PipelineCache> pipeline_cache {};
         public:
             constexpr LogicalDevice() noexcept = default;
             explicit LogicalDevice(const DeviceInfo &selected_device_info) noexcept;
-            constexpr LogicalDevice& operator=(LogicalDevice &&other) noexcept
+            LogicalDevice& operator=(LogicalDevice &&other) noexcept
             {
                 this->device = other.device;
+                this->physical_device = other.physical_device;
                 this->graphics_queue = other.graphics_queue;
+                this->presentation_queue = other.presentation_queue;
+                this->transfer_queue = other.transfer_queue;
+                this->queue_family_indices = other.queue_family_indices;
+                this->features = other.features;
+                this->limits = other.limits;
+                this->memory_heap = other.memory_heap;
+                this->draw_indirect_count = other.draw_indirect_count;
+                this->graphics_timestamp_bits = other.graphics_timestamp_bits;
+                this->allocator = std::move(other.allocator);
+                this->pipeline_cache = std::move(other.pipeline_cache);
 
                 other.device = VK_NULL_HANDLE;
                 return *this;
             }
-            constexpr explicit LogicalDevice(LogicalDevice &&other) noexcept
+            explicit LogicalDevice(LogicalDevice &&other) noexcept
             {
                 this->device = other.device;
+                this->physical_device = other.physical_device;
                 this->graphics_queue = other.graphics_queue;
+                this->presentation_queue = other.presentation_queue;
+                this->transfer_queue = other.transfer_queue;
+                this->queue_family_indices = other.queue_family_indices;
+                this->features = other.features;
+                this->limits = other.limits;
+                this->memory_heap = other.memory_heap;
+                this->draw_indirect_count = other.draw_indirect_count;
+                this->graphics_timestamp_bits = other.graphics_timestamp_bits;
+                this->allocator = std::move(other.allocator);
+                this->pipeline_cache = std::move(other.pipeline_cache);
 
                 other.device = VK_NULL_HANDLE;
             }
@@ -50,13 +85,33 @@ namespace Device
 
             ~LogicalDevice() noexcept; 
             constexpr auto get() const { return device; }
+            constexpr auto get_physical_device() const { return physical_device; }
+            constexpr auto get_graphics_queue() const { return graphics_queue; }
+            constexpr auto get_presentation_queue() const { return presentation_queue; }
+            // Same queue as the graphics queue if the device has no dedicated transfer family
+            constexpr auto get_transfer_queue() const { return transfer_queue; }
+            constexpr const auto &get_queue_family_indices() const { return queue_family_indices; }
+            // All device memory should be sub-allocated through this instead of calling vkAllocateMemory directly
+            auto &get_allocator() const { return *allocator; }
+            // Every pipeline should be created through this, it is persisted between launches
+            auto &get_pipeline_cache() const { return *pipeline_cache; }
+            // every feature the physical device supports is enabled
+            constexpr const auto &get_features() const { return features; }
+            constexpr const auto &get_limits() const { return limits; }
+            // the device local heap the device was selected by
+            constexpr const auto &get_memory_heap() const { return memory_heap; }
+            constexpr auto supports_draw_indirect_count() const { return draw_indirect_count; }
+            // valid bits of timestamps written on the graphics queue, zero if it has no timestamp support
+            constexpr auto get_graphics_timestamp_bits() const { return graphics_timestamp_bits; }
             static auto device_is_in_use(VkDevice device) noexcept
             {
                 return devices_in_use.find(device) != devices_in_use.end();
             }
     };
     
-    extern DeviceInfo select_physical_device(const VkComponents &components, GLFWwindow *window) noexcept;
+    // If 'prefer_cpu_device' is set, CPU implementations (e.g., lavapipe) are rated above
+    // GPUs. This keeps headless benchmarks and regression tests on the same device everywhere.
+    extern DeviceInfo select_physical_device(const VkComponents &components, bool prefer_cpu_device = false) noexcept;
 }
 
 #endif // MCVK_DEVICE_HPP
@@ -0,0 +1,286 @@
+#ifndef MCVK_ENTITIES_HPP
+#define MCVK_ENTITIES_HPP
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/jobs.hpp"
+
+// Entity component storage for mobs, items and particles. Every component type lives in its own
+// sparse set: the components are packed into one array without gaps, next to an array of the
+// entities owning them, and a sparse array indexed by entity finds an entity's slot. Updating one
+// component of every entity walks a single dense array, and a query over several components walks
+// the smallest of their arrays.
+//
+// Entities are indices with a generation. Destroying an entity bumps the generation of its index
+// before the index is reused, so handles to destroyed entities are detected instead of silently
+// referring to whatever entity got the index next.
+namespace Entities
+{
+    struct Entity
+    {
+        static constexpr u32 INVALID_INDEX {~0u};
+
+        u32 index {INVALID_INDEX};
+        u32 generation {};
+
+        constexpr bool operator==(const Entity &) const noexcept = default;
+    };
+
+    // The bookkeeping shared by the pools of every component type, which doesn't depend on the type
+    class PoolBase
+    {
+        protected:
+            static constexpr u32 ABSENT {~0u};
+
+            std::vector<u32> sparse {};   // slot of every entity index, ABSENT if it has no component
+            std::vector<u32> entities {}; // entity index of every slot
+
+            // Adds a slot for 'index' at the end, the caller appends the component
+            void insert_slot(u32 index) noexcept
+            {
+                if (index >= sparse.size())
+                    sparse.resize(index + 1, ABSENT);
+                sparse[index] = static_cast<u32>(entities.size());
+                entities.push_back(index);
+            }
+        public:
+            PoolBase() noexcept = default;
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(PoolBase)
+            virtual ~PoolBase() noexcept = default;
+
+            // Does nothing if the entity has no such component
+            virtual void remove(u32 index) noexcept = 0;
+            // Moves the components of the entities in 'order' to the front, in that order
+            virtual void arrange(std::span<const u32> order) noexcept = 0;
+
+            bool contains(u32 index) const noexcept { return index < sparse.size() && sparse[index] != ABSENT; }
+            usize size() const noexcept { return entities.size(); }
+            std::span<const u32> get_entities() const noexcept { return entities; }
+
+            // Slot of an entity in the pool, ABSENT if it has no component. Queries pass the slot
+            // the entity has in the pool they iterate as 'hint', which is the right one in pools
+            // arranged alike and saves the lookup in the sparse array.
+            u32 slot_of(u32 index, u32 hint) const noexcept
+            {
+                if (hint < entities.size() && entities[hint] == index)
+                    return hint;
+                return (index < sparse.size()) ? sparse[index] : ABSENT;
+            }
+    };
+
+    template<typename T>
+    class Pool final : public PoolBase
+    {
+        private:
+            std::vector<T> components {};
+
+            void swap_slots(u32 a, u32 b) noexcept
+            {
+                std::swap(components[a], components[b]);
+                std::swap(entities[a], entities[b]);
+                sparse[entities[a]] = a;
+                sparse[entities[b]] = b;
+            }
+        public:
+            T &add(u32 index, T component) noexcept
+            {
+                if (contains(index))
+                    return components[sparse[index]] = std::move(component);
+                insert_slot(index);
+                return components.emplace_back(std::move(component));
+            }
+
+            // The last component takes the place of the removed one
+            void remove(u32 index) noexcept override
+            {
+                if (!contains(index))
+                    return;
+                const auto slot = sparse[index];
+                const auto last = static_cast<u32>(entities.size() - 1);
+                if (slot != last) {
+                    components[slot] = std::move(components[last]);
+                    entities[slot] = entities[last];
+                    sparse[entities[slot]] = slot;
+                }
+                components.pop_back();
+                entities.pop_back();
+                sparse[index] = ABSENT;
+            }
+
+            void arrange(std::span<const u32> order) noexcept override
+            {
+                u32 next {};
+                for (const auto index : order)
+                    if (contains(index))
+                        swap_slots(sparse[index], next++);
+            }
+
+            T *get(u32 index) noexcept { return contains(index) ? &components[sparse[index]] : nullptr; }
+            T &at_slot(u32 slot) noexcept { return components[slot]; }
+            T *find(u32 index, u32 hint) noexcept
+            {
+                const auto slot = slot_of(index, hint);
+                return (slot != ABSENT) ? &components[slot] : nullptr;
+            }
+            std::span<T> get_components() noexcept { return components; }
+    };
+
+    // Owns every entity and the pools of their components. Adding or removing entities or components
+    // is not thread-safe, and must not happen while a query is running.
+    class Registry
+    {
+        private:
+            std::vector<u32> generations {}; // of every entity index, bumped when its entity is destroyed
+            std::vector<u32> free_indices {};
+            std::vector<std::unique_ptr<PoolBase>> pools {}; // indexed by component type id
+            usize alive_count {};
+
+            // ids are handed out on first use, in no particular order
+            static usize next_type_id() noexcept;
+            template<typename T>
+            static usize type_id() noexcept
+            {
+                static const usize id {next_type_id()};
+                return id;
+            }
+
+            template<typename T>
+            Pool<T> *find_pool() noexcept
+            {
+                const auto id = type_id<T>();
+                return (id < pools.size()) ? static_cast<Pool<T> *>(pools[id].get()) : nullptr;
+            }
+
+            // The pool with the fewest components drives a query, a missing pool ends it
+            template<typename... Components>
+            const PoolBase *smallest_pool(const std::array<PoolBase *, sizeof...(Components)> &query_pools) const noexcept
+            {
+                const PoolBase *smallest {query_pools[0]};
+                for (const auto *pool : query_pools) {
+                    if (pool == nullptr)
+                        return nullptr;
+                    if (pool->size() < smallest->size())
+                        smallest = pool;
+                }
+                return smallest;
+            }
+
+            template<typename... Components, typename Function>
+            void each_in(std::tuple<Pool<Components> *...> query_pools, std::span<const u32> entities, u32 first_slot, Function &function) noexcept
+            {
+                // arranged pools hold the same entities in the same slots, their arrays are read in
+                // order without looking at any other entity
+                const auto arranged_like = [entities, first_slot](const PoolBase *pool) {
+                    const auto others = pool->get_entities();
+                    return first_slot + entities.size() <= others.size() &&
+                           std::equal(entities.begin(), entities.end(), others.begin() + first_slot);
+                };
+                if ((arranged_like(std::get<Pool<Components> *>(query_pools)) && ...)) {
+                    for (u32 i {}; i < entities.size(); ++i)
+                        function(Entity{.index = entities[i], .generation = generations[entities[i]]},
+                                 std::get<Pool<Components> *>(query_pools)->at_slot(first_slot + i)...);
+                    return;
+                }
+
+                for (u32 i {}; i < entities.size(); ++i) {
+                    const auto index = entities[i];
+                    const std::tuple<Components *...> found {std::get<Pool<Components> *>(query_pools)->find(index, first_slot + i)...};
+                    if (!((std::get<Components *>(found) != nullptr) && ...))
+                        continue;
+                    function(Entity{.index = index, .generation = generations[index]}, *std::get<Components *>(found)...);
+                }
+            }
+        public:
+            Registry() noexcept = default;
+            DELETE_NON_COPYABLE_DEFAULT(Registry)
+
+            Entity create() noexcept;
+            // Removes every component of the entity, does nothing for stale handles
+            void destroy(Entity entity) noexcept;
+            bool is_alive(Entity entity) const noexcept
+            {
+                return entity.index < generations.size() && generations[entity.index] == entity.generation;
+            }
+            usize size() const noexcept { return alive_count; }
+
+            template<typename T>
+            Pool<T> &pool() noexcept
+            {
+                const auto id = type_id<T>();
+                if (id >= pools.size())
+                    pools.resize(id + 1);
+                if (pools[id] == nullptr)
+                    pools[id] = std::make_unique<Pool<T>>();
+                return static_cast<Pool<T> &>(*pools[id]);
+            }
+
+            // Replaces the component if the entity already has one. The entity must be alive.
+            template<typename T>
+            T &add(Entity entity, T component) noexcept { return pool<T>().add(entity.index, std::move(component)); }
+            template<typename T>
+            void remove(Entity entity) noexcept
+            {
+                if (auto *found = find_pool<T>(); found != nullptr && is_alive(entity))
+                    found->remove(entity.index);
+            }
+            // nullptr if the entity is gone or has no such component
+            template<typename T>
+            T *get(Entity entity) noexcept
+            {
+                auto *found = find_pool<T>();
+                return (found != nullptr && is_alive(entity)) ? found->get(entity.index) : nullptr;
+            }
+
+            // Arranges the pools of the other components like the pool of 'Leader', so the entities
+            // having all of them sit in the same slots of every pool and queries over them read every
+            // array in order. Worth calling after many entities have come and gone.
+            template<typename Leader, typename... Others>
+            void arrange() noexcept
+            {
+                const auto order = pool<Leader>().get_entities();
+                (pool<Others>().arrange(order), ...);
+            }
+
+            // Calls 'function(Entity, Components &...)' for every entity having all the components
+            template<typename... Components, typename Function>
+            void each(Function &&function) noexcept
+            {
+                const std::array<PoolBase *, sizeof...(Components)> query_pools {find_pool<Components>()...};
+                const auto *driver = smallest_pool<Components...>(query_pools);
+                if (driver != nullptr)
+                    each_in<Components...>({find_pool<Components>()...}, driver->get_entities(), 0, function);
+            }
+
+            // Same as 'each', split into jobs of 'batch_size' entities. 'function' is called from
+            // several threads at once, but never twice for the same entity. Returns once every job
+            // has finished.
+            template<typename... Components, typename Function>
+            void parallel_each(Jobs::JobSystem &job_system, Function &&function, usize batch_size = 4096) noexcept
+            {
+                const std::array<PoolBase *, sizeof...(Components)> query_pools {find_pool<Components>()...};
+                const auto *driver = smallest_pool<Components...>(query_pools);
+                if (driver == nullptr)
+                    return;
+
+                const auto entities = driver->get_entities();
+                const std::tuple<Pool<Components> *...> typed_pools {find_pool<Components>()...};
+                Jobs::Counter done {};
+                for (usize first {}; first < entities.size(); first += batch_size) {
+                    const auto batch = entities.subspan(first, std::min(batch_size, entities.size() - first));
+                    job_system.schedule([this, &function, typed_pools, batch, first] {
+                        each_in<Components...>(typed_pools, batch, static_cast<u32>(first), function);
+                    }, &done);
+                }
+                job_system.wait(done);
+            }
+    };
+}
+
+#endif // MCVK_ENTITIES_HPP
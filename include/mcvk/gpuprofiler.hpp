@@ -0,0 +1,79 @@
+#ifndef MCVK_GPUPROFILER_HPP
+#define MCVK_GPUPROFILER_HPP
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/device.hpp"
+#include "mcvk/profiler.hpp"
+
+// Timestamp queries around parts of the renderer's frame command buffers. Every frame in flight
+// owns a query pool, which is read back after the frame's fence has been waited on, so reading
+// the results never stalls. Devices whose graphics queue has no timestamp support aren't profiled.
+class GpuProfiler
+{
+    private:
+        struct Slot
+        {
+            VkQueryPool query_pool {VK_NULL_HANDLE};
+            u64 frame {};     // profiler frame the queries were written in, zero if there are no results
+            i64 submit_ns {}; // CPU time the frame's command buffer was finished at
+            // zone i uses queries 2i and 2i + 1, zone 0 is the whole frame
+            std::vector<const char *> names {};
+        };
+        VkDevice device {VK_NULL_HANDLE};
+        double timestamp_period {}; // nanoseconds per tick
+        u64 timestamp_mask {};      // zero if timestamps are not supported
+        std::vector<Slot> slots {};
+        Slot *recording {nullptr};
+        std::vector<u64> results {};
+        std::vector<Profiler::GpuZone> zones {};
+    public:
+        static constexpr u32 MAX_ZONES {32}; // per frame, further zones are ignored
+        static constexpr u32 NO_ZONE {~0u};
+
+        GpuProfiler(const Device::LogicalDevice &logical_device, u32 frames_in_flight) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(GpuProfiler)
+        ~GpuProfiler() noexcept;
+
+        constexpr bool is_supported() const noexcept { return Profiler::ENABLED && timestamp_mask != 0; }
+
+        // Hands the results of the last frame recorded in 'frame_slot' to the profiler. The slot's
+        // fence must have been waited on.
+        void collect(u32 frame_slot) noexcept;
+
+        // Resets the slot's queries and opens the frame zone, must be recorded outside of a render pass
+        void begin_frame(u32 frame_slot, VkCommandBuffer command_buffer) noexcept;
+
+        // Closes the frame zone, every other zone has to be closed before
+        void end_frame(VkCommandBuffer command_buffer) noexcept;
+
+        // Zones can't be opened or closed inside a render pass whose contents are secondary command
+        // buffers. 'name' must outlive the profiler (string literals).
+        [[nodiscard]] u32 begin_zone(VkCommandBuffer command_buffer, const char *name) noexcept;
+        void end_zone(VkCommandBuffer command_buffer, u32 zone) noexcept;
+
+        // Use PROFILE_GPU_ZONE instead, which compiles to nothing when profiling is disabled
+        class ScopedZone
+        {
+            private:
+                GpuProfiler *profiler {};
+                VkCommandBuffer command_buffer {};
+                u32 zone {};
+            public:
+                ScopedZone(GpuProfiler &pprofiler, VkCommandBuffer ccommand_buffer, const char *name) noexcept :
+                    profiler {&pprofiler}, command_buffer {ccommand_buffer}, zone {pprofiler.begin_zone(ccommand_buffer, name)} {}
+                DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(ScopedZone)
+                ~ScopedZone() noexcept { profiler->end_zone(command_buffer, zone); }
+        };
+};
+
+#if MCVK_PROFILE
+    #define PROFILE_GPU_ZONE(profiler, command_buffer, name) \
+        const GpuProfiler::ScopedZone MCVK_PROFILE_CONCAT(gpu_profile_zone_, __LINE__) {profiler, command_buffer, name}
+#else
+    #define PROFILE_GPU_ZONE(profiler, command_buffer, name) static_cast<void>(0)
+#endif
+
+#endif // MCVK_GPUPROFILER_HPP
@@ -0,0 +1,117 @@
+#ifndef MCVK_JOBS_HPP
+#define MCVK_JOBS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+
+namespace Jobs
+{
+    using Job = std::function<void()>;
+
+    enum class Affinity
+    {
+        Any,
+        // GLFW (and anything else that is not thread-safe) may only be used from the main thread,
+        // these jobs run in 'run_main_thread_jobs' or while the main thread waits on a counter
+        MainThread
+    };
+
+    class JobSystem;
+
+    // Counts the unfinished jobs scheduled with it. Jobs can be made to wait for a counter to
+    // reach zero, which is how dependencies between jobs are expressed.
+    class Counter
+    {
+        private:
+            friend class JobSystem;
+
+            struct Dependent
+            {
+                Job job {};
+                Counter *counter {};
+                Affinity affinity {};
+            };
+
+            std::atomic<u32> pending {};
+            std::mutex mutex {};
+            std::vector<Dependent> dependents {};
+        public:
+            Counter() noexcept = default;
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Counter)
+
+            bool is_done() const noexcept { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    // Work-stealing thread pool. Every worker owns a deque: jobs scheduled from a worker are pushed
+    // to and popped from the back of its own deque (so related work stays in its cache) while idle
+    // workers steal from the front of the others. The thread constructing the job system counts as
+    // the main thread, worker 0, and only runs jobs while it waits on a counter. Other threads may
+    // schedule and wait for jobs, but never run any.
+    class JobSystem
+    {
+        private:
+            struct Entry
+            {
+                Job job {};
+                Counter *counter {};
+            };
+
+            struct Worker
+            {
+                std::mutex mutex {};
+                std::deque<Entry> jobs {};
+            };
+
+            std::vector<std::unique_ptr<Worker>> workers {};
+            std::vector<std::thread> threads {};
+
+            std::mutex main_thread_mutex {};
+            std::deque<Entry> main_thread_jobs {};
+
+            // sleeping workers are woken through this when jobs are queued
+            std::mutex sleep_mutex {};
+            std::condition_variable wake {};
+            std::atomic<usize> queued {};
+            std::atomic<bool> running {true};
+
+            void push(Entry entry, Affinity affinity) noexcept;
+            bool try_pop(u32 index, Entry &entry) noexcept;
+            bool try_pop_main_thread(Entry &entry) noexcept;
+            void execute(Entry &entry) noexcept;
+            void worker_loop(u32 index) noexcept;
+        public:
+            // 'thread_count' includes the main thread, 0 uses every hardware thread
+            explicit JobSystem(u32 thread_count = 0) noexcept;
+            // Jobs that have not started yet are discarded
+            ~JobSystem() noexcept;
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(JobSystem)
+
+            // 'counter' is incremented now and decremented once the job has finished
+            void schedule(Job job, Counter *counter = nullptr, Affinity affinity = Affinity::Any) noexcept;
+            // Same as 'schedule', but the job is only queued once 'dependency' reaches zero
+            void schedule_after(Counter &dependency, Job job, Counter *counter = nullptr, Affinity affinity = Affinity::Any) noexcept;
+
+            // Runs queued jobs on the calling thread until 'counter' reaches zero
+            void wait(Counter &counter) noexcept;
+
+            // Runs every queued main thread job, should be called once per frame. Returns false if
+            // there was nothing to run.
+            bool run_main_thread_jobs() noexcept;
+
+            u32 thread_count() const noexcept { return static_cast<u32>(workers.size()); }
+
+            // Index of the calling worker in [0, thread_count()), 0 for the main thread. Useful for
+            // per-worker scratch memory. Fatal on threads outside the job system.
+            static u32 worker_index() noexcept;
+    };
+}
+
+#endif // MCVK_JOBS_HPP
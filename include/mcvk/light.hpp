@@ -0,0 +1,94 @@
+#ifndef MCVK_LIGHT_HPP
+#define MCVK_LIGHT_HPP
+
+#include <span>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/world.hpp"
+#include "mcvk/jobs.hpp"
+
+// Flood fill lighting with two channels of 16 levels. Block light starts at emitting blocks and
+// sky light at the top of the world, where it travels straight down without losing a level until
+// it hits an opaque block. Both lose a level per block everywhere else and never enter opaque
+// blocks. Light is stored in the sections (see World::Section::get_light).
+//
+// Placing or breaking a block doesn't relight anything beyond the light it changes: a removal
+// pass clears the light the old block let through or gave off, bounded by where brighter light
+// from elsewhere takes over, and an addition pass floods back from that border and from the new
+// block. Light fades out within 15 blocks horizontally, so both passes stay within the chunks
+// next to the changed one, and batches of changes in chunks at least 3 chunks apart are run in
+// parallel.
+namespace Lighting
+{
+    inline constexpr u8 MAX_LIGHT {15};
+
+    enum class Channel : u8
+    {
+        Block,
+        Sky
+    };
+
+    constexpr u8 pack_light(u8 block, u8 sky) noexcept { return static_cast<u8>(block | (sky << 4)); }
+    constexpr u8 block_light(u8 packed) noexcept { return packed & 0x0F; }
+    constexpr u8 sky_light(u8 packed) noexcept { return packed >> 4; }
+
+    // Packed light at world coordinates. Unloaded chunks are dark, above the world is open sky.
+    extern u8 get_light(const World::ChunkStore &store, i32 x, i32 y, i32 z) noexcept;
+
+    // Keeps the light of a chunk store up to date. Changes are queued and applied in batches on the
+    // job system, chunks must neither be loaded, unloaded nor modified elsewhere during 'process'.
+    // Unloaded chunks are treated as dark and opaque, so light doesn't leak into them.
+    class LightEngine
+    {
+        public:
+            struct Statistics
+            {
+                u64 block_changes {};
+                u64 columns {};
+                u64 light_writes {}; // blocks whose light was written, the work both passes did
+            };
+        private:
+            struct BlockChange
+            {
+                i32 x {}, y {}, z {};
+                World::BlockId id {};
+            };
+
+            // BFS queues, one set per worker, reused between batches
+            struct Scratch
+            {
+                std::vector<u32> additions {};
+                std::vector<u64> removals {};
+                u64 light_writes {};
+            };
+
+            World::ChunkStore &store;
+            std::vector<BlockChange> changes {};
+            std::vector<World::ChunkPos> columns {};
+            std::vector<Scratch> scratch {};
+            Statistics statistics {};
+
+            void light_column(World::ChunkPos pos, Scratch &worker_scratch) noexcept;
+            void apply_changes(World::ChunkPos pos, std::span<const BlockChange> chunk_changes, Scratch &worker_scratch) noexcept;
+        public:
+            explicit LightEngine(World::ChunkStore &chunk_store) noexcept : store {chunk_store} {}
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(LightEngine)
+
+            // Sets the block once the batch is processed and updates the light around it
+            void queue_block_change(i32 x, i32 y, i32 z, World::BlockId id) noexcept;
+            // Lights a column from scratch and spreads its light into the loaded chunks next to it,
+            // for chunks that were just generated or loaded. Light the column may have spread into
+            // its neighbours before is not taken back.
+            void queue_column(World::ChunkPos pos) noexcept;
+            bool has_pending() const noexcept { return !changes.empty() || !columns.empty(); }
+
+            // Lights the queued columns, then applies the queued block changes in the order they
+            // were queued within each chunk. Returns once everything is done.
+            void process(Jobs::JobSystem &job_system) noexcept;
+
+            constexpr const auto &get_statistics() const noexcept { return statistics; }
+    };
+}
+
+#endif // MCVK_LIGHT_HPP
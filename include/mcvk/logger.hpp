@@ -1,30 +1,191 @@
 #ifndef MCVK_LOGGER_HPP
 #define MCVK_LOGGER_HPP
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include "types.hpp"
+#include "global.hpp"
 
+// Messages are formatted and written on a background thread. A call only copies the format string
+// pointer and its arguments into a ring buffer owned by the calling thread, so it never blocks on
+// stdio or allocates. It takes no lock either, except on a thread's first message, which registers
+// its ring. If the ring is full, the call yields until the background thread has caught up.
+// '{}' is the only placeholder. Format strings have to be string literals, which is checked at
+// compile time along with the number of arguments.
 namespace Logger
 {
-    // for unrecoverable errors
-    [[noreturn]] extern void fatal_error(const char *msg) noexcept;
+    enum class Level : u8
+    {
+        Diagnostic, // differentiates messages of the vk debug messenger from our own
+        Info,
+        Warning,
+        Error,      // recoverable errors
+        Fatal       // unrecoverable errors, the process exits
+    };
 
-    // for recoverable errors
-    extern void error(const char *msg) noexcept;
+    // Calls below this level are compiled out entirely, arguments included. Override with
+    // -DMCVK_LOG_LEVEL=<0-4>.
+    #ifdef MCVK_LOG_LEVEL
+        static constexpr Level MIN_LEVEL {static_cast<Level>(MCVK_LOG_LEVEL)};
+    #else
+        static constexpr Level MIN_LEVEL {(Global::IS_DEBUG_BUILD) ? Level::Diagnostic : Level::Error};
+    #endif
+    static_assert(MIN_LEVEL <= Level::Fatal, "Fatal errors can't be compiled out");
 
+    template<typename... Args>
+    struct FormatString
+    {
+        const char *text {};
 
-    #ifndef NDEBUG
-        // does not serve any purpose other than being used to differentiate logging 
-        // and diagnostic messages in the vk debug messenger
-        extern void diagnostic(const char *msg) noexcept;
+        // NOLINTNEXTLINE(google-explicit-constructor)
+        consteval FormatString(const char *ttext) : text {ttext}
+        {
+            usize placeholders {};
+            for (const char *c {ttext}; *c != '\0'; ++c) {
+                if (c[0] == '{' && c[1] == '}') {
+                    ++placeholders;
+                    ++c;
+                }
+            }
+            if (placeholders != sizeof...(Args))
+                throw "The number of '{}' placeholders does not match the number of arguments";
+        }
+    };
 
-        // for logging messages, debugging, etc.
-        extern void info(const char *msg) noexcept;
+    // Keeps the arguments from being deduced from the format string
+    template<typename... Args>
+    using Format = FormatString<std::type_identity_t<Args>...>;
 
-        // for warnings
-        extern void warning(const char *msg) noexcept;
-        
-    #endif
+    namespace Detail
+    {
+        enum class Tag : u8
+        {
+            Signed,
+            Unsigned,
+            Float,
+            Bool,
+            String,
+            Pointer
+        };
+
+        // Longer strings are truncated
+        static constexpr usize MAX_PAYLOAD {1024};
+
+        // Arguments encoded on the caller's stack, decoded again on the logger thread
+        struct Payload
+        {
+            std::array<u8, MAX_PAYLOAD> bytes; // NOLINT(cppcoreguidelines-pro-type-member-init), never read before written
+            usize size {};
+
+            template<typename T>
+            void put_value(Tag tag, T value) noexcept
+            {
+                if (size + 1 + sizeof(T) > MAX_PAYLOAD) [[unlikely]]
+                    return;
+                bytes[size++] = static_cast<u8>(tag);
+                std::memcpy(&bytes[size], &value, sizeof(T));
+                size += sizeof(T);
+            }
+
+            void put_string(std::string_view string) noexcept
+            {
+                if (size + 1 + sizeof(u16) > MAX_PAYLOAD) [[unlikely]]
+                    return;
+                const auto length = static_cast<u16>(std::min(string.size(), MAX_PAYLOAD - size - 1 - sizeof(u16)));
+                bytes[size++] = static_cast<u8>(Tag::String);
+                std::memcpy(&bytes[size], &length, sizeof(length));
+                size += sizeof(length);
+                std::memcpy(&bytes[size], string.data(), length);
+                size += length;
+            }
+        };
+
+        template<typename T>
+        void encode(Payload &payload, const T &arg) noexcept
+        {
+            using Type = std::decay_t<T>;
+            if constexpr (std::is_same_v<Type, bool>)
+                payload.put_value(Tag::Bool, static_cast<u8>(arg));
+            else if constexpr (std::is_enum_v<Type>)
+                encode(payload, static_cast<std::underlying_type_t<Type>>(arg));
+            else if constexpr (std::is_integral_v<Type> && std::is_signed_v<Type>)
+                payload.put_value(Tag::Signed, static_cast<i64>(arg));
+            else if constexpr (std::is_integral_v<Type>)
+                payload.put_value(Tag::Unsigned, static_cast<u64>(arg));
+            else if constexpr (std::is_floating_point_v<Type>)
+                payload.put_value(Tag::Float, static_cast<double>(arg));
+            else if constexpr (std::is_same_v<Type, const char *> || std::is_same_v<Type, char *>)
+                payload.put_string((arg != nullptr) ? std::string_view{arg} : std::string_view{"(null)"});
+            else if constexpr (std::is_convertible_v<const T &, std::string_view>)
+                payload.put_string(std::string_view{arg});
+            else if constexpr (std::is_pointer_v<Type>)
+                payload.put_value(Tag::Pointer, reinterpret_cast<u64>(arg));
+            else
+                static_assert(!sizeof(T), "Unsupported log argument type");
+        }
+
+        // Copies the message into the calling thread's ring buffer. Only waits if the logger
+        // thread has fallen so far behind that the ring is full.
+        extern void submit(Level level, const char *format, const Payload &payload) noexcept;
+
+        // Writes out every submitted message and exits
+        [[noreturn]] extern void terminate() noexcept;
+
+        template<Level LEVEL, typename... Args>
+        void log(const char *format, const Args &...args) noexcept
+        {
+            if constexpr (LEVEL >= MIN_LEVEL) {
+                Payload payload;
+                (encode(payload, args), ...);
+                submit(LEVEL, format, payload);
+            }
+        }
+    }
+
+    template<typename... Args>
+    [[noreturn]] void fatal_error(Format<Args...> format, const Args &...args) noexcept
+    {
+        Detail::log<Level::Fatal>(format.text, args...);
+        Detail::terminate();
+    }
+
+    template<typename... Args>
+    void error(Format<Args...> format, const Args &...args) noexcept
+    {
+        Detail::log<Level::Error>(format.text, args...);
+    }
+
+    template<typename... Args>
+    void warning(Format<Args...> format, const Args &...args) noexcept
+    {
+        Detail::log<Level::Warning>(format.text, args...);
+    }
+
+    template<typename... Args>
+    void info(Format<Args...> format, const Args &...args) noexcept
+    {
+        Detail::log<Level::Info>(format.text, args...);
+    }
+
+    template<typename... Args>
+    void diagnostic(Format<Args...> format, const Args &...args) noexcept
+    {
+        Detail::log<Level::Diagnostic>(format.text, args...);
+    }
+
+    // Blocks until every message submitted before the call has been written
+    extern void flush() noexcept;
+
+    // Additionally writes every message as a line of JSON to 'path' (truncated first), nullptr
+    // closes the sink again. Returns false if the file can't be opened.
+    extern bool open_json_sink(const char *path) noexcept;
 
+    // The console is written to by default, turning it off is mostly useful for benchmarks
+    extern void set_console_enabled(bool enabled) noexcept;
 }
 
 #endif // MCVK_LOGGER_HPP
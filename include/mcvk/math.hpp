@@ -0,0 +1,175 @@
+#ifndef MCVK_MATH_HPP
+#define MCVK_MATH_HPP
+
+#include <array>
+#include <cmath>
+#include "mcvk/types.hpp"
+
+// Just enough linear algebra for the camera and culling. The world is right-handed with +y up,
+// matrices are column-major so they can be copied into GLSL uniforms as they are.
+namespace Math
+{
+    struct Vec3
+    {
+        float x {}, y {}, z {};
+
+        constexpr Vec3 operator+(const Vec3 &o) const noexcept { return {x + o.x, y + o.y, z + o.z}; }
+        constexpr Vec3 operator-(const Vec3 &o) const noexcept { return {x - o.x, y - o.y, z - o.z}; }
+        constexpr Vec3 operator*(float s) const noexcept { return {x * s, y * s, z * s}; }
+        constexpr bool operator==(const Vec3 &) const noexcept = default;
+    };
+
+    struct Vec4
+    {
+        float x {}, y {}, z {}, w {};
+    };
+
+    constexpr float dot(const Vec3 &a, const Vec3 &b) noexcept { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    constexpr Vec3 cross(const Vec3 &a, const Vec3 &b) noexcept
+    {
+        return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+    }
+    inline float length(const Vec3 &v) noexcept { return std::sqrt(dot(v, v)); }
+    inline Vec3 normalize(const Vec3 &v) noexcept
+    {
+        const auto len = length(v);
+        return (len > 0.0f) ? v * (1.0f / len) : v;
+    }
+
+    struct Mat4
+    {
+        std::array<float, 16> m {}; // m[column * 4 + row]
+
+        constexpr float &at(usize column, usize row) noexcept { return m[column * 4 + row]; }
+        constexpr float at(usize column, usize row) const noexcept { return m[column * 4 + row]; }
+
+        static constexpr Mat4 identity() noexcept
+        {
+            Mat4 result {};
+            result.at(0, 0) = result.at(1, 1) = result.at(2, 2) = result.at(3, 3) = 1.0f;
+            return result;
+        }
+
+        constexpr Mat4 operator*(const Mat4 &o) const noexcept
+        {
+            Mat4 result {};
+            for (usize c {}; c < 4; ++c)
+                for (usize r {}; r < 4; ++r)
+                    for (usize k {}; k < 4; ++k)
+                        result.at(c, r) += at(k, r) * o.at(c, k);
+            return result;
+        }
+
+        constexpr Vec4 row(usize r) const noexcept { return {at(0, r), at(1, r), at(2, r), at(3, r)}; }
+    };
+
+    // Vulkan clip space: depth in [0, 1] and y pointing down, so the y axis is flipped here. With
+    // the flip, faces that are counter-clockwise in world space stay counter-clockwise on screen.
+    inline Mat4 perspective(float fov_y, float aspect, float near, float far) noexcept
+    {
+        const auto f = 1.0f / std::tan(fov_y * 0.5f);
+        Mat4 result {};
+        result.at(0, 0) = f / aspect;
+        result.at(1, 1) = -f;
+        result.at(2, 2) = far / (near - far);
+        result.at(2, 3) = -1.0f;
+        result.at(3, 2) = (near * far) / (near - far);
+        return result;
+    }
+
+    inline Mat4 look_at(const Vec3 &eye, const Vec3 &center, const Vec3 &up) noexcept
+    {
+        const auto f = normalize(center - eye);
+        const auto s = normalize(cross(f, up));
+        const auto u = cross(s, f);
+
+        auto result = Mat4::identity();
+        result.at(0, 0) = s.x;
+        result.at(1, 0) = s.y;
+        result.at(2, 0) = s.z;
+        result.at(0, 1) = u.x;
+        result.at(1, 1) = u.y;
+        result.at(2, 1) = u.z;
+        result.at(0, 2) = -f.x;
+        result.at(1, 2) = -f.y;
+        result.at(2, 2) = -f.z;
+        result.at(3, 0) = -dot(s, eye);
+        result.at(3, 1) = -dot(u, eye);
+        result.at(3, 2) = dot(f, eye);
+        return result;
+    }
+
+    // Axis aligned box, 'min' is below 'max' on every axis
+    struct Aabb
+    {
+        Vec3 min {}, max {};
+
+        // Boxes that only touch don't intersect
+        constexpr bool intersects(const Aabb &o) const noexcept
+        {
+            return min.x < o.max.x && max.x > o.min.x && min.y < o.max.y && max.y > o.min.y && min.z < o.max.z && max.z > o.min.z;
+        }
+        constexpr Aabb translated(const Vec3 &offset) const noexcept { return {min + offset, max + offset}; }
+    };
+
+    // Planes are stored as (normal, distance) with the normal pointing into the frustum
+    struct Frustum
+    {
+        std::array<Vec4, 6> planes {};
+
+        // Extracts the planes from a view projection matrix (Gribb & Hartmann, adapted to a
+        // [0, 1] depth range)
+        static Frustum from_matrix(const Mat4 &view_projection) noexcept
+        {
+            const auto r0 = view_projection.row(0), r1 = view_projection.row(1);
+            const auto r2 = view_projection.row(2), r3 = view_projection.row(3);
+            Frustum frustum {};
+            frustum.planes = {{
+                {r3.x + r0.x, r3.y + r0.y, r3.z + r0.z, r3.w + r0.w},
+                {r3.x - r0.x, r3.y - r0.y, r3.z - r0.z, r3.w - r0.w},
+                {r3.x + r1.x, r3.y + r1.y, r3.z + r1.z, r3.w + r1.w},
+                {r3.x - r1.x, r3.y - r1.y, r3.z - r1.z, r3.w - r1.w},
+                {r2.x, r2.y, r2.z, r2.w},
+                {r3.x - r2.x, r3.y - r2.y, r3.z - r2.z, r3.w - r2.w},
+            }};
+            return frustum;
+        }
+
+        // Conservative, boxes near the frustum corners may be reported as visible
+        constexpr bool intersects_box(const Vec3 &min, const Vec3 &max) const noexcept
+        {
+            for (const auto &p : planes) {
+                // the corner furthest along the plane normal
+                const Vec3 corner {
+                    (p.x >= 0.0f) ? max.x : min.x,
+                    (p.y >= 0.0f) ? max.y : min.y,
+                    (p.z >= 0.0f) ? max.z : min.z
+                };
+                if (p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0.0f)
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    struct Camera
+    {
+        Vec3 position {};
+        float yaw {};   // radians, 0 looks along -z
+        float pitch {}; // radians, positive looks up
+        float fov_y {1.2f};
+        float near {0.1f};
+        float far {1000.0f};
+
+        Vec3 forward() const noexcept
+        {
+            return {std::sin(yaw) * std::cos(pitch), std::sin(pitch), -std::cos(yaw) * std::cos(pitch)};
+        }
+        Mat4 view_projection(float aspect) const noexcept
+        {
+            return perspective(fov_y, aspect, near, far) * look_at(position, position + forward(), {0.0f, 1.0f, 0.0f});
+        }
+    };
+}
+
+#endif // MCVK_MATH_HPP
@@ -0,0 +1,140 @@
+#ifndef MCVK_MEMORY_HPP
+#define MCVK_MEMORY_HPP
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <map>
+#include <span>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+
+namespace Memory
+{
+    // Determines which memory type an allocation is placed in
+    enum class Usage : u8
+    {
+        GpuOnly,    // device local memory, never touched by the CPU (meshes, textures)
+        CpuToGpu,   // host visible memory that is written by the CPU and read by the GPU (staging, uniforms)
+        GpuToCpu    // host visible memory that is written by the GPU and read back by the CPU (queries, screenshots)
+    };
+
+    // Linear resources (buffers, linear images) and optimal images are never placed in the same
+    // block, which avoids having to deal with 'bufferImageGranularity' entirely.
+    enum class ResourceKind : u8
+    {
+        Linear,
+        Optimal
+    };
+
+    struct Range
+    {
+        VkDeviceSize size {};
+        VkDeviceSize alignment {};
+    };
+
+    struct Block
+    {
+        VkDeviceMemory memory {VK_NULL_HANDLE};
+        VkDeviceSize size {};
+        VkDeviceSize used {};
+        void *mapped {nullptr};
+        u32 memory_type {};
+        ResourceKind kind {};
+        bool dedicated {false}; // holds exactly one allocation and is freed along with it
+
+        // Both are keyed by offset. Keeping the free ranges sorted makes coalescing neighbours on
+        // free a simple lookup.
+        std::map<VkDeviceSize, VkDeviceSize> free_ranges {};
+        std::map<VkDeviceSize, Range> allocations {};
+    };
+
+    // Range bookkeeping of a block. Also usable on its own (with no memory attached) to carve up
+    // a single large buffer, offsets and sizes are then simply relative to that buffer.
+    extern bool sub_allocate(Block &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) noexcept;
+    extern void sub_free(Block &block, VkDeviceSize offset) noexcept;
+
+    // A sub-allocated range of a larger VkDeviceMemory block. Allocations are plain values, the
+    // allocator keeps track of which ranges are in use.
+    struct Allocation
+    {
+        VkDeviceMemory memory {VK_NULL_HANDLE};
+        VkDeviceSize offset {};
+        VkDeviceSize size {};
+        void *mapped {nullptr}; // already offset, only set for host visible memory
+        Block *block {nullptr};
+        constexpr bool is_valid() const noexcept { return memory != VK_NULL_HANDLE; }
+    };
+
+    struct HeapStatistics
+    {
+        VkDeviceSize block_bytes {}; // bytes allocated through vkAllocateMemory
+        VkDeviceSize live_bytes {};  // bytes handed out to live allocations
+        u32 block_count {};
+        u32 allocation_count {};
+    };
+
+    // Called for every allocation the defragmenter wants to relocate. The owner is expected to
+    // copy the contents over and rebind its resource to 'moved', then return true. Returning false
+    // keeps the allocation where it is.
+    using MoveCallback = std::function<bool(const Allocation &old_allocation, const Allocation &moved)>;
+
+    class Allocator
+    {
+        private:
+            struct Pool
+            {
+                std::vector<std::unique_ptr<Block>> blocks {};
+            };
+            VkDevice device {VK_NULL_HANDLE};
+            VkPhysicalDeviceMemoryProperties memory_properties {};
+            u32 max_allocation_count {};
+            u32 device_allocation_count {};
+            mutable std::mutex mtx {};
+
+            // indexed by 'memory type * 2 + resource kind'
+            std::array<Pool, VK_MAX_MEMORY_TYPES * 2> pools {};
+            std::array<HeapStatistics, VK_MAX_MEMORY_HEAPS> heap_statistics {};
+
+            u32 find_memory_type(u32 type_bits, Usage usage) const noexcept;
+            VkDeviceSize preferred_block_size(u32 memory_type) const noexcept;
+            Block *create_block(u32 memory_type, ResourceKind kind, VkDeviceSize size, bool dedicated) noexcept;
+            void destroy_block(Block &block) noexcept;
+            // 'evacuating' holds the blocks the defragmenter is emptying, which never receive the
+            // allocation. It is empty for regular allocations.
+            Allocation allocate_locked(const VkMemoryRequirements &requirements, Usage usage, ResourceKind kind,
+                                       std::span<Block *const> evacuating) noexcept;
+            void free_locked(const Allocation &allocation) noexcept;
+        public:
+            static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE {64ull * 1024 * 1024};
+
+            Allocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memory_properties, const VkPhysicalDeviceLimits &limits) noexcept;
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Allocator)
+            ~Allocator() noexcept;
+
+            // Returns an invalid allocation if no memory type satisfies the requirements or the
+            // device is out of memory.
+            [[nodiscard]] Allocation allocate(const VkMemoryRequirements &requirements, Usage usage, ResourceKind kind) noexcept;
+            void free(Allocation &allocation) noexcept;
+
+            // Allocates and binds memory for the resource
+            [[nodiscard]] Allocation allocate_buffer(VkBuffer buffer, Usage usage) noexcept;
+            [[nodiscard]] Allocation allocate_image(VkImage image, Usage usage) noexcept;
+
+            // Tries to empty sparsely used blocks by moving their allocations into other blocks of the
+            // same pool. At most 'max_moves' allocations are relocated. Returns the number of moves.
+            u32 defragment(const MoveCallback &move, u32 max_moves) noexcept;
+
+            // Returns the memory of blocks that hold no allocations back to the driver
+            u32 release_empty_blocks() noexcept;
+
+            HeapStatistics heap_usage(u32 heap_index) const noexcept;
+            constexpr auto heap_count() const noexcept { return memory_properties.memoryHeapCount; }
+            void log_statistics() const noexcept;
+    };
+}
+
+#endif // MCVK_MEMORY_HPP
@@ -0,0 +1,171 @@
+#ifndef MCVK_MESHER_HPP
+#define MCVK_MESHER_HPP
+
+#include <array>
+#include <vector>
+#include <cstring>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/section.hpp"
+#include "mcvk/world.hpp"
+
+namespace Meshing
+{
+    // Order matters, the opposite face is always 'face ^ 1'
+    enum Face : u8
+    {
+        PositiveX,
+        NegativeX,
+        PositiveY,
+        NegativeY,
+        PositiveZ,
+        NegativeZ,
+        FaceCount
+    };
+
+    // 4 bytes per vertex: x (5 bits) | y (5) | z (5) | face (3) | ambient occlusion (2) | texture layer (12)
+    // Positions are relative to the section origin and lie in [0, 16]. Texture coordinates are not
+    // stored, the vertex shader takes them from the position along the face's axes, so merged quads
+    // repeat the texture once per block.
+    struct PackedVertex
+    {
+        u32 bits {};
+
+        static constexpr PackedVertex pack(u32 x, u32 y, u32 z, Face face, u32 ao, u32 texture_layer) noexcept
+        {
+            return {.bits = x | (y << 5) | (z << 10) | (static_cast<u32>(face) << 15) | (ao << 18) | (texture_layer << 20)};
+        }
+    };
+    static_assert(sizeof(PackedVertex) == 4);
+    inline constexpr u32 MAX_TEXTURE_LAYERS {1u << 12};
+
+    // Every face of every block, the bound for sections of alternating transparent blocks
+    inline constexpr usize MAX_QUADS {World::Section::VOLUME * FaceCount};
+    inline constexpr usize QUAD_INDEX_COUNT {MAX_QUADS * 6};
+
+    // Quads are 4 consecutive vertices and split from their first to their third vertex, so the
+    // indices of every mesh are the same and one index buffer holding these serves all of them
+    inline void write_quad_indices(u32 *out) noexcept
+    {
+        for (u32 quad {}; quad < MAX_QUADS; ++quad)
+            for (const u32 corner : {0, 1, 2, 2, 3, 0})
+                *out++ = quad * 4 + corner;
+    }
+
+    // Which faces of a section can see each other through its non-opaque blocks, the visibility
+    // graph cave culling walks (see ChunkRenderer). Faces are connected if one flood fill of the
+    // section's non-opaque blocks touches both of them.
+    struct Connectivity
+    {
+        std::array<u8, FaceCount> faces {}; // bit 'b' of 'faces[a]' is set if face 'b' is visible through face 'a'
+
+        static constexpr Connectivity all() noexcept
+        {
+            Connectivity connectivity {};
+            connectivity.faces.fill((1u << FaceCount) - 1);
+            return connectivity;
+        }
+        constexpr bool connects(Face from, Face to) const noexcept { return ((faces[from] >> to) & 1) != 0; }
+        constexpr bool operator==(const Connectivity &) const noexcept = default;
+    };
+
+    // The vertices of one section, a single upload, and the section's connectivity
+    struct MeshData
+    {
+        std::vector<PackedVertex> vertices {};
+        Connectivity connectivity {};
+
+        void clear() noexcept
+        {
+            vertices.clear();
+            connectivity = {};
+        }
+        bool empty() const noexcept { return vertices.empty(); }
+        usize quad_count() const noexcept { return vertices.size() / 4; }
+        usize byte_size() const noexcept { return vertices.size() * sizeof(PackedVertex); }
+        void write_to(void *destination) const noexcept
+        {
+            std::memcpy(destination, vertices.data(), byte_size());
+        }
+    };
+
+    // Level of detail 'lod' meshes a section as cubes of 2^lod blocks a side
+    inline constexpr u32 MAX_LOD {3};
+    // in sections, how far past a level's threshold the distance has to move before switching
+    inline constexpr float LOD_HYSTERESIS {0.5f};
+
+    // Level of detail for a section 'distance' sections away, currently meshed at 'current'. Full
+    // detail is used up to 'lod_distance' (0 always uses full detail) and every doubling of the
+    // distance beyond it halves the detail. A section at a threshold keeps its level until it is
+    // LOD_HYSTERESIS past it, so it doesn't flicker between the two.
+    constexpr u32 select_lod(u32 current, float distance, float lod_distance) noexcept
+    {
+        if (lod_distance <= 0.0f)
+            return 0;
+        const auto start = [lod_distance](u32 lod) { return lod_distance * static_cast<float>(1u << (lod - 1)); };
+        auto lod = current;
+        while (lod < MAX_LOD && distance > start(lod + 1) + LOD_HYSTERESIS)
+            ++lod;
+        while (lod > 0 && distance < start(lod) - LOD_HYSTERESIS)
+            --lod;
+        return lod;
+    }
+
+    // Sections next to the one being meshed, indexed by face. Missing neighbours are treated as air,
+    // so the faces on that border are always generated.
+    using Neighbours = std::array<const World::Section *, FaceCount>;
+
+    // Neighbours of section 'section_index' of the chunk at 'pos', taken from the loaded chunks
+    extern Neighbours neighbours_of(const World::ChunkStore &store, World::ChunkPos pos, i32 section_index) noexcept;
+
+    // Turns sections into greedy-merged quads. Faces hidden by opaque neighbours are culled using
+    // bitmasks (one bit per block, 32 blocks per operation) and coplanar faces with the same block
+    // and ambient occlusion are merged into as few quads as possible. The mesher keeps its scratch
+    // memory between calls, so every thread should own one.
+    class GreedyMesher
+    {
+        private:
+            static constexpr i32 PADDED_SIZE {World::Section::SIZE + 2};
+            static constexpr usize PADDED_VOLUME {PADDED_SIZE * PADDED_SIZE * PADDED_SIZE};
+
+            // the section plus a one block border taken from its neighbours
+            std::array<World::BlockId, PADDED_VOLUME> padded {};
+            std::array<World::BlockId, World::Section::VOLUME> unpacked {};
+
+            // one bit per block along x (indexed by padded y, z) and along z (indexed by padded y, x)
+            std::array<u32, PADDED_SIZE * PADDED_SIZE> non_air_x {}, opaque_x {};
+            std::array<u32, PADDED_SIZE * PADDED_SIZE> non_air_z {}, opaque_z {};
+
+            // a neighbour's blocks, only needed for reduced detail
+            std::array<World::BlockId, World::Section::VOLUME> neighbour_blocks {};
+
+            // flood fill scratch, indexed like 'unpacked'
+            std::array<bool, World::Section::VOLUME> filled {};
+            std::array<u16, World::Section::VOLUME> fill_stack {};
+
+            static constexpr usize padded_index(i32 x, i32 y, i32 z) noexcept
+            {
+                return static_cast<usize>(((y + 1) * PADDED_SIZE + (z + 1)) * PADDED_SIZE + (x + 1));
+            }
+            static constexpr usize row_index(i32 a, i32 b) noexcept
+            {
+                return static_cast<usize>((a + 1) * PADDED_SIZE + (b + 1));
+            }
+            void fill_padded(const World::Section &section, const Neighbours &neighbours, u32 lod) noexcept;
+            void downsample(u32 lod) noexcept;
+            void fill_coarse_border(const Neighbours &neighbours, u32 lod) noexcept;
+            void build_masks() noexcept;
+            // of 'unpacked', which has to be filled in
+            Connectivity connect_faces() noexcept;
+            void mesh_face(Face face, bool ambient_occlusion, MeshData &out) noexcept;
+        public:
+            GreedyMesher() noexcept = default;
+            DELETE_NON_COPYABLE_DEFAULT(GreedyMesher)
+
+            // Replaces the contents of 'out' with the mesh and the connectivity of 'section' at level
+            // of detail 'lod' (at most MAX_LOD). Vertex positions are in blocks at every level.
+            void mesh(const World::Section &section, const Neighbours &neighbours, MeshData &out, u32 lod = 0) noexcept;
+    };
+}
+
+#endif // MCVK_MESHER_HPP
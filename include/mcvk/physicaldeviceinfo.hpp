@@ -2,18 +2,14 @@
 #define MCVK_PHYSICALDEVICEINFO_HPP
 
 #include <vulkan/vulkan.h>
-#ifndef NDEBUG
-    #include <string>
-#endif
+#include <string>
 
 namespace Device
 {
     struct PhysicalDeviceInfo
     {
         VkPhysicalDevice self {};
-        #ifndef NDEBUG
-            std::string name {};
-        #endif
+        std::string name {};
     };
 }
 
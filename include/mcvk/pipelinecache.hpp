@@ -0,0 +1,48 @@
+#ifndef MCVK_PIPELINECACHE_HPP
+#define MCVK_PIPELINECACHE_HPP
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+
+// A VkPipelineCache that is loaded from disk on startup and written back on shutdown, so
+// pipelines only have to be compiled from scratch on the first launch. Each physical device
+// (and driver version, through 'pipelineCacheUUID') gets its own file. Files that are
+// truncated, corrupted or were written by another device or driver are ignored.
+class PipelineCache
+{
+    private:
+        VkDevice device {VK_NULL_HANDLE};
+        VkPipelineCache cache {VK_NULL_HANDLE};
+        VkPhysicalDeviceProperties properties {};
+        std::string path {};
+        bool loaded {false};
+
+        void create(const std::vector<u8> &initial_data) noexcept;
+        std::vector<u8> read_file() const noexcept;
+        bool is_compatible(const std::vector<u8> &data) const noexcept;
+    public:
+        // cache files are looked up relative to the working directory
+        static constexpr const char *CACHE_DIRECTORY {"cache/"};
+
+        PipelineCache(VkDevice ddevice, const VkPhysicalDeviceProperties &pproperties) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(PipelineCache)
+        // Saves the cache, all pipelines using it have to be destroyed first
+        ~PipelineCache() noexcept;
+
+        // Writes the cache to disk. The file is replaced atomically, a crash while saving never
+        // leaves a partially written cache behind. Returns false if it could not be written.
+        bool save() const noexcept;
+
+        // Drops everything compiled so far, which makes the next pipeline creation a cold one. No
+        // pipeline may be in the middle of being created.
+        void reset() noexcept;
+
+        constexpr auto get() const noexcept { return cache; }
+        // whether a valid cache file was found when this was created
+        constexpr auto was_loaded() const noexcept { return loaded; }
+};
+
+#endif // MCVK_PIPELINECACHE_HPP
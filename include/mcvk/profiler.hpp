@@ -0,0 +1,86 @@
+#ifndef MCVK_PROFILER_HPP
+#define MCVK_PROFILER_HPP
+
+#include <chrono>
+#include <span>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+
+// Frame profiler. CPU zones time a scope on any thread, GPU zones are timestamp queries written
+// into a frame's command buffer (see gpuprofiler.hpp). The last HISTORY_FRAMES frames are kept,
+// they can be exported as a Chrome trace (chrome://tracing or ui.perfetto.dev) or summarized.
+//
+// Zones are only compiled in if MCVK_PROFILE is non-zero, which is the default in debug builds.
+// Release builds are profiled with -DMCVK_PROFILE=1.
+#ifndef MCVK_PROFILE
+    #ifdef NDEBUG
+        #define MCVK_PROFILE 0
+    #else
+        #define MCVK_PROFILE 1
+    #endif
+#endif
+
+namespace Profiler
+{
+    static constexpr bool ENABLED {MCVK_PROFILE != 0};
+    static constexpr usize HISTORY_FRAMES {600};
+
+    using Clock = std::chrono::steady_clock;
+
+    inline i64 now_ns() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    struct GpuZone
+    {
+        const char *name {};
+        i64 start_ns {}; // on the CPU clock
+        i64 end_ns {};
+    };
+
+    // Records a CPU zone on the calling thread. 'name' must outlive the profiler (string literals).
+    extern void record_zone(const char *name, i64 start_ns, i64 end_ns) noexcept;
+
+    // Use PROFILE_ZONE instead, which compiles to nothing when profiling is disabled
+    class Zone
+    {
+        private:
+            const char *name {};
+            i64 start_ns {};
+        public:
+            explicit Zone(const char *nname) noexcept : name {nname}, start_ns {now_ns()} {}
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Zone)
+            ~Zone() noexcept { record_zone(name, start_ns, now_ns()); }
+    };
+
+    // The functions below may only be called from the thread that renders
+
+    // Ends the previous frame and starts a new one. Zones recorded on other threads are assigned
+    // to the frame that was running when they ended.
+    extern void begin_frame() noexcept;
+
+    // Index of the current frame, starting at 1 with the first 'begin_frame'
+    extern u64 current_frame() noexcept;
+
+    // Attaches a frame's GPU zones once its queries have been read back. The first zone must
+    // cover the whole frame. Ignored if the frame is no longer in the history.
+    extern void record_gpu_frame(u64 frame, std::span<const GpuZone> zones) noexcept;
+
+    // Writes every frame in the history as Chrome trace event JSON. Returns false if the file
+    // can't be written.
+    extern bool write_trace(const char *path) noexcept;
+
+    // Prints p50/p99 of the CPU and GPU frame times and of every zone over the history to stdout
+    extern void report() noexcept;
+}
+
+#if MCVK_PROFILE
+    #define MCVK_PROFILE_CONCAT_IMPL(a, b) a##b
+    #define MCVK_PROFILE_CONCAT(a, b) MCVK_PROFILE_CONCAT_IMPL(a, b)
+    #define PROFILE_ZONE(name) const Profiler::Zone MCVK_PROFILE_CONCAT(profile_zone_, __LINE__) {name}
+#else
+    #define PROFILE_ZONE(name) static_cast<void>(0)
+#endif
+
+#endif // MCVK_PROFILER_HPP
@@ -12,7 +12,10 @@ namespace Queue
     enum FamilyIndex
     {
         GraphicsQueueIndex,
-        PresentationQueueIndex
+        PresentationQueueIndex,
+        // A transfer-only family if the device has one (these map to the copy/DMA engines and run
+        // alongside rendering), otherwise the graphics family
+        TransferQueueIndex
     };
 
     class QueueFamilyIndices
@@ -22,7 +25,8 @@ namespace Queue
             enum IndexFlags : u8 {
                 None = 0x0,
                 GraphicsQueueCompatible = 0x1,
-                PresentationQueueCompatible = 0x2
+                PresentationQueueCompatible = 0x2,
+                TransferQueueCompatible = 0x4
             } flags {};
             static constexpr usize __QUEUE_TOTAL_INDICES_ = __LINE__ - __QUEUE_FAMILY_INDICES_CURRENT_LINE_ - 4;
             static constexpr auto __QUEUE_FLAG_INDICES_SUM_ {Global::FLAG_SUM(__QUEUE_TOTAL_INDICES_)};
@@ -48,6 +52,12 @@ namespace Queue
                 return true;
             }
             auto const constexpr &array() const noexcept { return indices; }
+            // true if uploads run on a different queue family than rendering, in which case
+            // ownership of uploaded resources has to be transferred
+            bool constexpr has_dedicated_transfer() const noexcept
+            {
+                return get(TransferQueueIndex) != get(GraphicsQueueIndex);
+            }
     };
 }
 
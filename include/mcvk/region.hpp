@@ -0,0 +1,79 @@
+#ifndef MCVK_REGION_HPP
+#define MCVK_REGION_HPP
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/chunk.hpp"
+#include "mcvk/compression.hpp"
+
+namespace World
+{
+    // Persists chunks in region files of REGION_SIZE x REGION_SIZE chunks. A region file starts
+    // with a table of where every chunk is stored, followed by the chunks. Each chunk stores its
+    // sections' palettes and the LZ4 compressed packed indices.
+    //
+    // Region files are memory mapped. Loading a chunk decompresses straight from the mapping into
+    // the sections' packed storage, no intermediate copy of the file or the blocks is made. Saves
+    // only copy the chunk on the calling thread; compressing and writing happens on a background
+    // thread, which writes everything queued for a region in one batch.
+    class RegionStorage
+    {
+        public:
+            static constexpr i32 REGION_SIZE {32};
+        private:
+            struct Region;
+
+            std::string directory {};
+            i32 compression_level {};
+
+            // Regions are opened on first use and stay open until the storage is destroyed. No
+            // default member initializer, it would need 'Region' to be complete in this header.
+            std::mutex regions_mutex {};
+            std::unordered_map<ChunkPos, std::unique_ptr<Region>, ChunkPosHash> regions;
+
+            // Copies of the chunks waiting to be written. 'writing' holds the batch the writer
+            // thread is busy with, loads check both so they never see an outdated chunk.
+            std::mutex queue_mutex {};
+            std::condition_variable queue_changed {}; // wakes the writer thread
+            std::condition_variable batch_written {}; // wakes threads waiting in 'flush'
+            std::unordered_map<ChunkPos, std::unique_ptr<Chunk>, ChunkPosHash> queued {};
+            std::unordered_map<ChunkPos, std::unique_ptr<Chunk>, ChunkPosHash> writing {};
+            bool running {true};
+            std::thread writer {};
+
+            Region *get_region(ChunkPos region_pos, bool create) noexcept;
+            void write_loop() noexcept;
+            void write_region(ChunkPos region_pos, const std::vector<const Chunk *> &chunks) noexcept;
+        public:
+            // Region files are read from and written to 'ddirectory', which is created if needed.
+            // 'level' is passed to Compression::compress.
+            explicit RegionStorage(std::string ddirectory, i32 level = Compression::DEFAULT_LEVEL) noexcept;
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(RegionStorage)
+            // Writes every queued chunk
+            ~RegionStorage() noexcept;
+
+            // Replaces the contents of 'chunk' with the stored chunk at its position. Returns false if
+            // it has never been saved or could not be read, the chunk's contents are unspecified then.
+            // Thread-safe.
+            [[nodiscard]] bool load(Chunk &chunk) noexcept;
+
+            // Queues a copy of 'chunk' to be written. The chunk must not be modified by another thread
+            // during the call. Thread-safe.
+            void save(const Chunk &chunk) noexcept;
+
+            // Blocks until every chunk queued so far has been written
+            void flush() noexcept;
+
+            // total size of the region files in the directory in bytes
+            usize disk_usage() const noexcept;
+    };
+}
+
+#endif // MCVK_REGION_HPP
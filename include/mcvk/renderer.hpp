@@ -0,0 +1,124 @@
+#ifndef MCVK_RENDERER_HPP
+#define MCVK_RENDERER_HPP
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/device.hpp"
+#include "mcvk/swapchain.hpp"
+#include "mcvk/upload.hpp"
+#include "mcvk/gpuprofiler.hpp"
+
+// Drives the acquire -> record -> submit -> present loop. Every frame in flight owns its
+// own command pool, semaphore and fence so the CPU can record frame N+1 while the GPU is
+// still busy with frame N.
+class Renderer
+{
+    private:
+        struct Frame
+        {
+            VkCommandPool command_pool {VK_NULL_HANDLE};
+            VkCommandBuffer command_buffer {VK_NULL_HANDLE};
+            VkSemaphore image_available {VK_NULL_HANDLE};
+            VkFence in_flight {VK_NULL_HANDLE};
+        };
+        VkDevice device {VK_NULL_HANDLE};
+        VkQueue graphics_queue {VK_NULL_HANDLE};
+        VkQueue presentation_queue {VK_NULL_HANDLE};
+        Memory::Allocator *allocator {nullptr};
+        Swapchain *swapchain {nullptr};
+        Uploader uploader;
+        GpuProfiler profiler;
+        VkRenderPass render_pass {VK_NULL_HANDLE};
+        std::vector<VkFramebuffer> framebuffers {};
+        std::vector<Frame> frames {};
+
+        VkImage depth_image {VK_NULL_HANDLE};
+        VkImageView depth_view {VK_NULL_HANDLE};
+        Memory::Allocation depth_allocation {};
+
+        // Signaled when rendering to a swapchain image has finished. These are indexed by the
+        // swapchain image rather than the frame, as the presentation engine may still be
+        // waiting on a semaphore after its frame slot has been reused.
+        std::vector<VkSemaphore> render_finished {};
+
+        // The fence of the frame currently rendering to each swapchain image, used when the
+        // swapchain hands back an image out of order.
+        std::vector<VkFence> images_in_flight {};
+        u32 current_frame {};
+        u32 image_index {};
+        u64 submitted_frames {};
+        bool frame_started {false};
+        bool render_pass_started {false};
+        u32 render_pass_zone {GpuProfiler::NO_ZONE};
+
+        // Everything that depends on the swapchain extent or its images. After a recreation these
+        // are kept alive until every frame that could still be using them has finished, so a
+        // resize never has to wait for the device to go idle.
+        struct RetiredSwapchain
+        {
+            u64 frame {}; // value of 'submitted_frames' at the time of the recreation
+            Swapchain::Retired swapchain {};
+            std::vector<VkFramebuffer> framebuffers {};
+            std::vector<VkSemaphore> render_finished {};
+            VkImage depth_image {VK_NULL_HANDLE};
+            VkImageView depth_view {VK_NULL_HANDLE};
+            Memory::Allocation depth_allocation {};
+        };
+        std::vector<RetiredSwapchain> retired_swapchains {};
+        VkExtent2D framebuffer_extent {};
+        bool swapchain_outdated {false};
+
+        void create_render_pass() noexcept;
+        void create_depth_buffer() noexcept;
+        void destroy_depth_buffer() noexcept;
+        void create_framebuffers() noexcept;
+        void create_frames(u32 graphics_family) noexcept;
+        void create_image_semaphores() noexcept;
+        void recreate_swapchain() noexcept;
+        void destroy_retired(RetiredSwapchain &retired) noexcept;
+    public:
+        static constexpr u32 DEFAULT_FRAMES_IN_FLIGHT {2};
+        static constexpr u32 MAX_FRAMES_IN_FLIGHT {3};
+        // every implementation supports either this or X8_D24 as a depth attachment, and all
+        // desktop ones support this
+        static constexpr VkFormat DEPTH_FORMAT {VK_FORMAT_D32_SFLOAT};
+
+        Renderer(const Device::LogicalDevice &logical_device,
+                 Swapchain &swapchain,
+                 u32 frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Renderer)
+        ~Renderer() noexcept;
+
+        // Waits for the current frame slot to become available, acquires a swapchain image and
+        // begins recording the frame's command buffer. Returns VK_NULL_HANDLE if no image could be
+        // acquired, in which case 'end_frame' must not be called. Transfers and barriers can be
+        // recorded until 'begin_render_pass' is called. An out of date swapchain is recreated here.
+        // The extent may differ from the previous frame's afterwards.
+        [[nodiscard]] VkCommandBuffer begin_frame() noexcept;
+
+        // Use VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when drawing through 'vkCmdExecuteCommands'
+        void begin_render_pass(VkSubpassContents contents) noexcept;
+
+        // Ends the render pass (beginning it first if nothing was drawn), submits the frame and
+        // queues it for presentation.
+        void end_frame() noexcept;
+
+        // Recreates the swapchain at the start of the next frame. Frames are skipped while either
+        // side of the extent is zero (a minimized window).
+        void resize(VkExtent2D new_framebuffer_extent) noexcept;
+
+        // Uploads staged here are submitted at the start of the next frame and become usable in the
+        // first frame that begins after the transfer queue has finished them
+        auto &get_uploader() noexcept { return uploader; }
+        // GPU zones can be recorded into the frame's command buffer outside of secondary render passes
+        auto &get_profiler() noexcept { return profiler; }
+        constexpr auto get_render_pass() const noexcept { return render_pass; }
+        constexpr auto get_framebuffer() const noexcept { return framebuffers[image_index]; }
+        constexpr auto get_extent() const noexcept { return swapchain->get_extent(); }
+        constexpr auto frames_in_flight() const noexcept { return static_cast<u32>(frames.size()); }
+        constexpr auto get_current_frame() const noexcept { return current_frame; }
+};
+
+#endif // MCVK_RENDERER_HPP
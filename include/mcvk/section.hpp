@@ -0,0 +1,118 @@
+#ifndef MCVK_SECTION_HPP
+#define MCVK_SECTION_HPP
+
+#include <vector>
+#include <span>
+#include "mcvk/types.hpp"
+#include "mcvk/block.hpp"
+
+namespace World
+{
+    // A 16x16x16 cube of blocks. Blocks are stored as bit-packed indices into a palette of the
+    // block ids that occur in the section, so a section made out of a handful of block types only
+    // needs a few bits per block. A section made out of a single block type stores no indices at all.
+    //
+    // Light is kept next to the blocks, a byte per block holding block light in the low and sky
+    // light in the high 4 bits (see Lighting). Like the blocks, a section where every block has the
+    // same light (open sky, solid rock) stores a single value.
+    class Section
+    {
+        public:
+            static constexpr i32 SIZE {16};
+            static constexpr usize VOLUME {SIZE * SIZE * SIZE};
+        private:
+            std::vector<BlockId> palette {Air};
+            std::vector<u64> data {};
+            u8 bits {}; // bits per packed index, 0 means every block is 'palette[0]'
+            u16 non_air_count {};
+            u32 version {}; // bumped on every modification, lets consumers detect stale derived data
+            std::vector<u8> light {}; // empty while every block has 'uniform_light'
+            u8 uniform_light {};
+
+            // entries never straddle two words, so the bit widths are restricted to powers of two
+            static constexpr usize entries_per_word(u8 bits) noexcept { return 64 / bits; }
+            static constexpr usize index_of(i32 x, i32 y, i32 z) noexcept
+            {
+                return static_cast<usize>((y * SIZE + z) * SIZE + x);
+            }
+            u32 read(usize index) const noexcept
+            {
+                const auto per_word = entries_per_word(bits);
+                const u64 mask = (1ull << bits) - 1;
+                return static_cast<u32>((data[index / per_word] >> ((index % per_word) * bits)) & mask);
+            }
+            void write(usize index, u32 value) noexcept
+            {
+                const auto per_word = entries_per_word(bits);
+                const auto shift = (index % per_word) * bits;
+                const u64 mask = ((1ull << bits) - 1) << shift;
+                auto &word = data[index / per_word];
+                word = (word & ~mask) | (static_cast<u64>(value) << shift);
+            }
+            u32 find_or_add_to_palette(BlockId id) noexcept;
+            void repack(u8 new_bits) noexcept;
+        public:
+            Section() noexcept = default;
+            explicit Section(BlockId fill_block) noexcept : palette {fill_block},
+                non_air_count {static_cast<u16>((fill_block == Air) ? 0 : VOLUME)} {}
+
+            // coordinates are local to the section and must be within [0, SIZE)
+            BlockId get(i32 x, i32 y, i32 z) const noexcept
+            {
+                if (bits == 0)
+                    return palette[0];
+                return palette[read(index_of(x, y, z))];
+            }
+            void set(i32 x, i32 y, i32 z, BlockId id) noexcept;
+            void fill(BlockId id) noexcept;
+
+            // Replaces every block, ordered like 'unpack'. The palette only contains the ids that
+            // occur, so the result is already compact. Much faster than calling 'set' for every block.
+            void assign(std::span<const BlockId, VOLUME> blocks) noexcept;
+
+            // Replaces the palette and returns the packed indices, laid out like 'get_data', which the
+            // caller has to overwrite completely. Lets stored sections be decoded straight into place.
+            // 'new_bits' must be 0, 1, 2, 4, 8 or 16 and able to index the whole palette.
+            std::span<u64> assign_packed(std::span<const BlockId> new_palette, u8 new_bits, u16 new_non_air_count) noexcept;
+
+            // Decodes every block into 'out', ordered y-major then z then x. Considerably faster than
+            // calling 'get' for every block.
+            void unpack(std::span<BlockId, VOLUME> out) const noexcept;
+
+            // Removes palette entries that are no longer referenced, shrinking the index width where
+            // possible. A section that ends up with a single block type collapses to a constant.
+            void compact() noexcept;
+
+            // Packed light of a block, see Lighting::pack_light
+            u8 get_light(i32 x, i32 y, i32 z) const noexcept
+            {
+                return light.empty() ? uniform_light : light[index_of(x, y, z)];
+            }
+            void set_light(i32 x, i32 y, i32 z, u8 value) noexcept
+            {
+                if (light.empty()) {
+                    if (value == uniform_light)
+                        return;
+                    light.assign(VOLUME, uniform_light);
+                }
+                light[index_of(x, y, z)] = value;
+            }
+            void fill_light(u8 value) noexcept;
+            // Frees the light storage if every block ended up with the same light
+            void compact_light() noexcept;
+
+            constexpr bool is_uniform() const noexcept { return bits == 0; }
+            constexpr bool is_empty() const noexcept { return non_air_count == 0; }
+            constexpr auto get_non_air_count() const noexcept { return non_air_count; }
+            constexpr auto get_version() const noexcept { return version; }
+            constexpr auto bits_per_block() const noexcept { return bits; }
+            constexpr bool has_uniform_light() const noexcept { return light.empty(); }
+            constexpr const auto &get_palette() const noexcept { return palette; }
+            constexpr const auto &get_data() const noexcept { return data; }
+
+            // heap and inline bytes used by this section
+            usize memory_usage() const noexcept;
+    };
+}
+
+#endif // MCVK_SECTION_HPP
@@ -0,0 +1,17 @@
+#ifndef MCVK_SHADER_HPP
+#define MCVK_SHADER_HPP
+
+#include <vulkan/vulkan.h>
+#include "mcvk/types.hpp"
+
+namespace Shader
+{
+    // SPIR-V binaries are looked up relative to the working directory
+    static constexpr const char *SHADER_DIRECTORY {"shaders/"};
+
+    // Loads 'SHADER_DIRECTORY/<name>.spv', e.g. "chunk.vert". A missing or malformed binary is a
+    // fatal error, the game can't render anything without its shaders.
+    extern VkShaderModule load_module(VkDevice device, const char *name) noexcept;
+}
+
+#endif // MCVK_SHADER_HPP
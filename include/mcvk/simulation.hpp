@@ -0,0 +1,103 @@
+#ifndef MCVK_SIMULATION_HPP
+#define MCVK_SIMULATION_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/math.hpp"
+
+// Runs the game state forward in fixed steps on its own thread, independent of the frame rate.
+// Every tick publishes the state before and after it into one of two buffers, and frames render
+// a blend of the two from the most recent buffer, taken at how far the frame is into the next
+// tick. The render thread only ever holds the lock long enough to copy a buffer, so a slow tick
+// never holds up a frame and a fast GPU never makes the simulation run faster.
+//
+// A tick that is late runs right away, so a few slow ticks are caught up on. Once the simulation
+// is more than MAX_CATCH_UP ticks behind, the ticks it can't make up are dropped and counted as
+// missed instead of running the game faster until it has caught up.
+class Simulation
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr u32 DEFAULT_TICK_RATE {20}; // per second
+        static constexpr u32 MAX_CATCH_UP {5};
+
+        // Everything frames read from the simulation
+        struct State
+        {
+            u64 tick {};
+            Math::Camera camera {};
+
+            // 'alpha' in [0, 1] blends from 'from' to 'to'
+            static State interpolate(const State &from, const State &to, float alpha) noexcept;
+        };
+
+        // Advances 'state' by one tick of 'seconds', on the simulation thread
+        using TickFunction = std::function<void(State &state, float seconds)>;
+
+        struct Statistics
+        {
+            u64 ticks {};
+            u64 missed_ticks {}; // dropped because the simulation fell too far behind
+            double average_tick_ms {};
+            double max_tick_ms {};
+            u64 frames {};
+            double average_frame_ms {}; // time between frames
+            double max_frame_ms {};
+        };
+    private:
+        // The state before and after a tick, and when the tick was due
+        struct Snapshot
+        {
+            State previous {};
+            State current {};
+            Clock::time_point time {};
+        };
+
+        TickFunction tick_function {};
+        Clock::duration tick_duration {};
+
+        std::array<Snapshot, 2> snapshots {};
+        u32 front {}; // the snapshot frames read from, guarded by 'snapshot_mutex'
+        std::mutex snapshot_mutex {};
+
+        // ticks wait on 'wake', so stopping doesn't have to wait for the next tick to be due
+        std::mutex wake_mutex {};
+        std::condition_variable wake {};
+        bool running {true};
+        std::thread thread {};
+
+        // written by the simulation thread
+        std::atomic<u64> ticks {}, missed_ticks {};
+        std::atomic<u64> tick_nanoseconds {}, max_tick_nanoseconds {};
+
+        // written by the render thread
+        u64 frames {};
+        Clock::time_point previous_frame {};
+        double frame_ms_total {}, max_frame_ms {};
+
+        void run(State state) noexcept;
+    public:
+        // Starts ticking 'tick_rate' times per second from 'initial_state'
+        Simulation(TickFunction function, const State &initial_state, u32 tick_rate = DEFAULT_TICK_RATE) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Simulation)
+        // Waits for the running tick to finish
+        ~Simulation() noexcept;
+
+        // The state to render at 'now', interpolated between the last two ticks. Should be called
+        // once per frame from the same thread, the time since the previous call is the frame time.
+        State frame_state(Clock::time_point now = Clock::now()) noexcept;
+
+        // Only call from the thread calling 'frame_state'
+        Statistics get_statistics() const noexcept;
+        void report() const noexcept;
+};
+
+#endif // MCVK_SIMULATION_HPP
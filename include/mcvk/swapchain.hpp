@@ -22,14 +22,45 @@ class Swapchain
         static constexpr usize __SWAPCHAIN_FLAGS_SUM_ = Global::FLAG_SUM(__LINE__ - __SWAPCHAIN_INDICES_CURRENT_LINE_ - 4);
         VkSwapchainKHR swapchain {VK_NULL_HANDLE};
         VkDevice device {VK_NULL_HANDLE};
+        VkFormat image_format {VK_FORMAT_UNDEFINED};
+        VkExtent2D extent {};
         std::vector<VkImage> images {};
+        std::vector<VkImageView> image_views {};
+
+        // kept for recreation, the format and presentation mode never change after creation
+        Device::PhysicalDeviceInfo physical_device {};
+        VkSurfaceKHR surface {VK_NULL_HANDLE};
+        Queue::QueueFamilyIndices queue_family_indices {};
+        VkSurfaceFormatKHR surface_format {};
+        VkPresentModeKHR present_mode {};
+
+        bool create(VkExtent2D framebuffer_extent, VkSwapchainKHR old_swapchain) noexcept;
+        void create_image_views() noexcept;
+        void destroy_image_views() noexcept;
     public:
+        // What is left of a swapchain after it has been recreated. It can only be destroyed once
+        // the GPU has finished every frame that rendered to one of its images.
+        struct Retired
+        {
+            VkSwapchainKHR swapchain {VK_NULL_HANDLE};
+            std::vector<VkImageView> image_views {};
+        };
+
         DELETE_NON_COPYABLE_DEFAULT(Swapchain)
         constexpr Swapchain(Swapchain &&other) noexcept
         {
             swapchain = other.swapchain;
             device = other.device;
             compatible_flag = other.compatible_flag;
+            image_format = other.image_format;
+            extent = other.extent;
+            images = std::move(other.images);
+            image_views = std::move(other.image_views);
+            physical_device = std::move(other.physical_device);
+            surface = other.surface;
+            queue_family_indices = other.queue_family_indices;
+            surface_format = other.surface_format;
+            present_mode = other.present_mode;
             other.swapchain = VK_NULL_HANDLE;
             other.device = VK_NULL_HANDLE;
             other.compatible_flag = CompatibleFlag::None;
@@ -39,6 +70,15 @@ class Swapchain
             swapchain = other.swapchain;
             device = other.device;
             compatible_flag = other.compatible_flag;
+            image_format = other.image_format;
+            extent = other.extent;
+            images = std::move(other.images);
+            image_views = std::move(other.image_views);
+            physical_device = std::move(other.physical_device);
+            surface = other.surface;
+            queue_family_indices = other.queue_family_indices;
+            surface_format = other.surface_format;
+            present_mode = other.present_mode;
             other.swapchain = VK_NULL_HANDLE;
             other.device = VK_NULL_HANDLE;
             other.compatible_flag = CompatibleFlag::None;
@@ -46,21 +86,43 @@ class Swapchain
         }
         constexpr Swapchain() noexcept = default;
 
+        // 'framebuffer_extent' is only used when the surface lets the swapchain decide its
+        // own size, which is always the case for headless surfaces.
         Swapchain(Device::PhysicalDeviceInfo physical_device, 
                   VkSurfaceKHR surface, 
-                  GLFWwindow *window,
+                  VkExtent2D framebuffer_extent,
                   const Queue::QueueFamilyIndices &queue_family_indices,
                   VkDevice device) noexcept;
 
+        // Creates a new swapchain for the current surface size, passing the current one as
+        // 'oldSwapchain' so the driver can reuse its resources. The image format stays the same.
+        [[nodiscard]] Retired recreate(VkExtent2D framebuffer_extent) noexcept;
+        void destroy(Retired &retired) const noexcept;
+
         constexpr bool is_compatible() const noexcept { 
             return (compatible_flag & __SWAPCHAIN_FLAGS_SUM_) == __SWAPCHAIN_FLAGS_SUM_;
         }
+
+        // Returns VK_SUCCESS, VK_SUBOPTIMAL_KHR or VK_ERROR_OUT_OF_DATE_KHR, any other
+        // result is treated as a fatal error. 'signal' is signaled once the image is ready
+        // to be rendered to.
+        VkResult acquire_next_image(VkSemaphore signal, u32 &image_index) const noexcept;
+
+        // Queues the image for presentation once 'wait' has been signaled.
+        VkResult present(VkQueue presentation_queue, VkSemaphore wait, u32 image_index) const noexcept;
+
+        constexpr auto get() const noexcept { return swapchain; }
+        constexpr auto get_image_format() const noexcept { return image_format; }
+        constexpr auto get_extent() const noexcept { return extent; }
+        constexpr auto image_count() const noexcept { return static_cast<u32>(images.size()); }
+        constexpr const auto &get_image_views() const noexcept { return image_views; }
+
         ~Swapchain() noexcept
         {
             if (swapchain != VK_NULL_HANDLE) {
                 if (Device::LogicalDevice::device_is_in_use(device)) {
-                    if constexpr (Global::IS_DEBUG_BUILD)
-                        Logger::info("De-allocating swapchain");
+                    Logger::info("De-allocating swapchain");
+                    destroy_image_views();
                     vkDestroySwapchainKHR(device, swapchain, nullptr);
                     swapchain = VK_NULL_HANDLE;
                 }
@@ -0,0 +1,56 @@
+#ifndef MCVK_TERRAIN_HPP
+#define MCVK_TERRAIN_HPP
+
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/chunk.hpp"
+
+// Seeded world generation. Layered gradient noise shapes the heightmap, a low frequency layer
+// separates oceans, plains and mountains, another one picks the surface biome and 3D noise carves
+// caves. The noise is evaluated on 16 columns (or blocks) of a row at once with AVX2, SSE4.1 or
+// plain scalar code. Everything is integer fixed point arithmetic, so the generated blocks are
+// identical on every path, every thread count and every compiler.
+namespace Terrain
+{
+    enum class Isa : u8
+    {
+        Scalar,
+        Sse41,
+        Avx2
+    };
+
+    // The widest instruction set the CPU supports
+    extern Isa best_isa() noexcept;
+    extern const char *isa_name(Isa isa) noexcept;
+
+    class Generator
+    {
+        public:
+            static constexpr i32 SEA_LEVEL {62};
+            static constexpr i32 SNOW_LINE {SEA_LEVEL + 36};
+        private:
+            // Every layer of noise has its own seed, derived from the world seed
+            struct Seeds
+            {
+                u32 continents {};
+                u32 detail {};
+                u32 temperature {};
+                u32 caves {};
+            } seeds {};
+            Isa isa {};
+        public:
+            // Uses the widest supported path if 'requested_isa' is not supported by the CPU
+            explicit Generator(u64 seed, Isa requested_isa = best_isa()) noexcept;
+
+            // Overwrites every section of the chunk. Only depends on the seed and the chunk's
+            // position, a generator can be shared by any number of threads.
+            void generate(World::Chunk &chunk) const noexcept;
+
+            constexpr auto get_isa() const noexcept { return isa; }
+    };
+
+    // Hash of every block of a chunk, used to check that generation is deterministic
+    extern u64 hash_chunk(const World::Chunk &chunk) noexcept;
+}
+
+#endif // MCVK_TERRAIN_HPP
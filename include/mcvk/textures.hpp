@@ -0,0 +1,91 @@
+#ifndef MCVK_TEXTURES_HPP
+#define MCVK_TEXTURES_HPP
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <bit>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/device.hpp"
+#include "mcvk/memory.hpp"
+#include "mcvk/upload.hpp"
+#include "mcvk/block.hpp"
+
+// Every block texture is a layer of one 2D array image, so the texture of a face is only a layer
+// index in its vertices (see Meshing::PackedVertex) and drawing never switches descriptors. The
+// array is exposed through a single descriptor set holding one combined image sampler.
+//
+// The layout of the image (the layer of every texture and the size and offset of every mip level
+// in the texel buffer) is fixed at compile time. Startup only fills that buffer and stages it.
+//
+// Mip levels are generated on the graphics queue by blitting each level from the previous one,
+// which needs FORMAT to support linear filtering for blits. Otherwise they are box filtered on
+// the CPU and uploaded along with the first level.
+class BlockTextures
+{
+    public:
+        static constexpr VkFormat FORMAT {VK_FORMAT_R8G8B8A8_SRGB};
+        static constexpr u32 TEXEL_SIZE {4};
+        static constexpr u32 SIZE {16}; // texels along each side of a texture
+        static constexpr u32 LAYER_COUNT {static_cast<u32>(World::Texture::Count)};
+        static constexpr u32 MIP_LEVELS {std::bit_width(SIZE)}; // down to 1x1
+        static_assert(std::has_single_bit(SIZE));
+
+        // A mip level of every layer, tightly packed one layer after another. The texel buffer
+        // holds the levels in order.
+        struct MipLevel
+        {
+            u32 size {};
+            VkDeviceSize offset {}; // into the texel buffer
+            VkDeviceSize bytes {};
+        };
+        static constexpr MipLevel mip_level(u32 level) noexcept
+        {
+            VkDeviceSize offset {};
+            for (u32 previous {}; previous < level; ++previous)
+                offset += VkDeviceSize{SIZE >> previous} * (SIZE >> previous) * TEXEL_SIZE * LAYER_COUNT;
+            const auto size = SIZE >> level;
+            return {.size = size, .offset = offset, .bytes = VkDeviceSize{size} * size * TEXEL_SIZE * LAYER_COUNT};
+        }
+    private:
+        VkDevice device {VK_NULL_HANDLE};
+        Memory::Allocator *allocator {nullptr};
+        Uploader *uploader {nullptr};
+
+        VkImage image {VK_NULL_HANDLE};
+        Memory::Allocation allocation {};
+        VkImageView view {VK_NULL_HANDLE};
+        VkSampler sampler {VK_NULL_HANDLE};
+        VkDescriptorSetLayout descriptor_set_layout {VK_NULL_HANDLE};
+        VkDescriptorPool descriptor_pool {VK_NULL_HANDLE};
+        VkDescriptorSet descriptor_set {VK_NULL_HANDLE};
+
+        bool gpu_mips {false};
+        std::vector<u8> texels {}; // every level for CPU mips, only the first otherwise, freed once staged
+        u32 staged_levels {};
+        Uploader::Ticket ticket {Uploader::INVALID_TICKET}; // of the last staged level
+        bool ready {false};
+
+        void create_image() noexcept;
+        void create_sampler(const Device::LogicalDevice &logical_device) noexcept;
+        void create_descriptors() noexcept;
+        void stage() noexcept;
+        void record_mip_generation(VkCommandBuffer command_buffer) const noexcept;
+    public:
+        BlockTextures(const Device::LogicalDevice &logical_device, Uploader &uuploader) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(BlockTextures)
+        // The textures must no longer be in use by the device
+        ~BlockTextures() noexcept;
+
+        // Records the mip generation once the upload has finished. Must be called every frame
+        // before anything samples the textures, outside of a render pass. Returns whether the
+        // textures can be sampled in this frame.
+        [[nodiscard]] bool prepare(VkCommandBuffer command_buffer) noexcept;
+
+        constexpr auto get_descriptor_set_layout() const noexcept { return descriptor_set_layout; }
+        constexpr auto get_descriptor_set() const noexcept { return descriptor_set; }
+        constexpr bool uses_gpu_mips() const noexcept { return gpu_mips; }
+};
+
+#endif // MCVK_TEXTURES_HPP
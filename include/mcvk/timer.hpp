@@ -0,0 +1,48 @@
+#ifndef MCVK_TIMER_HPP
+#define MCVK_TIMER_HPP
+
+#include <chrono>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+
+// Startup instrumentation. Every stage in front of the first frame records how long it took, so
+// regressions in the time to first present show up in '--startup-report'. None of this is
+// thread-safe, stages are only timed on the main thread.
+namespace Timing
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Record
+    {
+        const char *name {};
+        double ms {};
+        bool since_start {false}; // measured from process start rather than being a single stage
+    };
+
+    // Records the time from construction until it goes out of scope or 'stop' is called,
+    // whichever comes first. 'name' must outlive the records (string literals).
+    class ScopedTimer
+    {
+        private:
+            const char *name {};
+            Clock::time_point start {};
+            bool stopped {false};
+        public:
+            explicit ScopedTimer(const char *nname) noexcept : name {nname}, start {Clock::now()} {}
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(ScopedTimer)
+            ~ScopedTimer() noexcept { stop(); }
+
+            void stop() noexcept;
+    };
+
+    // Records the time since the process was started
+    extern void mark(const char *name) noexcept;
+
+    extern const std::vector<Record> &get_records() noexcept;
+
+    // Prints every record in the order they were taken to stdout
+    extern void report() noexcept;
+}
+
+#endif // MCVK_TIMER_HPP
@@ -0,0 +1,145 @@
+#ifndef MCVK_UPLOAD_HPP
+#define MCVK_UPLOAD_HPP
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/device.hpp"
+#include "mcvk/memory.hpp"
+
+// Streams data into device local buffers and images without ever stalling the graphics queue.
+// Data is written into a persistently mapped staging ring and copied on the transfer queue in
+// batches. Once a batch's fence has signaled, the graphics queue acquires ownership of the
+// resources it wrote (or just makes the writes visible if both queues share a family).
+//
+// Uploads can be staged from any thread. 'flush' and 'acquire_completed' belong to the thread
+// that records and submits frames.
+class Uploader
+{
+    public:
+        // Identifies the batch an upload was recorded into. Uploads become usable by the graphics
+        // queue once 'is_complete' returns true for their ticket.
+        using Ticket = u64;
+        static constexpr Ticket INVALID_TICKET {0};
+
+        static constexpr VkDeviceSize DEFAULT_STAGING_SIZE {32ull * 1024 * 1024};
+        static constexpr u32 MAX_BATCHES_IN_FLIGHT {4};
+    private:
+        // satisfies 'optimalBufferCopyOffsetAlignment' on every known device and the texel size
+        // alignment required for buffer to image copies
+        static constexpr VkDeviceSize STAGING_ALIGNMENT {256};
+
+        struct Batch
+        {
+            VkCommandBuffer command_buffer {VK_NULL_HANDLE};
+            VkFence fence {VK_NULL_HANDLE};
+            u64 ring_end {}; // ring position after the last staging allocation of this batch
+            bool recording {false};
+
+            // threads still copying their data into the staging ring for this batch
+            std::atomic<u32> pending_writes {};
+
+            // recorded at the end of the batch on the transfer queue and once it has completed on
+            // the graphics queue respectively
+            std::vector<VkBufferMemoryBarrier> buffer_releases {}, buffer_acquires {};
+            std::vector<VkImageMemoryBarrier> image_releases {}, image_acquires {};
+        };
+
+        VkDevice device {VK_NULL_HANDLE};
+        Memory::Allocator *allocator {nullptr};
+        VkQueue transfer_queue {VK_NULL_HANDLE};
+        u32 transfer_family {};
+        u32 graphics_family {};
+        VkCommandPool command_pool {VK_NULL_HANDLE};
+
+        VkBuffer staging_buffer {VK_NULL_HANDLE};
+        Memory::Allocation staging_allocation {};
+        VkDeviceSize staging_size {};
+
+        // Monotonic byte positions, the ring offset is 'position % staging_size'. Everything
+        // between the tail and the head may still be read by the transfer queue.
+        u64 ring_head {};
+        u64 ring_tail {};
+
+        std::array<Batch, MAX_BATCHES_IN_FLIGHT> batches {};
+        u64 submitted_batches {};
+        u64 completed_batches {};
+        mutable std::mutex mtx {};
+
+        struct Staging
+        {
+            void *data {nullptr};
+            VkDeviceSize offset {};
+            Batch *batch {nullptr};
+            Ticket ticket {INVALID_TICKET};
+        };
+
+        bool begin_batch_locked() noexcept;
+        Staging reserve_locked(VkDeviceSize size) noexcept;
+        Staging stage_buffer(VkBuffer destination, VkDeviceSize destination_offset, VkDeviceSize size) noexcept;
+        static void finish_write(const Staging &staging) noexcept
+        {
+            staging.batch->pending_writes.fetch_sub(1, std::memory_order_release);
+        }
+    public:
+        Uploader(const Device::LogicalDevice &logical_device, VkDeviceSize staging_buffer_size = DEFAULT_STAGING_SIZE) noexcept;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Uploader)
+        ~Uploader() noexcept;
+
+        // Copies 'size' bytes into 'destination'. 'write' is called with the mapped staging memory
+        // and must fill all of it, which lets producers such as the mesher write their output
+        // straight into the ring. Returns INVALID_TICKET if the staging ring (or every batch) is
+        // still in use, in which case the upload should be retried on a later frame.
+        template<typename Writer>
+        Ticket upload_buffer(VkBuffer destination, VkDeviceSize destination_offset, VkDeviceSize size, Writer &&write) noexcept
+        {
+            const auto staging = stage_buffer(destination, destination_offset, size);
+            if (staging.data == nullptr)
+                return INVALID_TICKET;
+            write(staging.data);
+            finish_write(staging);
+            return staging.ticket;
+        }
+        Ticket upload_buffer(VkBuffer destination, VkDeviceSize destination_offset, const void *data, VkDeviceSize size) noexcept
+        {
+            return upload_buffer(destination, destination_offset, size, [data, size](void *staging) {
+                std::memcpy(staging, data, size);
+            });
+        }
+
+        // Uploads tightly packed texels for layers [base_layer, base_layer + layer_count) of a mip
+        // level and leaves them in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. 'extent' is the extent
+        // of that level. Whole layers are copied since transfer-only queues may not support partial
+        // image copies.
+        Ticket upload_image(VkImage destination, VkExtent3D extent, u32 mip_level, u32 base_layer, u32 layer_count,
+                            const void *data, VkDeviceSize size) noexcept;
+
+        // Submits everything staged since the last call to the transfer queue. Never waits.
+        void flush() noexcept;
+
+        // Records the ownership acquires of every batch that has finished into a graphics command
+        // buffer, outside of a render pass. Uploads of those batches are usable afterwards.
+        void acquire_completed(VkCommandBuffer graphics_command_buffer) noexcept;
+
+        bool is_complete(Ticket ticket) const noexcept
+        {
+            std::lock_guard lock {mtx};
+            return ticket != INVALID_TICKET && ticket <= completed_batches;
+        }
+
+        // bytes of the staging ring still waiting to be consumed by the transfer queue
+        VkDeviceSize staging_usage() const noexcept
+        {
+            std::lock_guard lock {mtx};
+            return ring_head - ring_tail;
+        }
+        constexpr auto get_staging_size() const noexcept { return staging_size; }
+        constexpr bool has_dedicated_transfer_queue() const noexcept { return transfer_family != graphics_family; }
+};
+
+#endif // MCVK_UPLOAD_HPP
@@ -3,9 +3,6 @@
 
 #include "mcvk/global.hpp"
 #include <vulkan/vulkan.h>
-#ifndef NDEBUG
-    #include "mcvk/logger.hpp"
-#endif
 #include <GLFW/glfw3.h>
 
 class VkComponents
@@ -13,19 +10,21 @@ class VkComponents
     private:
         VkInstance instance {VK_NULL_HANDLE};
         VkSurfaceKHR surface {VK_NULL_HANDLE};
+        bool headless {false};
         #ifndef NDEBUG
             bool uses_debug_messenger {false}; 
             VkDebugUtilsMessengerEXT messenger {VK_NULL_HANDLE};
         #endif
 
     public:
-        #ifndef NDEBUG
-            explicit VkComponents(bool use_messenger, GLFWwindow *window) noexcept;
-        #endif
-        VkComponents() noexcept;
+        // If 'window' is nullptr, a headless surface (VK_EXT_headless_surface) is created instead
+        // of a window surface, so that rendering works on machines without a display. The messenger
+        // is only ever used in debug builds.
+        VkComponents(bool use_messenger, GLFWwindow *window) noexcept;
         ~VkComponents() noexcept;
         constexpr auto get_instance() const { return instance; }
         constexpr auto get_surface() const { return surface; }
+        constexpr auto is_headless() const { return headless; }
         DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(VkComponents)
 };
 
@@ -10,6 +10,7 @@ class Window
 {
     private:
         int width {}, height {};
+        bool framebuffer_resized {false};
     public:
         Window(int width, int height, const char *name) noexcept;
         DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Window)
@@ -18,6 +19,16 @@ class Window
         GLFWwindow *self {nullptr};
         inline constexpr auto get_width() const { return this->width; }
         inline constexpr auto get_height() const { return this->height; }
+
+        // Returns true once after every change of the framebuffer size
+        inline bool consume_resize() noexcept
+        {
+            const auto resized = framebuffer_resized;
+            framebuffer_resized = false;
+            return resized;
+        }
+        // Zero while the window is minimized
+        VkExtent2D get_framebuffer_extent() const noexcept;
 };
 
 #endif // MCVK_WINDOW_HPP
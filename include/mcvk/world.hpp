@@ -0,0 +1,61 @@
+#ifndef MCVK_WORLD_HPP
+#define MCVK_WORLD_HPP
+
+#include <unordered_map>
+#include <memory>
+#include "mcvk/types.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/chunk.hpp"
+
+namespace World
+{
+    // Converts a world block coordinate to the coordinate of the chunk containing it. Arithmetic
+    // shifts round towards negative infinity, so this also works for negative coordinates.
+    constexpr i32 to_chunk_coord(i32 block_coord) noexcept { return block_coord >> 4; }
+    constexpr i32 to_local_coord(i32 block_coord) noexcept { return block_coord & (Section::SIZE - 1); }
+
+    // Owns every loaded chunk. Chunks are heap allocated so references to them stay valid while
+    // other chunks are loaded and unloaded.
+    class ChunkStore
+    {
+        private:
+            std::unordered_map<ChunkPos, std::unique_ptr<Chunk>, ChunkPosHash> chunks {};
+        public:
+            ChunkStore() noexcept = default;
+            DELETE_NON_COPYABLE_DEFAULT(ChunkStore)
+
+            // Returns the existing chunk if it is already loaded
+            Chunk &create_chunk(ChunkPos pos) noexcept;
+            void remove_chunk(ChunkPos pos) noexcept;
+
+            Chunk *get_chunk(ChunkPos pos) noexcept
+            {
+                const auto found = chunks.find(pos);
+                return (found != chunks.end()) ? found->second.get() : nullptr;
+            }
+            const Chunk *get_chunk(ChunkPos pos) const noexcept
+            {
+                const auto found = chunks.find(pos);
+                return (found != chunks.end()) ? found->second.get() : nullptr;
+            }
+
+            // World coordinates. Blocks of unloaded chunks (or outside the world height) read as air
+            // and writes to them are dropped.
+            BlockId get_block(i32 x, i32 y, i32 z) const noexcept;
+            void set_block(i32 x, i32 y, i32 z, BlockId id) noexcept;
+
+            auto chunk_count() const noexcept { return chunks.size(); }
+            auto begin() const noexcept { return chunks.begin(); }
+            auto end() const noexcept { return chunks.end(); }
+
+            // total bytes held by all loaded chunks, including the map itself
+            usize memory_usage() const noexcept;
+    };
+
+    // Fills a chunk with layered placeholder terrain: bedrock, stone with scattered gravel, a few
+    // layers of dirt, grass and air above. The result only depends on the seed and the chunk's
+    // position, so chunks can be filled in any order and on any thread.
+    extern void fill_test_terrain(Chunk &chunk, u32 seed) noexcept;
+}
+
+#endif // MCVK_WORLD_HPP
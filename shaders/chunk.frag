@@ -0,0 +1,21 @@
+#version 450
+
+// Compile with: glslc chunk.frag -o chunk.frag.spv
+
+layout(location = 0) in vec2 uv;
+layout(location = 1) in float shade;
+layout(location = 2) flat in uint texture_index;
+
+layout(location = 0) out vec4 color;
+
+// see BlockTextures, every layer is one block texture
+layout(set = 1, binding = 0) uniform sampler2DArray block_textures;
+
+void main()
+{
+    vec4 texel = texture(block_textures, vec3(uv, float(texture_index)));
+    // leaves and glass are cut out, there is no blending
+    if (texel.a < 0.5)
+        discard;
+    color = vec4(texel.rgb * shade, 1.0);
+}
@@ -0,0 +1,54 @@
+#version 450
+
+// Compile with: glslc chunk.vert -o chunk.vert.spv
+
+layout(set = 0, binding = 0) uniform CameraData {
+    mat4 view_projection;
+    vec4 frustum_planes[6];
+    uint section_count;
+} camera;
+
+// see ChunkRenderer::SectionRecord, every draw passes its section's slot as the instance index
+struct Section {
+    ivec4 origin; // world position of the section's minimum corner
+    uint index_count;
+    int vertex_offset;
+    uvec2 padding;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer SectionData {
+    Section sections[];
+};
+
+// see Meshing::PackedVertex
+layout(location = 0) in uint packed_vertex;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out float out_shade;
+layout(location = 2) flat out uint out_texture;
+
+// fixed per face lighting: +x, -x, +y, -y, +z, -z
+const float FACE_SHADE[6] = float[](0.8, 0.8, 1.0, 0.5, 0.65, 0.65);
+
+void main()
+{
+    uint bits = packed_vertex;
+    vec3 position = vec3(bits & 31u, (bits >> 5) & 31u, (bits >> 10) & 31u);
+    uint face = (bits >> 15) & 7u;
+    uint ao = (bits >> 18) & 3u;
+
+    // the texture repeats once per block, so the position along the face's axes is the uv
+    if (face < 2u)
+        out_uv = position.zy;
+    else if (face < 4u)
+        out_uv = position.xz;
+    else
+        out_uv = position.xy;
+    // 'v' runs up along y on the sides, but the first texture row is the top one. Negating it
+    // keeps every block's texture upright, the sampler repeats it.
+    if (face != 2u && face != 3u)
+        out_uv.y = -out_uv.y;
+    out_shade = FACE_SHADE[face] * (0.4 + 0.2 * float(ao));
+    out_texture = bits >> 20;
+    gl_Position = camera.view_projection * vec4(position + vec3(sections[gl_InstanceIndex].origin.xyz), 1.0);
+}
@@ -0,0 +1,892 @@
+#include "mcvk/benchmark.hpp"
+#include "mcvk/world.hpp"
+#include "mcvk/mesher.hpp"
+#include "mcvk/jobs.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/terrain.hpp"
+#include "mcvk/region.hpp"
+#include "mcvk/light.hpp"
+#include "mcvk/simulation.hpp"
+#include "mcvk/entities.hpp"
+#include "mcvk/collision.hpp"
+#include "mcvk/checksum.hpp"
+#include "mcvk/math.hpp"
+#include "mcvk/types.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Benchmark
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr u32 SEED {1337};
+
+    static double seconds_since(Clock::time_point start) noexcept
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void world_storage() noexcept
+    {
+        static constexpr i32 RADIUS {8};
+        static constexpr usize OPERATIONS {10'000'000};
+
+        World::ChunkStore store {};
+        std::mt19937 rng {SEED};
+
+        auto start = Clock::now();
+        for (i32 z {-RADIUS}; z < RADIUS; ++z)
+            for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                World::fill_test_terrain(store.create_chunk({.x = x, .z = z}), SEED);
+        const auto fill_seconds = seconds_since(start);
+
+        const auto chunk_count = store.chunk_count();
+        const auto bytes = store.memory_usage();
+
+        // pre-generate coordinates so the random number generator is not part of the measurement
+        std::uniform_int_distribution<i32> horizontal {-RADIUS * World::Section::SIZE, RADIUS * World::Section::SIZE - 1};
+        std::uniform_int_distribution<i32> vertical {0, World::Chunk::HEIGHT - 1};
+        std::vector<std::array<i32, 3>> coordinates (1 << 16);
+        for (auto &c : coordinates)
+            c = {horizontal(rng), vertical(rng), horizontal(rng)};
+
+        u64 sink {};
+        start = Clock::now();
+        for (usize i {}; i < OPERATIONS; ++i) {
+            const auto &c = coordinates[i & (coordinates.size() - 1)];
+            sink += store.get_block(c[0], c[1], c[2]);
+        }
+        const auto get_seconds = seconds_since(start);
+
+        start = Clock::now();
+        for (usize i {}; i < OPERATIONS; ++i) {
+            const auto &c = coordinates[i & (coordinates.size() - 1)];
+            store.set_block(c[0], c[1], c[2], static_cast<World::BlockId>(1 + (i % (World::BlockCount - 1))));
+        }
+        const auto set_seconds = seconds_since(start);
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "world_storage: %zu chunks filled in %.3f s\n", chunk_count, fill_seconds);
+        fprintf(stdout, "  memory: %zu bytes total, %.1f bytes per chunk\n", bytes, static_cast<double>(bytes) / static_cast<double>(chunk_count));
+        fprintf(stdout, "  get: %.1f M blocks/s\n", static_cast<double>(OPERATIONS) / get_seconds / 1e6);
+        fprintf(stdout, "  set: %.1f M blocks/s\n", static_cast<double>(OPERATIONS) / set_seconds / 1e6);
+        fprintf(stdout, "  memory after random sets: %.1f bytes per chunk (checksum %llu)\n",
+                static_cast<double>(store.memory_usage()) / static_cast<double>(chunk_count), static_cast<unsigned long long>(sink));
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    void mesher() noexcept
+    {
+        static constexpr i32 RADIUS {4};
+        static constexpr double MIN_SECONDS {1.0};
+
+        World::ChunkStore store {};
+        for (i32 z {-RADIUS}; z < RADIUS; ++z)
+            for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                World::fill_test_terrain(store.create_chunk({.x = x, .z = z}), SEED);
+
+        // the worst case for both culling and merging: no two neighbouring blocks are alike
+        World::Section checkerboard {};
+        for (i32 y {}; y < World::Section::SIZE; ++y)
+            for (i32 z {}; z < World::Section::SIZE; ++z)
+                for (i32 x {}; x < World::Section::SIZE; ++x)
+                    if (((x + y + z) & 1) == 0)
+                        checkerboard.set(x, y, z, World::Stone);
+
+        Meshing::GreedyMesher greedy {};
+        Meshing::MeshData mesh {};
+
+        usize sections {}, meshed {}, quads {}, passes {};
+        const auto start = Clock::now();
+        while (seconds_since(start) < MIN_SECONDS) {
+            for (const auto &[pos, chunk] : store) {
+                for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i) {
+                    greedy.mesh(chunk->section(i), Meshing::neighbours_of(store, pos, i), mesh);
+                    ++sections;
+                    if (!mesh.empty()) {
+                        ++meshed;
+                        quads += mesh.quad_count();
+                    }
+                }
+            }
+            ++passes;
+        }
+        const auto terrain_seconds = seconds_since(start);
+
+        usize worst_case_sections {};
+        const auto worst_case_start = Clock::now();
+        while (seconds_since(worst_case_start) < MIN_SECONDS) {
+            greedy.mesh(checkerboard, {}, mesh);
+            ++worst_case_sections;
+        }
+        const auto worst_case_seconds = seconds_since(worst_case_start);
+
+        // a naive vertex of floats (position, normal, uv, texture layer, ambient occlusion) with
+        // 32-bit indices stored per mesh, against the packed vertices drawn with the shared indices
+        static constexpr usize NAIVE_FACE_BYTES {4 * (3 + 3 + 2 + 1 + 1) * sizeof(float) + 6 * sizeof(u32)};
+        static constexpr usize PACKED_FACE_BYTES {4 * sizeof(Meshing::PackedVertex)};
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "mesher: %zu chunks, %zu passes\n", store.chunk_count(), passes);
+        fprintf(stdout, "  terrain: %.0f sections/s (%zu of %zu sections produced geometry)\n",
+                static_cast<double>(sections) / terrain_seconds, meshed / passes, sections / passes);
+        fprintf(stdout, "  average non-empty mesh: %.1f quads, %.1f bytes\n",
+                static_cast<double>(quads) / static_cast<double>(meshed),
+                static_cast<double>(quads * PACKED_FACE_BYTES) / static_cast<double>(meshed));
+        fprintf(stdout, "  bytes per face: %zu packed, %zu naive (%.1fx)\n", PACKED_FACE_BYTES, NAIVE_FACE_BYTES,
+                static_cast<double>(NAIVE_FACE_BYTES) / static_cast<double>(PACKED_FACE_BYTES));
+        fprintf(stdout, "  checkerboard: %.0f sections/s, %zu quads\n",
+                static_cast<double>(worst_case_sections) / worst_case_seconds, mesh.quad_count());
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    // Main thread jobs, like the GLFW calls a worker needs, must run through the game loop's
+    // 'run_main_thread_jobs' call alone, the main thread doesn't necessarily wait on anything
+    static void check_main_thread_jobs(u32 thread_count) noexcept
+    {
+        static constexpr auto TIMEOUT = std::chrono::seconds{5};
+
+        std::atomic<u32> ran {};
+        const auto main_thread_job = [&ran] {
+            if (Jobs::JobSystem::worker_index() != 0)
+                Logger::fatal_error("A main thread job ran on worker {}", Jobs::JobSystem::worker_index());
+            ran.fetch_add(1, std::memory_order_relaxed);
+        };
+        Jobs::JobSystem job_system {thread_count};
+
+        // scheduled by the main thread itself, and by a worker
+        job_system.schedule(main_thread_job, nullptr, Jobs::Affinity::MainThread);
+        job_system.schedule([&job_system, &main_thread_job] {
+            job_system.schedule(main_thread_job, nullptr, Jobs::Affinity::MainThread);
+        });
+
+        const auto start = Clock::now();
+        while (ran.load(std::memory_order_relaxed) < 2) {
+            if (Clock::now() - start > TIMEOUT)
+                Logger::fatal_error("Only {} of 2 main thread jobs ran without waiting on them", ran.load());
+            job_system.run_main_thread_jobs();
+            std::this_thread::yield();
+        }
+    }
+
+    void jobs() noexcept
+    {
+        static constexpr i32 RADIUS {8};
+        static constexpr i32 REPEATS {3};
+
+        const auto max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<u32> thread_counts {};
+        for (u32 t {1}; t < max_threads; t *= 2)
+            thread_counts.push_back(t);
+        thread_counts.push_back(max_threads);
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "jobs: generating, meshing and staging %d chunks\n", (2 * RADIUS) * (2 * RADIUS));
+        double single_thread_seconds {};
+        for (const auto thread_count : thread_counts) {
+            double best {};
+            usize staged_bytes {};
+            for (i32 repeat {}; repeat < REPEATS; ++repeat) {
+                World::ChunkStore store {};
+                std::vector<World::Chunk *> chunks {};
+                for (i32 z {-RADIUS}; z < RADIUS; ++z)
+                    for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                        chunks.push_back(&store.create_chunk({.x = x, .z = z}));
+
+                Jobs::JobSystem job_system {thread_count};
+                std::vector<Meshing::GreedyMesher> meshers (thread_count);
+                std::vector<Meshing::MeshData> meshes (thread_count);
+                std::vector<std::vector<std::byte>> staging (thread_count);
+
+                const auto start = Clock::now();
+                Jobs::Counter generated {}, meshed {};
+                for (auto *chunk : chunks) {
+                    job_system.schedule([chunk] { World::fill_test_terrain(*chunk, SEED); }, &generated);
+                }
+                // meshing reads the neighbouring chunks, so it has to wait for all of them
+                for (const auto *chunk : chunks) {
+                    job_system.schedule_after(generated, [&, chunk] {
+                        const auto worker = Jobs::JobSystem::worker_index();
+                        auto &mesh = meshes[worker];
+                        auto &buffer = staging[worker];
+                        buffer.clear();
+                        for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i) {
+                            meshers[worker].mesh(chunk->section(i), Meshing::neighbours_of(store, chunk->get_pos(), i), mesh);
+                            const auto offset = buffer.size();
+                            buffer.resize(offset + mesh.byte_size());
+                            mesh.write_to(buffer.data() + offset);
+                        }
+                    }, &meshed);
+                }
+                job_system.wait(meshed);
+                const auto seconds = seconds_since(start);
+
+                best = (repeat == 0) ? seconds : std::min(best, seconds);
+                staged_bytes = 0;
+                for (const auto &buffer : staging)
+                    staged_bytes += buffer.capacity();
+            }
+
+            if (thread_count == 1)
+                single_thread_seconds = best;
+            fprintf(stdout, "  %2u threads: %8.2f ms, speedup %.2fx (%zu staging bytes)\n",
+                    thread_count, best * 1e3, single_thread_seconds / best, staged_bytes);
+        }
+
+        check_main_thread_jobs(std::max(max_threads, 2u));
+        fprintf(stdout, "  main thread jobs ran through run_main_thread_jobs alone\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    void logger() noexcept
+    {
+        static constexpr u32 MESSAGES_PER_THREAD {200'000};
+        static constexpr const char *NULL_PATH {"/dev/null"};
+
+        const auto max_threads = std::max(std::thread::hardware_concurrency(), 8u);
+        std::vector<u32> thread_counts {};
+        for (u32 t {1}; t < max_threads; t *= 2)
+            thread_counts.push_back(t);
+        thread_counts.push_back(max_threads);
+
+        std::FILE *null_file = std::fopen(NULL_PATH, "w");
+        if (null_file == nullptr)
+            Logger::fatal_error("Failed to open {} for the logger benchmark", NULL_PATH);
+        // without any sink the logger thread only discards records, which leaves the cost of the
+        // call itself. The JSON sink to /dev/null adds formatting, but no terminal.
+        Logger::set_console_enabled(false);
+
+        const auto run_threads = [](u32 thread_count, const auto &work) {
+            std::vector<std::thread> threads {};
+            for (u32 t {}; t < thread_count; ++t)
+                threads.emplace_back([&work, t] { work(static_cast<i32>(t)); });
+            for (auto &thread : threads)
+                thread.join();
+        };
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "logger: %u messages per thread, millions of messages per second\n", MESSAGES_PER_THREAD);
+        fprintf(stdout, "  threads | call site only | formatted to JSON | string + fprintf\n");
+        for (const auto thread_count : thread_counts) {
+            const auto total = static_cast<double>(thread_count) * MESSAGES_PER_THREAD;
+
+            // errors are the one level that is compiled into every build
+            const auto log = [](i32 thread) {
+                for (u32 i {}; i < MESSAGES_PER_THREAD; ++i)
+                    Logger::error("chunk {} {} meshed in {} us ({} quads)", thread, i, 12.5, i & 1023);
+            };
+
+            auto start = Clock::now();
+            run_threads(thread_count, log);
+            Logger::flush();
+            const auto submit_seconds = seconds_since(start);
+
+            if (!Logger::open_json_sink(NULL_PATH))
+                Logger::fatal_error("Failed to open {} for the logger benchmark", NULL_PATH);
+            start = Clock::now();
+            run_threads(thread_count, log);
+            Logger::flush();
+            const auto json_seconds = seconds_since(start);
+            Logger::open_json_sink(nullptr);
+
+            // what every call site used to do
+            start = Clock::now();
+            run_threads(thread_count, [null_file](i32 thread) {
+                for (u32 i {}; i < MESSAGES_PER_THREAD; ++i) {
+                    const auto msg = std::string{"chunk "} + std::to_string(thread) + " " + std::to_string(i) + " meshed in " +
+                                     std::to_string(12.5) + " us (" + std::to_string(i & 1023) + " quads)";
+                    fprintf(null_file, "ERROR: %s\n", msg.c_str());
+                }
+            });
+            const auto baseline_seconds = seconds_since(start);
+
+            fprintf(stdout, "  %7u | %14.2f | %17.2f | %16.2f\n", thread_count, total / submit_seconds / 1e6,
+                    total / json_seconds / 1e6, total / baseline_seconds / 1e6);
+        }
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+
+        std::fclose(null_file);
+        Logger::set_console_enabled(true);
+    }
+
+    void terrain() noexcept
+    {
+        static constexpr i32 RADIUS {8};
+        static constexpr i32 REPEATS {3};
+        // Hash of the chunks within RADIUS of the origin for SEED. Only update this when the output
+        // of the generator is meant to change.
+        static constexpr u64 GOLDEN_HASH {0xC84C07054264052A};
+
+        const auto max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<u32> thread_counts {};
+        for (u32 t {1}; t < max_threads; t *= 2)
+            thread_counts.push_back(t);
+        thread_counts.push_back(max_threads);
+
+        const auto chunk_count = (2 * RADIUS) * (2 * RADIUS);
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "terrain: generating %d chunks, best of %d\n", chunk_count, REPEATS);
+        for (auto isa = Terrain::Isa::Scalar; isa <= Terrain::best_isa(); isa = static_cast<Terrain::Isa>(static_cast<u8>(isa) + 1)) {
+            const Terrain::Generator generator {SEED, isa};
+            for (const auto thread_count : thread_counts) {
+                Jobs::JobSystem job_system {thread_count};
+                double best {};
+                u64 hash {};
+                for (i32 repeat {}; repeat < REPEATS; ++repeat) {
+                    World::ChunkStore store {};
+                    std::vector<World::Chunk *> chunks {};
+                    for (i32 z {-RADIUS}; z < RADIUS; ++z)
+                        for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                            chunks.push_back(&store.create_chunk({.x = x, .z = z}));
+
+                    const auto start = Clock::now();
+                    Jobs::Counter generated {};
+                    for (auto *chunk : chunks)
+                        job_system.schedule([&generator, chunk] { generator.generate(*chunk); }, &generated);
+                    job_system.wait(generated);
+                    const auto seconds = seconds_since(start);
+                    best = (repeat == 0) ? seconds : std::min(best, seconds);
+
+                    // chunks are hashed in a fixed order, whichever thread generated them
+                    hash = Checksum::FNV1A_BASIS;
+                    for (const auto *chunk : chunks)
+                        hash = Checksum::fnv1a_value(Terrain::hash_chunk(*chunk), hash);
+                }
+
+                if (hash != GOLDEN_HASH)
+                    Logger::fatal_error("Terrain generated with {} on {} threads does not match the golden hash ({} instead of {})",
+                                        Terrain::isa_name(isa), thread_count, hash, GOLDEN_HASH);
+                fprintf(stdout, "  %-6s %2u threads: %8.2f ms, %8.0f chunks/s\n",
+                        Terrain::isa_name(isa), thread_count, best * 1e3, chunk_count / best);
+            }
+        }
+        fprintf(stdout, "  every run matched the golden hash\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    void region() noexcept
+    {
+        static constexpr i32 RADIUS {8};
+        static constexpr std::array<i32, 4> LEVELS {1, 3, 6, 9};
+
+        World::ChunkStore store {};
+        std::vector<World::Chunk *> chunks {};
+        for (i32 z {-RADIUS}; z < RADIUS; ++z)
+            for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                chunks.push_back(&store.create_chunk({.x = x, .z = z}));
+
+        Jobs::JobSystem job_system {};
+        {
+            const Terrain::Generator generator {SEED};
+            Jobs::Counter generated {};
+            for (auto *chunk : chunks)
+                job_system.schedule([&generator, chunk] { generator.generate(*chunk); }, &generated);
+            job_system.wait(generated);
+        }
+
+        // the bytes a chunk would take on disk without compression
+        usize packed_bytes {};
+        for (const auto *chunk : chunks)
+            for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+                packed_bytes += chunk->section(i).get_palette().size() * sizeof(World::BlockId) +
+                                chunk->section(i).get_data().size() * sizeof(u64);
+
+        const auto directory = std::filesystem::temp_directory_path() / "mcvk_region_benchmark";
+        const auto chunk_count = static_cast<double>(chunks.size());
+        const auto megabytes = static_cast<double>(packed_bytes) / 1e6;
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "region: %zu chunks, %.0f packed bytes per chunk, loading on %u threads\n",
+                chunks.size(), static_cast<double>(packed_bytes) / chunk_count, job_system.thread_count());
+        fprintf(stdout, "  level | save chunks/s | save MB/s | load chunks/s | load MB/s | bytes/chunk on disk\n");
+        for (const auto level : LEVELS) {
+            std::error_code error {};
+            std::filesystem::remove_all(directory, error);
+
+            double save_seconds {};
+            usize disk_bytes {};
+            {
+                World::RegionStorage storage {directory.string(), level};
+                const auto start = Clock::now();
+                for (const auto *chunk : chunks)
+                    storage.save(*chunk);
+                storage.flush();
+                save_seconds = seconds_since(start);
+                disk_bytes = storage.disk_usage();
+            }
+
+            // a new storage has to open and map the region files again
+            World::ChunkStore loaded_store {};
+            std::vector<World::Chunk *> loaded {};
+            for (const auto *chunk : chunks)
+                loaded.push_back(&loaded_store.create_chunk(chunk->get_pos()));
+            double load_seconds {};
+            {
+                World::RegionStorage storage {directory.string(), level};
+                const auto start = Clock::now();
+                Jobs::Counter done {};
+                for (auto *chunk : loaded)
+                    job_system.schedule([&storage, chunk] {
+                        if (!storage.load(*chunk))
+                            Logger::fatal_error("Chunk ({}, {}) was saved but could not be loaded", chunk->get_pos().x, chunk->get_pos().z);
+                    }, &done);
+                job_system.wait(done);
+                load_seconds = seconds_since(start);
+            }
+
+            for (usize i {}; i < chunks.size(); ++i)
+                if (Terrain::hash_chunk(*chunks[i]) != Terrain::hash_chunk(*loaded[i]))
+                    Logger::fatal_error("Chunk ({}, {}) differs after being saved and loaded", chunks[i]->get_pos().x, chunks[i]->get_pos().z);
+
+            fprintf(stdout, "  %5d | %13.0f | %9.1f | %13.0f | %9.1f | %19.0f\n", level,
+                    chunk_count / save_seconds, megabytes / save_seconds, chunk_count / load_seconds,
+                    megabytes / load_seconds, static_cast<double>(disk_bytes) / chunk_count);
+        }
+        fprintf(stdout, "  every loaded chunk matched the saved one\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+
+        std::error_code error {};
+        std::filesystem::remove_all(directory, error);
+    }
+
+    // Hash of the light of every block of the loaded chunks, in a fixed order
+    static u64 hash_light(const World::ChunkStore &store, i32 radius) noexcept
+    {
+        u64 hash {Checksum::FNV1A_BASIS};
+        for (i32 cz {-radius}; cz < radius; ++cz) {
+            for (i32 cx {-radius}; cx < radius; ++cx) {
+                const auto *chunk = store.get_chunk({.x = cx, .z = cz});
+                for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+                    for (i32 y {}; y < World::Section::SIZE; ++y)
+                        for (i32 z {}; z < World::Section::SIZE; ++z)
+                            for (i32 x {}; x < World::Section::SIZE; ++x)
+                                hash = Checksum::fnv1a_value(chunk->section(i).get_light(x, y, z), hash);
+            }
+        }
+        return hash;
+    }
+
+    void lighting() noexcept
+    {
+        static constexpr i32 RADIUS {8};
+        static constexpr usize SOURCES {4096};
+        static constexpr usize SINGLE_UPDATES {512};
+
+        World::ChunkStore store {};
+        std::vector<World::ChunkPos> columns {};
+        for (i32 z {-RADIUS}; z < RADIUS; ++z)
+            for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                columns.push_back(store.create_chunk({.x = x, .z = z}).get_pos());
+
+        Jobs::JobSystem job_system {};
+        {
+            const Terrain::Generator generator {SEED};
+            Jobs::Counter generated {};
+            for (const auto pos : columns)
+                job_system.schedule([&generator, &store, pos] { generator.generate(*store.get_chunk(pos)); }, &generated);
+            job_system.wait(generated);
+        }
+
+        Lighting::LightEngine engine {store};
+        auto start = Clock::now();
+        for (const auto pos : columns)
+            engine.queue_column(pos);
+        engine.process(job_system);
+        const auto batched_column_seconds = seconds_since(start);
+
+        // one column per batch, as chunks trickle in while streaming
+        start = Clock::now();
+        for (const auto pos : columns) {
+            engine.queue_column(pos);
+            engine.process(job_system);
+        }
+        const auto single_column_seconds = seconds_since(start);
+        const auto lit_hash = hash_light(store, RADIUS);
+
+        // sources go on top of the surface, away from the unloaded chunks around the test area
+        std::mt19937 rng {SEED};
+        std::uniform_int_distribution<i32> horizontal {(1 - RADIUS) * World::Section::SIZE, (RADIUS - 1) * World::Section::SIZE - 1};
+        std::vector<std::array<i32, 3>> sources {};
+        while (sources.size() < SOURCES) {
+            const auto x = horizontal(rng), z = horizontal(rng);
+            i32 y {World::Chunk::HEIGHT - 1};
+            while (y > 0 && store.get_block(x, y - 1, z) == World::Air)
+                --y;
+            if (y < World::Chunk::HEIGHT - 1 && std::find(sources.begin(), sources.end(), std::array {x, y, z}) == sources.end())
+                sources.push_back({x, y, z});
+        }
+
+        struct Result
+        {
+            double updates_per_second {};
+            double writes_per_update {};
+        };
+        const auto measure = [&](std::span<const std::array<i32, 3>> batch, World::BlockId id, usize batch_size) {
+            const auto writes = engine.get_statistics().light_writes;
+            const auto measure_start = Clock::now();
+            for (usize i {}; i < batch.size(); ++i) {
+                engine.queue_block_change(batch[i][0], batch[i][1], batch[i][2], id);
+                if ((i + 1) % batch_size == 0 || i + 1 == batch.size())
+                    engine.process(job_system);
+            }
+            const auto seconds = seconds_since(measure_start);
+            const auto count = static_cast<double>(batch.size());
+            return Result{.updates_per_second = count / seconds,
+                          .writes_per_update = static_cast<double>(engine.get_statistics().light_writes - writes) / count};
+        };
+
+        const std::span<const std::array<i32, 3>> single {sources.data(), SINGLE_UPDATES};
+        const auto place_single = measure(single, World::Glowstone, 1);
+        const auto break_single = measure(single, World::Air, 1);
+        const auto place_batched = measure(sources, World::Glowstone, SOURCES);
+        const auto break_batched = measure(sources, World::Air, SOURCES);
+
+        if (hash_light(store, RADIUS) != lit_hash)
+            Logger::fatal_error("Breaking every placed light source did not restore the light of the world");
+
+        const auto column_count = static_cast<double>(columns.size());
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "lighting: %zu chunks on %u threads\n", columns.size(), job_system.thread_count());
+        fprintf(stdout, "  light new columns, one batch:       %8.0f columns/s\n", column_count / batched_column_seconds);
+        fprintf(stdout, "  relight lit columns, one per batch: %8.0f columns/s\n", column_count / single_column_seconds);
+        fprintf(stdout, "  light sources         | updates/s | light writes per update\n");
+        const auto print = [](const char *name, usize batch_size, const Result &result) {
+            fprintf(stdout, "  %s, %4zu per batch | %9.0f | %8.1f\n", name, batch_size, result.updates_per_second, result.writes_per_update);
+        };
+        print("place", 1, place_single);
+        print("break", 1, break_single);
+        print("place", SOURCES, place_batched);
+        print("break", SOURCES, break_batched);
+        fprintf(stdout, "  breaking every source restored the light\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    void simulation() noexcept
+    {
+        using namespace std::chrono_literals;
+        static constexpr auto DURATION {2s};
+        static constexpr auto FRAME {2ms}; // a frame rate far above the tick rate
+
+        struct Scenario
+        {
+            const char *name {};
+            std::chrono::milliseconds tick {};      // time every tick takes
+            std::chrono::milliseconds slow_tick {}; // time every 'slow_every'th tick takes instead
+            u64 slow_every {};
+        };
+        static constexpr std::array SCENARIOS {
+            Scenario{.name = "steady", .tick = 1ms},
+            Scenario{.name = "slow ticks", .tick = 1ms, .slow_tick = 120ms, .slow_every = 8},
+            Scenario{.name = "stall", .tick = 1ms, .slow_tick = 600ms, .slow_every = 20},
+        };
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "simulation: %u ticks per second for %.0f s, frames every %.0f ms\n", Simulation::DEFAULT_TICK_RATE,
+                std::chrono::duration<double>(DURATION).count(), std::chrono::duration<double, std::milli>(FRAME).count());
+        fprintf(stdout, "  scenario   | ticks/s | missed | max tick ms | frames | max frame ms\n");
+        for (const auto &scenario : SCENARIOS) {
+            Simulation simulation {[&scenario](Simulation::State &state, float seconds) {
+                const bool slow = scenario.slow_every != 0 && state.tick % scenario.slow_every == scenario.slow_every - 1;
+                std::this_thread::sleep_for(slow ? scenario.slow_tick : scenario.tick);
+                state.camera.position.z -= seconds;
+            }, {}};
+
+            const auto start = Clock::now();
+            while (Clock::now() - start < DURATION) {
+                static_cast<void>(simulation.frame_state());
+                std::this_thread::sleep_for(FRAME);
+            }
+            const auto seconds = seconds_since(start);
+
+            const auto statistics = simulation.get_statistics();
+            fprintf(stdout, "  %-10s | %7.1f | %6llu | %11.1f | %6llu | %12.1f\n", scenario.name,
+                    static_cast<double>(statistics.ticks) / seconds, static_cast<unsigned long long>(statistics.missed_ticks),
+                    statistics.max_tick_ms, static_cast<unsigned long long>(statistics.frames), statistics.max_frame_ms);
+        }
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    void entities() noexcept
+    {
+        static constexpr usize COUNT {100'000};
+        static constexpr usize STEPS {200};
+        static constexpr usize CHURN {COUNT / 5};
+        static constexpr float DT {0.05f};
+
+        // the usual object of a game loop, everything a mob knows in one place
+        struct Mob
+        {
+            Math::Vec3 position {};
+            Math::Vec3 velocity {};
+            Math::Vec3 rotation {};
+            float health {};
+            u32 target {};
+            u32 flags {};
+            u64 ai_state {};
+        };
+        struct Position { Math::Vec3 value {}; };
+        struct Velocity { Math::Vec3 value {}; };
+        struct Rotation { Math::Vec3 value {}; };
+        struct Health { float value {}; };
+
+        std::mt19937 rng {SEED};
+        std::uniform_real_distribution<float> distribution {-10.0f, 10.0f};
+        const auto random_vec3 = [&] { return Math::Vec3{distribution(rng), distribution(rng), distribution(rng)}; };
+
+        std::vector<Mob> mobs (COUNT);
+        Entities::Registry registry {};
+        std::vector<Entities::Entity> handles {};
+        for (auto &mob : mobs) {
+            mob = {.position = random_vec3(), .velocity = random_vec3(), .health = 20.0f};
+            const auto entity = registry.create();
+            registry.add(entity, Position{mob.position});
+            registry.add(entity, Velocity{mob.velocity});
+            registry.add(entity, Rotation{});
+            registry.add(entity, Health{mob.health});
+            handles.push_back(entity);
+        }
+
+        Jobs::JobSystem job_system {};
+        // best time of a step, in nanoseconds per entity
+        const auto measure = [](auto &&step) {
+            double best {};
+            for (usize i {}; i < STEPS; ++i) {
+                const auto start = Clock::now();
+                step();
+                const auto seconds = seconds_since(start);
+                best = (i == 0) ? seconds : std::min(best, seconds);
+            }
+            return best * 1e9 / static_cast<double>(COUNT);
+        };
+        const auto integrate = [](Entities::Entity, Position &position, const Velocity &velocity) {
+            position.value = position.value + velocity.value * DT;
+        };
+
+        const auto array_of_structs = measure([&mobs] {
+            for (auto &mob : mobs)
+                mob.position = mob.position + mob.velocity * DT;
+        });
+        const auto serial = measure([&registry, &integrate] { registry.each<Position, Velocity>(integrate); });
+        const auto parallel = measure([&] { registry.parallel_each<Position, Velocity>(job_system, integrate); });
+
+        // the entities took twice as many steps as the mobs, catch the mobs up and compare
+        for (usize i {}; i < STEPS; ++i)
+            for (auto &mob : mobs)
+                mob.position = mob.position + mob.velocity * DT;
+        for (usize i {}; i < COUNT; ++i)
+            if (!(registry.get<Position>(handles[i])->value == mobs[i].position))
+                Logger::fatal_error("Entity {} ended up somewhere else than the mob it mirrors", i);
+
+        // replace random entities and stop others for a moment, which moves their velocity to
+        // another slot than their position
+        for (usize i {}; i < CHURN; ++i) {
+            auto &handle = handles[std::uniform_int_distribution<usize>{0, COUNT - 1}(rng)];
+            if (i % 2 == 0) {
+                registry.destroy(handle);
+                handle = registry.create();
+                registry.add(handle, Position{random_vec3()});
+                registry.add(handle, Health{20.0f});
+            } else {
+                registry.remove<Velocity>(handle);
+            }
+            registry.add(handle, Velocity{random_vec3()});
+        }
+        if (registry.size() != COUNT || registry.pool<Position>().size() != COUNT)
+            Logger::fatal_error("The entity store lost track of entities while they were replaced");
+        const auto churned = measure([&registry, &integrate] { registry.each<Position, Velocity>(integrate); });
+        registry.arrange<Position, Velocity>();
+        const auto arranged = measure([&registry, &integrate] { registry.each<Position, Velocity>(integrate); });
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "entities: integrating %zu positions, best of %zu steps, %u threads\n", COUNT, STEPS, job_system.thread_count());
+        fprintf(stdout, "  array of %zu byte structs:            %6.2f ns/entity\n", sizeof(Mob), array_of_structs);
+        fprintf(stdout, "  component store:                     %6.2f ns/entity\n", serial);
+        fprintf(stdout, "  component store, on the job system:  %6.2f ns/entity\n", parallel);
+        fprintf(stdout, "  after %zu entities came and went:  %6.2f ns/entity\n", CHURN, churned);
+        fprintf(stdout, "  after arranging the pools:           %6.2f ns/entity\n", arranged);
+        fprintf(stdout, "  every entity matched the mob it mirrors\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    void collision() noexcept
+    {
+        static constexpr i32 RADIUS {4};
+        static constexpr usize COUNT {10'000};
+        static constexpr usize QUERIES {100'000};
+        static constexpr usize CHECKED_QUERIES {1'000};
+        static constexpr usize TICKS {20};
+        static constexpr float QUERY_RADIUS {4.0f};
+        static constexpr float RAY_LENGTH {64.0f};
+        static constexpr Math::Vec3 HALF_EXTENT {0.3f, 0.9f, 0.3f}; // a player sized box
+
+        World::ChunkStore store {};
+        const Terrain::Generator generator {SEED};
+        for (i32 z {-RADIUS}; z < RADIUS; ++z)
+            for (i32 x {-RADIUS}; x < RADIUS; ++x)
+                generator.generate(store.create_chunk({.x = x, .z = z}));
+
+        // entities stand on the surface or float a little above it
+        std::mt19937 rng {SEED};
+        const auto extent = static_cast<float>(RADIUS * World::Section::SIZE) - 8.0f;
+        std::uniform_real_distribution<float> horizontal {-extent, extent};
+        std::uniform_real_distribution<float> height {1.0f, 12.0f};
+        std::uniform_real_distribution<float> unit {-1.0f, 1.0f};
+        const auto surface = [&store](float x, float z) {
+            i32 y {World::Chunk::HEIGHT - 1};
+            while (y > 0 && !World::is_solid(store.get_block(static_cast<i32>(std::floor(x)), y - 1, static_cast<i32>(std::floor(z)))))
+                --y;
+            return static_cast<float>(y);
+        };
+
+        Entities::Registry registry {};
+        std::vector<Entities::Entity> entities {};
+        std::vector<Math::Vec3> centres {};
+        for (usize i {}; i < COUNT; ++i) {
+            const auto x = horizontal(rng), z = horizontal(rng);
+            entities.push_back(registry.create());
+            centres.push_back({x, surface(x, z) + HALF_EXTENT.y + height(rng), z});
+        }
+        const auto box_at = [](const Math::Vec3 &centre) { return Math::Aabb{centre - HALF_EXTENT, centre + HALF_EXTENT}; };
+
+        Collision::SpatialHash hash {};
+        auto start = Clock::now();
+        for (usize i {}; i < COUNT; ++i)
+            hash.update(entities[i], box_at(centres[i]));
+        const auto insert_seconds = seconds_since(start);
+
+        // every entity wanders a fraction of a block per tick
+        std::vector<Math::Vec3> velocities (COUNT);
+        for (auto &velocity : velocities)
+            velocity = {unit(rng) * 0.3f, unit(rng) * 0.1f, unit(rng) * 0.3f};
+        start = Clock::now();
+        for (usize tick {}; tick < TICKS; ++tick) {
+            for (usize i {}; i < COUNT; ++i) {
+                centres[i] = centres[i] + velocities[i];
+                hash.update(entities[i], box_at(centres[i]));
+            }
+        }
+        const auto update_seconds = seconds_since(start);
+
+        std::vector<Math::Aabb> query_boxes (QUERIES);
+        for (auto &box : query_boxes) {
+            const auto &centre = centres[std::uniform_int_distribution<usize>{0, COUNT - 1}(rng)];
+            box = {centre - Math::Vec3{QUERY_RADIUS, QUERY_RADIUS, QUERY_RADIUS}, centre + Math::Vec3{QUERY_RADIUS, QUERY_RADIUS, QUERY_RADIUS}};
+        }
+        std::vector<Entities::Entity> found {};
+        usize hash_results {};
+        start = Clock::now();
+        for (const auto &box : query_boxes) {
+            found.clear();
+            hash.query(box, found);
+            hash_results += found.size();
+        }
+        const auto query_seconds = seconds_since(start);
+
+        usize checked_results {};
+        start = Clock::now();
+        for (usize q {}; q < CHECKED_QUERIES; ++q) {
+            found.clear();
+            hash.query(query_boxes[q], found);
+            usize expected {};
+            for (usize i {}; i < COUNT; ++i) {
+                if (box_at(centres[i]).intersects(query_boxes[q])) {
+                    ++expected;
+                    if (std::find(found.begin(), found.end(), entities[i]) == found.end())
+                        Logger::fatal_error("Query {} of the spatial hash missed entity {}", q, i);
+                }
+            }
+            if (found.size() != expected)
+                Logger::fatal_error("Query {} of the spatial hash found {} entities instead of {}", q, found.size(), expected);
+            checked_results += expected;
+        }
+        const auto brute_force_seconds = seconds_since(start);
+
+        std::vector<Math::Vec3> directions (QUERIES);
+        for (auto &direction : directions)
+            direction = Math::normalize({unit(rng), unit(rng) - 0.3f, unit(rng)});
+        usize hits {};
+        start = Clock::now();
+        for (usize q {}; q < QUERIES; ++q)
+            hits += Collision::raycast(store, centres[q % COUNT], directions[q], RAY_LENGTH).has_value() ? 1 : 0;
+        const auto raycast_seconds = seconds_since(start);
+
+        // a tick of falling and walking for every entity
+        usize landed {};
+        const auto inside_block = [&store](const Math::Aabb &box) {
+            for (auto y = static_cast<i32>(std::floor(box.min.y)); y < static_cast<i32>(std::ceil(box.max.y)); ++y)
+                for (auto z = static_cast<i32>(std::floor(box.min.z)); z < static_cast<i32>(std::ceil(box.max.z)); ++z)
+                    for (auto x = static_cast<i32>(std::floor(box.min.x)); x < static_cast<i32>(std::ceil(box.max.x)); ++x)
+                        if (World::is_solid(store.get_block(x, y, z)))
+                            return true;
+            return false;
+        };
+        std::vector<Math::Aabb> boxes (COUNT);
+        for (usize i {}; i < COUNT; ++i)
+            boxes[i] = box_at(centres[i]);
+        start = Clock::now();
+        for (usize q {}; q < QUERIES; ++q) {
+            auto &box = boxes[q % COUNT];
+            const auto sweep = Collision::sweep(store, box, {velocities[q % COUNT].x, -0.8f, velocities[q % COUNT].z});
+            box = box.translated(sweep.motion);
+            landed += sweep.blocked[1] ? 1 : 0;
+        }
+        const auto sweep_seconds = seconds_since(start);
+        for (usize i {}; i < COUNT; ++i)
+            if (!inside_block(box_at(centres[i])) && inside_block({boxes[i].min + Math::Vec3{1e-3f, 1e-3f, 1e-3f}, boxes[i].max - Math::Vec3{1e-3f, 1e-3f, 1e-3f}}))
+                Logger::fatal_error("Entity {} was swept into a block", i);
+
+        const auto queries = static_cast<double>(QUERIES);
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "collision: %zu entities on %zu chunks, %zu occupied cells of %.0f blocks\n",
+                COUNT, store.chunk_count(), hash.cell_count(), static_cast<double>(Collision::SpatialHash::DEFAULT_CELL_SIZE));
+        fprintf(stdout, "  spatial hash inserts:        %10.0f /s\n", static_cast<double>(COUNT) / insert_seconds);
+        fprintf(stdout, "  spatial hash moves:          %10.0f /s\n", static_cast<double>(COUNT * TICKS) / update_seconds);
+        fprintf(stdout, "  box queries:                 %10.0f /s, %.1f entities each\n", queries / query_seconds,
+                static_cast<double>(hash_results) / queries);
+        fprintf(stdout, "  box queries, every entity:   %10.0f /s, %.1f entities each\n",
+                static_cast<double>(CHECKED_QUERIES) / brute_force_seconds, static_cast<double>(checked_results) / CHECKED_QUERIES);
+        fprintf(stdout, "  raycasts of %.0f blocks:      %10.0f /s, %.0f%% hit a block\n", static_cast<double>(RAY_LENGTH),
+                queries / raycast_seconds, 100.0 * static_cast<double>(hits) / queries);
+        fprintf(stdout, "  swept boxes:                 %10.0f /s, %.0f%% landed\n", queries / sweep_seconds,
+                100.0 * static_cast<double>(landed) / queries);
+        fprintf(stdout, "  queries matched testing every entity, no box was swept into a block\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+
+    bool run(const char *name) noexcept
+    {
+        if (strcmp(name, "world") == 0)
+            world_storage();
+        else if (strcmp(name, "mesher") == 0)
+            mesher();
+        else if (strcmp(name, "jobs") == 0)
+            jobs();
+        else if (strcmp(name, "logger") == 0)
+            logger();
+        else if (strcmp(name, "terrain") == 0)
+            terrain();
+        else if (strcmp(name, "region") == 0)
+            region();
+        else if (strcmp(name, "lighting") == 0)
+            lighting();
+        else if (strcmp(name, "simulation") == 0)
+            simulation();
+        else if (strcmp(name, "entities") == 0)
+            entities();
+        else if (strcmp(name, "collision") == 0)
+            collision();
+        else
+            return false;
+        return true;
+    }
+}
@@ -0,0 +1,1061 @@
+#include "mcvk/chunkrenderer.hpp"
+#include "mcvk/checksum.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/shader.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+
+namespace
+{
+    // Hash of the visible section slots, used to detect visibility changes per region
+    u64 hash_visible(const std::vector<u16> &visible) noexcept
+    {
+        return Checksum::fnv1a({reinterpret_cast<const u8 *>(visible.data()), visible.size() * sizeof(u16)});
+    }
+
+    constexpr u32 CULL_GROUP_SIZE {64}; // 'local_size_x' of chunk_cull.comp
+}
+
+ChunkRenderer::ChunkRenderer(const Device::LogicalDevice &logical_device, Renderer &rrenderer, Jobs::JobSystem &jjob_system,
+                             bool allow_gpu_culling, VkDeviceSize arena_size) noexcept :
+    device {logical_device.get()},
+    allocator {&logical_device.get_allocator()},
+    pipeline_cache {logical_device.get_pipeline_cache().get()},
+    renderer {&rrenderer},
+    job_system {&jjob_system},
+    graphics_family {logical_device.get_queue_family_indices().get(Queue::GraphicsQueueIndex)},
+    textures {logical_device, rrenderer.get_uploader()}
+{
+    // every draw passes its slot as 'firstInstance', which indirect draws only support with
+    // 'drawIndirectFirstInstance'
+    const auto &features = logical_device.get_features();
+    if (allow_gpu_culling && features.multiDrawIndirect && features.drawIndirectFirstInstance &&
+        logical_device.get_limits().maxDrawIndirectCount >= MAX_SECTIONS) {
+        path = DrawPath::Indirect;
+        if (logical_device.supports_draw_indirect_count()) {
+            draw_indexed_indirect_count = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+            if (draw_indexed_indirect_count != nullptr)
+                path = DrawPath::IndirectCount;
+        }
+    }
+
+    static constexpr std::array PATH_NAMES {"direct draws with CPU culling", "indirect draws with GPU culling",
+                                            "indirect count draws with GPU culling"};
+    Logger::info("Chunk renderer uses {}", PATH_NAMES[static_cast<usize>(path)]);
+
+    create_buffers(arena_size);
+    create_descriptors();
+    create_pipelines();
+}
+
+// Each pipeline is compiled on its own worker, the pipeline cache is internally synchronized
+void ChunkRenderer::create_pipelines() noexcept
+{
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    Jobs::Counter counter {};
+    const auto render_pass = renderer->get_render_pass();
+    job_system->schedule([this, render_pass] { create_pipeline(render_pass); }, &counter);
+    if (path != DrawPath::Direct)
+        job_system->schedule([this] { create_cull_pipeline(); }, &counter);
+    job_system->wait(counter);
+
+    pipeline_creation_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    Logger::info("Created chunk pipelines in {} ms", pipeline_creation_ms);
+}
+
+bool ChunkRenderer::quad_indices_ready() noexcept
+{
+    auto &uploader = renderer->get_uploader();
+    if (quad_index_ticket == Uploader::INVALID_TICKET)
+        quad_index_ticket = uploader.upload_buffer(quad_index_buffer, 0, Meshing::QUAD_INDEX_COUNT * sizeof(u32), [](void *staging) {
+            Meshing::write_quad_indices(static_cast<u32 *>(staging));
+        });
+    return uploader.is_complete(quad_index_ticket);
+}
+
+ChunkRenderer::~ChunkRenderer() noexcept
+{
+    if (device == VK_NULL_HANDLE)
+        return;
+
+    vkDeviceWaitIdle(device);
+
+    for (auto &[pos, region] : regions)
+        destroy_region(*region);
+    for (auto &retired : retired_regions)
+        destroy_region(*retired.region);
+
+    vkDestroyPipeline(device, cull_pipeline, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+
+    // every mesh lives in the arena, so freeing it frees all of them
+    const std::array buffers {
+        std::pair{camera_buffer, &camera_allocation},
+        std::pair{arena_buffer, &arena_allocation},
+        std::pair{quad_index_buffer, &quad_index_allocation},
+        std::pair{section_buffer, &section_allocation},
+        std::pair{draw_command_buffer, &draw_command_allocation},
+        std::pair{draw_count_buffer, &draw_count_allocation},
+        std::pair{reachable_buffer, &reachable_allocation}
+    };
+    for (const auto &[buffer, allocation] : buffers) {
+        if (buffer == VK_NULL_HANDLE)
+            continue;
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(*allocation);
+    }
+    device = VK_NULL_HANDLE;
+}
+
+VkBuffer ChunkRenderer::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, Memory::Allocation &allocation) const noexcept
+{
+    VkBufferCreateInfo buffer_create_info {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = size;
+    buffer_create_info.usage = usage;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer {VK_NULL_HANDLE};
+    if (vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create chunk renderer buffer");
+    allocation = allocator->allocate_buffer(buffer, Memory::Usage::GpuOnly);
+    if (!allocation.is_valid())
+        Logger::fatal_error("Failed to allocate memory for a chunk renderer buffer");
+    return buffer;
+}
+
+void ChunkRenderer::create_buffers(VkDeviceSize arena_size) noexcept
+{
+    // Everything below is updated inside the frame's command buffer, so one buffer serves every
+    // frame in flight and the cached secondary command buffers can keep using the same descriptors
+    camera_buffer = create_buffer(sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, camera_allocation);
+    section_buffer = create_buffer(sizeof(SectionRecord) * MAX_SECTIONS,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, section_allocation);
+
+    // only vertices live in the arena, the indices of every quad are the same and shared by all meshes
+    arena_buffer = create_buffer(arena_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, arena_allocation);
+    quad_index_buffer = create_buffer(Meshing::QUAD_INDEX_COUNT * sizeof(u32),
+                                      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, quad_index_allocation);
+    arena.size = arena_size;
+    arena.free_ranges.emplace(0, arena_size);
+
+    if (path != DrawPath::Direct) {
+        draw_command_buffer = create_buffer(sizeof(VkDrawIndexedIndirectCommand) * MAX_SECTIONS,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, draw_command_allocation);
+        draw_count_buffer = create_buffer(sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                       VK_BUFFER_USAGE_TRANSFER_DST_BIT, draw_count_allocation);
+        reachable_slots.resize((MAX_SECTIONS + 31) / 32);
+        reachable_buffer = create_buffer(reachable_slots.size() * sizeof(u32),
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, reachable_allocation);
+    }
+}
+
+void ChunkRenderer::create_descriptors() noexcept
+{
+    static constexpr auto VERTEX_AND_COMPUTE = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    static constexpr std::array BINDINGS {
+        // camera and frustum planes
+        VkDescriptorSetLayoutBinding{.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1,
+                                     .stageFlags = VERTEX_AND_COMPUTE, .pImmutableSamplers = nullptr},
+        // section records
+        VkDescriptorSetLayoutBinding{.binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1,
+                                     .stageFlags = VERTEX_AND_COMPUTE, .pImmutableSamplers = nullptr},
+        // draw commands and draw count, only written with GPU culling
+        VkDescriptorSetLayoutBinding{.binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1,
+                                     .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = nullptr},
+        VkDescriptorSetLayoutBinding{.binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1,
+                                     .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = nullptr},
+        // sections reached by occlusion culling, only read with GPU culling
+        VkDescriptorSetLayoutBinding{.binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1,
+                                     .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = nullptr}
+    };
+
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info {};
+    descriptor_set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptor_set_layout_create_info.bindingCount = static_cast<u32>(BINDINGS.size());
+    descriptor_set_layout_create_info.pBindings = BINDINGS.data();
+
+    if (vkCreateDescriptorSetLayout(device, &descriptor_set_layout_create_info, nullptr, &descriptor_set_layout) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create chunk descriptor set layout");
+
+    static constexpr std::array POOL_SIZES {
+        VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1},
+        VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 4}
+    };
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info {};
+    descriptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.maxSets = 1;
+    descriptor_pool_create_info.poolSizeCount = static_cast<u32>(POOL_SIZES.size());
+    descriptor_pool_create_info.pPoolSizes = POOL_SIZES.data();
+
+    if (vkCreateDescriptorPool(device, &descriptor_pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create chunk descriptor pool");
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info {};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool = descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts = &descriptor_set_layout;
+
+    if (vkAllocateDescriptorSets(device, &descriptor_set_allocate_info, &descriptor_set) != VK_SUCCESS)
+        Logger::fatal_error("Failed to allocate chunk descriptor set");
+
+    const std::array buffer_infos {
+        VkDescriptorBufferInfo{.buffer = camera_buffer, .offset = 0, .range = sizeof(CameraData)},
+        VkDescriptorBufferInfo{.buffer = section_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{.buffer = draw_command_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{.buffer = draw_count_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+        VkDescriptorBufferInfo{.buffer = reachable_buffer, .offset = 0, .range = VK_WHOLE_SIZE}
+    };
+
+    std::array<VkWriteDescriptorSet, buffer_infos.size()> writes {};
+    for (u32 i {}; i < writes.size(); ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptor_set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = BINDINGS[i].descriptorType;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    // the culling buffers only exist with GPU culling
+    const u32 write_count = (path == DrawPath::Direct) ? 2 : static_cast<u32>(writes.size());
+    vkUpdateDescriptorSets(device, write_count, writes.data(), 0, nullptr);
+
+    // shared by the graphics and the culling pipeline, which only uses the first set
+    const std::array set_layouts {descriptor_set_layout, textures.get_descriptor_set_layout()};
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info {};
+    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount = static_cast<u32>(set_layouts.size());
+    pipeline_layout_create_info.pSetLayouts = set_layouts.data();
+
+    if (vkCreatePipelineLayout(device, &pipeline_layout_create_info, nullptr, &pipeline_layout) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create chunk pipeline layout");
+}
+
+void ChunkRenderer::create_pipeline(VkRenderPass render_pass) noexcept
+{
+    const auto vertex_shader = Shader::load_module(device, "chunk.vert");
+    const auto fragment_shader = Shader::load_module(device, "chunk.frag");
+
+    const std::array shader_stages {
+        VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertex_shader,
+            .pName = "main",
+            .pSpecializationInfo = nullptr
+        },
+        VkPipelineShaderStageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment_shader,
+            .pName = "main",
+            .pSpecializationInfo = nullptr
+        }
+    };
+
+    static constexpr VkVertexInputBindingDescription VERTEX_BINDING {
+        .binding = 0,
+        .stride = sizeof(Meshing::PackedVertex),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+    };
+    // the packed vertex is unpacked in the vertex shader
+    static constexpr std::array VERTEX_ATTRIBUTES {
+        VkVertexInputAttributeDescription{.location = 0, .binding = 0, .format = VK_FORMAT_R32_UINT, .offset = 0}
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertex_input {};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = 1;
+    vertex_input.pVertexBindingDescriptions = &VERTEX_BINDING;
+    vertex_input.vertexAttributeDescriptionCount = static_cast<u32>(VERTEX_ATTRIBUTES.size());
+    vertex_input.pVertexAttributeDescriptions = VERTEX_ATTRIBUTES.data();
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly {};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // viewport and scissor are dynamic, the pipeline survives swapchain resizes
+    VkPipelineViewportStateCreateInfo viewport_state {};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization.cullMode = VK_CULL_MODE_BACK_BIT;
+    // the mesher emits counter-clockwise quads and the projection keeps them that way
+    rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil {};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = VK_TRUE;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment {};
+    color_blend_attachment.blendEnable = VK_FALSE;
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo color_blend {};
+    color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = 1;
+    color_blend.pAttachments = &color_blend_attachment;
+
+    static constexpr std::array DYNAMIC_STATES {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamic_state {};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<u32>(DYNAMIC_STATES.size());
+    dynamic_state.pDynamicStates = DYNAMIC_STATES.data();
+
+    VkGraphicsPipelineCreateInfo pipeline_create_info {};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stageCount = static_cast<u32>(shader_stages.size());
+    pipeline_create_info.pStages = shader_stages.data();
+    pipeline_create_info.pVertexInputState = &vertex_input;
+    pipeline_create_info.pInputAssemblyState = &input_assembly;
+    pipeline_create_info.pViewportState = &viewport_state;
+    pipeline_create_info.pRasterizationState = &rasterization;
+    pipeline_create_info.pMultisampleState = &multisample;
+    pipeline_create_info.pDepthStencilState = &depth_stencil;
+    pipeline_create_info.pColorBlendState = &color_blend;
+    pipeline_create_info.pDynamicState = &dynamic_state;
+    pipeline_create_info.layout = pipeline_layout;
+    pipeline_create_info.renderPass = render_pass;
+    pipeline_create_info.subpass = 0;
+
+    if (vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &pipeline) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create chunk pipeline");
+
+    // modules are only needed while the pipeline is created
+    vkDestroyShaderModule(device, vertex_shader, nullptr);
+    vkDestroyShaderModule(device, fragment_shader, nullptr);
+
+    Logger::info("Created chunk pipeline successfully");
+}
+
+void ChunkRenderer::create_cull_pipeline() noexcept
+{
+    const auto compute_shader = Shader::load_module(device, "chunk_cull.comp");
+
+    // see 'COMPACT' in chunk_cull.comp
+    const VkBool32 compact = (path == DrawPath::IndirectCount) ? VK_TRUE : VK_FALSE;
+    static constexpr VkSpecializationMapEntry COMPACT_ENTRY {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(VkBool32)
+    };
+    const VkSpecializationInfo specialization_info {
+        .mapEntryCount = 1,
+        .pMapEntries = &COMPACT_ENTRY,
+        .dataSize = sizeof(compact),
+        .pData = &compact
+    };
+
+    VkComputePipelineCreateInfo pipeline_create_info {};
+    pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_create_info.stage.module = compute_shader;
+    pipeline_create_info.stage.pName = "main";
+    pipeline_create_info.stage.pSpecializationInfo = &specialization_info;
+    pipeline_create_info.layout = pipeline_layout;
+
+    if (vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_create_info, nullptr, &cull_pipeline) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create chunk culling pipeline");
+
+    vkDestroyShaderModule(device, compute_shader, nullptr);
+}
+
+ChunkRenderer::Region &ChunkRenderer::get_or_create_region(RegionPos pos) noexcept
+{
+    auto &region = regions[pos];
+    if (region != nullptr)
+        return *region;
+
+    region = std::make_unique<Region>();
+    region->pos = pos;
+    region->caches.resize(renderer->frames_in_flight());
+
+    // One pool per region and frame in flight. Pools may only be used by one thread at a time and
+    // any worker can end up recording a region, so the pools follow the regions, not the threads.
+    for (auto &cache : region->caches) {
+        VkCommandPoolCreateInfo command_pool_create_info {};
+        command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        command_pool_create_info.queueFamilyIndex = graphics_family;
+
+        if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &cache.command_pool) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create region command pool");
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info {};
+        command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_allocate_info.commandPool = cache.command_pool;
+        command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        command_buffer_allocate_info.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &cache.command_buffer) != VK_SUCCESS)
+            Logger::fatal_error("Failed to allocate region command buffer");
+    }
+    return *region;
+}
+
+void ChunkRenderer::destroy_region(Region &region) const noexcept
+{
+    // freeing a pool frees its command buffers
+    for (auto &cache : region.caches)
+        vkDestroyCommandPool(device, cache.command_pool, nullptr);
+    region.caches.clear();
+}
+
+void ChunkRenderer::free_mesh(GpuMesh &mesh) noexcept
+{
+    if (!mesh.is_valid())
+        return;
+    Memory::sub_free(arena, mesh.arena_offset);
+    mesh = {};
+}
+
+void ChunkRenderer::retire(GpuMesh &mesh) noexcept
+{
+    if (!mesh.is_valid())
+        return;
+    retired_meshes.push_back({.frame = frame_number, .mesh = mesh});
+    mesh = {};
+}
+
+void ChunkRenderer::supersede(SectionMesh &section_mesh) noexcept
+{
+    if (section_mesh.pending.is_valid())
+        superseded_meshes.push_back({.frame = frame_number, .mesh = section_mesh.pending, .ticket = section_mesh.ticket});
+    section_mesh.pending = {};
+    section_mesh.ticket = Uploader::INVALID_TICKET;
+}
+
+bool ChunkRenderer::acquire_slot(SectionMesh &section_mesh) noexcept
+{
+    if (section_mesh.slot != INVALID_SLOT)
+        return true;
+
+    if (!free_slots.empty()) {
+        section_mesh.slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else if (section_records.size() < MAX_SECTIONS) {
+        section_mesh.slot = static_cast<u32>(section_records.size());
+        section_records.emplace_back();
+    }
+    else {
+        return false;
+    }
+    ++live_sections;
+    return true;
+}
+
+void ChunkRenderer::write_record(const SectionMesh &section_mesh, World::ChunkPos chunk, i32 section) noexcept
+{
+    const auto &mesh = section_mesh.current;
+    section_records[section_mesh.slot] = {
+        .origin = {chunk.x * World::Section::SIZE, section * World::Section::SIZE, chunk.z * World::Section::SIZE, 0},
+        .index_count = mesh.index_count,
+        .vertex_offset = mesh.vertex_offset,
+        .padding = {}
+    };
+    dirty_slots.push_back(section_mesh.slot);
+}
+
+void ChunkRenderer::release_slot(SectionMesh &section_mesh) noexcept
+{
+    if (section_mesh.slot == INVALID_SLOT)
+        return;
+    // an empty record is skipped by the culling pass
+    section_records[section_mesh.slot] = {};
+    dirty_slots.push_back(section_mesh.slot);
+    free_slots.push_back(section_mesh.slot);
+    section_mesh.slot = INVALID_SLOT;
+    --live_sections;
+}
+
+bool ChunkRenderer::update_section(World::ChunkPos chunk, i32 section, const Meshing::MeshData &mesh) noexcept
+{
+    auto &region = get_or_create_region(region_of(chunk));
+    auto &section_mesh = region.sections[section_slot(chunk, section)];
+    region.chunks |= chunk_bit(chunk);
+
+    // a newer mesh supersedes one that is still uploading
+    supersede(section_mesh);
+
+    if (mesh.empty()) {
+        section_mesh.connectivity = mesh.connectivity;
+        if (section_mesh.current.is_valid()) {
+            retire(section_mesh.current);
+            ++region.version;
+        }
+        release_slot(section_mesh);
+        return true;
+    }
+
+    // the record stays empty, and so the slot unused, until the upload has finished
+    if (!acquire_slot(section_mesh)) {
+        Logger::error("Too many chunk sections, dropping section mesh");
+        return true;
+    }
+
+    // the vertex offset of indexed draws counts whole vertices
+    VkDeviceSize offset {};
+    if (!Memory::sub_allocate(arena, mesh.byte_size(), sizeof(Meshing::PackedVertex), offset)) {
+        Logger::error("Chunk mesh arena is full, dropping section mesh");
+        if (!section_mesh.current.is_valid())
+            release_slot(section_mesh);
+        return true;
+    }
+
+    const GpuMesh gpu_mesh {
+        .arena_offset = offset,
+        .index_count = static_cast<u32>(mesh.quad_count() * 6),
+        .vertex_offset = static_cast<i32>(offset / sizeof(Meshing::PackedVertex))
+    };
+
+    const auto ticket = renderer->get_uploader().upload_buffer(arena_buffer, offset, mesh.byte_size(), [&mesh](void *staging) {
+        mesh.write_to(staging);
+    });
+    if (ticket == Uploader::INVALID_TICKET) {
+        Memory::sub_free(arena, offset);
+        if (!section_mesh.current.is_valid())
+            release_slot(section_mesh);
+        return false;
+    }
+
+    section_mesh.pending = gpu_mesh;
+    section_mesh.pending_connectivity = mesh.connectivity;
+    section_mesh.ticket = ticket;
+    pending_uploads.push_back({.region = &region, .section = section_slot(chunk, section)});
+    return true;
+}
+
+void ChunkRenderer::drop_meshes(Region &region, World::ChunkPos chunk) noexcept
+{
+    for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i) {
+        auto &section_mesh = region.sections[section_slot(chunk, i)];
+        supersede(section_mesh);
+        if (section_mesh.current.is_valid()) {
+            retire(section_mesh.current);
+            ++region.version;
+        }
+        release_slot(section_mesh);
+    }
+}
+
+void ChunkRenderer::drop_chunk_meshes(World::ChunkPos chunk) noexcept
+{
+    const auto found = regions.find(region_of(chunk));
+    if (found != regions.end())
+        drop_meshes(*found->second, chunk);
+}
+
+void ChunkRenderer::remove_chunk(World::ChunkPos chunk) noexcept
+{
+    const auto found = regions.find(region_of(chunk));
+    if (found == regions.end())
+        return;
+
+    auto &region = *found->second;
+    drop_meshes(region, chunk);
+    for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+        region.sections[section_slot(chunk, i)].connectivity = Meshing::Connectivity::all();
+
+    // Nothing of the region is left, the camera has moved on. Its meshes were retired above, its
+    // command buffers go once the frames that may still execute them have finished.
+    region.chunks &= static_cast<u16>(~chunk_bit(chunk));
+    if (region.chunks == 0) {
+        std::erase_if(pending_uploads, [&region](const PendingUpload &upload) { return upload.region == &region; });
+        retired_regions.push_back({.frame = frame_number, .region = std::move(found->second)});
+        regions.erase(found);
+    }
+}
+
+bool ChunkRenderer::is_chunk_uploaded(World::ChunkPos chunk) const noexcept
+{
+    const auto found = regions.find(region_of(chunk));
+    if (found == regions.end())
+        return true;
+    for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+        if (found->second->sections[section_slot(chunk, i)].ticket != Uploader::INVALID_TICKET)
+            return false;
+    return true;
+}
+
+void ChunkRenderer::finish_uploads() noexcept
+{
+    const auto &uploader = renderer->get_uploader();
+    std::erase_if(pending_uploads, [&uploader, this](const PendingUpload &upload) {
+        auto &section_mesh = upload.region->sections[upload.section];
+        // superseded or removed in the meantime
+        if (section_mesh.ticket == Uploader::INVALID_TICKET)
+            return true;
+        if (!uploader.is_complete(section_mesh.ticket))
+            return false;
+
+        retire(section_mesh.current);
+        section_mesh.current = section_mesh.pending;
+        section_mesh.connectivity = section_mesh.pending_connectivity;
+        section_mesh.pending = {};
+        section_mesh.ticket = Uploader::INVALID_TICKET;
+
+        // recover the chunk position and section index from the region slot
+        const World::ChunkPos chunk {
+            .x = upload.region->pos.x * REGION_SIZE + upload.section % REGION_SIZE,
+            .z = upload.region->pos.z * REGION_SIZE + (upload.section / REGION_SIZE) % REGION_SIZE
+        };
+        write_record(section_mesh, chunk, upload.section / (REGION_SIZE * REGION_SIZE));
+        ++upload.region->version;
+        return true;
+    });
+}
+
+void ChunkRenderer::write_section_records(VkCommandBuffer command_buffer) noexcept
+{
+    // vkCmdUpdateBuffer is limited to 64 KiB per call
+    static constexpr usize MAX_RECORDS_PER_UPDATE {65536 / sizeof(SectionRecord)};
+
+    std::sort(dirty_slots.begin(), dirty_slots.end());
+    dirty_slots.erase(std::unique(dirty_slots.begin(), dirty_slots.end()), dirty_slots.end());
+
+    // contiguous slots are written with a single update
+    for (usize i {}; i < dirty_slots.size();) {
+        usize count {1};
+        while (i + count < dirty_slots.size() && count < MAX_RECORDS_PER_UPDATE && dirty_slots[i + count] == dirty_slots[i] + count)
+            ++count;
+        vkCmdUpdateBuffer(command_buffer, section_buffer, dirty_slots[i] * sizeof(SectionRecord),
+                          count * sizeof(SectionRecord), &section_records[dirty_slots[i]]);
+        i += count;
+    }
+    dirty_slots.clear();
+}
+
+void ChunkRenderer::cull(const Math::Camera &camera, const Math::Frustum &frustum) noexcept
+{
+    PROFILE_ZONE("chunk culling");
+    for (auto &[pos, region] : regions)
+        region->visible.clear();
+
+    statistics.occlusion_ms = 0.0;
+    if (occlusion_culling) {
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        const bool culled = cull_occluded(camera, frustum);
+        statistics.occlusion_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (!culled)
+            cull_frustum(frustum);
+    } else {
+        cull_frustum(frustum);
+    }
+
+    statistics.visible_sections = 0;
+    statistics.visible_regions = 0;
+    for (auto &[pos, region] : regions) {
+        // the walk visits sections in no particular order, the hash has to be stable
+        std::sort(region->visible.begin(), region->visible.end());
+        region->visibility_hash = hash_visible(region->visible);
+        if (!region->visible.empty()) {
+            statistics.visible_sections += static_cast<u32>(region->visible.size());
+            ++statistics.visible_regions;
+        }
+    }
+}
+
+void ChunkRenderer::cull_frustum(const Math::Frustum &frustum) noexcept
+{
+    constexpr auto SIZE = static_cast<float>(World::Section::SIZE);
+    constexpr auto REGION_BLOCKS = static_cast<float>(REGION_SIZE * World::Section::SIZE);
+
+    for (auto &[pos, region] : regions) {
+        const Math::Vec3 region_min {static_cast<float>(pos.x) * REGION_BLOCKS, 0.0f, static_cast<float>(pos.z) * REGION_BLOCKS};
+        const Math::Vec3 region_max {region_min.x + REGION_BLOCKS, static_cast<float>(World::Chunk::HEIGHT), region_min.z + REGION_BLOCKS};
+        if (!frustum.intersects_box(region_min, region_max))
+            continue;
+
+        for (u16 slot {}; slot < SECTIONS_PER_REGION; ++slot) {
+            if (!region->sections[slot].current.is_valid())
+                continue;
+
+            const Math::Vec3 min {
+                region_min.x + static_cast<float>(slot % REGION_SIZE) * SIZE,
+                static_cast<float>(slot / (REGION_SIZE * REGION_SIZE)) * SIZE,
+                region_min.z + static_cast<float>((slot / REGION_SIZE) % REGION_SIZE) * SIZE
+            };
+            if (frustum.intersects_box(min, min + Math::Vec3{SIZE, SIZE, SIZE}))
+                region->visible.push_back(slot);
+        }
+    }
+}
+
+// A breadth first walk over the sections, starting at the camera's. A section is entered through
+// one face and only left through the faces its connectivity links to that one, and never in the
+// direction opposite to a step taken before, so the walk can't wrap around behind walls. Every
+// section is visited once, by the shortest walk reaching it, and only if it is in the frustum.
+bool ChunkRenderer::cull_occluded(const Math::Camera &camera, const Math::Frustum &frustum) noexcept
+{
+    constexpr i32 SIZE {World::Section::SIZE};
+    constexpr i32 HEIGHT {World::Chunk::SECTION_COUNT};
+    constexpr u8 NO_FACE {Meshing::FaceCount};
+    static constexpr std::array<std::array<i32, 3>, Meshing::FaceCount> STEPS {{
+        {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+    }};
+
+    if (regions.empty())
+        return false;
+
+    // stepping to a neighbour has to be cheap, so the regions are laid out in a dense grid first
+    RegionPos min {regions.begin()->first}, max {min};
+    for (const auto &[pos, region] : regions) {
+        min = {.x = std::min(min.x, pos.x), .z = std::min(min.z, pos.z)};
+        max = {.x = std::max(max.x, pos.x), .z = std::max(max.z, pos.z)};
+    }
+    const i32 grid_width {max.x - min.x + 1};
+    const i32 grid_depth {max.z - min.z + 1};
+    region_grid.assign(static_cast<usize>(grid_width * grid_depth), nullptr);
+    for (const auto &[pos, region] : regions)
+        region_grid[static_cast<usize>((pos.z - min.z) * grid_width + (pos.x - min.x))] = region.get();
+
+    const World::ChunkPos origin {.x = min.x * REGION_SIZE, .z = min.z * REGION_SIZE};
+    const i32 width {grid_width * REGION_SIZE};
+    const i32 depth {grid_depth * REGION_SIZE};
+    const auto region_at = [&](i32 x, i32 z) {
+        return region_grid[static_cast<usize>((z / REGION_SIZE) * grid_width + x / REGION_SIZE)];
+    };
+    const auto index_of = [width, depth](i32 x, i32 y, i32 z) {
+        return static_cast<usize>((y * depth + z) * width + x);
+    };
+
+    const auto block_to_section = [](float coordinate) { return static_cast<i32>(std::floor(coordinate / static_cast<float>(SIZE))); };
+    const GraphStep first {
+        .x = block_to_section(camera.position.x) - origin.x,
+        .y = block_to_section(camera.position.y),
+        .z = block_to_section(camera.position.z) - origin.z,
+        .entered_through = NO_FACE,
+        .directions = 0
+    };
+    if (first.x < 0 || first.x >= width || first.z < 0 || first.z >= depth || first.y < 0 || first.y >= HEIGHT ||
+        region_at(first.x, first.z) == nullptr)
+        return false;
+
+    reached.assign(static_cast<usize>(width * depth * HEIGHT), 0);
+    reached[index_of(first.x, first.y, first.z)] = 1;
+    graph_queue.clear();
+    graph_queue.push_back(first);
+
+    for (usize next {}; next < graph_queue.size(); ++next) {
+        const auto step = graph_queue[next];
+        auto &region = *region_at(step.x, step.z);
+        const World::ChunkPos chunk {.x = origin.x + step.x, .z = origin.z + step.z};
+        const auto slot = section_slot(chunk, step.y);
+        const auto &section_mesh = region.sections[slot];
+        if (section_mesh.current.is_valid())
+            region.visible.push_back(slot);
+
+        for (u8 face {}; face < Meshing::FaceCount; ++face) {
+            // never back towards the camera
+            if (((step.directions >> (face ^ 1)) & 1) != 0)
+                continue;
+            if (step.entered_through != NO_FACE &&
+                !section_mesh.connectivity.connects(static_cast<Meshing::Face>(step.entered_through), static_cast<Meshing::Face>(face)))
+                continue;
+
+            const i32 x {step.x + STEPS[face][0]};
+            const i32 y {step.y + STEPS[face][1]};
+            const i32 z {step.z + STEPS[face][2]};
+            if (x < 0 || x >= width || z < 0 || z >= depth || y < 0 || y >= HEIGHT)
+                continue;
+            const auto index = index_of(x, y, z);
+            if (reached[index] != 0 || region_at(x, z) == nullptr)
+                continue;
+
+            const Math::Vec3 section_min {
+                static_cast<float>((origin.x + x) * SIZE),
+                static_cast<float>(y * SIZE),
+                static_cast<float>((origin.z + z) * SIZE)
+            };
+            if (!frustum.intersects_box(section_min, section_min + Math::Vec3{SIZE, SIZE, SIZE}))
+                continue;
+
+            reached[index] = 1;
+            graph_queue.push_back({
+                .x = x,
+                .y = y,
+                .z = z,
+                .entered_through = static_cast<u8>(face ^ 1),
+                .directions = static_cast<u8>(step.directions | (1u << face))
+            });
+        }
+    }
+    return true;
+}
+
+void ChunkRenderer::write_reachable_slots(VkCommandBuffer command_buffer) noexcept
+{
+    const usize words {(section_records.size() + 31) / 32};
+    if (words == 0)
+        return;
+
+    std::fill_n(reachable_slots.begin(), words, 0u);
+    for (const auto &[pos, region] : regions)
+        for (const auto slot : region->visible)
+            if (const auto record = region->sections[slot].slot; record != INVALID_SLOT)
+                reachable_slots[record / 32] |= 1u << (record % 32);
+    vkCmdUpdateBuffer(command_buffer, reachable_buffer, 0, words * sizeof(u32), reachable_slots.data());
+}
+
+void ChunkRenderer::record_region(Region &region, CachedCommands &cache, VkCommandBufferInheritanceInfo inheritance, VkExtent2D extent) const noexcept
+{
+    PROFILE_ZONE("record region");
+    // the previous recording of this slot belonged to a frame that has finished
+    vkResetCommandPool(device, cache.command_pool, 0x0);
+
+    VkCommandBufferBeginInfo begin_info {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(cache.command_buffer, &begin_info) != VK_SUCCESS)
+        Logger::fatal_error("Failed to begin recording region command buffer");
+
+    // secondary command buffers inherit no state from the primary one
+    const VkViewport viewport {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(extent.width),
+        .height = static_cast<float>(extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    const VkRect2D scissor {.offset = {0, 0}, .extent = extent};
+    static constexpr VkDeviceSize VERTEX_OFFSET {0};
+    vkCmdBindPipeline(cache.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdSetViewport(cache.command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(cache.command_buffer, 0, 1, &scissor);
+    const std::array descriptor_sets {descriptor_set, textures.get_descriptor_set()};
+    vkCmdBindDescriptorSets(cache.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0,
+                            static_cast<u32>(descriptor_sets.size()), descriptor_sets.data(), 0, nullptr);
+    vkCmdBindVertexBuffers(cache.command_buffer, 0, 1, &arena_buffer, &VERTEX_OFFSET);
+    vkCmdBindIndexBuffer(cache.command_buffer, quad_index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    // the instance index selects the section record holding the section's origin
+    for (const auto slot : region.visible) {
+        const auto &section_mesh = region.sections[slot];
+        const auto &mesh = section_mesh.current;
+        vkCmdDrawIndexed(cache.command_buffer, mesh.index_count, 1, 0, mesh.vertex_offset, section_mesh.slot);
+    }
+
+    if (vkEndCommandBuffer(cache.command_buffer) != VK_SUCCESS)
+        Logger::fatal_error("Failed to record region command buffer");
+
+    cache.version = region.version;
+    cache.visibility_hash = region.visibility_hash;
+    cache.extent = extent;
+    cache.valid = true;
+}
+
+void ChunkRenderer::draw(VkCommandBuffer command_buffer, const Math::Camera &camera) noexcept
+{
+    PROFILE_ZONE("chunk draw");
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    ++frame_number;
+    // every frame that could have used a retired mesh has finished once the renderer has come
+    // back around to the same frame slot
+    while (!retired_meshes.empty() && retired_meshes.front().frame + renderer->frames_in_flight() < frame_number) {
+        free_mesh(retired_meshes.front().mesh);
+        retired_meshes.pop_front();
+    }
+    while (!retired_regions.empty() && retired_regions.front().frame + renderer->frames_in_flight() < frame_number) {
+        destroy_region(*retired_regions.front().region);
+        retired_regions.pop_front();
+    }
+    // transfer batches aren't ordered against each other, a range must not be handed to another
+    // upload while a copy into it may still be running
+    std::erase_if(superseded_meshes, [this](SupersededMesh &superseded) {
+        if (superseded.frame + renderer->frames_in_flight() >= frame_number || !renderer->get_uploader().is_complete(superseded.ticket))
+            return false;
+        free_mesh(superseded.mesh);
+        return true;
+    });
+    finish_uploads();
+    const bool textures_ready = textures.prepare(command_buffer);
+    if (!textures_ready || !quad_indices_ready()) [[unlikely]] {
+        statistics = {};
+        return;
+    }
+
+    const auto extent = renderer->get_extent();
+    CameraData camera_data {};
+    camera_data.view_projection = camera.view_projection(static_cast<float>(extent.width) / static_cast<float>(extent.height));
+    const auto frustum = Math::Frustum::from_matrix(camera_data.view_projection);
+    camera_data.frustum_planes = frustum.planes;
+    camera_data.section_count = static_cast<u32>(section_records.size());
+    camera_data.occlusion_culling = occlusion_culling ? 1 : 0;
+
+    // with GPU culling the reachable sections are handed to the culling pass
+    if (path == DrawPath::Direct || occlusion_culling)
+        cull(camera, frustum);
+
+    // the previous frame may still be reading the buffers updated here
+    static constexpr VkMemoryBarrier BEFORE_UPDATE {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT
+    };
+    static constexpr VkMemoryBarrier AFTER_UPDATE {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    static constexpr VkPipelineStageFlags READ_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    {
+        PROFILE_GPU_ZONE(renderer->get_profiler(), command_buffer, "chunk buffer updates");
+        vkCmdPipelineBarrier(command_buffer, READ_STAGES, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0, 1, &BEFORE_UPDATE, 0, nullptr, 0, nullptr);
+        vkCmdUpdateBuffer(command_buffer, camera_buffer, 0, sizeof(camera_data), &camera_data);
+        write_section_records(command_buffer);
+        if (path != DrawPath::Direct && occlusion_culling)
+            write_reachable_slots(command_buffer);
+        if (path == DrawPath::IndirectCount)
+            vkCmdFillBuffer(command_buffer, draw_count_buffer, 0, sizeof(u32), 0);
+    }
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0x0, 1, &AFTER_UPDATE, 0, nullptr, 0, nullptr);
+
+    if (path == DrawPath::Direct)
+        draw_direct(command_buffer, extent);
+    else
+        draw_indirect(command_buffer, extent);
+
+    statistics.record_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void ChunkRenderer::draw_direct(VkCommandBuffer command_buffer, VkExtent2D extent) noexcept
+{
+    VkCommandBufferInheritanceInfo inheritance {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = renderer->get_render_pass();
+    inheritance.subpass = 0;
+    // left out on purpose, the cached buffers are reused with every swapchain image
+    inheritance.framebuffer = VK_NULL_HANDLE;
+
+    const auto frame = renderer->get_current_frame();
+    std::vector<VkCommandBuffer> secondaries {};
+    Jobs::Counter recorded {};
+    statistics.recorded_regions = 0;
+
+    for (auto &[pos, region] : regions) {
+        if (region->visible.empty())
+            continue;
+
+        auto &cache = region->caches[frame];
+        secondaries.push_back(cache.command_buffer);
+
+        const auto up_to_date = cache.valid && cache.version == region->version &&
+                                cache.visibility_hash == region->visibility_hash &&
+                                cache.extent.width == extent.width && cache.extent.height == extent.height;
+        if (up_to_date)
+            continue;
+
+        ++statistics.recorded_regions;
+        job_system->schedule([this, r = region.get(), &cache, inheritance, extent] {
+            record_region(*r, cache, inheritance, extent);
+        }, &recorded);
+    }
+    job_system->wait(recorded);
+
+    renderer->begin_render_pass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    if (!secondaries.empty())
+        vkCmdExecuteCommands(command_buffer, static_cast<u32>(secondaries.size()), secondaries.data());
+}
+
+void ChunkRenderer::draw_indirect(VkCommandBuffer command_buffer, VkExtent2D extent) noexcept
+{
+    // without occlusion culling visibility is only known on the GPU
+    if (!occlusion_culling) {
+        statistics.visible_sections = live_sections;
+        statistics.occlusion_ms = 0.0;
+    }
+    statistics.visible_regions = 0;
+    statistics.recorded_regions = 0;
+
+    const auto slot_count = static_cast<u32>(section_records.size());
+    if (slot_count > 0) {
+        PROFILE_GPU_ZONE(renderer->get_profiler(), command_buffer, "chunk culling");
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+        vkCmdDispatch(command_buffer, (slot_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+        static constexpr VkMemoryBarrier COMMANDS_WRITTEN {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+        };
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                             0x0, 1, &COMMANDS_WRITTEN, 0, nullptr, 0, nullptr);
+    }
+
+    renderer->begin_render_pass(VK_SUBPASS_CONTENTS_INLINE);
+    if (slot_count == 0)
+        return;
+
+    const VkViewport viewport {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(extent.width),
+        .height = static_cast<float>(extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    const VkRect2D scissor {.offset = {0, 0}, .extent = extent};
+    static constexpr VkDeviceSize VERTEX_OFFSET {0};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    const std::array descriptor_sets {descriptor_set, textures.get_descriptor_set()};
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0,
+                            static_cast<u32>(descriptor_sets.size()), descriptor_sets.data(), 0, nullptr);
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &arena_buffer, &VERTEX_OFFSET);
+    vkCmdBindIndexBuffer(command_buffer, quad_index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    static constexpr u32 STRIDE {sizeof(VkDrawIndexedIndirectCommand)};
+    if (path == DrawPath::IndirectCount)
+        draw_indexed_indirect_count(command_buffer, draw_command_buffer, 0, draw_count_buffer, 0, slot_count, STRIDE);
+    else
+        vkCmdDrawIndexedIndirect(command_buffer, draw_command_buffer, 0, slot_count, STRIDE);
+}
+
+void ChunkRenderer::invalidate_cache() noexcept
+{
+    for (auto &[pos, region] : regions)
+        for (auto &cache : region->caches)
+            cache.valid = false;
+}
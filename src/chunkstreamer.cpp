@@ -0,0 +1,494 @@
+#include "mcvk/chunkstreamer.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+namespace
+{
+    // chunks are loaded one chunk beyond the view distance, so every chunk that is meshed has its
+    // neighbours, and only evicted once they are this much further out, so moving back and forth
+    // across a chunk border does not reload anything
+    constexpr i32 NEIGHBOUR_MARGIN {1};
+    constexpr i32 UNLOAD_MARGIN {2};
+
+    // chunks straight behind the camera count as this many times further away
+    constexpr float BEHIND_FACTOR {2.0f};
+
+    // a job that has not started yet is cancelled if waiting work is this much more important
+    constexpr float CANCEL_FACTOR {1.5f};
+
+    // once usage is below this fraction of both budgets, chunks of any priority are started again
+    constexpr double LOW_WATER {0.9};
+
+    constexpr std::array<World::ChunkPos, 4> NEIGHBOUR_OFFSETS {{
+        {.x = 1, .z = 0}, {.x = -1, .z = 0}, {.x = 0, .z = 1}, {.x = 0, .z = -1}
+    }};
+
+    // from the camera to the centre of the chunk, in chunks
+    std::array<float, 2> offset_to(World::ChunkPos pos, const Math::Camera &camera) noexcept
+    {
+        constexpr auto SIZE = static_cast<float>(World::Section::SIZE);
+        return {(static_cast<float>(pos.x) + 0.5f) - camera.position.x / SIZE,
+                (static_cast<float>(pos.z) + 0.5f) - camera.position.z / SIZE};
+    }
+}
+
+ChunkStreamer::ChunkStreamer(World::ChunkStore &sstore, ChunkRenderer &cchunk_renderer, Jobs::JobSystem &jjob_system,
+                             World::RegionStorage *sstorage, const Terrain::Generator &ggenerator, const Settings &ssettings) noexcept :
+    store {&sstore},
+    chunk_renderer {&cchunk_renderer},
+    job_system {&jjob_system},
+    storage {sstorage},
+    generator {&ggenerator},
+    settings {ssettings},
+    meshers (jjob_system.thread_count())
+{
+    if (settings.max_jobs == 0)
+        settings.max_jobs = 2 * job_system->thread_count();
+    time_to_visible_ms.reserve(TIME_TO_VISIBLE_HISTORY);
+}
+
+ChunkStreamer::~ChunkStreamer() noexcept
+{
+    job_system->wait(jobs);
+}
+
+void ChunkStreamer::update(const Math::Camera &camera) noexcept
+{
+    PROFILE_ZONE("chunk streaming");
+    process_completions();
+    request(camera);
+    enforce_budget();
+    schedule();
+    upload();
+    update_statistics();
+}
+
+void ChunkStreamer::prioritize(Entry &entry, const Math::Camera &camera) noexcept
+{
+    const auto [dx, dz] = offset_to(entry.pos, camera);
+    entry.distance = std::sqrt(dx * dx + dz * dz);
+
+    // the chunks right around the camera are needed whichever way it looks, and when looking
+    // straight up or down there is no horizontal direction to prefer
+    const auto forward = camera.forward();
+    const auto forward_length = std::sqrt(forward.x * forward.x + forward.z * forward.z);
+    if (entry.distance < 1.5f || forward_length < 1e-3f) {
+        entry.priority = entry.distance;
+        return;
+    }
+    const auto facing = (dx * forward.x + dz * forward.z) / (entry.distance * forward_length);
+    entry.priority = entry.distance * (1.0f + (BEHIND_FACTOR - 1.0f) * (1.0f - facing) * 0.5f);
+}
+
+std::array<u8, World::Chunk::SECTION_COUNT> ChunkStreamer::select_lods(const Entry &entry) const noexcept
+{
+    std::array<u8, World::Chunk::SECTION_COUNT> lods {};
+    for (usize i {}; i < lods.size(); ++i) {
+        const auto dy = (static_cast<float>(i) + 0.5f) - camera_section_y;
+        const auto distance = std::sqrt(entry.distance * entry.distance + dy * dy);
+        lods[i] = static_cast<u8>(Meshing::select_lod(entry.lods[i], distance, settings.lod_distance));
+    }
+    return lods;
+}
+
+void ChunkStreamer::request(const Math::Camera &camera) noexcept
+{
+    const World::ChunkPos center {
+        .x = World::to_chunk_coord(static_cast<i32>(std::floor(camera.position.x))),
+        .z = World::to_chunk_coord(static_cast<i32>(std::floor(camera.position.z)))
+    };
+    const auto load_distance = static_cast<float>(settings.view_distance + NEIGHBOUR_MARGIN);
+    const auto radius = settings.view_distance + NEIGHBOUR_MARGIN + 1;
+    const auto now = Clock::now();
+    camera_section_y = camera.position.y / static_cast<float>(World::Section::SIZE);
+
+    for (i32 z {center.z - radius}; z <= center.z + radius; ++z) {
+        for (i32 x {center.x - radius}; x <= center.x + radius; ++x) {
+            const World::ChunkPos pos {.x = x, .z = z};
+            const auto [dx, dz] = offset_to(pos, camera);
+            if (std::sqrt(dx * dx + dz * dz) > load_distance || entries.contains(pos))
+                continue;
+
+            auto &entry = entries[pos];
+            entry.pos = pos;
+            entry.requested = now;
+        }
+    }
+
+    // evicting erases entries, so they are collected first
+    candidates.clear();
+    const auto unload_distance = static_cast<float>(settings.view_distance + NEIGHBOUR_MARGIN + UNLOAD_MARGIN);
+    for (auto &[pos, entry] : entries) {
+        prioritize(entry, camera);
+        if (entry.distance > unload_distance && !entry.evict)
+            candidates.push_back(&entry);
+
+        // the old meshes stay visible until the new ones have been uploaded
+        if (entry.stage == Stage::Visible && settings.lod_distance > 0.0f && select_lods(entry) != entry.lods) {
+            entry.stage = Stage::Loaded;
+            entry.remeshing = true;
+            ++statistics.lod_changes;
+        }
+    }
+    for (auto *entry : candidates)
+        evict(*entry);
+}
+
+void ChunkStreamer::process_completions() noexcept
+{
+    {
+        const std::lock_guard lock {completions_mutex};
+        completions_scratch.swap(completions);
+    }
+    for (const auto &completion : completions_scratch)
+        complete(*completion.entry, completion.finished);
+    completions_scratch.clear();
+}
+
+void ChunkStreamer::complete(Entry &entry, bool finished) noexcept
+{
+    entry.has_job = false;
+    entry.cancelled.store(false, std::memory_order_relaxed);
+    --jobs_in_flight;
+    if (!finished)
+        ++statistics.cancelled_jobs;
+
+    if (entry.stage == Stage::Loading) {
+        entry.stage = finished ? Stage::Loaded : Stage::Wanted;
+        if (finished) {
+            chunk_bytes -= entry.chunk_bytes;
+            entry.chunk_bytes = entry.chunk->memory_usage();
+            chunk_bytes += entry.chunk_bytes;
+        }
+    }
+    else if (entry.stage == Stage::Meshing) {
+        // the neighbours were kept from being evicted while the job read them
+        for (const auto offset : NEIGHBOUR_OFFSETS) {
+            auto &neighbour = entries.find({.x = entry.pos.x + offset.x, .z = entry.pos.z + offset.z})->second;
+            if (--neighbour.readers == 0 && neighbour.evict)
+                evict(neighbour);
+        }
+        if (finished) {
+            entry.stage = Stage::Meshed;
+            entry.next_upload = 0;
+            for (const auto &mesh : *entry.meshes)
+                entry.mesh_bytes += mesh.byte_size();
+            mesh_bytes += entry.mesh_bytes;
+        }
+        else {
+            entry.stage = Stage::Loaded;
+            release_meshes(entry);
+        }
+    }
+
+    if (entry.evict)
+        evict(entry);
+}
+
+void ChunkStreamer::enforce_budget() noexcept
+{
+    auto ram = chunk_bytes + mesh_bytes;
+    auto vram = gpu_bytes;
+    if (ram <= settings.ram_budget && vram <= settings.vram_budget) {
+        if (static_cast<double>(ram) < LOW_WATER * static_cast<double>(settings.ram_budget) &&
+            static_cast<double>(vram) < LOW_WATER * static_cast<double>(settings.vram_budget))
+            priority_limit = std::numeric_limits<float>::infinity();
+        return;
+    }
+
+    // evict the least important chunks holding memory, until usage fits again
+    candidates.clear();
+    for (auto &[pos, entry] : entries)
+        if (entry.chunk != nullptr && !entry.has_job && entry.readers == 0 && !entry.evict)
+            candidates.push_back(&entry);
+    std::sort(candidates.begin(), candidates.end(), [](const Entry *a, const Entry *b) { return a->priority > b->priority; });
+
+    for (auto *entry : candidates) {
+        if (ram <= settings.ram_budget && vram <= settings.vram_budget)
+            break;
+        ram -= entry->chunk_bytes + entry->mesh_bytes;
+        vram -= entry->gpu_bytes;
+        priority_limit = std::min(priority_limit, entry->priority);
+        evict(*entry);
+    }
+}
+
+void ChunkStreamer::schedule() noexcept
+{
+    const auto view_distance = static_cast<float>(settings.view_distance);
+    candidates.clear();
+    for (auto &[pos, entry] : entries) {
+        if (entry.has_job || entry.evict || entry.priority >= priority_limit)
+            continue;
+        // chunks waiting for their neighbours can't start, so they must not cancel anything either
+        if (entry.stage == Stage::Wanted || (entry.stage == Stage::Loaded && entry.distance <= view_distance && neighbours_loaded(entry)))
+            candidates.push_back(&entry);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Entry *a, const Entry *b) { return a->priority < b->priority; });
+
+    // Every job slot is taken, but more important work is waiting (the camera turned or moved).
+    // Jobs that have not started yet give up their slot, the least important ones first.
+    if (jobs_in_flight >= settings.max_jobs && !candidates.empty()) {
+        running.clear();
+        for (auto &[pos, entry] : entries)
+            if (entry.has_job && !entry.cancelled.load(std::memory_order_relaxed))
+                running.push_back(&entry);
+        std::sort(running.begin(), running.end(), [](const Entry *a, const Entry *b) { return a->priority > b->priority; });
+
+        usize waiting {};
+        for (auto *entry : running) {
+            if (waiting == candidates.size() || entry->priority <= CANCEL_FACTOR * candidates[waiting]->priority)
+                break;
+            entry->cancelled.store(true, std::memory_order_relaxed);
+            ++waiting;
+        }
+    }
+
+    for (auto *entry : candidates) {
+        if (jobs_in_flight >= settings.max_jobs)
+            break;
+        if (entry->stage == Stage::Wanted)
+            start_load(*entry);
+        else
+            start_mesh(*entry);
+    }
+}
+
+bool ChunkStreamer::neighbours_loaded(const Entry &entry) const noexcept
+{
+    for (const auto offset : NEIGHBOUR_OFFSETS) {
+        const auto found = entries.find({.x = entry.pos.x + offset.x, .z = entry.pos.z + offset.z});
+        if (found == entries.end() || found->second.stage < Stage::Loaded || found->second.evict)
+            return false;
+    }
+    return true;
+}
+
+void ChunkStreamer::start_load(Entry &entry) noexcept
+{
+    if (entry.chunk == nullptr)
+        entry.chunk = &store->create_chunk(entry.pos);
+    entry.stage = Stage::Loading;
+    entry.has_job = true;
+    ++jobs_in_flight;
+
+    job_system->schedule([this, target = &entry] {
+        const auto finished = !target->cancelled.load(std::memory_order_relaxed);
+        if (finished && (storage == nullptr || !storage->load(*target->chunk))) {
+            generator->generate(*target->chunk);
+            if (storage != nullptr)
+                storage->save(*target->chunk);
+        }
+        const std::lock_guard lock {completions_mutex};
+        completions.push_back({.entry = target, .finished = finished});
+    }, &jobs);
+}
+
+void ChunkStreamer::start_mesh(Entry &entry) noexcept
+{
+    // the neighbours can't be evicted while the job reads them
+    std::array<const World::Chunk *, NEIGHBOUR_OFFSETS.size()> neighbour_chunks {};
+    for (usize i {}; i < NEIGHBOUR_OFFSETS.size(); ++i) {
+        auto &neighbour = entries.find({.x = entry.pos.x + NEIGHBOUR_OFFSETS[i].x, .z = entry.pos.z + NEIGHBOUR_OFFSETS[i].z})->second;
+        ++neighbour.readers;
+        neighbour_chunks[i] = neighbour.chunk;
+    }
+    if (entry.meshes == nullptr)
+        entry.meshes = std::make_unique<std::array<Meshing::MeshData, World::Chunk::SECTION_COUNT>>();
+    entry.lods = select_lods(entry);
+    entry.stage = Stage::Meshing;
+    entry.has_job = true;
+    ++jobs_in_flight;
+
+    job_system->schedule([this, target = &entry, neighbour_chunks, lods = entry.lods] {
+        using enum Meshing::Face;
+        const auto finished = !target->cancelled.load(std::memory_order_relaxed);
+        if (finished) {
+            const auto &chunk = *target->chunk;
+            auto &mesher = meshers[Jobs::JobSystem::worker_index()];
+            for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i) {
+                Meshing::Neighbours neighbours {};
+                neighbours[PositiveX] = &neighbour_chunks[0]->section(i);
+                neighbours[NegativeX] = &neighbour_chunks[1]->section(i);
+                neighbours[PositiveZ] = &neighbour_chunks[2]->section(i);
+                neighbours[NegativeZ] = &neighbour_chunks[3]->section(i);
+                neighbours[PositiveY] = (i + 1 < World::Chunk::SECTION_COUNT) ? &chunk.section(i + 1) : nullptr;
+                neighbours[NegativeY] = (i > 0) ? &chunk.section(i - 1) : nullptr;
+                mesher.mesh(chunk.section(i), neighbours, (*target->meshes)[static_cast<usize>(i)], lods[static_cast<usize>(i)]);
+            }
+        }
+        const std::lock_guard lock {completions_mutex};
+        completions.push_back({.entry = target, .finished = finished});
+    }, &jobs);
+}
+
+void ChunkStreamer::upload() noexcept
+{
+    candidates.clear();
+    for (auto &[pos, entry] : entries)
+        if (entry.stage == Stage::Meshed)
+            candidates.push_back(&entry);
+    std::sort(candidates.begin(), candidates.end(), [](const Entry *a, const Entry *b) { return a->priority < b->priority; });
+
+    for (auto *entry : candidates) {
+        for (; entry->next_upload < World::Chunk::SECTION_COUNT; ++entry->next_upload) {
+            const auto section = static_cast<usize>(entry->next_upload);
+            const auto &mesh = (*entry->meshes)[section];
+            // the arena also holds meshes that are still in use by frames in flight, which are
+            // not part of the budget but can't be overwritten yet either. A mesh replacing one of
+            // another level of detail only counts the difference.
+            const auto bytes = mesh.byte_size();
+            const VkDeviceSize replaced {entry->section_gpu_bytes[section]};
+            if (gpu_bytes - replaced + bytes > settings.vram_budget) {
+                make_room(*entry);
+                return;
+            }
+            if (chunk_renderer->arena_usage() + bytes > chunk_renderer->arena_capacity())
+                return;
+            if (!chunk_renderer->update_section(entry->pos, entry->next_upload, mesh))
+                return; // nothing more can be staged this frame
+            entry->in_renderer = true;
+            entry->gpu_bytes = entry->gpu_bytes - replaced + bytes;
+            gpu_bytes = gpu_bytes - replaced + bytes;
+            entry->section_gpu_bytes[section] = static_cast<u32>(bytes);
+        }
+        entry->stage = Stage::Uploading;
+        release_meshes(*entry);
+    }
+}
+
+void ChunkStreamer::release_meshes(Entry &entry) noexcept
+{
+    entry.meshes.reset();
+    mesh_bytes -= entry.mesh_bytes;
+    entry.mesh_bytes = 0;
+}
+
+void ChunkStreamer::evict(Entry &entry) noexcept
+{
+    if (entry.has_job || entry.readers > 0) {
+        entry.evict = true;
+        if (entry.has_job)
+            entry.cancelled.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    // Chunks are saved right after being generated and nothing modifies them afterwards, so
+    // there is nothing to write back here
+    if (entry.in_renderer)
+        chunk_renderer->remove_chunk(entry.pos);
+    if (entry.chunk != nullptr)
+        store->remove_chunk(entry.pos);
+    release_meshes(entry);
+    chunk_bytes -= entry.chunk_bytes;
+    gpu_bytes -= entry.gpu_bytes;
+    ++statistics.evicted_chunks;
+    entries.erase(entry.pos);
+}
+
+void ChunkStreamer::make_room(Entry &entry) noexcept
+{
+    // the least important chunk on the GPU gives way if it is less important than 'entry'
+    Entry *victim {nullptr};
+    for (auto &[pos, other] : entries) {
+        if (other.gpu_bytes == 0 || other.stage == Stage::Meshed || other.has_job || other.readers > 0 || other.evict)
+            continue;
+        if (other.priority > entry.priority && (victim == nullptr || other.priority > victim->priority))
+            victim = &other;
+    }
+    if (victim != nullptr) {
+        priority_limit = std::min(priority_limit, victim->priority);
+        evict(*victim);
+        return;
+    }
+
+    // Nothing on the GPU is less important, so 'entry' doesn't fit the budget. Its meshes would
+    // only hold RAM, drop them and don't mesh anything this unimportant until usage has dropped.
+    // The chunk stays loaded, so the renderer keeps it until it is evicted.
+    priority_limit = std::min(priority_limit, entry.priority);
+    if (entry.in_renderer)
+        chunk_renderer->drop_chunk_meshes(entry.pos);
+    gpu_bytes -= entry.gpu_bytes;
+    entry.gpu_bytes = 0;
+    entry.section_gpu_bytes = {};
+    entry.next_upload = 0;
+    release_meshes(entry);
+    entry.stage = Stage::Loaded;
+}
+
+void ChunkStreamer::update_statistics() noexcept
+{
+    const auto now = Clock::now();
+    const auto view_distance = static_cast<float>(settings.view_distance);
+    auto &s = statistics;
+    s.waiting_for_load = s.loading = s.waiting_for_mesh = s.meshing = s.waiting_for_upload = s.uploading = s.visible = s.deferred = 0;
+
+    for (auto &[pos, entry] : entries) {
+        if (entry.stage == Stage::Uploading && chunk_renderer->is_chunk_uploaded(pos)) {
+            entry.stage = Stage::Visible;
+            // a new level of detail for a chunk that was visible all along
+            if (!std::exchange(entry.remeshing, false)) {
+                const auto ms = std::chrono::duration<float, std::milli>(now - entry.requested).count();
+                if (time_to_visible_ms.size() < TIME_TO_VISIBLE_HISTORY)
+                    time_to_visible_ms.push_back(ms);
+                else
+                    time_to_visible_ms[time_to_visible_next] = ms;
+                time_to_visible_next = (time_to_visible_next + 1) % TIME_TO_VISIBLE_HISTORY;
+            }
+        }
+
+        // chunks only loaded as neighbours are never meshed, so they are not waiting for anything
+        if (entry.distance > view_distance && entry.stage >= Stage::Loaded)
+            continue;
+        if (entry.priority >= priority_limit && !entry.has_job && entry.stage <= Stage::Loaded) {
+            ++s.deferred;
+            continue;
+        }
+        switch (entry.stage) {
+            case Stage::Wanted:    ++s.waiting_for_load; break;
+            case Stage::Loading:   ++s.loading; break;
+            case Stage::Loaded:    ++s.waiting_for_mesh; break;
+            case Stage::Meshing:   ++s.meshing; break;
+            case Stage::Meshed:    ++s.waiting_for_upload; break;
+            case Stage::Uploading: ++s.uploading; break;
+            case Stage::Visible:   ++s.visible; break;
+        }
+    }
+    s.ram_usage = chunk_bytes + mesh_bytes;
+    s.vram_usage = gpu_bytes;
+}
+
+bool ChunkStreamer::is_idle() const noexcept
+{
+    const auto &s = statistics;
+    return jobs_in_flight == 0 && s.waiting_for_load + s.loading + s.waiting_for_mesh + s.meshing +
+                                  s.waiting_for_upload + s.uploading == 0;
+}
+
+void ChunkStreamer::report() const noexcept
+{
+    auto times = time_to_visible_ms;
+    std::sort(times.begin(), times.end());
+    const auto percentile = [&times](double p) {
+        return times.empty() ? 0.0 : static_cast<double>(times[static_cast<usize>(p * static_cast<double>(times.size() - 1))]);
+    };
+    const auto &s = statistics;
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Chunk streaming, view distance %d, %u jobs in flight\n", settings.view_distance, jobs_in_flight);
+    fprintf(stdout, "  load: %u waiting, %u running | mesh: %u waiting, %u running | upload: %u waiting, %u running\n",
+            s.waiting_for_load, s.loading, s.waiting_for_mesh, s.meshing, s.waiting_for_upload, s.uploading);
+    fprintf(stdout, "  %u visible, %u deferred by the budget, %llu jobs cancelled, %llu chunks evicted, %llu meshed again for LOD\n",
+            s.visible, s.deferred, static_cast<unsigned long long>(s.cancelled_jobs), static_cast<unsigned long long>(s.evicted_chunks),
+            static_cast<unsigned long long>(s.lod_changes));
+    fprintf(stdout, "  RAM %.1f / %.1f MiB, VRAM %.1f / %.1f MiB\n",
+            static_cast<double>(s.ram_usage) / (1024.0 * 1024.0), static_cast<double>(settings.ram_budget) / (1024.0 * 1024.0),
+            static_cast<double>(s.vram_usage) / (1024.0 * 1024.0), static_cast<double>(settings.vram_budget) / (1024.0 * 1024.0));
+    fprintf(stdout, "  time to visible over the last %zu chunks: p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+            times.size(), percentile(0.5), percentile(0.99), times.empty() ? 0.0 : static_cast<double>(times.back()));
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
@@ -0,0 +1,252 @@
+#include "mcvk/collision.hpp"
+#include "mcvk/block.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Collision
+{
+    namespace
+    {
+        // Remembers the chunk of the last lookup, queries move through a handful of chunks at most
+        class ChunkCache
+        {
+            private:
+                const World::ChunkStore &store;
+                World::ChunkPos pos {};
+                const World::Chunk *chunk {nullptr};
+                bool valid {false};
+            public:
+                explicit ChunkCache(const World::ChunkStore &chunk_store) noexcept : store {chunk_store} {}
+
+                // nullptr if the chunk holding the block column isn't loaded
+                const World::Chunk *chunk_at(i32 x, i32 z) noexcept
+                {
+                    const World::ChunkPos wanted {.x = World::to_chunk_coord(x), .z = World::to_chunk_coord(z)};
+                    if (!valid || wanted != pos) {
+                        pos = wanted;
+                        chunk = store.get_chunk(pos);
+                        valid = true;
+                    }
+                    return chunk;
+                }
+        };
+
+        constexpr std::array<float, 3> to_array(const Math::Vec3 &v) noexcept { return {v.x, v.y, v.z}; }
+        i32 floor_to_int(float value) noexcept { return static_cast<i32>(std::floor(value)); }
+    }
+
+    std::optional<RayHit> raycast(const World::ChunkStore &store, const Math::Vec3 &origin, const Math::Vec3 &direction, float max_distance) noexcept
+    {
+        constexpr auto INFINITE = std::numeric_limits<float>::infinity();
+        ChunkCache cache {store};
+        const auto start = to_array(origin);
+        const auto dir = to_array(direction);
+
+        // 'next' is the distance at which the ray crosses the next boundary along every axis,
+        // 'delta' the distance between two boundaries
+        std::array<i32, 3> block {}, step {};
+        std::array<float, 3> next {}, delta {};
+        for (usize axis {}; axis < 3; ++axis) {
+            block[axis] = floor_to_int(start[axis]);
+            if (dir[axis] > 0.0f) {
+                step[axis] = 1;
+                delta[axis] = 1.0f / dir[axis];
+                next[axis] = (static_cast<float>(block[axis] + 1) - start[axis]) * delta[axis];
+            } else if (dir[axis] < 0.0f) {
+                step[axis] = -1;
+                delta[axis] = -1.0f / dir[axis];
+                next[axis] = (start[axis] - static_cast<float>(block[axis])) * delta[axis];
+            } else {
+                delta[axis] = INFINITE;
+                next[axis] = INFINITE;
+            }
+        }
+
+        std::array<i32, 3> normal {};
+        float distance {};
+        while (true) {
+            const auto y = block[1];
+            if ((y >= World::Chunk::HEIGHT && step[1] >= 0) || (y < 0 && step[1] <= 0))
+                return std::nullopt;
+            if (y >= 0 && y < World::Chunk::HEIGHT) {
+                const auto *chunk = cache.chunk_at(block[0], block[2]);
+                if (chunk == nullptr)
+                    return std::nullopt;
+                const auto id = chunk->get(World::to_local_coord(block[0]), y, World::to_local_coord(block[2]));
+                if (World::is_solid(id))
+                    return RayHit{.x = block[0], .y = y, .z = block[2], .normal = normal, .distance = distance, .block = id};
+            }
+
+            const auto axis = static_cast<usize>(std::min_element(next.begin(), next.end()) - next.begin());
+            if (next[axis] > max_distance)
+                return std::nullopt;
+            distance = next[axis];
+            block[axis] += step[axis];
+            next[axis] += delta[axis];
+            normal = {};
+            normal[axis] = -step[axis];
+        }
+    }
+
+    Sweep sweep(const World::ChunkStore &store, const Math::Aabb &box, const Math::Vec3 &motion) noexcept
+    {
+        // boxes resting exactly on a block boundary must not count as overlapping the block beyond
+        constexpr float EPSILON {1e-4f};
+        ChunkCache cache {store};
+        const auto solid = [&cache](const std::array<i32, 3> &block) {
+            if (block[1] < 0)
+                return true;
+            if (block[1] >= World::Chunk::HEIGHT)
+                return false;
+            const auto *chunk = cache.chunk_at(block[0], block[2]);
+            return chunk == nullptr || World::is_solid(chunk->get(World::to_local_coord(block[0]), block[1], World::to_local_coord(block[2])));
+        };
+
+        auto min = to_array(box.min), max = to_array(box.max);
+        const auto wanted = to_array(motion);
+        std::array<float, 3> moved {};
+        Sweep result {};
+        for (const usize axis : {1u, 0u, 2u}) {
+            auto distance = wanted[axis];
+            if (distance == 0.0f)
+                continue;
+
+            // the blocks of one layer across the direction of motion that the box covers
+            const auto u = (axis + 1) % 3, v = (axis + 2) % 3;
+            const auto u_first = floor_to_int(min[u] + EPSILON), u_last = floor_to_int(max[u] - EPSILON);
+            const auto v_first = floor_to_int(min[v] + EPSILON), v_last = floor_to_int(max[v] - EPSILON);
+            const auto layer_is_blocked = [&](i32 layer) {
+                std::array<i32, 3> block {};
+                block[axis] = layer;
+                for (i32 a {u_first}; a <= u_last; ++a) {
+                    for (i32 b {v_first}; b <= v_last; ++b) {
+                        block[u] = a;
+                        block[v] = b;
+                        if (solid(block))
+                            return true;
+                    }
+                }
+                return false;
+            };
+
+            // layers entirely in front of the box, up to the one its far side ends up in
+            if (distance > 0.0f) {
+                const auto last = floor_to_int(max[axis] + distance - EPSILON);
+                for (i32 layer {floor_to_int(max[axis] - EPSILON) + 1}; layer <= last; ++layer) {
+                    if (layer_is_blocked(layer)) {
+                        distance = std::max(static_cast<float>(layer) - max[axis], 0.0f);
+                        break;
+                    }
+                }
+            } else {
+                const auto last = floor_to_int(min[axis] + distance + EPSILON);
+                for (i32 layer {static_cast<i32>(std::ceil(min[axis] + EPSILON)) - 2}; layer >= last; --layer) {
+                    if (layer_is_blocked(layer)) {
+                        distance = std::min(static_cast<float>(layer + 1) - min[axis], 0.0f);
+                        break;
+                    }
+                }
+            }
+
+            result.blocked[axis] = distance != wanted[axis];
+            min[axis] += distance;
+            max[axis] += distance;
+            moved[axis] = distance;
+        }
+        result.motion = {moved[0], moved[1], moved[2]};
+        return result;
+    }
+
+    SpatialHash::CellRange SpatialHash::cells_of(const Math::Aabb &box) const noexcept
+    {
+        return {
+            .min = {floor_to_int(box.min.x * inverse_cell_size), floor_to_int(box.min.y * inverse_cell_size), floor_to_int(box.min.z * inverse_cell_size)},
+            .max = {floor_to_int(box.max.x * inverse_cell_size), floor_to_int(box.max.y * inverse_cell_size), floor_to_int(box.max.z * inverse_cell_size)},
+        };
+    }
+
+    void SpatialHash::insert_into_cells(u32 index, const CellRange &range) noexcept
+    {
+        for (i32 z {range.min[2]}; z <= range.max[2]; ++z)
+            for (i32 y {range.min[1]}; y <= range.max[1]; ++y)
+                for (i32 x {range.min[0]}; x <= range.max[0]; ++x)
+                    cells[cell_key(x, y, z)].push_back(index);
+    }
+
+    void SpatialHash::remove_from_cells(u32 index, const CellRange &range) noexcept
+    {
+        for (i32 z {range.min[2]}; z <= range.max[2]; ++z) {
+            for (i32 y {range.min[1]}; y <= range.max[1]; ++y) {
+                for (i32 x {range.min[0]}; x <= range.max[0]; ++x) {
+                    const auto cell = cells.find(cell_key(x, y, z));
+                    auto &indices = cell->second;
+                    *std::find(indices.begin(), indices.end(), index) = indices.back();
+                    indices.pop_back();
+                    if (indices.empty())
+                        cells.erase(cell);
+                }
+            }
+        }
+    }
+
+    void SpatialHash::update(Entities::Entity entity, const Math::Aabb &box) noexcept
+    {
+        if (entity.index >= slots.size())
+            slots.resize(entity.index + 1, ABSENT);
+
+        const auto range = cells_of(box);
+        auto &slot = slots[entity.index];
+        if (slot == ABSENT) {
+            slot = static_cast<u32>(entries.size());
+            entries.push_back({.entity = entity, .box = box, .cells = range});
+            insert_into_cells(entity.index, range);
+            return;
+        }
+
+        auto &entry = entries[slot];
+        entry.entity = entity;
+        entry.box = box;
+        if (entry.cells == range)
+            return;
+        remove_from_cells(entity.index, entry.cells);
+        insert_into_cells(entity.index, range);
+        entry.cells = range;
+    }
+
+    void SpatialHash::remove(Entities::Entity entity) noexcept
+    {
+        if (entity.index >= slots.size() || slots[entity.index] == ABSENT || entries[slots[entity.index]].entity != entity)
+            return;
+
+        const auto slot = slots[entity.index];
+        remove_from_cells(entity.index, entries[slot].cells);
+        entries[slot] = entries.back();
+        slots[entries[slot].entity.index] = slot;
+        entries.pop_back();
+        slots[entity.index] = ABSENT;
+    }
+
+    void SpatialHash::query(const Math::Aabb &box, std::vector<Entities::Entity> &out) const noexcept
+    {
+        const auto range = cells_of(box);
+        for (i32 z {range.min[2]}; z <= range.max[2]; ++z) {
+            for (i32 y {range.min[1]}; y <= range.max[1]; ++y) {
+                for (i32 x {range.min[0]}; x <= range.max[0]; ++x) {
+                    const auto cell = cells.find(cell_key(x, y, z));
+                    if (cell == cells.end())
+                        continue;
+                    for (const auto index : cell->second) {
+                        const auto &entry = entries[slots[index]];
+                        // an entity in several of the cells is only reported from the first of them
+                        if (x != std::max(entry.cells.min[0], range.min[0]) || y != std::max(entry.cells.min[1], range.min[1]) ||
+                            z != std::max(entry.cells.min[2], range.min[2]))
+                            continue;
+                        if (entry.box.intersects(box))
+                            out.push_back(entry.entity);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,200 @@
+#include "mcvk/compression.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace Compression
+{
+    static constexpr usize MIN_MATCH {4};
+    // the block format requires the last 5 bytes to be literals and the last match to start at
+    // least 12 bytes before the end
+    static constexpr usize LAST_LITERALS {5};
+    static constexpr usize MATCH_FIND_LIMIT {12};
+    static constexpr usize MAX_OFFSET {65535};
+
+    static constexpr u32 HASH_BITS {14};
+    static constexpr usize WINDOW {1 << 16};
+
+    // Positions are stored offset by a base that grows with every call, so entries left over from
+    // earlier inputs are recognised by being below the base and the tables never need clearing.
+    struct MatchTables
+    {
+        std::vector<u32> head = std::vector<u32>(1 << HASH_BITS);
+        std::vector<u32> chain = std::vector<u32>(WINDOW); // previous position with the same hash, indexed modulo WINDOW
+        u32 base {1};
+    };
+
+    static u32 read_u32(const u8 *data) noexcept
+    {
+        u32 value {};
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static u32 hash(u32 sequence) noexcept
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    static void write_length(std::vector<u8> &out, usize length) noexcept
+    {
+        for (; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back(static_cast<u8>(length));
+    }
+
+    // 'match_length' is zero for the last sequence, which only has literals
+    static void write_sequence(std::vector<u8> &out, const u8 *literals, usize literal_count, usize offset, usize match_length) noexcept
+    {
+        const auto match_code = (match_length == 0) ? 0 : match_length - MIN_MATCH;
+        out.push_back(static_cast<u8>((std::min<usize>(literal_count, 15) << 4) | std::min<usize>(match_code, 15)));
+        if (literal_count >= 15)
+            write_length(out, literal_count - 15);
+        out.insert(out.end(), literals, literals + literal_count);
+        if (match_length == 0)
+            return;
+
+        out.push_back(static_cast<u8>(offset & 0xff));
+        out.push_back(static_cast<u8>(offset >> 8));
+        if (match_code >= 15)
+            write_length(out, match_code - 15);
+    }
+
+    usize compress(std::span<const u8> input, std::vector<u8> &out, i32 level) noexcept
+    {
+        level = std::clamp(level, MIN_LEVEL, MAX_LEVEL);
+        const auto start_size = out.size();
+        const auto *data = input.data();
+        const auto size = input.size();
+
+        if (size < MATCH_FIND_LIMIT + 1) {
+            write_sequence(out, data, size, 0, 0);
+            return out.size() - start_size;
+        }
+
+        thread_local MatchTables tables {};
+        if (tables.base > std::numeric_limits<u32>::max() - size - WINDOW) {
+            std::fill(tables.head.begin(), tables.head.end(), 0);
+            tables.base = 1;
+        }
+        const auto base = tables.base;
+        tables.base += static_cast<u32>(size);
+
+        const auto insert = [&](usize position) {
+            const auto absolute = base + static_cast<u32>(position);
+            auto &head = tables.head[hash(read_u32(data + position))];
+            tables.chain[absolute & (WINDOW - 1)] = head;
+            head = absolute;
+        };
+
+        const auto max_attempts = 1u << (level - 1);
+        const auto match_end = size - LAST_LITERALS;
+        const auto last_match_start = size - MATCH_FIND_LIMIT;
+        usize anchor {}, position {};
+        while (position <= last_match_start) {
+            const auto sequence = read_u32(data + position);
+            const auto absolute = base + static_cast<u32>(position);
+            auto candidate = tables.head[hash(sequence)];
+            insert(position);
+
+            usize best_length {}, best_offset {};
+            for (u32 attempt {}; attempt < max_attempts; ++attempt) {
+                if (candidate < base || absolute - candidate > MAX_OFFSET)
+                    break;
+                const auto match = static_cast<usize>(candidate - base);
+                if (read_u32(data + match) == sequence) {
+                    auto length = MIN_MATCH;
+                    while (position + length < match_end && data[match + length] == data[position + length])
+                        ++length;
+                    if (length > best_length) {
+                        best_length = length;
+                        best_offset = position - match;
+                    }
+                }
+                const auto previous = tables.chain[candidate & (WINDOW - 1)];
+                if (previous >= candidate)
+                    break;
+                candidate = previous;
+            }
+
+            if (best_length == 0) {
+                // skip ahead faster the longer nothing matched, incompressible data would crawl otherwise
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+
+            write_sequence(out, data + anchor, position - anchor, best_offset, best_length);
+            // deeper searches need every position inside the match, the fast level only one near its end
+            if (level > 1) {
+                for (auto p = position + 1; p < std::min(position + best_length, last_match_start + 1); ++p)
+                    insert(p);
+            }
+            else if (position + best_length - 2 <= last_match_start)
+                insert(position + best_length - 2);
+            position += best_length;
+            anchor = position;
+        }
+
+        write_sequence(out, data + anchor, size - anchor, 0, 0);
+        return out.size() - start_size;
+    }
+
+    // Reads the extra length bytes following a token nibble of 15
+    static bool read_length(std::span<const u8> input, usize &position, usize &length) noexcept
+    {
+        u8 byte {};
+        do {
+            if (position >= input.size())
+                return false;
+            byte = input[position++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    bool decompress(std::span<const u8> input, std::span<u8> out) noexcept
+    {
+        usize in {}, written {};
+        while (in < input.size()) {
+            const auto token = input[in++];
+
+            usize literal_count = token >> 4;
+            if (literal_count == 15 && !read_length(input, in, literal_count))
+                return false;
+            if (literal_count > input.size() - in || literal_count > out.size() - written)
+                return false;
+            std::copy_n(input.data() + in, literal_count, out.data() + written);
+            in += literal_count;
+            written += literal_count;
+
+            // the last sequence ends after its literals
+            if (in == input.size())
+                break;
+
+            if (input.size() - in < 2)
+                return false;
+            const usize offset = input[in] | (static_cast<usize>(input[in + 1]) << 8);
+            in += 2;
+            if (offset == 0 || offset > written)
+                return false;
+
+            usize match_length = token & 15;
+            if (match_length == 15 && !read_length(input, in, match_length))
+                return false;
+            match_length += MIN_MATCH;
+            if (match_length > out.size() - written)
+                return false;
+
+            // Overlapping matches repeat the last 'offset' bytes. Copying from the start of the match
+            // doubles the non-overlapping distance every step, so long runs take a few memcpys.
+            const auto source = written - offset;
+            while (match_length > 0) {
+                const auto count = std::min(match_length, written - source);
+                std::memcpy(out.data() + written, out.data() + source, count);
+                written += count;
+                match_length -= count;
+            }
+        }
+        return written == out.size();
+    }
+}
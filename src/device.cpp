@@ -7,6 +7,9 @@
  #include <set>
  #include <array>
  #include <cstring>
+ #include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 
 namespace Device
@@ -16,10 +19,11 @@ namespace Device
         VK_KHR_SWAPCHAIN_EXTENSION_NAME // Not all GPUs can present images to a screen so this is required
     };
 
-    static unsigned device_type_rating(VkPhysicalDeviceType type) noexcept
+    static unsigned device_type_rating(VkPhysicalDeviceType type, bool prefer_cpu_device) noexcept
     {
         switch (type)
         {
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: return (prefer_cpu_device) ? 3 : 0;
             case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 2;
             case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 1;
             // other types also exist, but for simplicity sake just
@@ -30,21 +34,24 @@ namespace Device
 
     static bool received_vram_retrieval_error(const DeviceInfo &info)
     {
+        // CPU implementations render out of system memory, so they are not required to expose a device local heap
+        if (info.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+            return info.memory_heap.size == 0;
+
         if (!(info.memory_heap.flags&VkMemoryHeapFlagBits::VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
-            const auto msg = std::string{"Failed to retrieve "} + info.properties.deviceName + " VRAM size";
-            Logger::error(msg.c_str());
+            Logger::error("Failed to retrieve {} VRAM size", info.properties.deviceName);
             return true;
         }
         return false;
     }
 
     // keep in mind this comparsion is quite primitive, but it should at least be good enough
-    static Global::Compare compare_device_specs(const DeviceInfo &one, const DeviceInfo &two)
+    static Global::Compare compare_device_specs(const DeviceInfo &one, const DeviceInfo &two, bool prefer_cpu_device)
     {
         // in the future can also check for sparse binding support, dynamic array indexing, and tesselation support,
         u32 score_one {}, score_two {};
-        const auto device_type_one = device_type_rating(one.properties.deviceType);
-        const auto device_type_two = device_type_rating(two.properties.deviceType);
+        const auto device_type_one = device_type_rating(one.properties.deviceType, prefer_cpu_device);
+        const auto device_type_two = device_type_rating(two.properties.deviceType, prefer_cpu_device);
 
         // Compare GPU type (dedicated VS integrated)
         if (device_type_one > device_type_two)
@@ -74,66 +81,172 @@ namespace Device
         return Global::Compare::Equal;
     }
 
-    static bool device_has_extension_support(const DeviceInfo &info) noexcept
+    static std::vector<VkExtensionProperties> enumerate_extensions(VkPhysicalDevice device) noexcept
     {
         u32 extension_count {};
-        vkEnumerateDeviceExtensionProperties(info.device.self, nullptr, &extension_count, nullptr);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+        std::vector<VkExtensionProperties> extensions (extension_count);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+        return extensions;
+    }
 
-        if (extension_count == 0) {
-            if constexpr (Global::IS_DEBUG_BUILD) {
-                const auto msg = std::string{"No extensions found for device "} + info.properties.deviceName;
-                Logger::info(msg.c_str());
+    static bool has_extension(const std::vector<VkExtensionProperties> &extensions, const char *name) noexcept
+    {
+        return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties &extension) {
+            return strcmp(extension.extensionName, name) == 0;
+        });
+    }
+
+    static bool device_has_extension_support(const DeviceInfo &info, const std::vector<VkExtensionProperties> &extensions) noexcept
+    {
+        bool supported {true};
+        for (const auto *extension : REQUIRED_DEVICE_EXTENSIONS) {
+            if (has_extension(extensions, extension))
+                continue;
+            supported = false;
+            Logger::info("Device {} does not support {}", info.properties.deviceName, extension);
+        }
+        return supported;
+    }
+
+    // Everything about a device that selection and logical device creation need, except for the
+    // swapchain compatibility check. Returns false if the device lacks a required extension or
+    // queue family.
+    static bool query_device_info(VkPhysicalDevice device, const VkComponents &components, DeviceInfo &info) noexcept
+    {
+        info.device.self = device;
+        vkGetPhysicalDeviceProperties(device, &info.properties);
+        vkGetPhysicalDeviceMemoryProperties(device, &info.memory_properties);
+        vkGetPhysicalDeviceFeatures(device, &info.features);
+        info.device.name = info.properties.deviceName;
+
+        const auto extensions = enumerate_extensions(device);
+        info.draw_indirect_count = has_extension(extensions, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+        const auto memory_heaps_ptr {info.memory_properties.memoryHeaps};
+        const std::vector<VkMemoryHeap> memory_heaps {memory_heaps_ptr, memory_heaps_ptr + info.memory_properties.memoryHeapCount};
+
+        // find VRAM size
+        for (const auto &heap : memory_heaps) {
+            if (heap.flags&VkMemoryHeapFlagBits::VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                info.memory_heap = heap;
+                break;
             }
-            return false;
         }
 
-        std::vector<VkExtensionProperties> available_device_extensions (extension_count);
-        vkEnumerateDeviceExtensionProperties(info.device.self, nullptr, &extension_count, available_device_extensions.data());
+        // CPU implementations may not mark any heap as device local, in which case the largest
+        // (system memory) heap is used instead
+        if (info.memory_heap.size == 0 && info.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) {
+            for (const auto &heap : memory_heaps)
+                if (heap.size > info.memory_heap.size)
+                    info.memory_heap = heap;
+        }
 
-        std::set<std::string> required_extensions {REQUIRED_DEVICE_EXTENSIONS.begin(), REQUIRED_DEVICE_EXTENSIONS.end()};
+        info.queue_family_indices = Queue::QueueFamilyIndices{info.device, components.get_surface()};
+        return device_has_extension_support(info, extensions) && info.features.geometryShader &&
+               info.queue_family_indices.is_complete();
+    }
 
-        for (const auto &extension : available_device_extensions) {
-            if constexpr (Global::IS_DEBUG_BUILD) {
-                if (required_extensions.find(extension.extensionName) != required_extensions.end()) {
-                    const auto msg = std::string{"Device "} + info.properties.deviceName + " supports " + extension.extensionName;
-                    Logger::info(msg.c_str());
-                }
-            }
-            required_extensions.erase(extension.extensionName);
-        }
+    // The device picked by the last full selection pass. As long as the same device with the same
+    // driver is still around (and no device was added or removed), it is picked again without
+    // querying and scoring every device. Vulkan 1.0 has no device UUID, but 'pipelineCacheUUID'
+    // is unique per device and driver build, which is all that matters here.
+    struct SelectionRecord
+    {
+        u32 magic {};
+        u32 version {};
+        u32 vendor_id {};
+        u32 device_id {};
+        u32 driver_version {};
+        u32 device_count {};
+        std::array<u8, VK_UUID_SIZE> uuid {};
+        u8 prefer_cpu_device {};
+        u8 headless {};
+    };
 
-        if constexpr (Global::IS_DEBUG_BUILD) {
+    static constexpr u32 SELECTION_RECORD_MAGIC {0x4d434453}; // "MCDS"
+    static constexpr u32 SELECTION_RECORD_VERSION {1};
 
-            // print out any extensions that were not found
-            for (const auto &extension : required_extensions) {
-                const auto msg = std::string{"Device "} + info.properties.deviceName + " does not support " + extension;
-                Logger::info(msg.c_str());
-            }
+    static std::string selection_record_path() noexcept
+    {
+        return std::string{PipelineCache::CACHE_DIRECTORY} + "device.bin";
+    }
 
-            if (!required_extensions.empty()) {
-                const auto msg = std::string{"Device "} + info.properties.deviceName + " does not support required extensions";
-                Logger::info(msg.c_str());
-            }
-            else {
-                const auto msg = std::string{"Device "} + info.properties.deviceName + " supports required extensions";
-                Logger::info(msg.c_str());
-            }
-        }
-        return required_extensions.empty();
+    static SelectionRecord make_selection_record(const VkPhysicalDeviceProperties &properties, usize device_count,
+                                                 bool prefer_cpu_device, bool headless) noexcept
+    {
+        SelectionRecord record {};
+        record.magic = SELECTION_RECORD_MAGIC;
+        record.version = SELECTION_RECORD_VERSION;
+        record.vendor_id = properties.vendorID;
+        record.device_id = properties.deviceID;
+        record.driver_version = properties.driverVersion;
+        record.device_count = static_cast<u32>(device_count);
+        std::copy(std::begin(properties.pipelineCacheUUID), std::end(properties.pipelineCacheUUID), record.uuid.begin());
+        record.prefer_cpu_device = prefer_cpu_device;
+        record.headless = headless;
+        return record;
     }
 
-    static bool can_use_physical_device(const DeviceInfo &info, const Swapchain &swapchain) noexcept
+    static bool operator==(const SelectionRecord &one, const SelectionRecord &two) noexcept
     {
-        const bool extensions_supported = device_has_extension_support(info);
+        return one.magic == two.magic && one.version == two.version && one.vendor_id == two.vendor_id &&
+               one.device_id == two.device_id && one.driver_version == two.driver_version &&
+               one.device_count == two.device_count && one.uuid == two.uuid &&
+               one.prefer_cpu_device == two.prefer_cpu_device && one.headless == two.headless;
+    }
+
+    static void write_selection_record(const SelectionRecord &record) noexcept
+    {
+        std::error_code error {};
+        std::filesystem::create_directories(PipelineCache::CACHE_DIRECTORY, error);
+        std::ofstream file {selection_record_path(), std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        if (!file)
+            Logger::error("Failed to write the device selection record");
+    }
 
-        if (extensions_supported) {
-            return info.features.geometryShader && info.queue_family_indices.is_complete() &&
-                   swapchain.is_compatible();
+    // Surface formats and present modes depend on the monitor and compositor, so they may change
+    // between launches even when the device doesn't
+    static bool supports_surface(const VkComponents &components, const DeviceInfo &info) noexcept
+    {
+        // a swapchain can be created as long as there is any format and present mode, which one is
+        // picked when the swapchain is created
+        u32 format_count {};
+        vkGetPhysicalDeviceSurfaceFormatsKHR(info.device.self, components.get_surface(), &format_count, nullptr);
+        u32 presentation_mode_count {};
+        vkGetPhysicalDeviceSurfacePresentModesKHR(info.device.self, components.get_surface(), &presentation_mode_count, nullptr);
+        return format_count != 0 && presentation_mode_count != 0;
+    }
+
+    // Returns false if there is no record or the recorded device can't be used anymore
+    static bool select_recorded_device(const VkComponents &components, const std::vector<VkPhysicalDevice> &devices,
+                                       bool prefer_cpu_device, DeviceInfo &selected_device_info) noexcept
+    {
+        std::ifstream file {selection_record_path(), std::ios::binary};
+        SelectionRecord recorded {};
+        if (!file || !file.read(reinterpret_cast<char *>(&recorded), sizeof(recorded)))
+            return false;
+
+        for (const auto device : devices) {
+            VkPhysicalDeviceProperties properties {};
+            vkGetPhysicalDeviceProperties(device, &properties);
+            if (make_selection_record(properties, devices.size(), prefer_cpu_device, components.is_headless()) != recorded)
+                continue;
+
+            // properties and extensions are fixed for a driver build, but the surface may not be
+            DeviceInfo info {};
+            if (!query_device_info(device, components, info) || !supports_surface(components, info))
+                return false;
+
+            selected_device_info = std::move(info);
+            Logger::info("Selected physical device from the last launch: {}", selected_device_info.properties.deviceName);
+            return true;
         }
         return false;
     }
 
-    [[nodiscard]] DeviceInfo select_physical_device(const VkComponents &components, GLFWwindow *window) noexcept
+    [[nodiscard]] DeviceInfo select_physical_device(const VkComponents &components, bool prefer_cpu_device) noexcept
     {
         u32 count {};
         vkEnumeratePhysicalDevices(components.get_instance(), &count, nullptr);
@@ -148,94 +261,48 @@ namespace Device
         DeviceInfo selected_device_info {};
         bool appropriate_device_exists = false;
 
+        if (select_recorded_device(components, devices, prefer_cpu_device, selected_device_info))
+            return selected_device_info;
+
         // iterate through all the available devices in the
         // system and try to select the best one
         for (const auto &device : devices) {
             DeviceInfo info {};
-            info.device.self = device;
-            VkPhysicalDeviceMemoryProperties device_mem_properties {};
+            const bool device_supported = query_device_info(device, components, info);
 
-            vkGetPhysicalDeviceProperties(device, &info.properties);
-            vkGetPhysicalDeviceMemoryProperties(device, &device_mem_properties);
-            vkGetPhysicalDeviceFeatures(device, &info.features);
+            Logger::info("Checking device: {}", info.device.name);
 
-            info.device.name = info.properties.deviceName;
-            #ifndef NDEBUG
-                const auto check_dev_msg = std::string{"Checking device: "} + info.device.name;
-                Logger::info(check_dev_msg.c_str());
-            #endif
-
-            const auto memory_heaps_ptr {device_mem_properties.memoryHeaps};
-            const std::vector<VkMemoryHeap> memory_heaps {memory_heaps_ptr, memory_heaps_ptr + device_mem_properties.memoryHeapCount};
-
-            // find VRAM size
-            for (const auto &heap : memory_heaps) {
-                if (heap.flags&VkMemoryHeapFlagBits::VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
-                    info.memory_heap = heap;
-                    break;
-                }
-            }
-            #ifndef NDEBUG
-                const Device::PhysicalDeviceInfo physical_device_info {
-                    .self = device,
-                    .name = info.properties.deviceName
-                };
-            #else
-                const Device::PhysicalDeviceIfo physical_device_info {
-                    .self = device
-                };
-            #endif
-
-            info.queue_family_indices = Queue::QueueFamilyIndices{physical_device_info, components.get_surface()};
-            const Swapchain swapchain {info.device, components.get_surface(), window, info.queue_family_indices, VK_NULL_HANDLE};
-
-            const bool can_use_device = can_use_physical_device(info, swapchain);
+            const bool can_use_device = device_supported && supports_surface(components, info);
 
             // device must be compatible in order to use it
             if (can_use_device) {
-                if constexpr (Global::IS_DEBUG_BUILD) {
-                    const auto msg = std::string{"Device "} + info.properties.deviceName + " supports all required features.";
-                    Logger::info(msg.c_str());
-                }
+                Logger::info("Device {} supports all required features.", info.properties.deviceName);
                 // if the previous device wasnt initialized yet, set the selected device to this device
                 if (previous_device_info.device.self == VK_NULL_HANDLE) {
                     appropriate_device_exists = true;
-                    selected_device_info.device = info.device;
-                    selected_device_info.properties = info.properties;
-                    selected_device_info.features = info.features;
-                    selected_device_info.memory_heap = info.memory_heap;
-                    selected_device_info.queue_family_indices = info.queue_family_indices;
+                    selected_device_info = info;
                 }
                 else {
                     // now we can actually compare the devices
-                    const auto cmp = compare_device_specs(info, previous_device_info);
-                    if (cmp == Global::Compare::Greater) {
-                        selected_device_info.device = info.device;
-                        selected_device_info.properties = info.properties;
-                        selected_device_info.features = info.features;
-                        selected_device_info.memory_heap = info.memory_heap;
-                        selected_device_info.queue_family_indices = info.queue_family_indices;
-                    }
+                    const auto cmp = compare_device_specs(info, previous_device_info, prefer_cpu_device);
+                    if (cmp == Global::Compare::Greater)
+                        selected_device_info = info;
                 }
                 previous_device_info = std::move(info);
             }
-            #ifndef NDEBUG 
-                else {
-                    const auto msg = std::string{"Device "} + info.properties.deviceName + " does not support required features. Skipping...";
-                    Logger::info(msg.c_str());
-                }
-            #endif
+            else {
+                Logger::info("Device {} does not support required features. Skipping...", info.properties.deviceName);
+            }
 
         }
 
         if (!appropriate_device_exists)
             Logger::fatal_error("Could not find a suitable GPU to run the game");
 
-        #ifndef NDEBUG
-            const auto msg = std::string{"Selected physical device: "} + selected_device_info.properties.deviceName;
-            Logger::info(msg.c_str());
-        #endif
+        Logger::info("Selected physical device: {}", selected_device_info.properties.deviceName);
 
+        write_selection_record(make_selection_record(selected_device_info.properties, devices.size(),
+                                                     prefer_cpu_device, components.is_headless()));
         return selected_device_info;
     }
 
@@ -266,17 +333,34 @@ namespace Device
         device_create_info.pQueueCreateInfos = queue_create_infos.data();
         device_create_info.queueCreateInfoCount = static_cast<u32>(queue_create_infos.size());
         device_create_info.pEnabledFeatures = &selected_device_info.features;
-        device_create_info.enabledExtensionCount = static_cast<u32>(REQUIRED_DEVICE_EXTENSIONS.size());
-        device_create_info.ppEnabledExtensionNames = REQUIRED_DEVICE_EXTENSIONS.data();
+
+        std::vector<const char *> extensions {REQUIRED_DEVICE_EXTENSIONS.begin(), REQUIRED_DEVICE_EXTENSIONS.end()};
+        // optional, lets the GPU decide how many indirect draws are executed
+        if (selected_device_info.draw_indirect_count)
+            extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        device_create_info.enabledExtensionCount = static_cast<u32>(extensions.size());
+        device_create_info.ppEnabledExtensionNames = extensions.data();
 
         if (vkCreateDevice(selected_device_info.device.self, &device_create_info, nullptr, &device) != VK_SUCCESS)
             Logger::fatal_error("Failed to create logical device");
-        #ifndef NDEBUG
-            else
-                Logger::info("Logical device created successfully");
-        #endif
+        Logger::info("Logical device created successfully");
 
         devices_in_use.insert(device); // We are now using the device so add it to the set
+        physical_device = selected_device_info.device.self;
+        queue_family_indices = selected_device_info.queue_family_indices;
+        features = selected_device_info.features;
+        limits = selected_device_info.properties.limits;
+        memory_heap = selected_device_info.memory_heap;
+        draw_indirect_count = selected_device_info.draw_indirect_count;
+
+        u32 family_count {};
+        vkGetPhysicalDeviceQueueFamilyProperties(selected_device_info.device.self, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families (family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(selected_device_info.device.self, &family_count, families.data());
+        graphics_timestamp_bits = families[selected_device_info.queue_family_indices.get(Queue::GraphicsQueueIndex)].timestampValidBits;
+
+        allocator = std::make_unique<Memory::Allocator>(device, selected_device_info.memory_properties, selected_device_info.properties.limits);
+        pipeline_cache = std::make_unique<PipelineCache>(device, selected_device_info.properties);
 
         vkGetDeviceQueue(device, 
                          selected_device_info.queue_family_indices.get(Queue::GraphicsQueueIndex), 
@@ -287,17 +371,24 @@ namespace Device
                          selected_device_info.queue_family_indices.get(Queue::PresentationQueueIndex), 
                          0, 
                          &presentation_queue);
+
+        vkGetDeviceQueue(device, 
+                         selected_device_info.queue_family_indices.get(Queue::TransferQueueIndex), 
+                         0, 
+                         &transfer_queue);
     }
 
     LogicalDevice::~LogicalDevice() noexcept
     {
         if (device != VK_NULL_HANDLE) {
+            Logger::info("De-allocating logical device");
             if constexpr (Global::IS_DEBUG_BUILD) {
-                Logger::info("De-allocating logical device");
                 if (!this->device_is_in_use(device)) {
                     Logger::fatal_error("Attempted to de-allocate logical device, but it is not being used. Fix this bug");
                 }
             }
+            pipeline_cache.reset(); // saved to disk here
+            allocator.reset(); // all device memory has to be freed before the device itself
             vkDestroyDevice(device, nullptr); 
             devices_in_use.erase(device); // No longer using the device so erase it
             device = VK_NULL_HANDLE;
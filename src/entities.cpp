@@ -0,0 +1,35 @@
+#include "mcvk/entities.hpp"
+#include <atomic>
+
+namespace Entities
+{
+    usize Registry::next_type_id() noexcept
+    {
+        static std::atomic<usize> next {};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Entity Registry::create() noexcept
+    {
+        ++alive_count;
+        if (!free_indices.empty()) {
+            const auto index = free_indices.back();
+            free_indices.pop_back();
+            return {.index = index, .generation = generations[index]};
+        }
+        generations.push_back(0);
+        return {.index = static_cast<u32>(generations.size() - 1), .generation = 0};
+    }
+
+    void Registry::destroy(Entity entity) noexcept
+    {
+        if (!is_alive(entity))
+            return;
+        for (const auto &pool : pools)
+            if (pool != nullptr)
+                pool->remove(entity.index);
+        ++generations[entity.index];
+        free_indices.push_back(entity.index);
+        --alive_count;
+    }
+}
@@ -0,0 +1,108 @@
+#include "mcvk/gpuprofiler.hpp"
+#include "mcvk/logger.hpp"
+
+GpuProfiler::GpuProfiler(const Device::LogicalDevice &logical_device, u32 frames_in_flight) noexcept :
+    device {logical_device.get()},
+    timestamp_period {static_cast<double>(logical_device.get_limits().timestampPeriod)}
+{
+    if constexpr (!Profiler::ENABLED)
+        return;
+
+    const auto valid_bits = logical_device.get_graphics_timestamp_bits();
+    if (valid_bits == 0) {
+        Logger::warning("The graphics queue does not support timestamps, GPU zones are not profiled");
+        return;
+    }
+    timestamp_mask = (valid_bits >= 64) ? ~u64{} : (u64{1} << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo query_pool_create_info {};
+    query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_create_info.queryCount = MAX_ZONES * 2;
+
+    slots.resize(frames_in_flight);
+    for (auto &slot : slots) {
+        if (vkCreateQueryPool(device, &query_pool_create_info, nullptr, &slot.query_pool) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create timestamp query pool");
+        slot.names.reserve(MAX_ZONES);
+    }
+    results.resize(MAX_ZONES * 2);
+    zones.reserve(MAX_ZONES);
+}
+
+GpuProfiler::~GpuProfiler() noexcept
+{
+    for (auto &slot : slots)
+        vkDestroyQueryPool(device, slot.query_pool, nullptr);
+}
+
+void GpuProfiler::collect(u32 frame_slot) noexcept
+{
+    if (!is_supported())
+        return;
+
+    auto &slot = slots[frame_slot];
+    if (slot.frame == 0)
+        return;
+    const auto frame = slot.frame;
+    slot.frame = 0;
+
+    // the fence has been waited on, so anything not available now never will be (an unclosed zone)
+    const auto query_count = static_cast<u32>(slot.names.size() * 2);
+    const auto result = vkGetQueryPoolResults(device, slot.query_pool, 0, query_count, query_count * sizeof(u64),
+                                              results.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return;
+
+    // the GPU clock has an unknown offset to the CPU clock, so the frame is placed at its submission
+    const auto frame_start = results[0];
+    const auto to_cpu = [&](u64 timestamp) {
+        const auto ticks = (timestamp - frame_start) & timestamp_mask;
+        return slot.submit_ns + static_cast<i64>(static_cast<double>(ticks) * timestamp_period);
+    };
+
+    zones.clear();
+    for (usize i {}; i < slot.names.size(); ++i)
+        zones.push_back({.name = slot.names[i], .start_ns = to_cpu(results[2 * i]), .end_ns = to_cpu(results[2 * i + 1])});
+    Profiler::record_gpu_frame(frame, zones);
+}
+
+void GpuProfiler::begin_frame(u32 frame_slot, VkCommandBuffer command_buffer) noexcept
+{
+    if (!is_supported())
+        return;
+
+    recording = &slots[frame_slot];
+    recording->names.clear();
+    vkCmdResetQueryPool(command_buffer, recording->query_pool, 0, MAX_ZONES * 2);
+    static_cast<void>(begin_zone(command_buffer, "frame"));
+}
+
+void GpuProfiler::end_frame(VkCommandBuffer command_buffer) noexcept
+{
+    if (!is_supported() || recording == nullptr)
+        return;
+
+    end_zone(command_buffer, 0);
+    recording->frame = Profiler::current_frame();
+    recording->submit_ns = Profiler::now_ns();
+    recording = nullptr;
+}
+
+u32 GpuProfiler::begin_zone(VkCommandBuffer command_buffer, const char *name) noexcept
+{
+    if (!is_supported() || recording == nullptr || recording->names.size() >= MAX_ZONES)
+        return NO_ZONE;
+
+    const auto zone = static_cast<u32>(recording->names.size());
+    recording->names.push_back(name);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, recording->query_pool, zone * 2);
+    return zone;
+}
+
+void GpuProfiler::end_zone(VkCommandBuffer command_buffer, u32 zone) noexcept
+{
+    if (zone == NO_ZONE || recording == nullptr)
+        return;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, recording->query_pool, zone * 2 + 1);
+}
@@ -5,76 +5,560 @@
 #include "mcvk/vkcomponents.hpp"
 #include "mcvk/validationlayers.hpp"
 #include "mcvk/swapchain.hpp"
+#include "mcvk/renderer.hpp"
+#include "mcvk/benchmark.hpp"
+#include "mcvk/world.hpp"
+#include "mcvk/mesher.hpp"
+#include "mcvk/jobs.hpp"
+#include "mcvk/math.hpp"
+#include "mcvk/chunkrenderer.hpp"
+#include "mcvk/timer.hpp"
+#include "mcvk/profiler.hpp"
+#include "mcvk/terrain.hpp"
+#include "mcvk/region.hpp"
+#include "mcvk/chunkstreamer.hpp"
+#include "mcvk/simulation.hpp"
 #include <vulkan/vulkan.h>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
 #include <vector>
+#include <optional>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
+struct Options
+{
+    bool headless {false};
+    bool prefer_cpu_device {false};
+    u32 frames_in_flight {Renderer::DEFAULT_FRAMES_IN_FLIGHT};
+    u32 frame_count {1000}; // number of frames rendered before exiting, only used in headless mode
+    const char *benchmark {nullptr}; // name of the CPU benchmark to run instead of the game
+    bool record_benchmark {false};
+    bool pipeline_benchmark {false};
+    bool occlusion_benchmark {false};
+    bool lod_benchmark {false};
+    bool streaming_check {false};
+    bool startup_report {false};
+    const char *profile_path {nullptr}; // the profiler trace is written here on exit
+    u32 view_distance {8};   // in chunks
+    u32 ram_budget_mib {512};
+    u32 vram_budget_mib {0}; // 0 derives the budget from the size of the device local heap
+    bool occlusion_culling {true};
+    u32 lod_distance {8}; // in chunks, 0 meshes every section at full detail
+    u32 tick_rate {Simulation::DEFAULT_TICK_RATE};
+};
+
+// the game and the headless benchmarks share the same terrain
+static constexpr u64 WORLD_SEED {1337};
+
+// The meshes of every section of a test world, in the order they should be uploaded
+struct TestWorld
+{
+    struct SectionMesh
+    {
+        World::ChunkPos chunk {};
+        i32 section {};
+        Meshing::MeshData mesh {};
+    };
 
-static void game();
+    World::ChunkStore store {};
+    std::vector<SectionMesh> meshes {};
+};
+
+static Options parse_options(int argc, char **argv) noexcept;
+static void game(const Options &options);
 static void init_vulkan(const VkComponents &components, 
                         Device::LogicalDevice &device, 
                         Swapchain &swapchain,
-                        GLFWwindow *window) noexcept;
+                        VkExtent2D framebuffer_extent,
+                        bool prefer_cpu_device) noexcept;
+static void run_headless_benchmark(Renderer &renderer, VkExtent2D extent, u32 frame_count) noexcept;
+static void run_record_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept;
+static void run_pipeline_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept;
+static void run_occlusion_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept;
+static void run_lod_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept;
+static void run_streaming_check(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept;
+static void build_test_world(TestWorld &world, Jobs::JobSystem &job_system, i32 radius,
+                             float lod_distance = 0.0f, Math::Vec3 viewpoint = {}) noexcept;
+static void upload_test_world(const TestWorld &world, Renderer &renderer, ChunkRenderer &chunk_renderer, const Math::Camera &camera) noexcept;
+static void write_profile(const Options &options) noexcept;
 #ifndef NDEBUG
     static bool has_validation_layer_support() noexcept;
 #endif
 
-int main() 
+int main(int argc, char **argv) 
 {
+    const auto options = parse_options(argc, argv);
+
+    // CPU benchmarks don't need vulkan or a window at all
+    if (options.benchmark != nullptr) {
+        if (!Benchmark::run(options.benchmark))
+            Logger::fatal_error("Unknown benchmark requested");
+        return 0;
+    }
+
     // Before initializing the game, check if validation layers are supported
     // (only necessary for debug builds)
     #ifndef NDEBUG
         if (!has_validation_layer_support())
             Logger::fatal_error("Validation layers requested, but not available");
     #endif
-    glfwInit();
-    game();
-    glfwTerminate();
+
+    // GLFW is not needed at all in headless mode, which also means no display server is required
+    if (!options.headless) {
+        const Timing::ScopedTimer timer {"glfwInit"};
+        glfwInit();
+    }
+    game(options);
+    if (!options.headless)
+        glfwTerminate();
     return 0;
 }
 
+// Supported options:
+//   --headless             render to a headless surface without a window for a fixed number of frames
+//   --frames=N             number of frames rendered in headless mode
+//   --frames-in-flight=N   number of frames the CPU may record ahead of the GPU
+//   --cpu                  prefer CPU implementations such as lavapipe over GPUs
+//   --benchmark=NAME       run one of the CPU benchmarks (see benchmark.hpp) and exit
+//   --record-benchmark     headless, measure chunk draw recording time against visible sections, with
+//                          CPU culling and with GPU culling
+//   --pipeline-benchmark   headless, compare pipeline creation with the cache loaded from disk, an empty
+//                          (cold) cache and a warm one
+//   --occlusion-benchmark  headless, measure drawn sections and culling time per frame with occlusion
+//                          culling on and off, above and below the surface
+//   --lod-benchmark        headless, compare vertex counts, mesh memory and frame times with and without
+//                          reduced detail for distant sections
+//   --streaming-check      headless, fly far through the streamed world and fail if the chunk renderer
+//                          keeps more regions the further the camera gets
+//   --startup-report       print how long every startup stage took once the first frame has been
+//                          presented (or before a headless benchmark starts)
+//   --profile=PATH         print a summary of the profiled frames and write them to PATH as a Chrome
+//                          trace on exit. F3 prints the summary at any time.
+//   --view-distance=N      distance in chunks up to which chunks are streamed in and drawn
+//   --ram-budget=MIB       memory the streamed chunks' blocks and meshes waiting for upload may use
+//   --vram-budget=MIB      memory the chunk meshes may use on the device, defaults to a quarter of
+//                          the device local heap (at most 512 MiB)
+//   --no-occlusion-culling draw every section in the frustum, including the ones hidden by terrain
+//   --lod-distance=N       distance in chunks beyond which sections are meshed at reduced detail
+//   --no-lod               mesh every section at full detail
+//   --tick-rate=N          simulation ticks per second, independent of the frame rate
+static Options parse_options(int argc, char **argv) noexcept
+{
+    Options options {};
 
-static void game()
+    static constexpr auto parse_count = [](const char *value) {
+        char *end {nullptr};
+        const auto count = std::strtoul(value, &end, 10);
+        if (end == value || *end != '\0' || count == 0)
+            Logger::fatal_error("Expected a positive number as option value");
+        return static_cast<u32>(count);
+    };
+
+    for (int i {1}; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--headless") == 0)
+            options.headless = true;
+        else if (strcmp(arg, "--cpu") == 0)
+            options.prefer_cpu_device = true;
+        else if (strncmp(arg, "--frames=", std::strlen("--frames=")) == 0)
+            options.frame_count = parse_count(arg + std::strlen("--frames="));
+        else if (strncmp(arg, "--frames-in-flight=", std::strlen("--frames-in-flight=")) == 0)
+            options.frames_in_flight = parse_count(arg + std::strlen("--frames-in-flight="));
+        else if (strncmp(arg, "--benchmark=", std::strlen("--benchmark=")) == 0)
+            options.benchmark = arg + std::strlen("--benchmark=");
+        else if (strcmp(arg, "--record-benchmark") == 0)
+            options.headless = options.record_benchmark = true;
+        else if (strcmp(arg, "--pipeline-benchmark") == 0)
+            options.headless = options.pipeline_benchmark = true;
+        else if (strcmp(arg, "--occlusion-benchmark") == 0)
+            options.headless = options.occlusion_benchmark = true;
+        else if (strcmp(arg, "--lod-benchmark") == 0)
+            options.headless = options.lod_benchmark = true;
+        else if (strcmp(arg, "--streaming-check") == 0)
+            options.headless = options.streaming_check = true;
+        else if (strcmp(arg, "--startup-report") == 0)
+            options.startup_report = true;
+        else if (strncmp(arg, "--profile=", std::strlen("--profile=")) == 0)
+            options.profile_path = arg + std::strlen("--profile=");
+        else if (strncmp(arg, "--view-distance=", std::strlen("--view-distance=")) == 0)
+            options.view_distance = parse_count(arg + std::strlen("--view-distance="));
+        else if (strncmp(arg, "--ram-budget=", std::strlen("--ram-budget=")) == 0)
+            options.ram_budget_mib = parse_count(arg + std::strlen("--ram-budget="));
+        else if (strncmp(arg, "--vram-budget=", std::strlen("--vram-budget=")) == 0)
+            options.vram_budget_mib = parse_count(arg + std::strlen("--vram-budget="));
+        else if (strcmp(arg, "--no-occlusion-culling") == 0)
+            options.occlusion_culling = false;
+        else if (strncmp(arg, "--lod-distance=", std::strlen("--lod-distance=")) == 0)
+            options.lod_distance = parse_count(arg + std::strlen("--lod-distance="));
+        else if (strcmp(arg, "--no-lod") == 0)
+            options.lod_distance = 0;
+        else if (strncmp(arg, "--tick-rate=", std::strlen("--tick-rate=")) == 0)
+            options.tick_rate = parse_count(arg + std::strlen("--tick-rate="));
+        else
+            Logger::error("Ignoring unknown option");
+    }
+    return options;
+}
+
+static void game(const Options &options)
 {
     static constexpr unsigned WIDTH {500}, HEIGHT {500};
-    Window window {WIDTH, HEIGHT, "Minecraft"};
+    static constexpr bool USE_DEBUG_MESSENGER = Global::IS_DEBUG_BUILD;
 
-    #ifndef NDEBUG
-        static constexpr bool USE_DEBUG_MESSENGER = true;
-        VkComponents components {USE_DEBUG_MESSENGER, window.self};
-    #else
-        VkComponents components {window.self};
-    #endif
+    std::optional<Window> window {};
+    VkExtent2D framebuffer_extent {.width = WIDTH, .height = HEIGHT}; // headless mode always renders at a fixed resolution
+    if (!options.headless) {
+        const Timing::ScopedTimer timer {"window"};
+        window.emplace(WIDTH, HEIGHT, "Minecraft");
+
+        int width {}, height {};
+        glfwGetFramebufferSize(window->self, &width, &height);
+        framebuffer_extent = {.width = static_cast<u32>(width), .height = static_cast<u32>(height)};
+    }
+
+    Timing::ScopedTimer components_timer {"VkComponents"};
+    VkComponents components {USE_DEBUG_MESSENGER, (window) ? window->self : nullptr};
+    components_timer.stop();
 
     Device::LogicalDevice device;
     Swapchain swapchain {};
 
     // Initialize base vulkan instance, setting up physical/logical devices, debug messengers, swapchain, etc.
-    init_vulkan(components, device, swapchain, window.self);
+    init_vulkan(components, device, swapchain, framebuffer_extent, options.prefer_cpu_device);
+
+    Timing::ScopedTimer renderer_timer {"renderer"};
+    Renderer renderer {device, swapchain, options.frames_in_flight};
+    renderer_timer.stop();
+    Jobs::JobSystem job_system {};
+
+    if (options.headless) {
+        Timing::mark("ready to render");
+        if (options.startup_report)
+            Timing::report();
+    }
+
+    if (options.record_benchmark) {
+        run_record_benchmark(device, renderer, job_system);
+        return;
+    }
+    if (options.pipeline_benchmark) {
+        run_pipeline_benchmark(device, renderer, job_system);
+        return;
+    }
+    if (options.occlusion_benchmark) {
+        run_occlusion_benchmark(device, renderer, job_system);
+        return;
+    }
+    if (options.lod_benchmark) {
+        run_lod_benchmark(device, renderer, job_system);
+        return;
+    }
+    if (options.streaming_check) {
+        run_streaming_check(device, renderer, job_system);
+        return;
+    }
+    if (options.headless) {
+        run_headless_benchmark(renderer, swapchain.get_extent(), options.frame_count);
+        write_profile(options);
+        return;
+    }
+
+    static constexpr float ROTATION_SPEED {0.2f}; // radians per second
+    static constexpr float MOVE_SPEED {8.0f};     // blocks per second along -z
+    static constexpr const char *WORLD_DIRECTORY {"world/"};
+    static constexpr VkDeviceSize MIB {1024 * 1024};
+    static constexpr VkDeviceSize MAX_DEFAULT_VRAM_BUDGET {512 * MIB};
 
+    ChunkStreamer::Settings settings {
+        .view_distance = static_cast<i32>(options.view_distance),
+        .lod_distance = static_cast<float>(options.lod_distance),
+        .ram_budget = options.ram_budget_mib * MIB,
+        .vram_budget = (options.vram_budget_mib != 0) ? options.vram_budget_mib * MIB :
+                                                         std::min(device.get_memory_heap().size / 4, MAX_DEFAULT_VRAM_BUDGET),
+    };
+    Logger::info("Streaming chunks up to {} chunks away, with {} MiB of RAM and {} MiB of VRAM",
+                 settings.view_distance, settings.ram_budget / MIB, settings.vram_budget / MIB);
 
-    while (!glfwWindowShouldClose(window.self)) [[likely]] {
+    // declared before the store, so chunks that are still being saved outlive it
+    World::RegionStorage storage {WORLD_DIRECTORY};
+    World::ChunkStore store {};
+    const Terrain::Generator generator {WORLD_SEED};
+
+    Timing::ScopedTimer chunk_renderer_timer {"chunk renderer"};
+    // removed meshes stay in the arena until the frames using them have finished, leave some room for those
+    ChunkRenderer chunk_renderer {device, renderer, job_system, true, settings.vram_budget + settings.vram_budget / 8};
+    chunk_renderer_timer.stop();
+    chunk_renderer.set_occlusion_culling(options.occlusion_culling);
+    ChunkStreamer streamer {store, chunk_renderer, job_system, &storage, generator, settings};
+
+    // the camera flies along -z while slowly turning around
+    const Simulation::State initial_state {.camera = {.position = {0.0f, 110.0f, 0.0f}, .pitch = -0.35f}};
+    Simulation simulation {[](Simulation::State &state, float seconds) {
+        state.camera.yaw += ROTATION_SPEED * seconds;
+        state.camera.position.z -= MOVE_SPEED * seconds;
+    }, initial_state, options.tick_rate};
+
+    bool first_frame {true};
+    bool summary_key_down {false};
+    while (!glfwWindowShouldClose(window->self)) [[likely]] {
         glfwPollEvents();
+        // jobs that have to call GLFW or anything else that isn't thread-safe
+        job_system.run_main_thread_jobs();
+
+        const auto summary_key = glfwGetKey(window->self, GLFW_KEY_F3) == GLFW_PRESS;
+        if (summary_key && !summary_key_down) {
+            Profiler::report();
+            streamer.report();
+            simulation.report();
+        }
+        summary_key_down = summary_key;
+
+        if (window->consume_resize()) [[unlikely]] {
+            // a minimized window has a zero extent and nothing to present to, block until it is restored
+            auto extent = window->get_framebuffer_extent();
+            while ((extent.width == 0 || extent.height == 0) && !glfwWindowShouldClose(window->self)) {
+                glfwWaitEvents();
+                extent = window->get_framebuffer_extent();
+            }
+            renderer.resize(extent);
+        }
+
+        const auto state = simulation.frame_state();
+        const auto command_buffer = renderer.begin_frame();
+        if (command_buffer != VK_NULL_HANDLE) [[likely]] {
+            streamer.update(state.camera);
+            chunk_renderer.draw(command_buffer, state.camera);
+            renderer.end_frame();
+
+            if (first_frame) [[unlikely]] {
+                first_frame = false;
+                Timing::mark("first present");
+                if (options.startup_report)
+                    Timing::report();
+            }
+        }
     }
+    write_profile(options);
+}
 
+static void write_profile(const Options &options) noexcept
+{
+    if (options.profile_path == nullptr)
+        return;
+    if constexpr (!Profiler::ENABLED) {
+        Logger::warning("Profiling is compiled out, build with -DMCVK_PROFILE=1 to use --profile");
+        return;
+    }
+    Profiler::report();
+    Profiler::write_trace(options.profile_path);
 }
 
 // Components must be initialized before this is called, as it can affect the physical device selection
 static void init_vulkan(const VkComponents &components, 
                         Device::LogicalDevice &device, 
                         Swapchain &swapchain,
-                        GLFWwindow *window) noexcept
+                        VkExtent2D framebuffer_extent,
+                        bool prefer_cpu_device) noexcept
 {
-    const Device::DeviceInfo device_info {Device::select_physical_device(components, window)};
-    device = Device::LogicalDevice{device_info};
+    Timing::ScopedTimer selection_timer {"device selection"};
+    const Device::DeviceInfo device_info {Device::select_physical_device(components, prefer_cpu_device)};
+    selection_timer.stop();
+    {
+        const Timing::ScopedTimer timer {"logical device"};
+        device = Device::LogicalDevice{device_info};
+    }
+    const Timing::ScopedTimer timer {"swapchain"};
     swapchain = Swapchain{device_info.device, 
                           components.get_surface(),
-                          window,
+                          framebuffer_extent,
                           device_info.queue_family_indices, 
                           device.get()};
 }
 
+// Renders a fixed number of frames and reports the frame times, so that the results are
+// comparable between runs (and machines using the same device).
+static void run_headless_benchmark(Renderer &renderer, VkExtent2D extent, u32 frame_count) noexcept
+{
+    using Clock = std::chrono::steady_clock;
+    std::vector<double> frame_times_ms {};
+    frame_times_ms.reserve(frame_count);
+
+    auto previous = Clock::now();
+    for (u32 i {}; i < frame_count; ++i) {
+        if (renderer.begin_frame() != VK_NULL_HANDLE) [[likely]]
+            renderer.end_frame();
+
+        const auto now = Clock::now();
+        frame_times_ms.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+        previous = now;
+    }
+
+    double total_ms {};
+    for (const auto time : frame_times_ms)
+        total_ms += time;
+    std::sort(frame_times_ms.begin(), frame_times_ms.end());
+
+    const auto percentile = [&frame_times_ms](double p) {
+        return frame_times_ms[static_cast<usize>(p * static_cast<double>(frame_times_ms.size() - 1))];
+    };
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Rendered %u frames at %ux%u with %u frames in flight\n", frame_count, extent.width, extent.height, renderer.frames_in_flight());
+    fprintf(stdout, "  average: %.3f ms (%.1f fps)\n", total_ms / frame_count, 1000.0 * frame_count / total_ms);
+    fprintf(stdout, "  min: %.3f ms, p50: %.3f ms, p99: %.3f ms, max: %.3f ms\n",
+            frame_times_ms.front(), percentile(0.5), percentile(0.99), frame_times_ms.back());
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
+
+// Generates and meshes a square of chunks around the origin on the job system. With a non-zero
+// 'lod_distance' sections are meshed at the level of detail the streamer would pick for a camera
+// at 'viewpoint'.
+static void build_test_world(TestWorld &world, Jobs::JobSystem &job_system, i32 radius, float lod_distance, Math::Vec3 viewpoint) noexcept
+{
+    const Terrain::Generator generator {WORLD_SEED};
+
+    std::vector<World::Chunk *> chunks {};
+    for (i32 z {-radius}; z < radius; ++z)
+        for (i32 x {-radius}; x < radius; ++x)
+            chunks.push_back(&world.store.create_chunk({.x = x, .z = z}));
+
+    // every chunk writes its meshes to its own slots, so the jobs never share any output
+    std::vector<TestWorld::SectionMesh> meshes (chunks.size() * World::Chunk::SECTION_COUNT);
+    std::vector<Meshing::GreedyMesher> meshers (job_system.thread_count());
+
+    Jobs::Counter generated {}, meshed {};
+    for (auto *chunk : chunks)
+        job_system.schedule([&generator, chunk] { generator.generate(*chunk); }, &generated);
+    for (usize i {}; i < chunks.size(); ++i) {
+        job_system.schedule_after(generated, [&, i] {
+            const auto pos = chunks[i]->get_pos();
+            auto &mesher = meshers[Jobs::JobSystem::worker_index()];
+            for (i32 section {}; section < World::Chunk::SECTION_COUNT; ++section) {
+                auto &out = meshes[i * World::Chunk::SECTION_COUNT + static_cast<usize>(section)];
+                out.chunk = pos;
+                out.section = section;
+
+                constexpr auto SIZE = static_cast<float>(World::Section::SIZE);
+                const auto dx = static_cast<float>(pos.x) + 0.5f - viewpoint.x / SIZE;
+                const auto dy = static_cast<float>(section) + 0.5f - viewpoint.y / SIZE;
+                const auto dz = static_cast<float>(pos.z) + 0.5f - viewpoint.z / SIZE;
+                const auto lod = Meshing::select_lod(0, std::sqrt(dx * dx + dy * dy + dz * dz), lod_distance);
+                mesher.mesh(chunks[i]->section(section), Meshing::neighbours_of(world.store, pos, section), out.mesh, lod);
+            }
+        }, &meshed);
+    }
+    job_system.wait(meshed);
+
+    // empty sections are only kept if they hide something, for occlusion culling
+    std::erase_if(meshes, [](const TestWorld::SectionMesh &section) {
+        return section.mesh.empty() && section.mesh.connectivity == Meshing::Connectivity::all();
+    });
+    world.meshes = std::move(meshes);
+}
+
+// Renders frames until every mesh of the test world has been uploaded, as many uploads as fit
+// into the staging ring are issued per frame
+static void upload_test_world(const TestWorld &world, Renderer &renderer, ChunkRenderer &chunk_renderer, const Math::Camera &camera) noexcept
+{
+    usize next {};
+    while (next < world.meshes.size() || chunk_renderer.has_pending_uploads()) {
+        const auto command_buffer = renderer.begin_frame();
+        if (command_buffer == VK_NULL_HANDLE) [[unlikely]]
+            continue;
+
+        while (next < world.meshes.size()) {
+            const auto &section = world.meshes[next];
+            if (!chunk_renderer.update_section(section.chunk, section.section, section.mesh))
+                break;
+            ++next;
+        }
+        chunk_renderer.draw(command_buffer, camera);
+        renderer.end_frame();
+    }
+}
+
+// Measures the CPU time spent culling and recording chunk draws per frame at several render
+// distances, once with CPU culling and once with GPU culling if the device supports it. CPU
+// culling is measured with the cache disabled, with a still camera, whose secondary command
+// buffers never have to be re-recorded, and with a rotating camera.
+static void run_record_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept
+{
+    static constexpr std::array RENDER_DISTANCES {2, 4, 8, 12, 16, 24, 32};
+    static constexpr u32 FRAMES {200};
+    static constexpr float ROTATION_PER_FRAME {0.01f};
+    static constexpr std::array PATH_NAMES {"cpu", "gpu", "gpu-count"};
+
+    struct Result
+    {
+        double record_ms {};
+        double visible_sections {};
+        double recorded_regions {};
+    };
+
+    const auto measure = [&renderer](ChunkRenderer &chunk_renderer, Math::Camera camera, bool cached, float rotation) {
+        Result result {};
+        u32 frames {};
+        while (frames < FRAMES) {
+            if (!cached)
+                chunk_renderer.invalidate_cache();
+
+            const auto command_buffer = renderer.begin_frame();
+            if (command_buffer == VK_NULL_HANDLE) [[unlikely]]
+                continue;
+            chunk_renderer.draw(command_buffer, camera);
+            renderer.end_frame();
+
+            const auto &statistics = chunk_renderer.get_statistics();
+            result.record_ms += statistics.record_ms;
+            result.visible_sections += statistics.visible_sections;
+            result.recorded_regions += statistics.recorded_regions;
+            camera.yaw += rotation;
+            ++frames;
+        }
+        result.record_ms /= FRAMES;
+        result.visible_sections /= FRAMES;
+        result.recorded_regions /= FRAMES;
+        return result;
+    };
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Chunk draw recording on %u worker threads, average over %u frames\n", job_system.thread_count(), FRAMES);
+    fprintf(stdout, "  (with GPU culling, 'sections' counts every section handed to the culling pass)\n");
+    fprintf(stdout, "  distance  path       sections |  uncached ms | still ms  re-recorded | rotating ms  re-recorded\n");
+    for (const auto distance : RENDER_DISTANCES) {
+        TestWorld world {};
+        build_test_world(world, job_system, distance);
+        const Math::Camera camera {.position = {0.0f, 110.0f, 0.0f}, .pitch = -0.35f};
+
+        // the test terrain is a lot noisier than real terrain, large distances outgrow the default arena
+        VkDeviceSize mesh_bytes {};
+        for (const auto &section : world.meshes)
+            mesh_bytes += section.mesh.byte_size() + sizeof(Meshing::PackedVertex);
+        const auto arena_size = std::max(ChunkRenderer::DEFAULT_ARENA_SIZE, mesh_bytes + mesh_bytes / 4);
+
+        for (const auto gpu_culling : {false, true}) {
+            ChunkRenderer chunk_renderer {device, renderer, job_system, gpu_culling, arena_size};
+            if (gpu_culling && chunk_renderer.get_draw_path() == ChunkRenderer::DrawPath::Direct)
+                break;
+            upload_test_world(world, renderer, chunk_renderer, camera);
+
+            // let every frame in flight record its own copy first
+            measure(chunk_renderer, camera, true, 0.0f);
+            const auto uncached = measure(chunk_renderer, camera, false, 0.0f);
+            const auto still = measure(chunk_renderer, camera, true, 0.0f);
+            const auto rotating = measure(chunk_renderer, camera, true, ROTATION_PER_FRAME);
+
+            fprintf(stdout, "  %8d  %-9s  %8.0f | %12.3f | %8.3f  %11.1f | %11.3f  %11.1f\n",
+                    distance, PATH_NAMES[static_cast<usize>(chunk_renderer.get_draw_path())], uncached.visible_sections,
+                    uncached.record_ms, still.record_ms, still.recorded_regions, rotating.record_ms, rotating.recorded_regions);
+        }
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
+
 #ifndef NDEBUG
     static bool has_validation_layer_support() noexcept
     {
@@ -100,3 +584,249 @@ static void init_vulkan(const VkComponents &components,
         return true;  
     }
 #endif
+
+// Pipeline creation is most of the renderer's startup time. The first measurement uses the cache
+// as it was loaded from disk, which is what a launch of the game sees. Note that drivers may also
+// keep their own shader cache (e.g. Mesa), which makes 'cold' faster than a true first launch.
+static void run_pipeline_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept
+{
+    static constexpr u32 ITERATIONS {10};
+    // no meshes are uploaded, the arena only has to exist
+    static constexpr VkDeviceSize ARENA_SIZE {1 << 20};
+
+    auto &cache = device.get_pipeline_cache();
+    const auto measure = [&](bool cold) {
+        double total_ms {};
+        for (u32 i {}; i < ITERATIONS; ++i) {
+            if (cold)
+                cache.reset();
+            const ChunkRenderer chunk_renderer {device, renderer, job_system, true, ARENA_SIZE};
+            total_ms += chunk_renderer.get_pipeline_creation_ms();
+        }
+        return total_ms / ITERATIONS;
+    };
+
+    double startup_ms {};
+    {
+        const ChunkRenderer chunk_renderer {device, renderer, job_system, true, ARENA_SIZE};
+        startup_ms = chunk_renderer.get_pipeline_creation_ms();
+    }
+    const auto cold_ms = measure(true);
+    const auto warm_ms = measure(false);
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Chunk pipeline creation on %u worker threads\n", job_system.thread_count());
+    fprintf(stdout, "  startup (%s): %.3f ms\n", (cache.was_loaded()) ? "cache loaded from disk" : "no cache file", startup_ms);
+    fprintf(stdout, "  cold, average over %u: %.3f ms\n", ITERATIONS, cold_ms);
+    fprintf(stdout, "  warm, average over %u: %.3f ms\n", ITERATIONS, warm_ms);
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
+
+// Measures how many sections are drawn and how much CPU time culling and recording take per frame
+// with occlusion culling on and off, for cameras above and below the surface of the seeded world.
+// The camera rotates, so the walk and the recorded regions change every frame. With GPU culling,
+// occlusion culling is the only way to know the drawn sections on the CPU, without it every
+// section is handed to the culling pass.
+static void run_occlusion_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept
+{
+    static constexpr std::array RENDER_DISTANCES {8, 16};
+    static constexpr u32 FRAMES {200};
+    static constexpr float ROTATION_PER_FRAME {0.01f};
+    static constexpr std::array PATH_NAMES {"cpu", "gpu", "gpu-count"};
+
+    struct Scene
+    {
+        const char *name {};
+        Math::Camera camera {};
+    };
+    static constexpr std::array SCENES {
+        Scene{.name = "surface", .camera = {.position = {0.0f, 110.0f, 0.0f}, .pitch = -0.35f}},
+        Scene{.name = "horizon", .camera = {.position = {0.0f, 90.0f, 0.0f}, .pitch = 0.0f}},
+        Scene{.name = "underground", .camera = {.position = {0.0f, 24.0f, 0.0f}, .pitch = -0.2f}}
+    };
+
+    struct Result
+    {
+        double visible_sections {};
+        double record_ms {};
+        double occlusion_ms {};
+    };
+
+    const auto measure = [&renderer](ChunkRenderer &chunk_renderer, Math::Camera camera) {
+        Result result {};
+        u32 frames {};
+        while (frames < FRAMES) {
+            const auto command_buffer = renderer.begin_frame();
+            if (command_buffer == VK_NULL_HANDLE) [[unlikely]]
+                continue;
+            chunk_renderer.draw(command_buffer, camera);
+            renderer.end_frame();
+
+            const auto &statistics = chunk_renderer.get_statistics();
+            result.visible_sections += statistics.visible_sections;
+            result.record_ms += statistics.record_ms;
+            result.occlusion_ms += statistics.occlusion_ms;
+            camera.yaw += ROTATION_PER_FRAME;
+            ++frames;
+        }
+        result.visible_sections /= FRAMES;
+        result.record_ms /= FRAMES;
+        result.occlusion_ms /= FRAMES;
+        return result;
+    };
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Occlusion culling on seed %llu, %u worker threads, average over %u frames of a rotating camera\n",
+            static_cast<unsigned long long>(WORLD_SEED), job_system.thread_count(), FRAMES);
+    fprintf(stdout, "  (with GPU culling and occlusion culling off, 'sections' counts every section handed to the culling pass)\n");
+    fprintf(stdout, "  distance  scene        path      |  off: sections  record ms |  on: sections  record ms  (walk ms)\n");
+    for (const auto distance : RENDER_DISTANCES) {
+        TestWorld world {};
+        build_test_world(world, job_system, distance);
+
+        VkDeviceSize mesh_bytes {};
+        for (const auto &section : world.meshes)
+            mesh_bytes += section.mesh.byte_size() + sizeof(Meshing::PackedVertex);
+        const auto arena_size = std::max(ChunkRenderer::DEFAULT_ARENA_SIZE, mesh_bytes + mesh_bytes / 4);
+
+        for (const auto gpu_culling : {false, true}) {
+            ChunkRenderer chunk_renderer {device, renderer, job_system, gpu_culling, arena_size};
+            if (gpu_culling && chunk_renderer.get_draw_path() == ChunkRenderer::DrawPath::Direct)
+                break;
+            upload_test_world(world, renderer, chunk_renderer, SCENES[0].camera);
+
+            for (const auto &scene : SCENES) {
+                chunk_renderer.set_occlusion_culling(false);
+                measure(chunk_renderer, scene.camera); // let every frame in flight record its own copy first
+                const auto off = measure(chunk_renderer, scene.camera);
+                chunk_renderer.set_occlusion_culling(true);
+                measure(chunk_renderer, scene.camera);
+                const auto on = measure(chunk_renderer, scene.camera);
+
+                fprintf(stdout, "  %8d  %-11s  %-9s | %14.0f  %9.3f | %13.0f  %9.3f  (%7.3f)\n",
+                        distance, scene.name, PATH_NAMES[static_cast<usize>(chunk_renderer.get_draw_path())],
+                        off.visible_sections, off.record_ms, on.visible_sections, on.record_ms, on.occlusion_ms);
+            }
+        }
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
+
+// Compares the meshes of the seeded world at full detail with the ones meshed at the levels of
+// detail the streamer picks for the camera: vertices, mesh memory and the average time between
+// frames. Frames are not capped, so the frame time includes the GPU once it is the bottleneck.
+// Configurations whose meshes don't fit into half of the device heap are skipped.
+static void run_lod_benchmark(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept
+{
+    static constexpr std::array RENDER_DISTANCES {16, 32, 64};
+    static constexpr float LOD_DISTANCE {8.0f};
+    static constexpr u32 FRAMES {200};
+    static constexpr float ROTATION_PER_FRAME {0.01f};
+
+    const auto measure = [&renderer](ChunkRenderer &chunk_renderer, Math::Camera camera) {
+        u32 frames {};
+        const auto start = std::chrono::steady_clock::now();
+        while (frames < FRAMES) {
+            const auto command_buffer = renderer.begin_frame();
+            if (command_buffer == VK_NULL_HANDLE) [[unlikely]]
+                continue;
+            chunk_renderer.draw(command_buffer, camera);
+            renderer.end_frame();
+            camera.yaw += ROTATION_PER_FRAME;
+            ++frames;
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / FRAMES;
+    };
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Level of detail on seed %llu, full detail up to %.0f chunks, average over %u frames of a rotating camera\n",
+            static_cast<unsigned long long>(WORLD_SEED), static_cast<double>(LOD_DISTANCE), FRAMES);
+    fprintf(stdout, "  distance  lod |     vertices  mesh MiB | frame ms\n");
+    for (const auto distance : RENDER_DISTANCES) {
+        for (const auto lod_distance : {0.0f, LOD_DISTANCE}) {
+            const char *const lod_name = lod_distance > 0.0f ? "on" : "off";
+            Math::Camera camera {.position = {0.0f, 110.0f, 0.0f}, .pitch = -0.35f};
+            camera.far = std::max(camera.far, static_cast<float>(distance * World::Section::SIZE) * 2.0f);
+
+            TestWorld world {};
+            build_test_world(world, job_system, distance, lod_distance, camera.position);
+
+            usize vertices {};
+            VkDeviceSize mesh_bytes {};
+            for (const auto &section : world.meshes) {
+                vertices += section.mesh.vertices.size();
+                mesh_bytes += section.mesh.byte_size() + sizeof(Meshing::PackedVertex);
+            }
+            const auto mesh_mib = static_cast<double>(mesh_bytes) / (1024.0 * 1024.0);
+            const auto arena_size = std::max(ChunkRenderer::DEFAULT_ARENA_SIZE, mesh_bytes + mesh_bytes / 4);
+            if (arena_size > device.get_memory_heap().size / 2) {
+                fprintf(stdout, "  %8d  %-3s | %12zu  %8.1f | does not fit\n", distance, lod_name, vertices, mesh_mib);
+                continue;
+            }
+
+            ChunkRenderer chunk_renderer {device, renderer, job_system, true, arena_size};
+            upload_test_world(world, renderer, chunk_renderer, camera);
+            measure(chunk_renderer, camera); // let every frame in flight record its own copy first
+            const auto frame_ms = measure(chunk_renderer, camera);
+
+            fprintf(stdout, "  %8d  %-3s | %12zu  %8.1f | %8.3f\n", distance, lod_name, vertices, mesh_mib, frame_ms);
+        }
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
+
+// Flies the camera along -z like the game does, but in jumps of a few chunks, and waits at every
+// stop until the streamer has caught up. Chunks left behind are evicted, and the chunk renderer
+// has to let go of their regions as well: the number of regions must not grow with the distance
+// travelled.
+static void run_streaming_check(const Device::LogicalDevice &device, Renderer &renderer, Jobs::JobSystem &job_system) noexcept
+{
+    static constexpr i32 VIEW_DISTANCE {6};
+    static constexpr i32 STOPS {40};
+    static constexpr float STEP {static_cast<float>(VIEW_DISTANCE * World::Section::SIZE)}; // blocks between stops
+    static constexpr u32 MAX_FRAMES_PER_STOP {5000};
+
+    const ChunkStreamer::Settings settings {.view_distance = VIEW_DISTANCE, .lod_distance = 0.0f};
+    World::ChunkStore store {};
+    const Terrain::Generator generator {WORLD_SEED};
+    ChunkRenderer chunk_renderer {device, renderer, job_system, true, settings.vram_budget + settings.vram_budget / 8};
+    ChunkStreamer streamer {store, chunk_renderer, job_system, nullptr, generator, settings};
+
+    Math::Camera camera {.position = {0.0f, 110.0f, 0.0f}, .pitch = -0.35f};
+    usize start_regions {}, max_regions {};
+    u32 frames {};
+    const auto start = std::chrono::steady_clock::now();
+    for (i32 stop {}; stop <= STOPS; ++stop) {
+        for (u32 stop_frames {}; stop_frames < MAX_FRAMES_PER_STOP;) {
+            const auto command_buffer = renderer.begin_frame();
+            if (command_buffer == VK_NULL_HANDLE) [[unlikely]]
+                continue;
+            streamer.update(camera);
+            chunk_renderer.draw(command_buffer, camera);
+            renderer.end_frame();
+            ++stop_frames;
+            ++frames;
+            if (streamer.is_idle())
+                break;
+        }
+
+        if (stop == 0)
+            start_regions = chunk_renderer.region_count();
+        max_regions = std::max(max_regions, chunk_renderer.region_count());
+        camera.position.z -= STEP;
+    }
+    const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Streaming on seed %llu, view distance %d, %d chunks along -z in %u frames (%.1f s)\n",
+            static_cast<unsigned long long>(WORLD_SEED), VIEW_DISTANCE, STOPS * VIEW_DISTANCE, frames, seconds);
+    fprintf(stdout, "  regions: %zu at the start, at most %zu, %zu at the end | %llu chunks evicted\n",
+            start_regions, max_regions, chunk_renderer.region_count(),
+            static_cast<unsigned long long>(streamer.get_statistics().evicted_chunks));
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+
+    // the regions covering the range only differ by how the range lines up with the region grid
+    if (start_regions == 0 || max_regions > start_regions * 2)
+        Logger::fatal_error("The chunk renderer kept {} regions after flying {} chunks, starting with {}",
+                            max_regions, STOPS * VIEW_DISTANCE, start_regions);
+}
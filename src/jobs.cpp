@@ -0,0 +1,213 @@
+#include "mcvk/jobs.hpp"
+#include "mcvk/logger.hpp"
+#include <algorithm>
+#include <string>
+
+namespace Jobs
+{
+    // threads that don't belong to any job system, such as the simulation thread
+    static constexpr u32 FOREIGN_THREAD {~0u};
+    static thread_local u32 current_worker {FOREIGN_THREAD};
+
+    u32 JobSystem::worker_index() noexcept
+    {
+        if (current_worker == FOREIGN_THREAD) [[unlikely]]
+            Logger::fatal_error("Worker index requested on a thread outside the job system");
+        return current_worker;
+    }
+
+    JobSystem::JobSystem(u32 thread_count) noexcept
+    {
+        if (thread_count == 0)
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+        workers.reserve(thread_count);
+        for (u32 i {}; i < thread_count; ++i)
+            workers.push_back(std::make_unique<Worker>());
+
+        // the constructing thread is the main thread
+        current_worker = 0;
+        threads.reserve(thread_count - 1);
+        for (u32 i {1}; i < thread_count; ++i)
+            threads.emplace_back([this, i] { worker_loop(i); });
+
+        Logger::info("Job system started with {} threads", thread_count);
+    }
+
+    JobSystem::~JobSystem() noexcept
+    {
+        {
+            std::lock_guard lock {sleep_mutex};
+            running.store(false, std::memory_order_release);
+        }
+        wake.notify_all();
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    void JobSystem::push(Entry entry, Affinity affinity) noexcept
+    {
+        if (affinity == Affinity::MainThread) {
+            std::lock_guard lock {main_thread_mutex};
+            main_thread_jobs.push_back(std::move(entry));
+            return;
+        }
+
+        // threads that do not belong to this pool share the main thread's deque
+        const auto index = (current_worker < workers.size()) ? current_worker : 0;
+        {
+            std::lock_guard lock {workers[index]->mutex};
+            workers[index]->jobs.push_back(std::move(entry));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+
+        // taking the lock orders this with a worker that has just checked 'queued' and is about to
+        // go to sleep, otherwise the notification could be lost
+        { std::lock_guard lock {sleep_mutex}; }
+        wake.notify_one();
+    }
+
+    bool JobSystem::try_pop(u32 index, Entry &entry) noexcept
+    {
+        if (queued.load(std::memory_order_acquire) == 0)
+            return false;
+
+        // newest job of our own deque first, then the oldest job of everyone else's
+        {
+            auto &own = *workers[index];
+            std::lock_guard lock {own.mutex};
+            if (!own.jobs.empty()) {
+                entry = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        const auto count = static_cast<u32>(workers.size());
+        for (u32 i {1}; i < count; ++i) {
+            auto &victim = *workers[(index + i) % count];
+            std::lock_guard lock {victim.mutex};
+            if (!victim.jobs.empty()) {
+                entry = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool JobSystem::try_pop_main_thread(Entry &entry) noexcept
+    {
+        std::lock_guard lock {main_thread_mutex};
+        if (main_thread_jobs.empty())
+            return false;
+        entry = std::move(main_thread_jobs.front());
+        main_thread_jobs.pop_front();
+        return true;
+    }
+
+    void JobSystem::execute(Entry &entry) noexcept
+    {
+        entry.job();
+
+        auto *counter = entry.counter;
+        if (counter == nullptr)
+            return;
+
+        // the last decrement and taking the dependents happen under the lock, and 'wait' takes the
+        // lock before returning: the counter may be destroyed as soon as it is unlocked
+        std::vector<Counter::Dependent> released {};
+        {
+            std::lock_guard lock {counter->mutex};
+            if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                released.swap(counter->dependents);
+        }
+        for (auto &dependent : released)
+            push({.job = std::move(dependent.job), .counter = dependent.counter}, dependent.affinity);
+    }
+
+    void JobSystem::worker_loop(u32 index) noexcept
+    {
+        current_worker = index;
+
+        Entry entry {};
+        while (running.load(std::memory_order_acquire)) {
+            if (try_pop(index, entry)) {
+                execute(entry);
+                continue;
+            }
+
+            std::unique_lock lock {sleep_mutex};
+            wake.wait(lock, [this] {
+                return queued.load(std::memory_order_acquire) != 0 || !running.load(std::memory_order_acquire);
+            });
+        }
+    }
+
+    void JobSystem::schedule(Job job, Counter *counter, Affinity affinity) noexcept
+    {
+        if (counter != nullptr)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        push({.job = std::move(job), .counter = counter}, affinity);
+    }
+
+    void JobSystem::schedule_after(Counter &dependency, Job job, Counter *counter, Affinity affinity) noexcept
+    {
+        // the job counts as pending from now on, so waiting on 'counter' also covers it while it is
+        // still held back by its dependency
+        if (counter != nullptr)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard lock {dependency.mutex};
+            if (!dependency.is_done()) {
+                dependency.dependents.push_back({.job = std::move(job), .counter = counter, .affinity = affinity});
+                return;
+            }
+        }
+        push({.job = std::move(job), .counter = counter}, affinity);
+    }
+
+    void JobSystem::wait(Counter &counter) noexcept
+    {
+        // A foreign thread has no scratch index of its own and must not run main thread jobs, so
+        // it leaves every job to the workers
+        if (current_worker >= workers.size()) {
+            if (workers.size() == 1) [[unlikely]]
+                Logger::fatal_error("Waiting on jobs outside the job system, which has no worker threads");
+            while (!counter.is_done())
+                std::this_thread::yield();
+            { std::lock_guard lock {counter.mutex}; }
+            return;
+        }
+
+        const auto index = current_worker;
+        Entry entry {};
+        while (!counter.is_done()) {
+            if ((index == 0 && try_pop_main_thread(entry)) || try_pop(index, entry)) {
+                execute(entry);
+                continue;
+            }
+            // the remaining jobs are running on other threads
+            std::this_thread::yield();
+        }
+        // the job that finished last may still hold the lock, wait for it to let go of the counter
+        { std::lock_guard lock {counter.mutex}; }
+    }
+
+    bool JobSystem::run_main_thread_jobs() noexcept
+    {
+        if (current_worker != 0) [[unlikely]]
+            Logger::fatal_error("Main thread jobs can only be run by the main thread");
+
+        bool ran {};
+        Entry entry {};
+        while (try_pop_main_thread(entry)) {
+            execute(entry);
+            ran = true;
+        }
+        return ran;
+    }
+}
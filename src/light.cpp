@@ -0,0 +1,448 @@
+#include "mcvk/light.hpp"
+#include "mcvk/block.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace Lighting
+{
+    namespace
+    {
+        constexpr i32 SIZE {World::Section::SIZE};
+
+        // Indexed like Meshing::Face
+        constexpr std::array<std::array<i32, 3>, 6> OFFSETS {{
+            {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+        }};
+        constexpr usize DOWN {3};
+
+        constexpr u32 shift_of(Channel channel) noexcept { return (channel == Channel::Sky) ? 4 : 0; }
+
+        // The 3x3 chunks around the chunk being lit, which is as far as its light can reach.
+        // Coordinates are relative to the corner of the centre chunk, x and z lie in [MIN, MAX).
+        class Neighbourhood
+        {
+            public:
+                static constexpr i32 MIN {-SIZE};
+                static constexpr i32 MAX {2 * SIZE};
+            private:
+                std::array<World::Chunk *, 9> chunks {};
+            public:
+                Neighbourhood(World::ChunkStore &store, World::ChunkPos centre) noexcept
+                {
+                    for (i32 dz {-1}; dz <= 1; ++dz)
+                        for (i32 dx {-1}; dx <= 1; ++dx)
+                            chunks[static_cast<usize>((dz + 1) * 3 + (dx + 1))] = store.get_chunk({.x = centre.x + dx, .z = centre.z + dz});
+                }
+
+                World::Chunk *centre() const noexcept { return chunks[4]; }
+
+                // nullptr outside of the neighbourhood, outside of the world and in unloaded chunks
+                World::Section *section(i32 x, i32 y, i32 z) const noexcept
+                {
+                    if (x < MIN || x >= MAX || z < MIN || z >= MAX || y < 0 || y >= World::Chunk::HEIGHT)
+                        return nullptr;
+                    auto *chunk = chunks[static_cast<usize>(((z - MIN) / SIZE) * 3 + (x - MIN) / SIZE)];
+                    return (chunk != nullptr) ? &chunk->section(y / SIZE) : nullptr;
+                }
+
+                // highest y below which some section of the neighbourhood holds a block
+                i32 top() const noexcept
+                {
+                    i32 top {};
+                    for (const auto *chunk : chunks) {
+                        if (chunk == nullptr)
+                            continue;
+                        for (i32 i {World::Chunk::SECTION_COUNT - 1}; i >= 0; --i) {
+                            if (!chunk->section(i).is_empty()) {
+                                top = std::max(top, (i + 1) * SIZE);
+                                break;
+                            }
+                        }
+                    }
+                    return top;
+                }
+        };
+
+        // 6 bits each for x and z, 8 for y
+        constexpr u32 pack_position(i32 x, i32 y, i32 z) noexcept
+        {
+            return static_cast<u32>(x - Neighbourhood::MIN) | (static_cast<u32>(z - Neighbourhood::MIN) << 6) | (static_cast<u32>(y) << 12);
+        }
+        constexpr std::array<i32, 3> unpack_position(u32 packed) noexcept
+        {
+            return {static_cast<i32>(packed & 63) + Neighbourhood::MIN, static_cast<i32>(packed >> 12),
+                    static_cast<i32>((packed >> 6) & 63) + Neighbourhood::MIN};
+        }
+
+        u8 level_at(const World::Section &section, i32 x, i32 y, i32 z, u32 shift) noexcept
+        {
+            return static_cast<u8>((section.get_light(x & (SIZE - 1), y & (SIZE - 1), z & (SIZE - 1)) >> shift) & 0x0F);
+        }
+        void set_level(World::Section &section, i32 x, i32 y, i32 z, u32 shift, u8 level) noexcept
+        {
+            const auto lx = x & (SIZE - 1), ly = y & (SIZE - 1), lz = z & (SIZE - 1);
+            const auto packed = section.get_light(lx, ly, lz);
+            section.set_light(lx, ly, lz, static_cast<u8>((packed & ~(0x0F << shift)) | (level << shift)));
+        }
+        bool opaque_at(const World::Section &section, i32 x, i32 y, i32 z) noexcept
+        {
+            return World::is_opaque(section.get(x & (SIZE - 1), y & (SIZE - 1), z & (SIZE - 1)));
+        }
+
+        // The two breadth first passes of one channel within a neighbourhood. Both queues are
+        // drained by the pass that reads them.
+        class Propagator
+        {
+            private:
+                const Neighbourhood &area;
+                std::vector<u32> &additions; // positions to spread light from
+                std::vector<u64> &removals;  // positions in the low, the light they had in the high word
+                Channel channel {};
+                u32 shift {};
+            public:
+                u64 writes {};
+
+                Propagator(const Neighbourhood &neighbourhood, std::vector<u32> &addition_queue, std::vector<u64> &removal_queue) noexcept
+                    : area {neighbourhood}, additions {addition_queue}, removals {removal_queue} {}
+
+                void set_channel(Channel new_channel) noexcept
+                {
+                    channel = new_channel;
+                    shift = shift_of(channel);
+                }
+
+                u8 get(const World::Section &section, i32 x, i32 y, i32 z) const noexcept { return level_at(section, x, y, z, shift); }
+                void set(World::Section &section, i32 x, i32 y, i32 z, u8 level) noexcept
+                {
+                    set_level(section, x, y, z, shift, level);
+                    ++writes;
+                }
+
+                void add(i32 x, i32 y, i32 z) noexcept { additions.push_back(pack_position(x, y, z)); }
+                // Clears the light of a block and queues the light it had for removal
+                void remove(World::Section &section, i32 x, i32 y, i32 z) noexcept
+                {
+                    const auto level = get(section, x, y, z);
+                    if (level == 0)
+                        return;
+                    set(section, x, y, z, 0);
+                    removals.push_back(pack_position(x, y, z) | (u64{level} << 32));
+                }
+                // Lets the light around a block flow into it
+                void add_neighbours(i32 x, i32 y, i32 z) noexcept
+                {
+                    for (const auto &offset : OFFSETS)
+                        if (area.section(x + offset[0], y + offset[1], z + offset[2]) != nullptr)
+                            add(x + offset[0], y + offset[1], z + offset[2]);
+                }
+
+                void spread() noexcept
+                {
+                    for (usize head {}; head < additions.size(); ++head) {
+                        const auto [x, y, z] = unpack_position(additions[head]);
+                        const auto level = get(*area.section(x, y, z), x, y, z);
+                        if (level <= 1)
+                            continue;
+
+                        for (usize face {}; face < OFFSETS.size(); ++face) {
+                            const auto nx = x + OFFSETS[face][0], ny = y + OFFSETS[face][1], nz = z + OFFSETS[face][2];
+                            auto *neighbour = area.section(nx, ny, nz);
+                            if (neighbour == nullptr)
+                                continue;
+
+                            // full sky light travels down without fading
+                            const bool straight_down = channel == Channel::Sky && face == DOWN && level == MAX_LIGHT;
+                            const auto target = static_cast<u8>(straight_down ? level : level - 1);
+                            if (get(*neighbour, nx, ny, nz) >= target || opaque_at(*neighbour, nx, ny, nz))
+                                continue;
+                            set(*neighbour, nx, ny, nz, target);
+                            add(nx, ny, nz);
+                        }
+                    }
+                    additions.clear();
+                }
+
+                // Clears every block whose light came from a removed block. Blocks that are at
+                // least as bright got their light from somewhere else and are queued to spread it
+                // back, so 'spread' has to follow.
+                void unspread() noexcept
+                {
+                    for (usize head {}; head < removals.size(); ++head) {
+                        const auto [x, y, z] = unpack_position(static_cast<u32>(removals[head]));
+                        const auto level = static_cast<u8>(removals[head] >> 32);
+
+                        for (usize face {}; face < OFFSETS.size(); ++face) {
+                            const auto nx = x + OFFSETS[face][0], ny = y + OFFSETS[face][1], nz = z + OFFSETS[face][2];
+                            auto *neighbour = area.section(nx, ny, nz);
+                            if (neighbour == nullptr)
+                                continue;
+                            const auto neighbour_level = get(*neighbour, nx, ny, nz);
+                            if (neighbour_level == 0)
+                                continue;
+
+                            const bool straight_down = channel == Channel::Sky && face == DOWN && level == MAX_LIGHT;
+                            if (neighbour_level >= level && !(straight_down && neighbour_level == MAX_LIGHT)) {
+                                add(nx, ny, nz);
+                                continue;
+                            }
+                            set(*neighbour, nx, ny, nz, 0);
+                            removals.push_back(pack_position(nx, ny, nz) | (u64{neighbour_level} << 32));
+
+                            // light sources inside the cleared area shine again
+                            if (channel == Channel::Block) {
+                                const auto emission = World::emission_of(neighbour->get(nx & (SIZE - 1), ny & (SIZE - 1), nz & (SIZE - 1)));
+                                if (emission > 0) {
+                                    set(*neighbour, nx, ny, nz, emission);
+                                    add(nx, ny, nz);
+                                }
+                            }
+                        }
+                    }
+                    removals.clear();
+                }
+        };
+
+        constexpr auto chunk_order = [](World::ChunkPos a, World::ChunkPos b) {
+            return (a.x != b.x) ? a.x < b.x : a.z < b.z;
+        };
+
+        // Chunks of the same colour are at least 3 chunks apart along x or z, so the chunks around
+        // them never overlap and they can be lit at the same time
+        constexpr usize COLOURS {9};
+        constexpr usize colour_of(World::ChunkPos pos) noexcept
+        {
+            return static_cast<usize>(((pos.x % 3 + 3) % 3) * 3 + (pos.z % 3 + 3) % 3);
+        }
+    }
+
+    u8 get_light(const World::ChunkStore &store, i32 x, i32 y, i32 z) noexcept
+    {
+        if (y >= World::Chunk::HEIGHT)
+            return pack_light(0, MAX_LIGHT);
+        if (y < 0)
+            return 0;
+        const auto *chunk = store.get_chunk({.x = World::to_chunk_coord(x), .z = World::to_chunk_coord(z)});
+        if (chunk == nullptr)
+            return 0;
+        return chunk->section(y / SIZE).get_light(World::to_local_coord(x), y % SIZE, World::to_local_coord(z));
+    }
+
+    void LightEngine::queue_block_change(i32 x, i32 y, i32 z, World::BlockId id) noexcept
+    {
+        if (y < 0 || y >= World::Chunk::HEIGHT)
+            return;
+        changes.push_back({.x = x, .y = y, .z = z, .id = id});
+    }
+
+    void LightEngine::queue_column(World::ChunkPos pos) noexcept
+    {
+        columns.push_back(pos);
+    }
+
+    void LightEngine::light_column(World::ChunkPos pos, Scratch &worker_scratch) noexcept
+    {
+        PROFILE_ZONE("light column");
+        const Neighbourhood area {store, pos};
+        auto *chunk = area.centre();
+        if (chunk == nullptr)
+            return;
+        Propagator propagator {area, worker_scratch.additions, worker_scratch.removals};
+
+        // sections above the highest block are open sky and stay uniform
+        i32 top {};
+        for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+            if (!chunk->section(i).is_empty())
+                top = (i + 1) * SIZE;
+        for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+            chunk->section(i).fill_light((i * SIZE >= top) ? pack_light(0, MAX_LIGHT) : 0);
+
+        propagator.set_channel(Channel::Block);
+        for (i32 i {}; i < top / SIZE; ++i) {
+            auto &section = chunk->section(i);
+            const auto &palette = section.get_palette();
+            if (std::none_of(palette.begin(), palette.end(), [](World::BlockId id) { return World::emission_of(id) > 0; }))
+                continue;
+            for (i32 y {}; y < SIZE; ++y) {
+                for (i32 z {}; z < SIZE; ++z) {
+                    for (i32 x {}; x < SIZE; ++x) {
+                        const auto emission = World::emission_of(section.get(x, y, z));
+                        if (emission > 0) {
+                            propagator.set(section, x, i * SIZE + y, z, emission);
+                            propagator.add(x, i * SIZE + y, z);
+                        }
+                    }
+                }
+            }
+        }
+
+        // light already in the chunks around flows in, from the blocks touching this chunk
+        const auto add_border = [&](u32 shift) {
+            for (const auto &offset : OFFSETS) {
+                if (offset[1] != 0)
+                    continue;
+                const auto fixed = (offset[0] + offset[2] > 0) ? SIZE : -1;
+                for (i32 y {}; y < World::Chunk::HEIGHT; y += SIZE) {
+                    const auto *section = (offset[0] != 0) ? area.section(fixed, y, 0) : area.section(0, y, fixed);
+                    if (section == nullptr || (section->has_uniform_light() && level_at(*section, 0, 0, 0, shift) <= 1))
+                        continue;
+                    for (i32 ly {}; ly < SIZE; ++ly) {
+                        for (i32 along {}; along < SIZE; ++along) {
+                            const auto x = (offset[0] != 0) ? fixed : along;
+                            const auto z = (offset[0] != 0) ? along : fixed;
+                            if (level_at(*section, x, y + ly, z, shift) > 1)
+                                propagator.add(x, y + ly, z);
+                        }
+                    }
+                }
+            }
+        };
+        add_border(shift_of(Channel::Block));
+        propagator.spread();
+
+        // direct sky light down every column, down to the first opaque block
+        propagator.set_channel(Channel::Sky);
+        std::array<i32, SIZE * SIZE> lit_from {}; // lowest y of every column that is directly lit
+        for (i32 z {}; z < SIZE; ++z) {
+            for (i32 x {}; x < SIZE; ++x) {
+                i32 y {top - 1};
+                for (; y >= 0 && !World::is_opaque(chunk->get(x, y, z)); --y)
+                    propagator.set(chunk->section(y / SIZE), x, y, z, MAX_LIGHT);
+                lit_from[static_cast<usize>(z * SIZE + x)] = y + 1;
+            }
+        }
+
+        // directly lit blocks spread sideways where the blocks next to them are darker, which
+        // above 'top' can only be the case in the neighbouring chunks
+        const auto area_top = area.top();
+        for (i32 z {}; z < SIZE; ++z) {
+            for (i32 x {}; x < SIZE; ++x) {
+                const bool border = x == 0 || z == 0 || x == SIZE - 1 || z == SIZE - 1;
+                const auto end = border ? area_top : std::min(area_top, top);
+                for (i32 y {lit_from[static_cast<usize>(z * SIZE + x)]}; y < end; ++y) {
+                    for (const auto &offset : OFFSETS) {
+                        if (offset[1] != 0)
+                            continue;
+                        const auto nx = x + offset[0], nz = z + offset[2];
+                        const auto *neighbour = area.section(nx, y, nz);
+                        if (neighbour != nullptr && propagator.get(*neighbour, nx, y, nz) < MAX_LIGHT - 1 && !opaque_at(*neighbour, nx, y, nz)) {
+                            propagator.add(x, y, z);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        add_border(shift_of(Channel::Sky));
+        propagator.spread();
+
+        for (i32 i {}; i < World::Chunk::SECTION_COUNT; ++i)
+            chunk->section(i).compact_light();
+        worker_scratch.light_writes += propagator.writes;
+    }
+
+    void LightEngine::apply_changes(World::ChunkPos pos, std::span<const BlockChange> chunk_changes, Scratch &worker_scratch) noexcept
+    {
+        PROFILE_ZONE("light block changes");
+        const Neighbourhood area {store, pos};
+        auto *chunk = area.centre();
+        if (chunk == nullptr)
+            return;
+        Propagator propagator {area, worker_scratch.additions, worker_scratch.removals};
+
+        for (const auto &change : chunk_changes) {
+            const auto x = World::to_local_coord(change.x), y = change.y, z = World::to_local_coord(change.z);
+            const auto previous = chunk->get(x, y, z);
+            if (previous == change.id)
+                continue;
+            chunk->set(x, y, z, change.id);
+
+            const bool was_opaque = World::is_opaque(previous), opaque = World::is_opaque(change.id);
+            const auto emission = World::emission_of(change.id);
+            auto &section = chunk->section(y / SIZE);
+
+            if (was_opaque != opaque || World::emission_of(previous) != emission) {
+                propagator.set_channel(Channel::Block);
+                propagator.remove(section, x, y, z);
+                propagator.unspread();
+                if (emission > 0) {
+                    propagator.set(section, x, y, z, emission);
+                    propagator.add(x, y, z);
+                }
+                if (!opaque)
+                    propagator.add_neighbours(x, y, z);
+                propagator.spread();
+            }
+
+            if (was_opaque != opaque) {
+                propagator.set_channel(Channel::Sky);
+                if (opaque) {
+                    propagator.remove(section, x, y, z);
+                    propagator.unspread();
+                } else {
+                    // nothing above the world can be in the way
+                    if (y == World::Chunk::HEIGHT - 1) {
+                        propagator.set(section, x, y, z, MAX_LIGHT);
+                        propagator.add(x, y, z);
+                    }
+                    propagator.add_neighbours(x, y, z);
+                }
+                propagator.spread();
+            }
+        }
+        worker_scratch.light_writes += propagator.writes;
+    }
+
+    void LightEngine::process(Jobs::JobSystem &job_system) noexcept
+    {
+        PROFILE_ZONE("process light");
+        if (scratch.size() < job_system.thread_count())
+            scratch.resize(job_system.thread_count());
+
+        std::sort(columns.begin(), columns.end(), chunk_order);
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+        // changes are grouped by chunk, keeping the order within every chunk
+        std::stable_sort(changes.begin(), changes.end(), [](const BlockChange &a, const BlockChange &b) {
+            return chunk_order({.x = World::to_chunk_coord(a.x), .z = World::to_chunk_coord(a.z)},
+                               {.x = World::to_chunk_coord(b.x), .z = World::to_chunk_coord(b.z)});
+        });
+        struct Batch
+        {
+            World::ChunkPos pos {};
+            std::span<const BlockChange> changes {};
+        };
+        std::vector<Batch> batches {};
+        for (usize begin {}; begin < changes.size();) {
+            const World::ChunkPos pos {.x = World::to_chunk_coord(changes[begin].x), .z = World::to_chunk_coord(changes[begin].z)};
+            auto end = begin + 1;
+            while (end < changes.size() && World::to_chunk_coord(changes[end].x) == pos.x && World::to_chunk_coord(changes[end].z) == pos.z)
+                ++end;
+            batches.push_back({.pos = pos, .changes = std::span {changes}.subspan(begin, end - begin)});
+            begin = end;
+        }
+
+        for (usize colour {}; colour < COLOURS; ++colour) {
+            Jobs::Counter done {};
+            for (const auto pos : columns)
+                if (colour_of(pos) == colour)
+                    job_system.schedule([this, pos] { light_column(pos, scratch[Jobs::JobSystem::worker_index()]); }, &done);
+            job_system.wait(done);
+        }
+        for (usize colour {}; colour < COLOURS; ++colour) {
+            Jobs::Counter done {};
+            for (const auto &batch : batches)
+                if (colour_of(batch.pos) == colour)
+                    job_system.schedule([this, &batch] { apply_changes(batch.pos, batch.changes, scratch[Jobs::JobSystem::worker_index()]); }, &done);
+            job_system.wait(done);
+        }
+
+        statistics.columns += columns.size();
+        statistics.block_changes += changes.size();
+        for (auto &worker_scratch : scratch)
+            statistics.light_writes += std::exchange(worker_scratch.light_writes, 0);
+        columns.clear();
+        changes.clear();
+    }
+}
@@ -1,45 +1,447 @@
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
+#include "mcvk/logger.hpp"
 #include "mcvk/color.h"
 
 
-namespace Logger
+namespace Logger::Detail
 {
+    using Clock = std::chrono::steady_clock;
 
-    static std::mutex mtx;
+    // Every record starts with this, followed by 'payload_size' bytes of encoded arguments. Records
+    // are padded to 8 bytes so headers never straddle the end of the ring.
+    struct RecordHeader
+    {
+        const char *format {};
+        u64 timestamp {}; // nanoseconds since the logger was started
+        u32 size {};      // including the header and padding
+        u16 payload_size {};
+        Level level {};
+    };
 
-    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
-    [[noreturn]] void fatal_error(const char *msg) noexcept
+    // Single producer (the owning thread), single consumer (whoever holds 'drain_mutex')
+    struct Ring
     {
-        // Need a lock here because exit is not thread-safe, it uses a
-        // global variable which is not protected so a race condition can
-        // occur. 
-        std::lock_guard lock {mtx};
-        fprintf(stderr, COLOR_BOLDRED "FATAL ERROR: " COLOR_RESET "%s\n", msg);
-        exit(EXIT_FAILURE);
+        static constexpr usize SIZE {1 << 17};
+        static_assert((SIZE & (SIZE - 1)) == 0, "Ring size has to be a power of two");
+
+        // both only ever increase, the position in 'data' is the value modulo SIZE
+        alignas(64) std::atomic<u64> head {}; // written by the producer
+        alignas(64) std::atomic<u64> tail {}; // written by the consumer
+        alignas(64) std::atomic<bool> in_use {false};
+        u32 thread {};
+        std::array<u8, SIZE> data {};
+
+        void write(u64 position, const void *source, usize size) noexcept
+        {
+            const auto offset = static_cast<usize>(position & (SIZE - 1));
+            const auto first = std::min(size, SIZE - offset);
+            std::memcpy(&data[offset], source, first);
+            std::memcpy(data.data(), static_cast<const u8 *>(source) + first, size - first);
+        }
+
+        void read(u64 position, void *destination, usize size) const noexcept
+        {
+            const auto offset = static_cast<usize>(position & (SIZE - 1));
+            const auto first = std::min(size, SIZE - offset);
+            std::memcpy(destination, &data[offset], first);
+            std::memcpy(static_cast<u8 *>(destination) + first, data.data(), size - first);
+        }
+    };
+
+    struct Entry
+    {
+        u64 timestamp {};
+        Level level {};
+        u32 thread {};
+        std::string text {};
+    };
+
+    static void format_message(const char *format, const u8 *payload, usize payload_size, std::string &out) noexcept
+    {
+        usize position {};
+        for (const char *c {format}; *c != '\0'; ++c) {
+            if (c[0] != '{' || c[1] != '}') {
+                out += *c;
+                continue;
+            }
+            ++c;
+
+            // arguments that did not fit into the payload
+            if (position >= payload_size) {
+                out += "{?}";
+                continue;
+            }
+
+            const auto tag = static_cast<Tag>(payload[position++]);
+            const auto read = [&](auto &value) {
+                std::memcpy(&value, &payload[position], sizeof(value));
+                position += sizeof(value);
+            };
+            std::array<char, 32> number {};
+            const auto append_number = [&](auto value) {
+                const auto result = std::to_chars(number.data(), number.data() + number.size(), value);
+                out.append(number.data(), result.ptr);
+            };
+            switch (tag) {
+                case Tag::Signed: {
+                    i64 value {};
+                    read(value);
+                    append_number(value);
+                    break;
+                }
+                case Tag::Unsigned: {
+                    u64 value {};
+                    read(value);
+                    append_number(value);
+                    break;
+                }
+                case Tag::Float: {
+                    double value {};
+                    read(value);
+                    append_number(value);
+                    break;
+                }
+                case Tag::Bool: {
+                    u8 value {};
+                    read(value);
+                    out += (value != 0) ? "true" : "false";
+                    break;
+                }
+                case Tag::String: {
+                    u16 length {};
+                    read(length);
+                    out.append(reinterpret_cast<const char *>(&payload[position]), length);
+                    position += length;
+                    break;
+                }
+                case Tag::Pointer: {
+                    u64 value {};
+                    read(value);
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+                    std::snprintf(number.data(), number.size(), "0x%llx", static_cast<unsigned long long>(value));
+                    out += number.data();
+                    break;
+                }
+            }
+        }
     }
 
-    void error(const char *msg) noexcept 
+    static void append_json_string(std::string &out, const std::string &text) noexcept
     {
-        fprintf(stderr, COLOR_RED "ERROR: " COLOR_RESET "%s\n", msg);
+        out += '"';
+        for (const char c : text) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<u8>(c) < 0x20) {
+                        std::array<char, 8> escaped {};
+                        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+                        std::snprintf(escaped.data(), escaped.size(), "\\u%04x", static_cast<unsigned>(c));
+                        out += escaped.data();
+                    }
+                    else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
     }
 
-    #ifndef NDEBUG
-        void diagnostic(const char *msg) noexcept
+    class Backend
+    {
+        private:
+            const Clock::time_point start {Clock::now()};
+
+            // only locked to register a ring, or by the consumer to go through them
+            std::mutex rings_mutex {};
+            std::vector<std::unique_ptr<Ring>> rings {};
+
+            // serializes consumers, the logger thread and 'flush' callers
+            std::mutex drain_mutex {};
+            std::vector<Entry> entries {}; // reused, only the first 'entry_count' are current
+            usize entry_count {};
+            std::string json_line {};
+            std::FILE *json_sink {nullptr};
+            std::atomic<bool> console_enabled {true};
+
+            // only 'running' is protected by the mutex, producers set 'wake_requested' without it
+            std::mutex wake_mutex {};
+            std::condition_variable wake_condition {};
+            std::atomic<bool> wake_requested {false};
+            bool running {true};
+            std::thread thread {};
+
+            bool has_sink() const noexcept
+            {
+                return console_enabled.load(std::memory_order_relaxed) || json_sink != nullptr;
+            }
+
+            void drain_ring(Ring &ring) noexcept
+            {
+                auto tail = ring.tail.load(std::memory_order_relaxed);
+                const auto head = ring.head.load(std::memory_order_acquire);
+                // nothing would be written, so there is no point in formatting
+                if (!has_sink()) {
+                    ring.tail.store(head, std::memory_order_release);
+                    return;
+                }
+
+                std::array<u8, MAX_PAYLOAD> payload {};
+                while (tail != head) {
+                    RecordHeader header {};
+                    ring.read(tail, &header, sizeof(header));
+                    ring.read(tail + sizeof(header), payload.data(), header.payload_size);
+
+                    if (entry_count == entries.size())
+                        entries.emplace_back();
+                    auto &entry = entries[entry_count++];
+                    entry.timestamp = header.timestamp;
+                    entry.level = header.level;
+                    entry.thread = ring.thread;
+                    entry.text.clear();
+                    format_message(header.format, payload.data(), header.payload_size, entry.text);
+                    tail += header.size;
+                }
+                ring.tail.store(tail, std::memory_order_release);
+            }
+
+            void write_entries() noexcept
+            {
+                // every ring is in order on its own, merging them by time keeps threads interleaved
+                const auto end = entries.begin() + static_cast<std::ptrdiff_t>(entry_count);
+                std::stable_sort(entries.begin(), end, [](const Entry &one, const Entry &two) {
+                    return one.timestamp < two.timestamp;
+                });
+
+                static constexpr std::array LEVEL_NAMES {"diagnostic", "info", "warning", "error", "fatal"};
+                // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+                for (usize i {}; i < entry_count; ++i) {
+                    const auto &entry = entries[i];
+                    if (console_enabled.load(std::memory_order_relaxed)) {
+                        switch (entry.level) {
+                            case Level::Diagnostic: fprintf(stdout, COLOR_MAGENTA "DIAGNOSTIC: " COLOR_RESET "%s\n", entry.text.c_str()); break;
+                            case Level::Info: fprintf(stdout, COLOR_MAGENTA "INFO: " COLOR_RESET "%s\n", entry.text.c_str()); break;
+                            case Level::Warning: fprintf(stderr, COLOR_YELLOW "WARNING: " COLOR_RESET "%s\n", entry.text.c_str()); break;
+                            case Level::Error: fprintf(stderr, COLOR_RED "ERROR: " COLOR_RESET "%s\n", entry.text.c_str()); break;
+                            case Level::Fatal: fprintf(stderr, COLOR_BOLDRED "FATAL ERROR: " COLOR_RESET "%s\n", entry.text.c_str()); break;
+                        }
+                    }
+                    if (json_sink != nullptr) {
+                        json_line.clear();
+                        json_line += "{\"time_us\":";
+                        json_line += std::to_string((entry.timestamp) / 1000);
+                        json_line += ",\"level\":\"";
+                        json_line += LEVEL_NAMES[static_cast<usize>(entry.level)];
+                        json_line += "\",\"thread\":";
+                        json_line += std::to_string(entry.thread);
+                        json_line += ",\"message\":";
+                        append_json_string(json_line, entry.text);
+                        json_line += "}\n";
+                        std::fwrite(json_line.data(), 1, json_line.size(), json_sink);
+                    }
+                }
+                // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+                entry_count = 0;
+                std::fflush(stdout);
+                if (json_sink != nullptr)
+                    std::fflush(json_sink);
+            }
+
+            void thread_loop() noexcept
+            {
+                static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds{2};
+                while (true) {
+                    {
+                        std::unique_lock lock {wake_mutex};
+                        wake_condition.wait_for(lock, FLUSH_INTERVAL, [this] {
+                            return wake_requested.load(std::memory_order_acquire) || !running;
+                        });
+                        wake_requested.store(false, std::memory_order_relaxed);
+                        if (!running)
+                            break;
+                    }
+                    drain();
+                }
+                drain();
+            }
+        public:
+            Backend() noexcept : thread {[this] { thread_loop(); }} {}
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Backend)
+            ~Backend() noexcept
+            {
+                {
+                    const std::lock_guard lock {wake_mutex};
+                    running = false;
+                }
+                wake_condition.notify_one();
+                thread.join();
+                if (json_sink != nullptr)
+                    std::fclose(json_sink);
+            }
+
+            u64 now() const noexcept
+            {
+                return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+            }
+
+            // Returns a ring no other live thread owns, rings of exited threads are reused
+            Ring &claim_ring() noexcept
+            {
+                const std::lock_guard lock {rings_mutex};
+                for (auto &ring : rings) {
+                    bool expected {false};
+                    if (ring->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                        return *ring;
+                }
+                auto &ring = rings.emplace_back(std::make_unique<Ring>());
+                ring->thread = static_cast<u32>(rings.size() - 1);
+                ring->in_use.store(true, std::memory_order_relaxed);
+                return *ring;
+            }
+
+            // Without the lock, a notification sent just before the logger thread goes to sleep is
+            // lost. The thread then wakes up once the flush interval has passed instead.
+            void wake() noexcept
+            {
+                if (!wake_requested.exchange(true, std::memory_order_release))
+                    wake_condition.notify_one();
+            }
+
+            void drain() noexcept
+            {
+                const std::lock_guard drain_lock {drain_mutex};
+                {
+                    const std::lock_guard lock {rings_mutex};
+                    for (auto &ring : rings)
+                        drain_ring(*ring);
+                }
+                if (entry_count != 0)
+                    write_entries();
+            }
+
+            bool open_json_sink(const char *path) noexcept
+            {
+                const std::lock_guard drain_lock {drain_mutex};
+                if (json_sink != nullptr)
+                    std::fclose(json_sink);
+                json_sink = (path != nullptr) ? std::fopen(path, "w") : nullptr;
+                return json_sink != nullptr;
+            }
+
+            void set_console_enabled(bool enabled) noexcept
+            {
+                console_enabled.store(enabled, std::memory_order_relaxed);
+            }
+    };
+
+    // Messages logged before the backend exists (or after it is gone, from static destructors) are
+    // written synchronously instead
+    static std::atomic<Backend *> active_backend {nullptr};
+
+    static Backend &backend() noexcept
+    {
+        static struct Instance
         {
-            fprintf(stdout, COLOR_MAGENTA "DIAGNOSTIC: " COLOR_RESET "%s\n", msg);
-        }
+            Backend backend {};
+            Instance() noexcept { active_backend.store(&backend, std::memory_order_release); }
+            ~Instance() noexcept { active_backend.store(nullptr, std::memory_order_release); }
+            DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Instance)
+        } instance {};
+        return instance.backend;
+    }
 
-        void info(const char *msg) noexcept
+    // Gives the ring back once its thread exits, whatever is left in it is still written
+    struct LocalRing
+    {
+        Ring *ring {nullptr};
+        LocalRing() noexcept = default;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(LocalRing)
+        ~LocalRing() noexcept
         {
-            fprintf(stdout, COLOR_MAGENTA "INFO: " COLOR_RESET "%s\n", msg);
+            if (ring != nullptr)
+                ring->in_use.store(false, std::memory_order_release);
         }
+    };
+    static thread_local LocalRing local_ring {};
 
-        void warning(const char *msg) noexcept
-        {
-            fprintf(stderr, COLOR_YELLOW "WARNING: " COLOR_RESET "%s\n", msg);
+    void submit(Level level, const char *format, const Payload &payload) noexcept
+    {
+        auto &logger = backend();
+        if (active_backend.load(std::memory_order_acquire) == nullptr) [[unlikely]] {
+            std::string text {};
+            format_message(format, payload.bytes.data(), payload.size, text);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+            fprintf(stderr, "%s\n", text.c_str());
+            return;
+        }
+
+        if (local_ring.ring == nullptr) [[unlikely]]
+            local_ring.ring = &logger.claim_ring();
+        auto &ring = *local_ring.ring;
+
+        static constexpr usize ALIGNMENT {alignof(RecordHeader)};
+        const RecordHeader header {
+            .format = format,
+            .timestamp = logger.now(),
+            .size = static_cast<u32>((sizeof(RecordHeader) + payload.size + ALIGNMENT - 1) & ~(ALIGNMENT - 1)),
+            .payload_size = static_cast<u16>(payload.size),
+            .level = level
+        };
+
+        const auto head = ring.head.load(std::memory_order_relaxed);
+        while (head + header.size - ring.tail.load(std::memory_order_acquire) > Ring::SIZE) [[unlikely]] {
+            logger.wake();
+            std::this_thread::yield();
         }
-    #endif
-    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
-}
\ No newline at end of file
+        ring.write(head, &header, sizeof(header));
+        ring.write(head + sizeof(header), payload.bytes.data(), payload.size);
+        ring.head.store(head + header.size, std::memory_order_release);
+
+        if (level >= Level::Warning)
+            logger.wake();
+    }
+
+    static std::mutex exit_mutex;
+
+    [[noreturn]] void terminate() noexcept
+    {
+        flush();
+        // Need a lock here because exit is not thread-safe, it uses a
+        // global variable which is not protected so a race condition can
+        // occur.
+        const std::lock_guard lock {exit_mutex};
+        exit(EXIT_FAILURE);
+    }
+}
+
+namespace Logger
+{
+    void flush() noexcept
+    {
+        if (Detail::active_backend.load(std::memory_order_acquire) != nullptr)
+            Detail::backend().drain();
+        std::fflush(stderr);
+    }
+
+    bool open_json_sink(const char *path) noexcept
+    {
+        return Detail::backend().open_json_sink(path);
+    }
+
+    void set_console_enabled(bool enabled) noexcept
+    {
+        Detail::backend().set_console_enabled(enabled);
+    }
+}
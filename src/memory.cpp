@@ -0,0 +1,410 @@
+#include "mcvk/memory.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/global.hpp"
+#include <algorithm>
+#include <limits>
+#include <bit>
+#include <string>
+
+namespace Memory
+{
+    static constexpr u32 INVALID_MEMORY_TYPE {std::numeric_limits<u32>::max()};
+
+    static constexpr VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) noexcept
+    {
+        return (alignment <= 1) ? value : (value + alignment - 1) / alignment * alignment;
+    }
+
+    static constexpr usize pool_index(u32 memory_type, ResourceKind kind) noexcept
+    {
+        return static_cast<usize>(memory_type) * 2 + static_cast<usize>(kind);
+    }
+
+    // First-fit search through the free ranges of a block. Alignment padding in front of the
+    // allocation is given back to the free list, so nothing is lost to it permanently.
+    bool sub_allocate(Block &block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset) noexcept
+    {
+        for (auto it = block.free_ranges.begin(); it != block.free_ranges.end(); ++it) {
+            const auto [range_offset, range_size] = *it;
+            const auto aligned = align_up(range_offset, alignment);
+            if (aligned + size > range_offset + range_size)
+                continue;
+
+            block.free_ranges.erase(it);
+            if (aligned > range_offset)
+                block.free_ranges.emplace(range_offset, aligned - range_offset);
+            if (aligned + size < range_offset + range_size)
+                block.free_ranges.emplace(aligned + size, range_offset + range_size - aligned - size);
+
+            block.allocations.emplace(aligned, Range{.size = size, .alignment = alignment});
+            block.used += size;
+            offset = aligned;
+            return true;
+        }
+        return false;
+    }
+
+    void sub_free(Block &block, VkDeviceSize offset) noexcept
+    {
+        const auto allocation = block.allocations.find(offset);
+        if (allocation == block.allocations.end()) [[unlikely]]
+            Logger::fatal_error("Attempted to free memory that was not allocated from this block. Fix this bug");
+
+        auto size = allocation->second.size;
+        block.used -= size;
+        block.allocations.erase(allocation);
+
+        // coalesce with the next range
+        const auto next = block.free_ranges.find(offset + size);
+        if (next != block.free_ranges.end()) {
+            size += next->second;
+            block.free_ranges.erase(next);
+        }
+
+        // coalesce with the previous range
+        auto following = block.free_ranges.lower_bound(offset);
+        if (following != block.free_ranges.begin()) {
+            const auto previous = std::prev(following);
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+        block.free_ranges.emplace(offset, size);
+    }
+
+    Allocator::Allocator(VkDevice ddevice, const VkPhysicalDeviceMemoryProperties &properties, const VkPhysicalDeviceLimits &limits) noexcept :
+        device {ddevice},
+        memory_properties {properties},
+        max_allocation_count {limits.maxMemoryAllocationCount}
+    {
+        Logger::info("Memory allocator created with {} memory types and {} heaps",
+                     memory_properties.memoryTypeCount, memory_properties.memoryHeapCount);
+    }
+
+    Allocator::~Allocator() noexcept
+    {
+        if constexpr (Logger::MIN_LEVEL <= Logger::Level::Info)
+            log_statistics();
+        Logger::info("De-allocating device memory blocks");
+
+        for (auto &pool : pools) {
+            for (auto &block : pool.blocks) {
+                if (!block->allocations.empty())
+                    Logger::warning("Device memory block is being freed while it still has live allocations");
+                destroy_block(*block);
+            }
+            pool.blocks.clear();
+        }
+    }
+
+    u32 Allocator::find_memory_type(u32 type_bits, Usage usage) const noexcept
+    {
+        VkMemoryPropertyFlags required {}, preferred {}, avoided {};
+        switch (usage)
+        {
+            case Usage::GpuOnly:
+                preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+                avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+                break;
+            case Usage::CpuToGpu:
+                required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+                // staging memory should not eat into the (usually small) device local + host visible heap
+                avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+                break;
+            case Usage::GpuToCpu:
+                required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+                preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                break;
+        }
+
+        u32 best_type {INVALID_MEMORY_TYPE};
+        int best_score {std::numeric_limits<int>::min()};
+        for (u32 i {}; i < memory_properties.memoryTypeCount; ++i) {
+            const auto flags = memory_properties.memoryTypes[i].propertyFlags;
+            if (!(type_bits & (1u << i)) || (flags & required) != required)
+                continue;
+
+            // preferring a flag always outweighs avoiding one
+            const int score = 2 * std::popcount(flags & preferred) - std::popcount(flags & avoided);
+            if (score > best_score) {
+                best_score = score;
+                best_type = i;
+            }
+        }
+        return best_type;
+    }
+
+    VkDeviceSize Allocator::preferred_block_size(u32 memory_type) const noexcept
+    {
+        // small heaps (e.g., the 256MiB BAR heap) would be exhausted by a few default sized blocks
+        static constexpr VkDeviceSize SMALL_HEAP_SIZE {1024ull * 1024 * 1024};
+        const auto heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+        return (heap_size <= SMALL_HEAP_SIZE) ? align_up(heap_size / 8, 32) : DEFAULT_BLOCK_SIZE;
+    }
+
+    Block *Allocator::create_block(u32 memory_type, ResourceKind kind, VkDeviceSize size, bool dedicated) noexcept
+    {
+        if (device_allocation_count >= max_allocation_count) [[unlikely]] {
+            Logger::error("Reached maxMemoryAllocationCount, cannot allocate another device memory block");
+            return nullptr;
+        }
+
+        VkMemoryAllocateInfo memory_allocate_info {};
+        memory_allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memory_allocate_info.allocationSize = size;
+        memory_allocate_info.memoryTypeIndex = memory_type;
+
+        VkDeviceMemory memory {VK_NULL_HANDLE};
+        if (vkAllocateMemory(device, &memory_allocate_info, nullptr, &memory) != VK_SUCCESS)
+            return nullptr;
+
+        auto block = std::make_unique<Block>();
+        block->memory = memory;
+        block->size = size;
+        block->memory_type = memory_type;
+        block->kind = kind;
+        block->dedicated = dedicated;
+        block->free_ranges.emplace(0, size);
+
+        // host visible blocks stay mapped for their whole lifetime, mapping is not free
+        if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0x0, &block->mapped) != VK_SUCCESS)
+                Logger::fatal_error("Failed to map host visible device memory block");
+        }
+
+        ++device_allocation_count;
+        auto &heap = heap_statistics[memory_properties.memoryTypes[memory_type].heapIndex];
+        heap.block_bytes += size;
+        ++heap.block_count;
+
+        auto &pool = pools[pool_index(memory_type, kind)];
+        pool.blocks.push_back(std::move(block));
+        return pool.blocks.back().get();
+    }
+
+    void Allocator::destroy_block(Block &block) noexcept
+    {
+        if (block.memory == VK_NULL_HANDLE)
+            return;
+
+        // freeing memory implicitly unmaps it
+        vkFreeMemory(device, block.memory, nullptr);
+        block.memory = VK_NULL_HANDLE;
+        block.mapped = nullptr;
+
+        --device_allocation_count;
+        auto &heap = heap_statistics[memory_properties.memoryTypes[block.memory_type].heapIndex];
+        heap.block_bytes -= block.size;
+        --heap.block_count;
+    }
+
+    Allocation Allocator::allocate_locked(const VkMemoryRequirements &requirements, Usage usage, ResourceKind kind,
+                                          std::span<Block *const> evacuating) noexcept
+    {
+        const bool defragmenting {!evacuating.empty()};
+        const auto memory_type = defragmenting ? evacuating.front()->memory_type : find_memory_type(requirements.memoryTypeBits, usage);
+        if (memory_type == INVALID_MEMORY_TYPE) [[unlikely]] {
+            Logger::error("No memory type satisfies the allocation requirements");
+            return {};
+        }
+
+        auto &pool = pools[pool_index(memory_type, kind)];
+        const auto block_size = preferred_block_size(memory_type);
+
+        const auto make_allocation = [this, &requirements](Block &block, VkDeviceSize offset) {
+            auto &heap = heap_statistics[memory_properties.memoryTypes[block.memory_type].heapIndex];
+            heap.live_bytes += requirements.size;
+            ++heap.allocation_count;
+            return Allocation{
+                .memory = block.memory,
+                .offset = offset,
+                .size = requirements.size,
+                .mapped = (block.mapped != nullptr) ? static_cast<u8 *>(block.mapped) + offset : nullptr,
+                .block = &block
+            };
+        };
+
+        VkDeviceSize offset {};
+
+        // large resources get a block of their own, sub-allocating them would mostly create holes
+        if (requirements.size > block_size / 2) {
+            // the defragmenter never moves into dedicated blocks
+            if (defragmenting)
+                return {};
+            Block *block = create_block(memory_type, kind, requirements.size, true);
+            if (block == nullptr || !sub_allocate(*block, requirements.size, requirements.alignment, offset))
+                return {};
+            return make_allocation(*block, offset);
+        }
+
+        for (auto &block : pool.blocks) {
+            if (block->dedicated || block->size - block->used < requirements.size)
+                continue;
+            if (std::find(evacuating.begin(), evacuating.end(), block.get()) != evacuating.end())
+                continue;
+            if (sub_allocate(*block, requirements.size, requirements.alignment, offset))
+                return make_allocation(*block, offset);
+        }
+
+        // the defragmenter only compacts into existing blocks
+        if (defragmenting)
+            return {};
+
+        // No space left, so allocate a new block. If the driver refuses, retry with smaller blocks
+        // before giving up completely.
+        for (auto size = block_size; size >= requirements.size; size /= 2) {
+            Block *block = create_block(memory_type, kind, size, false);
+            if (block != nullptr) {
+                if (!sub_allocate(*block, requirements.size, requirements.alignment, offset))
+                    return {};
+                return make_allocation(*block, offset);
+            }
+        }
+
+        Logger::error("Out of device memory");
+        return {};
+    }
+
+    void Allocator::free_locked(const Allocation &allocation) noexcept
+    {
+        auto &block = *allocation.block;
+        sub_free(block, allocation.offset);
+
+        auto &heap = heap_statistics[memory_properties.memoryTypes[block.memory_type].heapIndex];
+        heap.live_bytes -= allocation.size;
+        --heap.allocation_count;
+
+        if (block.dedicated) {
+            destroy_block(block);
+            auto &blocks = pools[pool_index(block.memory_type, block.kind)].blocks;
+            std::erase_if(blocks, [&block](const auto &b) { return b.get() == &block; });
+        }
+    }
+
+    Allocation Allocator::allocate(const VkMemoryRequirements &requirements, Usage usage, ResourceKind kind) noexcept
+    {
+        std::lock_guard lock {mtx};
+        return allocate_locked(requirements, usage, kind, {});
+    }
+
+    void Allocator::free(Allocation &allocation) noexcept
+    {
+        if (!allocation.is_valid())
+            return;
+        {
+            std::lock_guard lock {mtx};
+            free_locked(allocation);
+        }
+        allocation = {};
+    }
+
+    Allocation Allocator::allocate_buffer(VkBuffer buffer, Usage usage) noexcept
+    {
+        VkMemoryRequirements requirements {};
+        vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+        auto allocation = allocate(requirements, usage, ResourceKind::Linear);
+        if (allocation.is_valid() && vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+            Logger::fatal_error("Failed to bind buffer memory");
+        return allocation;
+    }
+
+    Allocation Allocator::allocate_image(VkImage image, Usage usage) noexcept
+    {
+        VkMemoryRequirements requirements {};
+        vkGetImageMemoryRequirements(device, image, &requirements);
+
+        auto allocation = allocate(requirements, usage, ResourceKind::Optimal);
+        if (allocation.is_valid() && vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+            Logger::fatal_error("Failed to bind image memory");
+        return allocation;
+    }
+
+    u32 Allocator::defragment(const MoveCallback &move, u32 max_moves) noexcept
+    {
+        std::lock_guard lock {mtx};
+        u32 moves {};
+
+        for (auto &pool : pools) {
+            if (pool.blocks.size() < 2)
+                continue;
+
+            // Start with the emptiest block, it is the cheapest to evacuate. Only blocks that are at
+            // most half full are considered, anything else is not worth the copies. Allocations only
+            // move into the other blocks, so nothing is moved twice or into a block that is emptied
+            // next.
+            std::vector<Block *> candidates {};
+            for (auto &block : pool.blocks)
+                if (!block->dedicated && !block->allocations.empty() && block->used <= block->size / 2)
+                    candidates.push_back(block.get());
+            std::sort(candidates.begin(), candidates.end(), [](const Block *a, const Block *b) { return a->used < b->used; });
+
+            for (Block *block : candidates) {
+                // copy the list, it is modified while moving
+                const std::vector<std::pair<VkDeviceSize, Range>> allocations {block->allocations.begin(), block->allocations.end()};
+                for (const auto &[offset, range] : allocations) {
+                    if (moves >= max_moves)
+                        return moves;
+
+                    const VkMemoryRequirements requirements {
+                        .size = range.size,
+                        .alignment = range.alignment,
+                        .memoryTypeBits = 1u << block->memory_type
+                    };
+                    const auto moved = allocate_locked(requirements, Usage::GpuOnly, block->kind, candidates);
+                    if (!moved.is_valid())
+                        break; // every other block is full as well
+
+                    const Allocation old_allocation {
+                        .memory = block->memory,
+                        .offset = offset,
+                        .size = range.size,
+                        .mapped = (block->mapped != nullptr) ? static_cast<u8 *>(block->mapped) + offset : nullptr,
+                        .block = block
+                    };
+                    if (move(old_allocation, moved)) {
+                        free_locked(old_allocation);
+                        ++moves;
+                    }
+                    else
+                        free_locked(moved);
+                }
+            }
+        }
+        return moves;
+    }
+
+    u32 Allocator::release_empty_blocks() noexcept
+    {
+        std::lock_guard lock {mtx};
+        u32 released {};
+
+        for (auto &pool : pools) {
+            std::erase_if(pool.blocks, [this, &released](auto &block) {
+                if (!block->allocations.empty())
+                    return false;
+                destroy_block(*block);
+                ++released;
+                return true;
+            });
+        }
+        return released;
+    }
+
+    HeapStatistics Allocator::heap_usage(u32 heap_index) const noexcept
+    {
+        std::lock_guard lock {mtx};
+        return heap_statistics.at(heap_index);
+    }
+
+    void Allocator::log_statistics() const noexcept
+    {
+        std::lock_guard lock {mtx};
+        for (u32 i {}; i < memory_properties.memoryHeapCount; ++i) {
+            const auto &heap = heap_statistics[i];
+            Logger::info("Heap {}: {} live bytes in {} allocations, {} bytes in {} blocks", i, heap.live_bytes,
+                         heap.allocation_count, heap.block_bytes, heap.block_count);
+        }
+    }
+}
@@ -0,0 +1,440 @@
+#include "mcvk/mesher.hpp"
+#include "mcvk/block.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace Meshing
+{
+    namespace
+    {
+        // Quads are built in the plane spanned by 'u' (the column inside a mask row) and 'v' (the
+        // mask row), 'axis' is the direction along which the slices are taken
+        struct FaceAxes
+        {
+            std::array<i32, 3> axis {}, u {}, v {};
+            // true if u x v points against the face normal, the corners have to be emitted in
+            // reverse to stay counter-clockwise when seen from outside
+            bool reverse_winding {};
+        };
+
+        constexpr std::array<FaceAxes, FaceCount> FACE_AXES {{
+            {.axis = {1, 0, 0}, .u = {0, 0, 1}, .v = {0, 1, 0}, .reverse_winding = true},
+            {.axis = {1, 0, 0}, .u = {0, 0, 1}, .v = {0, 1, 0}, .reverse_winding = false},
+            {.axis = {0, 1, 0}, .u = {1, 0, 0}, .v = {0, 0, 1}, .reverse_winding = true},
+            {.axis = {0, 1, 0}, .u = {1, 0, 0}, .v = {0, 0, 1}, .reverse_winding = false},
+            {.axis = {0, 0, 1}, .u = {1, 0, 0}, .v = {0, 1, 0}, .reverse_winding = false},
+            {.axis = {0, 0, 1}, .u = {1, 0, 0}, .v = {0, 1, 0}, .reverse_winding = true},
+        }};
+
+        constexpr bool is_positive(Face face) noexcept { return (face & 1) == 0; }
+
+        // layer of the block texture array for every face of every block, indexed by block id
+        static_assert(static_cast<u32>(World::Texture::Count) <= MAX_TEXTURE_LAYERS);
+        constexpr auto FACE_TEXTURES = [] {
+            std::array<std::array<u16, FaceCount>, World::BlockCount> layers {};
+            for (usize block {}; block < layers.size(); ++block) {
+                const auto &properties = World::BLOCK_PROPERTIES[block];
+                for (usize face {}; face < FaceCount; ++face) {
+                    auto texture = properties.side;
+                    if (face == PositiveY)
+                        texture = properties.top;
+                    else if (face == NegativeY)
+                        texture = properties.bottom;
+                    layers[block][face] = static_cast<u16>(texture);
+                }
+            }
+            return layers;
+        }();
+
+        constexpr u32 ROW_MASK {(1u << World::Section::SIZE) - 1};
+    }
+
+    void GreedyMesher::fill_padded(const World::Section &section, const Neighbours &neighbours, u32 lod) noexcept
+    {
+        constexpr i32 SIZE {World::Section::SIZE};
+        constexpr i32 LAST {SIZE - 1};
+
+        // the edges and corners of the border are never filled in, they only matter for the
+        // ambient occlusion of blocks on the section edges and are treated as air
+        padded.fill(World::Air);
+
+        section.unpack(unpacked);
+        if (lod > 0)
+            downsample(lod);
+        for (i32 y {}; y < SIZE; ++y)
+            for (i32 z {}; z < SIZE; ++z)
+                std::copy_n(&unpacked[static_cast<usize>((y * SIZE + z) * SIZE)], SIZE, &padded[padded_index(0, y, z)]);
+
+        if (lod > 0) {
+            fill_coarse_border(neighbours, lod);
+            return;
+        }
+
+        for (i32 a {}; a < SIZE; ++a) {
+            for (i32 b {}; b < SIZE; ++b) {
+                if (neighbours[PositiveX] != nullptr)
+                    padded[padded_index(SIZE, a, b)] = neighbours[PositiveX]->get(0, a, b);
+                if (neighbours[NegativeX] != nullptr)
+                    padded[padded_index(-1, a, b)] = neighbours[NegativeX]->get(LAST, a, b);
+                if (neighbours[PositiveY] != nullptr)
+                    padded[padded_index(a, SIZE, b)] = neighbours[PositiveY]->get(a, 0, b);
+                if (neighbours[NegativeY] != nullptr)
+                    padded[padded_index(a, -1, b)] = neighbours[NegativeY]->get(a, LAST, b);
+                if (neighbours[PositiveZ] != nullptr)
+                    padded[padded_index(a, b, SIZE)] = neighbours[PositiveZ]->get(a, b, 0);
+                if (neighbours[NegativeZ] != nullptr)
+                    padded[padded_index(a, b, -1)] = neighbours[NegativeZ]->get(a, b, LAST);
+            }
+        }
+    }
+
+    // Replaces every cube of 2^lod blocks by its top most non-air block if at least half of the cube
+    // is not air, and by air otherwise. Taking the top block keeps grass and snow on the surface
+    // instead of the dirt and stone below them.
+    void GreedyMesher::downsample(u32 lod) noexcept
+    {
+        constexpr i32 SIZE {World::Section::SIZE};
+        const i32 cube {1 << lod};
+        const i32 half_volume {cube * cube * cube / 2};
+        const auto index = [](i32 x, i32 y, i32 z) { return static_cast<usize>((y * SIZE + z) * SIZE + x); };
+
+        for (i32 cy {}; cy < SIZE; cy += cube) {
+            for (i32 cz {}; cz < SIZE; cz += cube) {
+                for (i32 cx {}; cx < SIZE; cx += cube) {
+                    World::BlockId top {World::Air};
+                    i32 non_air {};
+                    for (i32 y {cy + cube - 1}; y >= cy; --y) {
+                        for (i32 z {cz}; z < cz + cube; ++z) {
+                            for (i32 x {cx}; x < cx + cube; ++x) {
+                                const auto block = unpacked[index(x, y, z)];
+                                if (block == World::Air)
+                                    continue;
+                                ++non_air;
+                                if (top == World::Air)
+                                    top = block;
+                            }
+                        }
+                    }
+
+                    const World::BlockId fill {(non_air >= half_volume) ? top : static_cast<World::BlockId>(World::Air)};
+                    for (i32 y {cy}; y < cy + cube; ++y)
+                        for (i32 z {cz}; z < cz + cube; ++z)
+                            std::fill_n(&unpacked[index(cx, y, z)], cube, fill);
+                }
+            }
+        }
+    }
+
+    // Neighbours are drawn at their own level of detail, which may differ from this section's. A
+    // face on the border is only culled if the neighbour is opaque through the whole cube of
+    // 2^lod blocks next to it, that cube is then solid at every finer level and covers the face.
+    // Coarser neighbours are further from the camera, the faces they could leave open point away
+    // from it.
+    void GreedyMesher::fill_coarse_border(const Neighbours &neighbours, u32 lod) noexcept
+    {
+        constexpr i32 SIZE {World::Section::SIZE};
+        const i32 cube {1 << lod};
+
+        for (u8 f {}; f < FaceCount; ++f) {
+            const auto face = static_cast<Face>(f);
+            const auto *neighbour = neighbours[face];
+            if (neighbour == nullptr)
+                continue;
+            const bool uniform {neighbour->is_uniform()};
+            if (uniform && !World::is_opaque(neighbour->get_palette()[0]))
+                continue;
+            if (!uniform)
+                neighbour->unpack(neighbour_blocks);
+
+            const usize axis {face / 2u};
+            const usize u_axis {(axis + 1) % 3};
+            const usize v_axis {(axis + 2) % 3};
+            const i32 depth_start {is_positive(face) ? 0 : SIZE - cube};
+            const i32 border {is_positive(face) ? SIZE : -1};
+
+            for (i32 u {}; u < SIZE; u += cube) {
+                for (i32 v {}; v < SIZE; v += cube) {
+                    bool opaque {true};
+                    for (i32 d {depth_start}; !uniform && opaque && d < depth_start + cube; ++d) {
+                        for (i32 du {}; opaque && du < cube; ++du) {
+                            for (i32 dv {}; opaque && dv < cube; ++dv) {
+                                std::array<i32, 3> p {};
+                                p[axis] = d;
+                                p[u_axis] = u + du;
+                                p[v_axis] = v + dv;
+                                opaque = World::is_opaque(neighbour_blocks[static_cast<usize>((p[1] * SIZE + p[2]) * SIZE + p[0])]);
+                            }
+                        }
+                    }
+                    if (!opaque)
+                        continue;
+
+                    // any opaque block culls the faces next to it the same way
+                    for (i32 du {}; du < cube; ++du) {
+                        for (i32 dv {}; dv < cube; ++dv) {
+                            std::array<i32, 3> p {};
+                            p[axis] = border;
+                            p[u_axis] = u + du;
+                            p[v_axis] = v + dv;
+                            padded[padded_index(p[0], p[1], p[2])] = World::Stone;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void GreedyMesher::build_masks() noexcept
+    {
+        non_air_x.fill(0);
+        opaque_x.fill(0);
+        non_air_z.fill(0);
+        opaque_z.fill(0);
+
+        usize i {};
+        for (i32 y {-1}; y < PADDED_SIZE - 1; ++y) {
+            for (i32 z {-1}; z < PADDED_SIZE - 1; ++z) {
+                u32 non_air {}, opaque {};
+                for (i32 x {-1}; x < PADDED_SIZE - 1; ++x, ++i) {
+                    const auto id = padded[i];
+                    const u32 bit_x {1u << (x + 1)};
+                    const u32 bit_z {1u << (z + 1)};
+                    if (id != World::Air) {
+                        non_air |= bit_x;
+                        non_air_z[row_index(y, x)] |= bit_z;
+                    }
+                    if (World::is_opaque(id)) {
+                        opaque |= bit_x;
+                        opaque_z[row_index(y, x)] |= bit_z;
+                    }
+                }
+                non_air_x[row_index(y, z)] = non_air;
+                opaque_x[row_index(y, z)] = opaque;
+            }
+        }
+    }
+
+    void GreedyMesher::mesh_face(Face face, bool ambient_occlusion, MeshData &out) noexcept
+    {
+        constexpr i32 SIZE {World::Section::SIZE};
+        const auto &axes = FACE_AXES[face];
+        const auto positive = is_positive(face);
+        const i32 step {positive ? 1 : -1};
+
+        // offsets inside 'padded' for a step along each direction
+        constexpr auto offset_of = [](const std::array<i32, 3> &d) {
+            return d[0] + d[2] * PADDED_SIZE + d[1] * PADDED_SIZE * PADDED_SIZE;
+        };
+        const i32 normal_offset {offset_of(axes.axis) * step};
+        const i32 u_offset {offset_of(axes.u)};
+        const i32 v_offset {offset_of(axes.v)};
+
+        const auto opaque_at = [this](i32 index) -> u32 {
+            return World::is_opaque(padded[static_cast<usize>(index)]) ? 1 : 0;
+        };
+        // 3 is fully lit, 0 is a corner enclosed by two opaque blocks
+        const auto corner_ao = [&](i32 layer, i32 du, i32 dv) -> u32 {
+            const auto side_u = opaque_at(layer + du);
+            const auto side_v = opaque_at(layer + dv);
+            if (side_u != 0 && side_v != 0)
+                return 0;
+            return 3 - (side_u + side_v + opaque_at(layer + du + dv));
+        };
+
+        std::array<u16, SIZE> rows {};
+        std::array<u32, SIZE * SIZE> keys {};
+
+        for (i32 s {}; s < SIZE; ++s) {
+            // faces of blocks in this slice that are not hidden by an opaque block in front of them
+            u32 any {};
+            for (i32 r {}; r < SIZE; ++r) {
+                u32 visible {};
+                if (axes.axis[0] != 0)
+                    visible = non_air_z[row_index(r, s)] & ~opaque_z[row_index(r, s + step)];
+                else if (axes.axis[1] != 0)
+                    visible = non_air_x[row_index(s, r)] & ~opaque_x[row_index(s + step, r)];
+                else
+                    visible = non_air_x[row_index(r, s)] & ~opaque_x[row_index(r, s + step)];
+                rows[static_cast<usize>(r)] = static_cast<u16>((visible >> 1) & ROW_MASK);
+                any |= visible;
+            }
+            if (any == 0)
+                continue;
+
+            // merge key of every visible face: the block and the ambient occlusion of its corners
+            for (i32 r {}; r < SIZE; ++r) {
+                auto &row = rows[static_cast<usize>(r)];
+                for (u32 bits {row}; bits != 0; bits &= bits - 1) {
+                    const auto c = std::countr_zero(bits);
+                    const auto cell = static_cast<i32>(padded_index(
+                        axes.axis[0] * s + axes.u[0] * c + axes.v[0] * r,
+                        axes.axis[1] * s + axes.u[1] * c + axes.v[1] * r,
+                        axes.axis[2] * s + axes.u[2] * c + axes.v[2] * r));
+                    const auto block = padded[static_cast<usize>(cell)];
+                    const auto layer = cell + normal_offset;
+
+                    // touching transparent blocks of the same kind (water, glass) share no faces
+                    if (padded[static_cast<usize>(layer)] == block) {
+                        row &= static_cast<u16>(~(1u << c));
+                        continue;
+                    }
+
+                    const u32 ao = !ambient_occlusion ? 0xFF : corner_ao(layer, -u_offset, -v_offset)
+                                                             | (corner_ao(layer, u_offset, -v_offset) << 2)
+                                                             | (corner_ao(layer, u_offset, v_offset) << 4)
+                                                             | (corner_ao(layer, -u_offset, v_offset) << 6);
+                    keys[static_cast<usize>(r * SIZE + c)] = (static_cast<u32>(block) << 8) | ao;
+                }
+            }
+
+            const auto plane = static_cast<u32>(s + (positive ? 1 : 0));
+            for (i32 r {}; r < SIZE; ++r) {
+                while (rows[static_cast<usize>(r)] != 0) {
+                    const auto row = rows[static_cast<usize>(r)];
+                    const auto c = std::countr_zero(row);
+                    const auto key = keys[static_cast<usize>(r * SIZE + c)];
+
+                    i32 width {1};
+                    while (c + width < SIZE && ((row >> (c + width)) & 1) != 0 && keys[static_cast<usize>(r * SIZE + c + width)] == key)
+                        ++width;
+                    const auto run = static_cast<u16>(((1u << width) - 1) << c);
+
+                    i32 height {1};
+                    while (r + height < SIZE) {
+                        if ((rows[static_cast<usize>(r + height)] & run) != run)
+                            break;
+                        const auto *first = &keys[static_cast<usize>((r + height) * SIZE + c)];
+                        if (!std::all_of(first, first + width, [key](u32 k) { return k == key; }))
+                            break;
+                        ++height;
+                    }
+                    for (i32 h {}; h < height; ++h)
+                        rows[static_cast<usize>(r + h)] &= static_cast<u16>(~run);
+
+                    const auto block = static_cast<World::BlockId>(key >> 8);
+                    const u32 texture {(block < World::BlockCount) ? FACE_TEXTURES[block][face] : 0u};
+
+                    // corners in (u, v) order: (0, 0), (1, 0), (1, 1), (0, 1)
+                    std::array<PackedVertex, 4> corners {};
+                    std::array<u32, 4> corner_ao_values {};
+                    for (u32 corner {}; corner < 4; ++corner) {
+                        const auto index = axes.reverse_winding ? ((4 - corner) & 3) : corner;
+                        const auto u = static_cast<u32>(c + ((index == 1 || index == 2) ? width : 0));
+                        const auto v = static_cast<u32>(r + ((index >= 2) ? height : 0));
+                        const auto ao = (key >> (index * 2)) & 3;
+                        corner_ao_values[corner] = ao;
+                        corners[corner] = PackedVertex::pack(
+                            static_cast<u32>(axes.axis[0]) * plane + static_cast<u32>(axes.u[0]) * u + static_cast<u32>(axes.v[0]) * v,
+                            static_cast<u32>(axes.axis[1]) * plane + static_cast<u32>(axes.u[1]) * u + static_cast<u32>(axes.v[1]) * v,
+                            static_cast<u32>(axes.axis[2]) * plane + static_cast<u32>(axes.u[2]) * u + static_cast<u32>(axes.v[2]) * v,
+                            face, ao, texture);
+                    }
+
+                    // Split along the diagonal that keeps the ambient occlusion gradient symmetric. The
+                    // shared indices split from the first corner, starting at the second flips it.
+                    const u32 first {(corner_ao_values[0] + corner_ao_values[2] > corner_ao_values[1] + corner_ao_values[3]) ? 1u : 0u};
+                    for (u32 corner {}; corner < 4; ++corner)
+                        out.vertices.push_back(corners[(first + corner) & 3]);
+                }
+            }
+        }
+    }
+
+    Connectivity GreedyMesher::connect_faces() noexcept
+    {
+        constexpr i32 SIZE {World::Section::SIZE};
+        constexpr i32 LAST {SIZE - 1};
+
+        // opaque blocks start out filled, so fills only ever spread through the others
+        for (usize i {}; i < unpacked.size(); ++i)
+            filled[i] = World::is_opaque(unpacked[i]);
+
+        Connectivity connectivity {};
+        for (usize start {}; start < unpacked.size(); ++start) {
+            if (filled[start])
+                continue;
+
+            u8 touched {};
+            usize top {};
+            const auto push = [this, &top](usize i) {
+                if (!filled[i]) {
+                    filled[i] = true;
+                    fill_stack[top++] = static_cast<u16>(i);
+                }
+            };
+            push(start);
+            while (top > 0) {
+                const usize i {fill_stack[--top]};
+                const auto x = static_cast<i32>(i % SIZE);
+                const auto z = static_cast<i32>((i / SIZE) % SIZE);
+                const auto y = static_cast<i32>(i / (SIZE * SIZE));
+                touched |= static_cast<u8>(((x == LAST) << PositiveX) | ((x == 0) << NegativeX) | ((y == LAST) << PositiveY) |
+                                           ((y == 0) << NegativeY) | ((z == LAST) << PositiveZ) | ((z == 0) << NegativeZ));
+                if (x < LAST)
+                    push(i + 1);
+                if (x > 0)
+                    push(i - 1);
+                if (z < LAST)
+                    push(i + SIZE);
+                if (z > 0)
+                    push(i - SIZE);
+                if (y < LAST)
+                    push(i + SIZE * SIZE);
+                if (y > 0)
+                    push(i - SIZE * SIZE);
+            }
+
+            for (u8 face {}; face < FaceCount; ++face)
+                if (((touched >> face) & 1) != 0)
+                    connectivity.faces[face] |= touched;
+        }
+        return connectivity;
+    }
+
+    void GreedyMesher::mesh(const World::Section &section, const Neighbours &neighbours, MeshData &out, u32 lod) noexcept
+    {
+        PROFILE_ZONE("mesh section");
+        out.clear();
+        // sections emptied block by block keep their palette until compacted, but are as open as air
+        if (section.is_empty()) {
+            out.connectivity = Connectivity::all();
+            return;
+        }
+        if (section.is_uniform())
+            out.connectivity = World::is_opaque(section.get_palette()[0]) ? Connectivity{} : Connectivity::all();
+
+        // sections buried in solid terrain are common and have no visible faces at all
+        const auto is_solid = [](const World::Section *s) {
+            return s != nullptr && s->is_uniform() && World::is_opaque(s->get_palette()[0]);
+        };
+        if (is_solid(&section) && std::all_of(neighbours.begin(), neighbours.end(), is_solid))
+            return;
+
+        fill_padded(section, neighbours, lod);
+        if (!section.is_uniform())
+            out.connectivity = connect_faces();
+        build_masks();
+        // ambient occlusion is computed per block, it would split the quads of coarse cubes
+        for (u8 face {}; face < FaceCount; ++face)
+            mesh_face(static_cast<Face>(face), lod == 0, out);
+    }
+
+    Neighbours neighbours_of(const World::ChunkStore &store, World::ChunkPos pos, i32 section_index) noexcept
+    {
+        Neighbours neighbours {};
+        const auto section_of = [&store](World::ChunkPos chunk_pos, i32 index) -> const World::Section * {
+            if (index < 0 || index >= World::Chunk::SECTION_COUNT)
+                return nullptr;
+            const auto *chunk = store.get_chunk(chunk_pos);
+            return (chunk != nullptr) ? &chunk->section(index) : nullptr;
+        };
+        neighbours[PositiveX] = section_of({.x = pos.x + 1, .z = pos.z}, section_index);
+        neighbours[NegativeX] = section_of({.x = pos.x - 1, .z = pos.z}, section_index);
+        neighbours[PositiveY] = section_of(pos, section_index + 1);
+        neighbours[NegativeY] = section_of(pos, section_index - 1);
+        neighbours[PositiveZ] = section_of({.x = pos.x, .z = pos.z + 1}, section_index);
+        neighbours[NegativeZ] = section_of({.x = pos.x, .z = pos.z - 1}, section_index);
+        return neighbours;
+    }
+}
@@ -0,0 +1,186 @@
+#include "mcvk/pipelinecache.hpp"
+#include "mcvk/checksum.hpp"
+#include "mcvk/logger.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// Prepended to the data returned by 'vkGetPipelineCacheData'. Drivers only check their own header,
+// so a file that was truncated or corrupted after it has been written could otherwise still be
+// handed to them.
+struct FileHeader
+{
+    u32 magic {};
+    u32 version {};
+    u64 data_size {};
+    u64 checksum {};
+};
+
+static constexpr u32 FILE_MAGIC {0x4d43504c}; // "MCPL"
+static constexpr u32 FILE_VERSION {1};
+
+// Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, which every implementation has to put at the
+// start of its cache data
+static constexpr usize VK_HEADER_SIZE {16 + VK_UUID_SIZE};
+
+PipelineCache::PipelineCache(VkDevice ddevice, const VkPhysicalDeviceProperties &pproperties) noexcept :
+    device {ddevice},
+    properties {pproperties}
+{
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    // e.g. "cache/pipelines_10de_2484_<uuid>.bin"
+    std::array<char, 2 * VK_UUID_SIZE + 1> uuid {};
+    for (usize i {}; i < VK_UUID_SIZE; ++i)
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+        std::snprintf(&uuid[2 * i], 3, "%02x", properties.pipelineCacheUUID[i]);
+    std::array<char, 32> ids {};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    std::snprintf(ids.data(), ids.size(), "%04x_%04x_", properties.vendorID, properties.deviceID);
+    path = std::string{CACHE_DIRECTORY} + "pipelines_" + ids.data() + uuid.data() + ".bin";
+
+    const auto data = read_file();
+    loaded = !data.empty();
+    create(data);
+
+    if (loaded)
+        Logger::info("Loaded pipeline cache {} ({} bytes) in {} ms", path, data.size(),
+                     std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    else
+        Logger::info("No usable pipeline cache found, pipelines are compiled from scratch");
+}
+
+PipelineCache::~PipelineCache() noexcept
+{
+    if (cache == VK_NULL_HANDLE)
+        return;
+    save();
+    vkDestroyPipelineCache(device, cache, nullptr);
+}
+
+void PipelineCache::create(const std::vector<u8> &initial_data) noexcept
+{
+    VkPipelineCacheCreateInfo pipeline_cache_create_info {};
+    pipeline_cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipeline_cache_create_info.initialDataSize = initial_data.size();
+    pipeline_cache_create_info.pInitialData = initial_data.data();
+
+    if (vkCreatePipelineCache(device, &pipeline_cache_create_info, nullptr, &cache) == VK_SUCCESS)
+        return;
+
+    // the driver is free to reject data it does not like, even with a valid header
+    if (!initial_data.empty()) {
+        Logger::error("Pipeline cache data was rejected by the driver, starting with an empty cache");
+        loaded = false;
+        pipeline_cache_create_info.initialDataSize = 0;
+        pipeline_cache_create_info.pInitialData = nullptr;
+        if (vkCreatePipelineCache(device, &pipeline_cache_create_info, nullptr, &cache) == VK_SUCCESS)
+            return;
+    }
+    Logger::fatal_error("Failed to create pipeline cache");
+}
+
+// Returns nothing if there is no cache file or it can't be used
+std::vector<u8> PipelineCache::read_file() const noexcept
+{
+    std::ifstream file {path, std::ios::binary | std::ios::ate};
+    if (!file)
+        return {};
+
+    const auto size = static_cast<usize>(file.tellg());
+    FileHeader header {};
+    if (size < sizeof(header))
+        return {};
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    const auto reject = [this](const char *reason) {
+        Logger::error("Ignoring pipeline cache {}: {}", path, reason);
+        return std::vector<u8>{};
+    };
+
+    if (header.magic != FILE_MAGIC || header.version != FILE_VERSION)
+        return reject("unknown file format");
+    if (header.data_size != size - sizeof(header))
+        return reject("file is truncated");
+
+    std::vector<u8> data (static_cast<usize>(header.data_size));
+    file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file)
+        return reject("failed to read file");
+    if (Checksum::fnv1a(data) != header.checksum)
+        return reject("file is corrupted");
+    if (!is_compatible(data))
+        return reject("written by another device or driver version");
+    return data;
+}
+
+bool PipelineCache::is_compatible(const std::vector<u8> &data) const noexcept
+{
+    if (data.size() < VK_HEADER_SIZE)
+        return false;
+
+    u32 header_size {}, header_version {}, vendor_id {}, device_id {};
+    std::memcpy(&header_size, data.data(), sizeof(u32));
+    std::memcpy(&header_version, data.data() + 4, sizeof(u32));
+    std::memcpy(&vendor_id, data.data() + 8, sizeof(u32));
+    std::memcpy(&device_id, data.data() + 12, sizeof(u32));
+
+    return header_size >= VK_HEADER_SIZE && header_size <= data.size() &&
+           header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vendor_id == properties.vendorID && device_id == properties.deviceID &&
+           std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::save() const noexcept
+{
+    usize size {};
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0)
+        return false;
+    std::vector<u8> data (size);
+    // VK_INCOMPLETE if a pipeline was added in between, it is simply saved the next time
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+        return false;
+    data.resize(size);
+
+    const FileHeader header {
+        .magic = FILE_MAGIC,
+        .version = FILE_VERSION,
+        .data_size = data.size(),
+        .checksum = Checksum::fnv1a(data)
+    };
+
+    std::error_code error {};
+    std::filesystem::create_directories(CACHE_DIRECTORY, error);
+
+    // written next to the old file and renamed over it afterwards, which replaces it atomically
+    const auto temporary_path = path + ".tmp";
+    {
+        std::ofstream file {temporary_path, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            Logger::error("Failed to write pipeline cache {}", temporary_path);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary_path, path, error);
+    if (error) {
+        Logger::error("Failed to replace pipeline cache {}", path);
+        return false;
+    }
+
+    Logger::info("Saved pipeline cache {} ({} bytes)", path, data.size());
+    return true;
+}
+
+void PipelineCache::reset() noexcept
+{
+    vkDestroyPipelineCache(device, cache, nullptr);
+    create({});
+}
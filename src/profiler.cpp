@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "mcvk/profiler.hpp"
+#include "mcvk/logger.hpp"
+
+namespace Profiler
+{
+    struct Event
+    {
+        const char *name {};
+        i64 start_ns {};
+        i64 end_ns {};
+        u32 thread {};
+    };
+
+    // Zones are buffered per thread until the next 'begin_frame' moves them into the frame. Without
+    // frames (e.g. the CPU benchmarks) they would pile up forever, so anything beyond this is dropped.
+    static constexpr usize MAX_PENDING_EVENTS {1 << 16};
+
+    struct ThreadEvents
+    {
+        std::mutex mutex {}; // only contended while the events are collected
+        std::vector<Event> events {};
+        usize dropped {};
+        u32 index {};
+        bool in_use {false}; // guarded by 'State::threads_mutex'
+    };
+
+    struct Frame
+    {
+        u64 index {};
+        i64 start_ns {};
+        i64 end_ns {}; // zero while the frame is running
+        std::vector<Event> cpu_events {};
+        std::vector<GpuZone> gpu_zones {};
+    };
+
+    struct State
+    {
+        std::mutex threads_mutex {};
+        std::vector<std::unique_ptr<ThreadEvents>> threads {};
+        std::vector<Frame> frames {std::vector<Frame>(HISTORY_FRAMES)};
+        u64 frame {};
+        usize dropped {};
+    };
+
+    static State &state() noexcept
+    {
+        static State state {};
+        return state;
+    }
+
+    // Threads that exited hand their buffer to the next thread that starts recording. Pending events
+    // are still collected, they just share a track with the new thread in the trace.
+    static ThreadEvents &claim_thread() noexcept
+    {
+        auto &s = state();
+        const std::lock_guard lock {s.threads_mutex};
+        for (auto &thread : s.threads) {
+            if (!thread->in_use) {
+                thread->in_use = true;
+                return *thread;
+            }
+        }
+        auto &thread = s.threads.emplace_back(std::make_unique<ThreadEvents>());
+        // track 0 of the trace is used for the frames themselves
+        thread->index = static_cast<u32>(s.threads.size());
+        thread->in_use = true;
+        return *thread;
+    }
+
+    struct LocalThread
+    {
+        ThreadEvents *events {&claim_thread()};
+
+        LocalThread() noexcept = default;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(LocalThread)
+        ~LocalThread() noexcept
+        {
+            const std::lock_guard lock {state().threads_mutex};
+            events->in_use = false;
+        }
+    };
+
+    void record_zone(const char *name, i64 start_ns, i64 end_ns) noexcept
+    {
+        static thread_local LocalThread local {};
+        auto &thread = *local.events;
+
+        const std::lock_guard lock {thread.mutex};
+        if (thread.events.size() >= MAX_PENDING_EVENTS) [[unlikely]] {
+            ++thread.dropped;
+            return;
+        }
+        thread.events.push_back({.name = name, .start_ns = start_ns, .end_ns = end_ns, .thread = thread.index});
+    }
+
+    static void collect_events(State &s, std::vector<Event> &out) noexcept
+    {
+        const std::lock_guard lock {s.threads_mutex};
+        for (auto &thread : s.threads) {
+            const std::lock_guard thread_lock {thread->mutex};
+            out.insert(out.end(), thread->events.begin(), thread->events.end());
+            thread->events.clear();
+            s.dropped += thread->dropped;
+            thread->dropped = 0;
+        }
+    }
+
+    void begin_frame() noexcept
+    {
+        auto &s = state();
+        const auto now = now_ns();
+        if (s.frame > 0) {
+            auto &previous = s.frames[s.frame % HISTORY_FRAMES];
+            previous.end_ns = now;
+            collect_events(s, previous.cpu_events);
+        }
+
+        ++s.frame;
+        // the vectors keep their capacity, so a full history no longer allocates
+        auto &frame = s.frames[s.frame % HISTORY_FRAMES];
+        frame.index = s.frame;
+        frame.start_ns = now;
+        frame.end_ns = 0;
+        frame.cpu_events.clear();
+        frame.gpu_zones.clear();
+    }
+
+    u64 current_frame() noexcept
+    {
+        return state().frame;
+    }
+
+    void record_gpu_frame(u64 frame, std::span<const GpuZone> zones) noexcept
+    {
+        auto &record = state().frames[frame % HISTORY_FRAMES];
+        if (record.index != frame)
+            return;
+        record.gpu_zones.assign(zones.begin(), zones.end());
+    }
+
+    // Calls 'function' with every frame in the history that has ended, oldest first
+    template<typename F>
+    static void for_each_finished_frame(const State &s, F function) noexcept
+    {
+        const auto first = (s.frame > HISTORY_FRAMES) ? s.frame - HISTORY_FRAMES + 1 : 1;
+        for (auto index = first; index <= s.frame; ++index) {
+            const auto &frame = s.frames[index % HISTORY_FRAMES];
+            if (frame.index == index && frame.end_ns != 0)
+                function(frame);
+        }
+    }
+
+    static void write_json_name(std::FILE *file, const char *name) noexcept
+    {
+        std::fputc('"', file);
+        for (const char *c {name}; *c != '\0'; ++c) {
+            if (*c == '"' || *c == '\\')
+                std::fputc('\\', file);
+            std::fputc(*c, file);
+        }
+        std::fputc('"', file);
+    }
+
+    // Chrome's trace event format, every zone becomes a complete ('X') event. CPU zones are in
+    // process 1 with one track per thread, GPU zones in process 2. The GPU clock is not calibrated
+    // against the CPU clock, a frame's GPU zones start at the time the frame was submitted, so they
+    // line up with the CPU side only as far as the GPU starts working right away.
+    bool write_trace(const char *path) noexcept
+    {
+        auto &s = state();
+        std::FILE *file = std::fopen(path, "w");
+        if (file == nullptr) {
+            Logger::error("Failed to open {} for writing the profiler trace", path);
+            return false;
+        }
+
+        // timestamps are written relative to the earliest one, in microseconds
+        i64 base_ns {std::numeric_limits<i64>::max()};
+        for_each_finished_frame(s, [&base_ns](const Frame &frame) {
+            base_ns = std::min(base_ns, frame.start_ns);
+            for (const auto &event : frame.cpu_events)
+                base_ns = std::min(base_ns, event.start_ns);
+        });
+        const auto us = [base_ns](i64 ns) { return static_cast<double>(ns - base_ns) / 1000.0; };
+
+        u32 thread_count {};
+        {
+            const std::lock_guard lock {s.threads_mutex};
+            thread_count = static_cast<u32>(s.threads.size());
+        }
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(file, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"CPU\"}},\n");
+        fprintf(file, "{\"ph\":\"M\",\"pid\":2,\"name\":\"process_name\",\"args\":{\"name\":\"GPU\"}},\n");
+        fprintf(file, "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"thread_name\",\"args\":{\"name\":\"frames\"}}");
+        for (u32 thread {1}; thread <= thread_count; ++thread)
+            fprintf(file, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"thread %u\"}}", thread, thread);
+
+        for_each_finished_frame(s, [&](const Frame &frame) {
+            fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":0,\"name\":\"frame %llu\",\"ts\":%.3f,\"dur\":%.3f}",
+                    static_cast<unsigned long long>(frame.index), us(frame.start_ns), us(frame.end_ns) - us(frame.start_ns));
+            for (const auto &event : frame.cpu_events) {
+                fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"name\":", event.thread);
+                write_json_name(file, event.name);
+                fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}", us(event.start_ns), us(event.end_ns) - us(event.start_ns));
+            }
+            for (const auto &zone : frame.gpu_zones) {
+                fprintf(file, ",\n{\"ph\":\"X\",\"pid\":2,\"tid\":0,\"name\":");
+                write_json_name(file, zone.name);
+                fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}", us(zone.start_ns), us(zone.end_ns) - us(zone.start_ns));
+            }
+        });
+        fprintf(file, "\n]}\n");
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+
+        const auto written = std::ferror(file) == 0;
+        std::fclose(file);
+        if (!written)
+            Logger::error("Failed to write the profiler trace to {}", path);
+        else
+            Logger::info("Wrote profiler trace to {}", path);
+        return written;
+    }
+
+    // Zones are summed per frame first, so a zone opened for every region of a frame shows the
+    // total time spent in it. Frames without the zone are left out of its percentiles.
+    void report() noexcept
+    {
+        const auto &s = state();
+
+        struct Series
+        {
+            std::vector<double> values {};
+
+            void sort() noexcept { std::sort(values.begin(), values.end()); }
+            double percentile(double p) const noexcept
+            {
+                return values[static_cast<usize>(p * static_cast<double>(values.size() - 1))];
+            }
+        };
+
+        Series cpu_frames {}, gpu_frames {};
+        std::map<std::string_view, Series> cpu_zones {}, gpu_zones {};
+        std::map<std::string_view, double> frame_totals {};
+
+        const auto add_totals = [&frame_totals](std::map<std::string_view, Series> &zones) {
+            for (const auto &[name, total] : frame_totals)
+                zones[name].values.push_back(total);
+            frame_totals.clear();
+        };
+
+        for_each_finished_frame(s, [&](const Frame &frame) {
+            cpu_frames.values.push_back(static_cast<double>(frame.end_ns - frame.start_ns) / 1e6);
+            for (const auto &event : frame.cpu_events)
+                frame_totals[event.name] += static_cast<double>(event.end_ns - event.start_ns) / 1e6;
+            add_totals(cpu_zones);
+
+            if (frame.gpu_zones.empty())
+                return;
+            gpu_frames.values.push_back(static_cast<double>(frame.gpu_zones.front().end_ns - frame.gpu_zones.front().start_ns) / 1e6);
+            // the first zone is the frame itself
+            for (auto zone = frame.gpu_zones.begin() + 1; zone != frame.gpu_zones.end(); ++zone)
+                frame_totals[zone->name] += static_cast<double>(zone->end_ns - zone->start_ns) / 1e6;
+            add_totals(gpu_zones);
+        });
+
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        if (cpu_frames.values.empty()) {
+            fprintf(stdout, "Profiler: no frames recorded\n");
+            return;
+        }
+        fprintf(stdout, "Profile of the last %zu frames (times in ms)\n", cpu_frames.values.size());
+        fprintf(stdout, "         %-24s %7s %9s %9s %9s\n", "zone", "frames", "p50", "p99", "max");
+
+        const auto print = [](const char *side, std::string_view name, Series &series) {
+            series.sort();
+            fprintf(stdout, "  %-5s  %-24.*s %7zu %9.3f %9.3f %9.3f\n", side, static_cast<int>(name.size()), name.data(),
+                    series.values.size(), series.percentile(0.5), series.percentile(0.99), series.values.back());
+        };
+        print("cpu", "frame", cpu_frames);
+        for (auto &[name, series] : cpu_zones)
+            print("cpu", name, series);
+        if (!gpu_frames.values.empty()) {
+            print("gpu", "frame", gpu_frames);
+            for (auto &[name, series] : gpu_zones)
+                print("gpu", name, series);
+        }
+        if (s.dropped > 0)
+            fprintf(stdout, "  %zu zones were dropped because no frames were started\n", s.dropped);
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+}
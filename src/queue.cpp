@@ -13,10 +13,7 @@ namespace Queue
         vkGetPhysicalDeviceQueueFamilyProperties(device.self, &count, nullptr);
 
         if (count == 0) {
-            if constexpr (Global::IS_DEBUG_BUILD) {
-                const auto count_zero_msg = std::string{device.name} + " does not support any queue families";
-                Logger::info(count_zero_msg.c_str());
-            }
+            Logger::info("{} does not support any queue families", device.name);
             return;
         }
         std::vector<VkQueueFamilyProperties> families (count);
@@ -26,33 +23,39 @@ namespace Queue
             VkBool32 device_has_presentation_queue = false;
             vkGetPhysicalDeviceSurfaceSupportKHR(device.self, i, surface, &device_has_presentation_queue);
 
-            if (device_has_presentation_queue) {
+            if (device_has_presentation_queue && !(this->flags&IndexFlags::PresentationQueueCompatible)) {
                 this->set(FamilyIndex::PresentationQueueIndex, i);
-                if constexpr (Global::IS_DEBUG_BUILD) {
-                    const auto msg = std::string{"Found presentation queue family on device "} + device.name;
-                    Logger::info(msg.c_str());
-                }
+                Logger::info("Found presentation queue family on device {}", device.name);
                 this->flags = static_cast<IndexFlags>(this->flags|IndexFlags::PresentationQueueCompatible);
             }
             
 
-            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && !(this->flags&IndexFlags::GraphicsQueueCompatible)) {
                 this->set(FamilyIndex::GraphicsQueueIndex, i);
-                if constexpr (Global::IS_DEBUG_BUILD) {
-                    const auto msg = std::string{"Found graphics queue family on device "} + device.name;
-                    Logger::info(msg.c_str());
-                }
+                Logger::info("Found graphics queue family on device {}", device.name);
                 this->flags = static_cast<IndexFlags>(this->flags|IndexFlags::GraphicsQueueCompatible);
             }
 
-            if (this->is_complete()) {
-                if constexpr (Global::IS_DEBUG_BUILD) {
-                    const auto msg = std::string{"Found all required queue families on device "} + device.name;
-                    Logger::info(msg.c_str());
-                }
-                break;
+            // A family with the transfer bit but neither graphics nor compute is backed by the copy
+            // engines, so uploads there never compete with rendering. It is usually one of the last
+            // families, which is why the loop no longer stops once graphics and presentation are found.
+            const auto is_transfer_only = (families[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                                          !(families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT|VK_QUEUE_COMPUTE_BIT));
+            if (is_transfer_only && !(this->flags&IndexFlags::TransferQueueCompatible)) {
+                this->set(FamilyIndex::TransferQueueIndex, i);
+                Logger::info("Found dedicated transfer queue family on device {}", device.name);
+                this->flags = static_cast<IndexFlags>(this->flags|IndexFlags::TransferQueueCompatible);
             }
         }
+
+        // graphics queues always support transfers, even if they don't advertise it
+        if ((this->flags&IndexFlags::GraphicsQueueCompatible) && !(this->flags&IndexFlags::TransferQueueCompatible)) {
+            this->set(FamilyIndex::TransferQueueIndex, this->get(FamilyIndex::GraphicsQueueIndex));
+            this->flags = static_cast<IndexFlags>(this->flags|IndexFlags::TransferQueueCompatible);
+        }
+
+        if (this->is_complete())
+            Logger::info("Found all required queue families on device {}", device.name);
     }
 
 }
@@ -0,0 +1,435 @@
+#include "mcvk/region.hpp"
+#include "mcvk/checksum.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <shared_mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace World
+{
+    // A region file is a RegionHeader and a ChunkLocation for every chunk of the region, followed by
+    // the chunk records, each starting at a sector boundary. A record is a RecordHeader and for
+    // every section a SectionHeader, the palette and the packed indices. Everything is stored in
+    // the native byte order, which is little endian on everything this runs on.
+    struct RegionHeader
+    {
+        u32 magic {};
+        u32 version {};
+    };
+
+    struct ChunkLocation
+    {
+        u32 sector {};
+        u32 sector_count {}; // zero if the chunk is not stored
+    };
+
+    struct RecordHeader
+    {
+        u32 size {}; // bytes following the header
+        u32 padding {};
+        u64 checksum {};
+    };
+
+    struct SectionHeader
+    {
+        u32 data_size {}; // the packed indices are stored uncompressed if this equals their size
+        u32 palette_size {};
+        u16 non_air_count {};
+        u8 bits {};
+        u8 padding {};
+    };
+
+    static constexpr u32 FILE_MAGIC {0x4d435247}; // "MCRG"
+    static constexpr u32 FILE_VERSION {1};
+    static constexpr usize SECTOR_SIZE {256};
+    static constexpr usize CHUNKS_PER_REGION {RegionStorage::REGION_SIZE * RegionStorage::REGION_SIZE};
+    static constexpr usize HEADER_SECTORS {
+        (sizeof(RegionHeader) + CHUNKS_PER_REGION * sizeof(ChunkLocation) + SECTOR_SIZE - 1) / SECTOR_SIZE
+    };
+
+    struct RegionStorage::Region
+    {
+        std::shared_mutex mutex {}; // shared while reading chunks, exclusive while writing them
+        std::string path {};
+        int file {-1};
+        const u8 *mapping {};
+        usize mapped_size {};
+        u32 sector_count {}; // size of the file
+        std::array<ChunkLocation, CHUNKS_PER_REGION> locations {};
+
+        Region() noexcept = default;
+        DELETE_NON_COPYABLE_NON_MOVABLE_DEFAULT(Region)
+        ~Region() noexcept
+        {
+            unmap();
+            if (file >= 0)
+                close(file);
+        }
+
+        void unmap() noexcept
+        {
+            if (mapping != nullptr)
+                munmap(const_cast<u8 *>(mapping), mapped_size);
+            mapping = nullptr;
+            mapped_size = 0;
+        }
+
+        bool map() noexcept
+        {
+            unmap();
+            const auto size = sector_count * SECTOR_SIZE;
+            auto *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+            if (address == MAP_FAILED) {
+                Logger::error("Failed to map region file {}: {}", path, std::strerror(errno));
+                return false;
+            }
+            mapping = static_cast<const u8 *>(address);
+            mapped_size = size;
+            return true;
+        }
+    };
+
+    static ChunkPos region_of(ChunkPos pos) noexcept
+    {
+        return {.x = pos.x >> 5, .z = pos.z >> 5};
+    }
+
+    static usize location_index(ChunkPos pos) noexcept
+    {
+        constexpr i32 MASK {RegionStorage::REGION_SIZE - 1};
+        return static_cast<usize>((pos.z & MASK) * RegionStorage::REGION_SIZE + (pos.x & MASK));
+    }
+
+    static bool write_all(int file, const void *data, usize size, usize offset) noexcept
+    {
+        const auto *bytes = static_cast<const u8 *>(data);
+        while (size > 0) {
+            const auto written = pwrite(file, bytes, size, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= static_cast<usize>(written);
+            offset += static_cast<usize>(written);
+        }
+        return true;
+    }
+
+    static bool read_all(int file, void *data, usize size, usize offset) noexcept
+    {
+        auto *bytes = static_cast<u8 *>(data);
+        while (size > 0) {
+            const auto count = pread(file, bytes, size, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            bytes += count;
+            size -= static_cast<usize>(count);
+            offset += static_cast<usize>(count);
+        }
+        return true;
+    }
+
+    // Serializes every section of 'chunk' into 'out', which is overwritten
+    static void write_record(const Chunk &chunk, i32 level, std::vector<u8> &out) noexcept
+    {
+        out.resize(sizeof(RecordHeader));
+        for (i32 i {}; i < Chunk::SECTION_COUNT; ++i) {
+            const auto &section = chunk.section(i);
+            const auto &palette = section.get_palette();
+            const auto indices = std::as_bytes(std::span{section.get_data()});
+
+            const auto header_offset = out.size();
+            out.resize(out.size() + sizeof(SectionHeader));
+            const auto *palette_bytes = reinterpret_cast<const u8 *>(palette.data());
+            out.insert(out.end(), palette_bytes, palette_bytes + palette.size() * sizeof(BlockId));
+
+            const auto data_offset = out.size();
+            const std::span raw {reinterpret_cast<const u8 *>(indices.data()), indices.size()};
+            if (!raw.empty() && Compression::compress(raw, out, level) >= raw.size()) {
+                out.resize(data_offset);
+                out.insert(out.end(), raw.begin(), raw.end());
+            }
+
+            const SectionHeader header {
+                .data_size = static_cast<u32>(out.size() - data_offset),
+                .palette_size = static_cast<u32>(palette.size()),
+                .non_air_count = section.get_non_air_count(),
+                .bits = section.bits_per_block()
+            };
+            std::memcpy(out.data() + header_offset, &header, sizeof(header));
+        }
+
+        const auto payload = std::span{out}.subspan(sizeof(RecordHeader));
+        const RecordHeader header {.size = static_cast<u32>(payload.size()), .checksum = Checksum::fnv1a(payload)};
+        std::memcpy(out.data(), &header, sizeof(header));
+    }
+
+    // Decodes a record into 'chunk', returns why it failed or nullptr
+    static const char *read_record(std::span<const u8> record, Chunk &chunk) noexcept
+    {
+        RecordHeader header {};
+        if (record.size() < sizeof(header))
+            return "record is truncated";
+        std::memcpy(&header, record.data(), sizeof(header));
+        if (header.size > record.size() - sizeof(header))
+            return "record is truncated";
+        const auto payload = record.subspan(sizeof(header), header.size);
+        if (Checksum::fnv1a(payload) != header.checksum)
+            return "record is corrupted";
+
+        // the palette in the file is not necessarily aligned
+        thread_local std::vector<BlockId> palette {};
+        usize position {};
+        for (i32 i {}; i < Chunk::SECTION_COUNT; ++i) {
+            SectionHeader section {};
+            if (payload.size() - position < sizeof(section))
+                return "section is truncated";
+            std::memcpy(&section, payload.data() + position, sizeof(section));
+            position += sizeof(section);
+
+            // the checksum matched, so this only rejects files written by something else
+            const auto valid_bits = section.bits == 0 || section.bits == 1 || section.bits == 2 ||
+                                    section.bits == 4 || section.bits == 8 || section.bits == 16;
+            const auto valid_palette = (section.bits == 0) ? section.palette_size == 1 :
+                                       (section.palette_size >= 1 && section.palette_size <= (1u << section.bits));
+            if (!valid_bits || !valid_palette || section.non_air_count > Section::VOLUME)
+                return "invalid section";
+
+            const auto palette_bytes = usize{section.palette_size} * sizeof(BlockId);
+            if (payload.size() - position < palette_bytes)
+                return "section is truncated";
+            palette.resize(section.palette_size);
+            std::memcpy(palette.data(), payload.data() + position, palette_bytes);
+            position += palette_bytes;
+
+            if (payload.size() - position < section.data_size)
+                return "section is truncated";
+            const auto stored = payload.subspan(position, section.data_size);
+            position += section.data_size;
+
+            const auto indices = chunk.section(i).assign_packed(palette, section.bits, section.non_air_count);
+            const std::span out {reinterpret_cast<u8 *>(indices.data()), indices.size_bytes()};
+            if (stored.size() == out.size())
+                std::copy_n(stored.data(), stored.size(), out.data());
+            else if (!Compression::decompress(stored, out))
+                return "section data is corrupted";
+        }
+        return nullptr;
+    }
+
+    RegionStorage::RegionStorage(std::string ddirectory, i32 level) noexcept :
+        directory {std::move(ddirectory)},
+        compression_level {level}
+    {
+        std::error_code error {};
+        std::filesystem::create_directories(directory, error);
+        if (error)
+            Logger::error("Failed to create world directory {}", directory);
+        writer = std::thread {&RegionStorage::write_loop, this};
+    }
+
+    RegionStorage::~RegionStorage() noexcept
+    {
+        {
+            const std::lock_guard lock {queue_mutex};
+            running = false;
+        }
+        queue_changed.notify_one();
+        writer.join();
+    }
+
+    RegionStorage::Region *RegionStorage::get_region(ChunkPos region_pos, bool create) noexcept
+    {
+        const std::lock_guard lock {regions_mutex};
+        if (const auto found = regions.find(region_pos); found != regions.end())
+            return found->second.get();
+
+        auto region = std::make_unique<Region>();
+        region->path = (std::filesystem::path{directory} /
+                        ("r." + std::to_string(region_pos.x) + "." + std::to_string(region_pos.z) + ".mcr")).string();
+        region->file = open(region->path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+        if (region->file < 0) {
+            if (errno != ENOENT)
+                Logger::error("Failed to open region file {}: {}", region->path, std::strerror(errno));
+            return nullptr;
+        }
+
+        struct stat info {};
+        fstat(region->file, &info);
+        const auto file_size = static_cast<usize>(info.st_size);
+        bool valid {};
+        if (file_size == 0) {
+            const RegionHeader header {.magic = FILE_MAGIC, .version = FILE_VERSION};
+            valid = ftruncate(region->file, static_cast<off_t>(HEADER_SECTORS * SECTOR_SIZE)) == 0 &&
+                    write_all(region->file, &header, sizeof(header), 0);
+            region->sector_count = HEADER_SECTORS;
+        }
+        else {
+            RegionHeader header {};
+            valid = file_size >= HEADER_SECTORS * SECTOR_SIZE &&
+                    read_all(region->file, &header, sizeof(header), 0) &&
+                    header.magic == FILE_MAGIC && header.version == FILE_VERSION &&
+                    read_all(region->file, region->locations.data(), sizeof(region->locations), sizeof(header));
+            // a partial sector at the end of a truncated file is left out, reading a chunk from it
+            // could touch mapped pages past the end of the file; new chunks are written over it
+            region->sector_count = static_cast<u32>(file_size / SECTOR_SIZE);
+
+            // a chunk pointing outside of the file is as good as missing
+            for (auto &location : region->locations)
+                if (location.sector < HEADER_SECTORS || location.sector + u64{location.sector_count} > region->sector_count)
+                    location = {};
+        }
+
+        // Invalid files are remembered, so the error is only reported once. Nothing is written to
+        // them, the file is left as it is for inspection.
+        if (!valid || !region->map()) {
+            Logger::error("Region file {} is not a valid region file, its chunks are neither loaded nor saved", region->path);
+            regions.emplace(region_pos, nullptr);
+            return nullptr;
+        }
+        return regions.emplace(region_pos, std::move(region)).first->second.get();
+    }
+
+    bool RegionStorage::load(Chunk &chunk) noexcept
+    {
+        PROFILE_ZONE("load chunk");
+        const auto pos = chunk.get_pos();
+
+        // a chunk that has not been written yet is newer than anything on disk
+        {
+            const std::lock_guard lock {queue_mutex};
+            for (const auto *pending : {&queued, &writing}) {
+                if (const auto found = pending->find(pos); found != pending->end()) {
+                    chunk = *found->second;
+                    return true;
+                }
+            }
+        }
+
+        auto *region = get_region(region_of(pos), false);
+        if (region == nullptr)
+            return false;
+
+        const std::shared_lock lock {region->mutex};
+        const auto location = region->locations[location_index(pos)];
+        if (location.sector_count == 0)
+            return false;
+
+        const auto offset = usize{location.sector} * SECTOR_SIZE;
+        const auto size = usize{location.sector_count} * SECTOR_SIZE;
+        const auto *error = (offset + size <= region->mapped_size) ?
+                            read_record({region->mapping + offset, size}, chunk) : "record is outside of the file";
+        if (error != nullptr) {
+            Logger::error("Failed to load chunk ({}, {}) from {}: {}", pos.x, pos.z, region->path, error);
+            return false;
+        }
+        return true;
+    }
+
+    void RegionStorage::save(const Chunk &chunk) noexcept
+    {
+        PROFILE_ZONE("save chunk");
+        auto copy = std::make_unique<Chunk>(chunk);
+        {
+            const std::lock_guard lock {queue_mutex};
+            queued.insert_or_assign(chunk.get_pos(), std::move(copy));
+        }
+        queue_changed.notify_one();
+    }
+
+    void RegionStorage::flush() noexcept
+    {
+        std::unique_lock lock {queue_mutex};
+        batch_written.wait(lock, [this] { return queued.empty() && writing.empty(); });
+    }
+
+    usize RegionStorage::disk_usage() const noexcept
+    {
+        usize bytes {};
+        std::error_code error {};
+        for (std::filesystem::directory_iterator it {directory, error}, end {}; !error && it != end; it.increment(error))
+            if (it->path().extension() == ".mcr")
+                bytes += static_cast<usize>(it->file_size(error));
+        return bytes;
+    }
+
+    void RegionStorage::write_loop() noexcept
+    {
+        std::unique_lock lock {queue_mutex};
+        while (true) {
+            queue_changed.wait(lock, [this] { return !queued.empty() || !running; });
+            if (queued.empty())
+                return;
+
+            // everything queued so far is written as one batch, grouped by region
+            writing.swap(queued);
+            lock.unlock();
+
+            std::unordered_map<ChunkPos, std::vector<const Chunk *>, ChunkPosHash> batches {};
+            for (const auto &[pos, chunk] : writing)
+                batches[region_of(pos)].push_back(chunk.get());
+            for (const auto &[region_pos, chunks] : batches)
+                write_region(region_pos, chunks);
+
+            lock.lock();
+            writing.clear();
+            batch_written.notify_all();
+        }
+    }
+
+    void RegionStorage::write_region(ChunkPos region_pos, const std::vector<const Chunk *> &chunks) noexcept
+    {
+        PROFILE_ZONE("write region");
+        auto *region = get_region(region_pos, true);
+        if (region == nullptr) {
+            Logger::error("Failed to save {} chunks of region ({}, {})", chunks.size(), region_pos.x, region_pos.z);
+            return;
+        }
+
+        // everything is compressed up front, so loads from this region are only blocked by the writes
+        std::vector<std::vector<u8>> records (chunks.size());
+        for (usize i {}; i < chunks.size(); ++i)
+            write_record(*chunks[i], compression_level, records[i]);
+
+        const std::unique_lock lock {region->mutex};
+        const auto previous_sector_count = region->sector_count;
+        for (usize i {}; i < chunks.size(); ++i) {
+            const auto sectors = static_cast<u32>((records[i].size() + SECTOR_SIZE - 1) / SECTOR_SIZE);
+
+            // Chunks are rewritten in place if they still fit, otherwise they move to the end of the
+            // file. The sectors they leave behind are not reused.
+            auto &location = region->locations[location_index(chunks[i]->get_pos())];
+            if (location.sector_count < sectors) {
+                location.sector = region->sector_count;
+                region->sector_count += sectors;
+            }
+            location.sector_count = sectors;
+
+            if (!write_all(region->file, records[i].data(), records[i].size(), usize{location.sector} * SECTOR_SIZE)) {
+                Logger::error("Failed to write chunk ({}, {}) to {}: {}", chunks[i]->get_pos().x, chunks[i]->get_pos().z,
+                              region->path, std::strerror(errno));
+                location = {};
+            }
+        }
+
+        // the table is written after the chunks, so a crash in between never makes it point past
+        // the end of the file. A chunk torn while being rewritten in place fails its checksum.
+        const auto file_size = usize{region->sector_count} * SECTOR_SIZE;
+        if ((region->sector_count != previous_sector_count && ftruncate(region->file, static_cast<off_t>(file_size)) != 0) ||
+            !write_all(region->file, region->locations.data(), sizeof(region->locations), sizeof(RegionHeader)))
+            Logger::error("Failed to update the chunk table of {}: {}", region->path, std::strerror(errno));
+        if (region->sector_count != previous_sector_count)
+            region->map();
+    }
+}
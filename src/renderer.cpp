@@ -0,0 +1,443 @@
+#include "mcvk/renderer.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/global.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <utility>
+
+Renderer::Renderer(const Device::LogicalDevice &logical_device,
+                   Swapchain &sswapchain,
+                   u32 frames_in_flight) noexcept :
+    device {logical_device.get()},
+    graphics_queue {logical_device.get_graphics_queue()},
+    presentation_queue {logical_device.get_presentation_queue()},
+    allocator {&logical_device.get_allocator()},
+    swapchain {&sswapchain},
+    uploader {logical_device},
+    profiler {logical_device, std::clamp(frames_in_flight, 1u, MAX_FRAMES_IN_FLIGHT)},
+    framebuffer_extent {sswapchain.get_extent()}
+{
+    if (device == VK_NULL_HANDLE || swapchain->get() == VK_NULL_HANDLE)
+        Logger::fatal_error("Renderer requires a logical device and swapchain to be created first");
+
+    frames.resize(std::clamp(frames_in_flight, 1u, MAX_FRAMES_IN_FLIGHT));
+
+    create_render_pass();
+    create_depth_buffer();
+    create_framebuffers();
+    create_frames(logical_device.get_queue_family_indices().get(Queue::GraphicsQueueIndex));
+    create_image_semaphores();
+
+    Logger::info("Renderer created with {} frames in flight", frames.size());
+}
+
+Renderer::~Renderer() noexcept
+{
+    if (device == VK_NULL_HANDLE)
+        return;
+
+    // nothing can be destroyed while the GPU may still be using it
+    vkDeviceWaitIdle(device);
+
+    Logger::info("De-allocating renderer");
+
+    for (auto &frame : frames) {
+        vkDestroyFence(device, frame.in_flight, nullptr);
+        vkDestroySemaphore(device, frame.image_available, nullptr);
+        // destroying the pool frees its command buffers too
+        vkDestroyCommandPool(device, frame.command_pool, nullptr);
+    }
+    for (auto &retired : retired_swapchains)
+        destroy_retired(retired);
+    for (auto semaphore : render_finished)
+        vkDestroySemaphore(device, semaphore, nullptr);
+    for (auto framebuffer : framebuffers)
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    destroy_depth_buffer();
+    vkDestroyRenderPass(device, render_pass, nullptr);
+    device = VK_NULL_HANDLE;
+}
+
+void Renderer::create_render_pass() noexcept
+{
+    VkAttachmentDescription color_attachment {};
+    color_attachment.format = swapchain->get_image_format();
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // the previous contents are cleared anyway, so let the driver discard them
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // depth is only needed while the pass is running, so it is never stored
+    VkAttachmentDescription depth_attachment {};
+    depth_attachment.format = DEPTH_FORMAT;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    const std::array attachments {color_attachment, depth_attachment};
+
+    static constexpr VkAttachmentReference COLOR_ATTACHMENT_REFERENCE {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+    };
+    static constexpr VkAttachmentReference DEPTH_ATTACHMENT_REFERENCE {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    };
+
+    VkSubpassDescription subpass {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &COLOR_ATTACHMENT_REFERENCE;
+    subpass.pDepthStencilAttachment = &DEPTH_ATTACHMENT_REFERENCE;
+
+    // The layout transition at the start of the render pass has to wait until the presentation
+    // engine is done reading the image, which is signaled through the image available semaphore
+    // at the color attachment output stage. The single depth buffer is shared by all frames in
+    // flight, so clearing it also has to wait for the previous frame's depth tests.
+    VkSubpassDependency dependency {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo render_pass_create_info {};
+    render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_create_info.attachmentCount = static_cast<u32>(attachments.size());
+    render_pass_create_info.pAttachments = attachments.data();
+    render_pass_create_info.subpassCount = 1;
+    render_pass_create_info.pSubpasses = &subpass;
+    render_pass_create_info.dependencyCount = 1;
+    render_pass_create_info.pDependencies = &dependency;
+
+    if (vkCreateRenderPass(device, &render_pass_create_info, nullptr, &render_pass) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create render pass");
+    Logger::info("Created render pass successfully");
+}
+
+void Renderer::create_depth_buffer() noexcept
+{
+    const auto extent = swapchain->get_extent();
+
+    VkImageCreateInfo image_create_info {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = DEPTH_FORMAT;
+    image_create_info.extent = {.width = extent.width, .height = extent.height, .depth = 1};
+    image_create_info.mipLevels = 1;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device, &image_create_info, nullptr, &depth_image) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create depth buffer");
+
+    depth_allocation = allocator->allocate_image(depth_image, Memory::Usage::GpuOnly);
+    if (!depth_allocation.is_valid())
+        Logger::fatal_error("Failed to allocate memory for the depth buffer");
+
+    VkImageViewCreateInfo image_view_create_info {};
+    image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_create_info.image = depth_image;
+    image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    image_view_create_info.format = DEPTH_FORMAT;
+    image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    image_view_create_info.subresourceRange.baseMipLevel = 0;
+    image_view_create_info.subresourceRange.levelCount = 1;
+    image_view_create_info.subresourceRange.baseArrayLayer = 0;
+    image_view_create_info.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device, &image_view_create_info, nullptr, &depth_view) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create depth buffer view");
+}
+
+void Renderer::destroy_depth_buffer() noexcept
+{
+    vkDestroyImageView(device, depth_view, nullptr);
+    vkDestroyImage(device, depth_image, nullptr);
+    allocator->free(depth_allocation);
+    depth_view = VK_NULL_HANDLE;
+    depth_image = VK_NULL_HANDLE;
+}
+
+void Renderer::create_framebuffers() noexcept
+{
+    const auto &image_views = swapchain->get_image_views();
+    const auto extent = swapchain->get_extent();
+    framebuffers.resize(image_views.size());
+
+    for (usize i {}; i < image_views.size(); ++i) {
+        const std::array attachments {image_views[i], depth_view};
+
+        VkFramebufferCreateInfo framebuffer_create_info {};
+        framebuffer_create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebuffer_create_info.renderPass = render_pass;
+        framebuffer_create_info.attachmentCount = static_cast<u32>(attachments.size());
+        framebuffer_create_info.pAttachments = attachments.data();
+        framebuffer_create_info.width = extent.width;
+        framebuffer_create_info.height = extent.height;
+        framebuffer_create_info.layers = 1;
+
+        if (vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &framebuffers[i]) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create framebuffer");
+    }
+}
+
+void Renderer::create_frames(u32 graphics_family) noexcept
+{
+    static constexpr VkSemaphoreCreateInfo SEMAPHORE_CREATE_INFO {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0
+    };
+
+    // fences start signaled so the first wait on each frame slot returns immediately
+    static constexpr VkFenceCreateInfo FENCE_CREATE_INFO {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT
+    };
+
+    for (auto &frame : frames) {
+        VkCommandPoolCreateInfo command_pool_create_info {};
+        command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        // the whole pool is reset every frame, so the command buffers are short lived
+        command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        command_pool_create_info.queueFamilyIndex = graphics_family;
+
+        if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &frame.command_pool) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create frame command pool");
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info {};
+        command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_allocate_info.commandPool = frame.command_pool;
+        command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        command_buffer_allocate_info.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &frame.command_buffer) != VK_SUCCESS)
+            Logger::fatal_error("Failed to allocate frame command buffer");
+
+        if (vkCreateSemaphore(device, &SEMAPHORE_CREATE_INFO, nullptr, &frame.image_available) != VK_SUCCESS ||
+            vkCreateFence(device, &FENCE_CREATE_INFO, nullptr, &frame.in_flight) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create frame synchronization objects");
+    }
+}
+
+void Renderer::create_image_semaphores() noexcept
+{
+    static constexpr VkSemaphoreCreateInfo SEMAPHORE_CREATE_INFO {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0
+    };
+
+    render_finished.resize(swapchain->image_count());
+    for (auto &semaphore : render_finished) {
+        if (vkCreateSemaphore(device, &SEMAPHORE_CREATE_INFO, nullptr, &semaphore) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create frame synchronization objects");
+    }
+    images_in_flight.assign(swapchain->image_count(), VK_NULL_HANDLE);
+}
+
+void Renderer::resize(VkExtent2D new_framebuffer_extent) noexcept
+{
+    framebuffer_extent = new_framebuffer_extent;
+    swapchain_outdated = true;
+}
+
+// The render pass, the pipelines using it and all frame resources stay as they are, the image
+// format never changes. Only what depends on the extent or on the swapchain images is rebuilt.
+void Renderer::recreate_swapchain() noexcept
+{
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    RetiredSwapchain retired {};
+    retired.frame = submitted_frames;
+    retired.swapchain = swapchain->recreate(framebuffer_extent);
+    retired.framebuffers = std::exchange(framebuffers, {});
+    retired.render_finished = std::exchange(render_finished, {});
+    retired.depth_image = std::exchange(depth_image, VK_NULL_HANDLE);
+    retired.depth_view = std::exchange(depth_view, VK_NULL_HANDLE);
+    retired.depth_allocation = std::exchange(depth_allocation, {});
+    retired_swapchains.push_back(std::move(retired));
+
+    create_depth_buffer();
+    create_framebuffers();
+    create_image_semaphores();
+    swapchain_outdated = false;
+
+    Logger::info("Recreated swapchain in {} ms", std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+}
+
+void Renderer::destroy_retired(RetiredSwapchain &retired) noexcept
+{
+    for (auto framebuffer : retired.framebuffers)
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+    for (auto semaphore : retired.render_finished)
+        vkDestroySemaphore(device, semaphore, nullptr);
+    vkDestroyImageView(device, retired.depth_view, nullptr);
+    vkDestroyImage(device, retired.depth_image, nullptr);
+    allocator->free(retired.depth_allocation);
+    swapchain->destroy(retired.swapchain);
+}
+
+VkCommandBuffer Renderer::begin_frame() noexcept
+{
+    // nothing can be presented to a minimized window
+    if (framebuffer_extent.width == 0 || framebuffer_extent.height == 0) [[unlikely]]
+        return VK_NULL_HANDLE;
+
+    Profiler::begin_frame();
+    auto &frame = frames[current_frame];
+
+    // wait until the GPU has finished with the last submission that used this frame slot
+    {
+        PROFILE_ZONE("wait for frame");
+        vkWaitForFences(device, 1, &frame.in_flight, VK_TRUE, std::numeric_limits<u64>::max());
+    }
+    profiler.collect(current_frame);
+
+    // once every frame slot has been waited on since a recreation, nothing uses the old swapchain
+    std::erase_if(retired_swapchains, [this](RetiredSwapchain &retired) {
+        if (submitted_frames < retired.frame + frames.size())
+            return false;
+        destroy_retired(retired);
+        return true;
+    });
+
+    if (swapchain_outdated) [[unlikely]]
+        recreate_swapchain();
+
+    VkResult result {};
+    {
+        PROFILE_ZONE("acquire image");
+        result = swapchain->acquire_next_image(frame.image_available, image_index);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) [[unlikely]] {
+        // the semaphore is left unsignaled, so the acquire can simply be retried
+        recreate_swapchain();
+        result = swapchain->acquire_next_image(frame.image_available, image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            return VK_NULL_HANDLE;
+    }
+    // the image can still be presented, so the recreation waits until the next frame
+    if (result == VK_SUBOPTIMAL_KHR)
+        swapchain_outdated = true;
+
+    // the swapchain can return images out of order, so make sure no other frame is still
+    // rendering to this one
+    if (images_in_flight[image_index] != VK_NULL_HANDLE && images_in_flight[image_index] != frame.in_flight)
+        vkWaitForFences(device, 1, &images_in_flight[image_index], VK_TRUE, std::numeric_limits<u64>::max());
+    images_in_flight[image_index] = frame.in_flight;
+
+    // only reset the fence once we know work will be submitted, otherwise it would never be signaled
+    vkResetFences(device, 1, &frame.in_flight);
+
+    // resetting the pool is cheaper than resetting each command buffer individually
+    vkResetCommandPool(device, frame.command_pool, 0x0);
+
+    static constexpr VkCommandBufferBeginInfo BEGIN_INFO {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+    if (vkBeginCommandBuffer(frame.command_buffer, &BEGIN_INFO) != VK_SUCCESS)
+        Logger::fatal_error("Failed to begin recording frame command buffer");
+    profiler.begin_frame(current_frame, frame.command_buffer);
+
+    // Ownership of finished uploads is acquired before the render pass, barriers for other queue
+    // families cannot be recorded inside one
+    uploader.flush();
+    uploader.acquire_completed(frame.command_buffer);
+
+    frame_started = true;
+    return frame.command_buffer;
+}
+
+void Renderer::begin_render_pass(VkSubpassContents contents) noexcept
+{
+    if (!frame_started || render_pass_started) [[unlikely]]
+        Logger::fatal_error("Renderer::begin_render_pass must be called once per frame, after begin_frame");
+
+    static constexpr std::array CLEAR_VALUES {
+        VkClearValue{.color = {.float32 = {0.47f, 0.65f, 1.0f, 1.0f}}},
+        VkClearValue{.depthStencil = {.depth = 1.0f, .stencil = 0}}
+    };
+
+    VkRenderPassBeginInfo render_pass_begin_info {};
+    render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_begin_info.renderPass = render_pass;
+    render_pass_begin_info.framebuffer = framebuffers[image_index];
+    render_pass_begin_info.renderArea.offset = {0, 0};
+    render_pass_begin_info.renderArea.extent = swapchain->get_extent();
+    render_pass_begin_info.clearValueCount = static_cast<u32>(CLEAR_VALUES.size());
+    render_pass_begin_info.pClearValues = CLEAR_VALUES.data();
+
+    render_pass_zone = profiler.begin_zone(frames[current_frame].command_buffer, "render pass");
+    vkCmdBeginRenderPass(frames[current_frame].command_buffer, &render_pass_begin_info, contents);
+    render_pass_started = true;
+}
+
+void Renderer::end_frame() noexcept
+{
+    if (!frame_started) [[unlikely]]
+        Logger::fatal_error("Renderer::end_frame called without a matching begin_frame");
+
+    auto &frame = frames[current_frame];
+    // frames that draw nothing still have to clear and transition the swapchain image
+    if (!render_pass_started)
+        begin_render_pass(VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdEndRenderPass(frame.command_buffer);
+    profiler.end_zone(frame.command_buffer, render_pass_zone);
+    profiler.end_frame(frame.command_buffer);
+
+    if (vkEndCommandBuffer(frame.command_buffer) != VK_SUCCESS)
+        Logger::fatal_error("Failed to record frame command buffer");
+
+    static constexpr VkPipelineStageFlags WAIT_STAGE {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+
+    VkSubmitInfo submit_info {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &frame.image_available;
+    submit_info.pWaitDstStageMask = &WAIT_STAGE;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &frame.command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &render_finished[image_index];
+
+    {
+        PROFILE_ZONE("submit");
+        if (vkQueueSubmit(graphics_queue, 1, &submit_info, frame.in_flight) != VK_SUCCESS)
+            Logger::fatal_error("Failed to submit frame command buffer");
+    }
+
+    PROFILE_ZONE("present");
+    const auto result = swapchain->present(presentation_queue, render_finished[image_index], image_index);
+    if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR) [[unlikely]]
+        swapchain_outdated = true;
+
+    ++submitted_frames;
+    frame_started = false;
+    render_pass_started = false;
+    current_frame = (current_frame + 1) % static_cast<u32>(frames.size());
+}
@@ -0,0 +1,207 @@
+#include "mcvk/section.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace World
+{
+    // Smallest power-of-two index width able to address 'palette_size' entries
+    static constexpr u8 bits_for_palette_size(usize palette_size) noexcept
+    {
+        if (palette_size <= 1)
+            return 0;
+        const auto needed = std::bit_width(palette_size - 1);
+        return static_cast<u8>(std::bit_ceil(static_cast<unsigned>(needed)));
+    }
+
+    u32 Section::find_or_add_to_palette(BlockId id) noexcept
+    {
+        // palettes are almost always tiny, so a linear scan beats any kind of lookup table
+        const auto found = std::find(palette.begin(), palette.end(), id);
+        if (found != palette.end())
+            return static_cast<u32>(found - palette.begin());
+
+        palette.push_back(id);
+        const auto required_bits = bits_for_palette_size(palette.size());
+        if (required_bits > bits)
+            repack(required_bits);
+        return static_cast<u32>(palette.size() - 1);
+    }
+
+    void Section::repack(u8 new_bits) noexcept
+    {
+        std::vector<u64> new_data (VOLUME / entries_per_word(new_bits));
+
+        const auto new_per_word = entries_per_word(new_bits);
+        for (usize i {}; i < VOLUME; ++i) {
+            const u64 value = (bits == 0) ? 0 : read(i);
+            new_data[i / new_per_word] |= value << ((i % new_per_word) * new_bits);
+        }
+        data = std::move(new_data);
+        bits = new_bits;
+    }
+
+    void Section::set(i32 x, i32 y, i32 z, BlockId id) noexcept
+    {
+        const auto index = index_of(x, y, z);
+        const auto previous = (bits == 0) ? palette[0] : palette[read(index)];
+        if (previous == id)
+            return;
+
+        const auto palette_index = find_or_add_to_palette(id);
+        write(index, palette_index);
+
+        if (previous == Air)
+            ++non_air_count;
+        else if (id == Air)
+            --non_air_count;
+        ++version;
+    }
+
+    void Section::fill(BlockId id) noexcept
+    {
+        palette.assign(1, id);
+        data.clear();
+        data.shrink_to_fit();
+        bits = 0;
+        non_air_count = (id == Air) ? 0 : static_cast<u16>(VOLUME);
+        ++version;
+    }
+
+    void Section::assign(std::span<const BlockId, VOLUME> blocks) noexcept
+    {
+        std::array<u8, VOLUME> indices; // NOLINT(cppcoreguidelines-pro-type-member-init), every entry is written below
+        palette.assign(1, blocks[0]);
+        usize non_air {};
+
+        // generated blocks come in long runs, so the palette is only searched when the id changes
+        BlockId previous {blocks[0]};
+        u8 previous_index {};
+        for (usize i {}; i < VOLUME; ++i) {
+            const auto id = blocks[i];
+            if (id != previous) {
+                const auto index = static_cast<usize>(std::find(palette.begin(), palette.end(), id) - palette.begin());
+                if (index == palette.size())
+                    palette.push_back(id);
+                previous = id;
+                previous_index = static_cast<u8>(index);
+            }
+            indices[i] = previous_index;
+            non_air += (id != Air) ? 1 : 0;
+        }
+
+        // more than 256 different ids can't come out of a single section of generated terrain
+        if (palette.size() > 256) [[unlikely]] {
+            fill(Air);
+            for (usize i {}; i < VOLUME; ++i)
+                set(static_cast<i32>(i % SIZE), static_cast<i32>(i / (SIZE * SIZE)), static_cast<i32>((i / SIZE) % SIZE), blocks[i]);
+            return;
+        }
+
+        non_air_count = static_cast<u16>(non_air);
+        ++version;
+        bits = bits_for_palette_size(palette.size());
+        if (bits == 0) {
+            data.clear();
+            data.shrink_to_fit();
+            return;
+        }
+
+        const auto per_word = entries_per_word(bits);
+        data.assign(VOLUME / per_word, 0);
+        for (usize i {}; i < VOLUME; ++i)
+            data[i / per_word] |= static_cast<u64>(indices[i]) << ((i % per_word) * bits);
+    }
+
+    std::span<u64> Section::assign_packed(std::span<const BlockId> new_palette, u8 new_bits, u16 new_non_air_count) noexcept
+    {
+        palette.assign(new_palette.begin(), new_palette.end());
+        bits = new_bits;
+        non_air_count = new_non_air_count;
+        ++version;
+        if (bits == 0) {
+            data.clear();
+            data.shrink_to_fit();
+            return {};
+        }
+        data.resize(VOLUME / entries_per_word(bits));
+        return data;
+    }
+
+    void Section::unpack(std::span<BlockId, VOLUME> out) const noexcept
+    {
+        if (bits == 0) {
+            std::fill(out.begin(), out.end(), palette[0]);
+            return;
+        }
+
+        // decode a whole word at a time instead of recomputing the word and shift for every block
+        const auto per_word = entries_per_word(bits);
+        const u64 mask = (1ull << bits) - 1;
+        usize i {};
+        for (const auto word : data) {
+            auto value = word;
+            for (usize j {}; j < per_word; ++j, ++i) {
+                out[i] = palette[value & mask];
+                value >>= bits;
+            }
+        }
+    }
+
+    void Section::compact() noexcept
+    {
+        if (bits == 0)
+            return;
+
+        // count how often every palette entry is referenced
+        std::vector<u32> references (palette.size());
+        for (usize i {}; i < VOLUME; ++i)
+            ++references[read(i)];
+
+        std::vector<BlockId> new_palette {};
+        std::vector<u32> remap (palette.size());
+        for (usize i {}; i < palette.size(); ++i) {
+            if (references[i] != 0) {
+                remap[i] = static_cast<u32>(new_palette.size());
+                new_palette.push_back(palette[i]);
+            }
+        }
+
+        if (new_palette.size() == 1) {
+            fill(new_palette[0]);
+            return;
+        }
+        if (new_palette.size() == palette.size())
+            return;
+
+        const auto new_bits = bits_for_palette_size(new_palette.size());
+        std::vector<u64> new_data (VOLUME / entries_per_word(new_bits));
+        const auto new_per_word = entries_per_word(new_bits);
+        for (usize i {}; i < VOLUME; ++i)
+            new_data[i / new_per_word] |= static_cast<u64>(remap[read(i)]) << ((i % new_per_word) * new_bits);
+
+        palette = std::move(new_palette);
+        data = std::move(new_data);
+        bits = new_bits;
+    }
+
+    void Section::fill_light(u8 value) noexcept
+    {
+        light.clear();
+        light.shrink_to_fit();
+        uniform_light = value;
+    }
+
+    void Section::compact_light() noexcept
+    {
+        if (light.empty())
+            return;
+        if (std::all_of(light.begin(), light.end(), [first = light[0]](u8 value) { return value == first; }))
+            fill_light(light[0]);
+    }
+
+    usize Section::memory_usage() const noexcept
+    {
+        return sizeof(Section) + palette.capacity() * sizeof(BlockId) + data.capacity() * sizeof(u64) + light.capacity();
+    }
+}
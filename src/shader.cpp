@@ -0,0 +1,40 @@
+#include "mcvk/shader.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/global.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Shader
+{
+    VkShaderModule load_module(VkDevice device, const char *name) noexcept
+    {
+        const auto path = std::string{SHADER_DIRECTORY} + name + ".spv";
+        std::ifstream file {path, std::ios::binary | std::ios::ate};
+        if (!file) {
+            Logger::fatal_error("Failed to open shader binary {}", path);
+        }
+
+        // SPIR-V is a stream of 32-bit words
+        const auto size = static_cast<usize>(file.tellg());
+        if (size == 0 || size % sizeof(u32) != 0) {
+            Logger::fatal_error("Shader binary {} is not valid SPIR-V", path);
+        }
+        std::vector<u32> code (size / sizeof(u32));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(code.data()), static_cast<std::streamsize>(size));
+
+        VkShaderModuleCreateInfo shader_module_create_info {};
+        shader_module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        shader_module_create_info.codeSize = size;
+        shader_module_create_info.pCode = code.data();
+
+        VkShaderModule module {VK_NULL_HANDLE};
+        if (vkCreateShaderModule(device, &shader_module_create_info, nullptr, &module) != VK_SUCCESS) {
+            Logger::fatal_error("Failed to create shader module from {}", path);
+        }
+
+        Logger::info("Loaded shader {}", path);
+        return module;
+    }
+}
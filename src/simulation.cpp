@@ -0,0 +1,128 @@
+#include "mcvk/simulation.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+Simulation::State Simulation::State::interpolate(const State &from, const State &to, float alpha) noexcept
+{
+    const auto blend = [alpha](float a, float b) { return a + (b - a) * alpha; };
+    State state {to};
+    state.camera.position = {blend(from.camera.position.x, to.camera.position.x),
+                             blend(from.camera.position.y, to.camera.position.y),
+                             blend(from.camera.position.z, to.camera.position.z)};
+    state.camera.yaw = blend(from.camera.yaw, to.camera.yaw);
+    state.camera.pitch = blend(from.camera.pitch, to.camera.pitch);
+    return state;
+}
+
+Simulation::Simulation(TickFunction function, const State &initial_state, u32 tick_rate) noexcept
+    : tick_function {std::move(function)},
+      tick_duration {std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(tick_rate, 1u)))}
+{
+    const auto start = Clock::now();
+    snapshots[front] = {.previous = initial_state, .current = initial_state, .time = start};
+    previous_frame = start;
+    thread = std::thread {[this, initial_state] { run(initial_state); }};
+}
+
+Simulation::~Simulation() noexcept
+{
+    {
+        const std::lock_guard lock {wake_mutex};
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void Simulation::run(State state) noexcept
+{
+    const auto seconds = std::chrono::duration<float>(tick_duration).count();
+    auto next = Clock::now() + tick_duration;
+    while (true) {
+        {
+            std::unique_lock lock {wake_mutex};
+            if (wake.wait_until(lock, next, [this] { return !running; }))
+                return;
+        }
+
+        const auto start = Clock::now();
+        auto previous = state;
+        {
+            PROFILE_ZONE("simulation tick");
+            tick_function(state, seconds);
+        }
+        ++state.tick;
+        const auto nanoseconds = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+        // 'front' is only written on this thread, reading it doesn't need the lock
+        const auto back = front ^ 1;
+        snapshots[back] = {.previous = std::move(previous), .current = state, .time = next};
+        {
+            const std::lock_guard lock {snapshot_mutex};
+            front = back;
+        }
+
+        ticks.fetch_add(1, std::memory_order_relaxed);
+        tick_nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        if (nanoseconds > max_tick_nanoseconds.load(std::memory_order_relaxed))
+            max_tick_nanoseconds.store(nanoseconds, std::memory_order_relaxed);
+
+        // catch up on a few late ticks, but rather drop them than run at many times the tick rate
+        next += tick_duration;
+        const auto behind = static_cast<u64>(std::max<Clock::rep>((Clock::now() - next) / tick_duration, 0));
+        if (behind > MAX_CATCH_UP) {
+            missed_ticks.fetch_add(behind, std::memory_order_relaxed);
+            next += tick_duration * static_cast<Clock::rep>(behind);
+        }
+    }
+}
+
+Simulation::State Simulation::frame_state(Clock::time_point now) noexcept
+{
+    Snapshot snapshot {};
+    {
+        const std::lock_guard lock {snapshot_mutex};
+        snapshot = snapshots[front];
+    }
+
+    const auto frame_ms = std::chrono::duration<double, std::milli>(now - previous_frame).count();
+    if (frames != 0) {
+        frame_ms_total += frame_ms;
+        max_frame_ms = std::max(max_frame_ms, frame_ms);
+    }
+    ++frames;
+    previous_frame = now;
+
+    // before the next tick is due, the frame lies between the last two ticks
+    const auto alpha = std::chrono::duration<float>(now - snapshot.time) / std::chrono::duration<float>(tick_duration);
+    return State::interpolate(snapshot.previous, snapshot.current, std::clamp(alpha, 0.0f, 1.0f));
+}
+
+Simulation::Statistics Simulation::get_statistics() const noexcept
+{
+    const auto tick_count = ticks.load(std::memory_order_relaxed);
+    const auto intervals = (frames > 1) ? frames - 1 : 1;
+    return {
+        .ticks = tick_count,
+        .missed_ticks = missed_ticks.load(std::memory_order_relaxed),
+        .average_tick_ms = static_cast<double>(tick_nanoseconds.load(std::memory_order_relaxed)) / 1e6 / static_cast<double>(std::max<u64>(tick_count, 1)),
+        .max_tick_ms = static_cast<double>(max_tick_nanoseconds.load(std::memory_order_relaxed)) / 1e6,
+        .frames = frames,
+        .average_frame_ms = frame_ms_total / static_cast<double>(intervals),
+        .max_frame_ms = max_frame_ms,
+    };
+}
+
+void Simulation::report() const noexcept
+{
+    const auto s = get_statistics();
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+    fprintf(stdout, "Simulation at %.0f ticks per second\n", 1.0 / std::chrono::duration<double>(tick_duration).count());
+    fprintf(stdout, "  %llu ticks, %llu missed | tick: average %.3f ms, max %.3f ms\n",
+            static_cast<unsigned long long>(s.ticks), static_cast<unsigned long long>(s.missed_ticks), s.average_tick_ms, s.max_tick_ms);
+    fprintf(stdout, "  %llu frames | frame: average %.3f ms, max %.3f ms\n",
+            static_cast<unsigned long long>(s.frames), s.average_frame_ms, s.max_frame_ms);
+    // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+}
@@ -2,7 +2,6 @@
 #include "mcvk/types.hpp"
 #include "mcvk/logger.hpp"
 #include "mcvk/global.hpp"
-#include <GLFW/glfw3.h>
 #include <limits>
 #include <algorithm>
 #include <vector>
@@ -12,21 +11,21 @@
 inline static VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR> &formats) noexcept;
 inline static VkPresentModeKHR choose_swap_presentation_mode(const std::vector<VkPresentModeKHR> &presentation_modes) noexcept;
 inline static VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR &capabilities,
-                                                  GLFWwindow *window) noexcept;
-
-Swapchain::Swapchain(const Device::PhysicalDeviceInfo physical_device, 
-                     VkSurfaceKHR surface, 
-                     GLFWwindow *window,
-                     const Queue::QueueFamilyIndices &queue_family_indices,
-                     VkDevice ddevice) noexcept
+                                                  VkExtent2D framebuffer_extent) noexcept;
+
+Swapchain::Swapchain(const Device::PhysicalDeviceInfo physical_device_info, 
+                     VkSurfaceKHR ssurface, 
+                     VkExtent2D framebuffer_extent,
+                     const Queue::QueueFamilyIndices &qqueue_family_indices,
+                     VkDevice ddevice) noexcept :
+    physical_device {physical_device_info},
+    surface {ssurface},
+    queue_family_indices {qqueue_family_indices}
 {
     VkSurfaceCapabilitiesKHR capabilities {};
 
     if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device.self, surface, &capabilities) != VK_SUCCESS) {
-        if constexpr (Global::IS_DEBUG_BUILD) {
-            const auto msg = std::string{"Failed to retrieve surface capabilities for device "} + physical_device.name;
-            Logger::info(msg.c_str());
-        }
+        Logger::info("Failed to retrieve surface capabilities for device {}", physical_device.name);
         return;
     }
 
@@ -36,19 +35,13 @@ Swapchain::Swapchain(const Device::PhysicalDeviceInfo physical_device,
 
     if (format_count != 0) {
         compatible_flag = static_cast<CompatibleFlag>(compatible_flag | CompatibleFlag::CompatibleWithSurfaceFormat);
-        if constexpr (Global::IS_DEBUG_BUILD) {
-            const auto msg = std::string{"Found "} + std::to_string(format_count) + " surface formats for device " + physical_device.name;
-            Logger::info(msg.c_str());
-        }
+        Logger::info("Found {} surface formats for device {}", format_count, physical_device.name);
 
         formats.resize(format_count);
         vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device.self, surface, &format_count, formats.data());
     }
     else {
-        if constexpr (Global::IS_DEBUG_BUILD) {
-            const auto msg = std::string{"No surface formats found for device "} + physical_device.name;
-            Logger::info(msg.c_str());
-        }
+        Logger::info("No surface formats found for device {}", physical_device.name);
         return;
     }
 
@@ -58,19 +51,13 @@ Swapchain::Swapchain(const Device::PhysicalDeviceInfo physical_device,
 
     if (presentation_mode_count != 0) {
         compatible_flag = static_cast<CompatibleFlag>(compatible_flag | CompatibleFlag::CompatibleWithPresentation);
-        if constexpr (Global::IS_DEBUG_BUILD) {
-            const auto msg = std::string{"Found "} + std::to_string(presentation_mode_count) + " presentation modes for device " + physical_device.name;
-            Logger::info(msg.c_str());
-        }
+        Logger::info("Found {} presentation modes for device {}", presentation_mode_count, physical_device.name);
 
         presentation_modes.resize(presentation_mode_count);
         vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device.self, surface, &presentation_mode_count, presentation_modes.data());
     }
     else {
-        if constexpr (Global::IS_DEBUG_BUILD) {
-            const auto msg = std::string{"No presentation modes found for device "} + physical_device.name;
-            Logger::info(msg.c_str());
-        }
+        Logger::info("No presentation modes found for device {}", physical_device.name);
         return;
     }
 
@@ -78,80 +65,175 @@ Swapchain::Swapchain(const Device::PhysicalDeviceInfo physical_device,
     // The compatible flag has been set, so it is unnecessary to proceed from here. Also check to make sure the
     // device is in fact being used.
     if (ddevice != VK_NULL_HANDLE && Device::LogicalDevice::device_is_in_use(ddevice)) {
-
-        const auto swap_surface_format = choose_swap_surface_format(formats);
-        const auto swap_presentation_mode = choose_swap_presentation_mode(presentation_modes);
-        const auto swap_extent = choose_swap_extent(capabilities, window);
-        const auto available_images = std::clamp(capabilities.minImageCount + 1, capabilities.minImageCount, capabilities.maxImageCount);
-
-        if constexpr (Global::IS_DEBUG_BUILD) {
-            const auto msg = std::string{"Swapchain extent: "} + std::to_string(swap_extent.width) + "x" + std::to_string(swap_extent.height);
-            Logger::info(msg.c_str());
-        }
-
-        VkSwapchainCreateInfoKHR swapchain_create_info {};
-        swapchain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-        swapchain_create_info.surface = surface;
-        swapchain_create_info.minImageCount = available_images;
-        swapchain_create_info.imageColorSpace = swap_surface_format.colorSpace;
-        swapchain_create_info.imageFormat = swap_surface_format.format;
-        swapchain_create_info.imageExtent = swap_extent;
-        swapchain_create_info.imageArrayLayers = 1;
-        swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // using swapchain for direct rendering, so use color attachment bit
-
-        if (queue_family_indices.get(Queue::GraphicsQueueIndex) != queue_family_indices.get(Queue::PresentationQueueIndex)) {
-            // Images can be used across multiple queue families without explicit ownership transfer
-            swapchain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-            swapchain_create_info.queueFamilyIndexCount = 2;
-            swapchain_create_info.pQueueFamilyIndices = queue_family_indices.array().data();
-        }
-        else {
-            // Ownership must be shared (i.e., transferred) to another queue family in order to be used. This offers the
-            // best performance.
-            swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            swapchain_create_info.queueFamilyIndexCount = 0;
-            swapchain_create_info.pQueueFamilyIndices = nullptr;
-        }
-
-        swapchain_create_info.preTransform = capabilities.currentTransform; // apply image transform if supported
-        swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;  // do not blend with other windows
-        swapchain_create_info.presentMode = swap_presentation_mode;
-        swapchain_create_info.clipped = VK_TRUE; // don't care if another window gets in the way
-        swapchain_create_info.oldSwapchain = VK_NULL_HANDLE;
-
-        VkSwapchainKHR tmp {};
-        if (vkCreateSwapchainKHR(ddevice, &swapchain_create_info, nullptr, &tmp) != VK_SUCCESS) {
-            Logger::error("Failed to create swapchain");
-            return;
-        }
-        #ifndef NDEBUG
-            else {
-                const auto msg = std::string{"Swapchain successfully created for device "} + physical_device.name;
-                Logger::info(msg.c_str());
-            }
-        #endif
-
-        // swapchain successfully created, so initialize the device and swapchain
         device = ddevice;
-        swapchain = tmp;
+        surface_format = choose_swap_surface_format(formats);
+        present_mode = choose_swap_presentation_mode(presentation_modes);
+
+        if (!create(framebuffer_extent, VK_NULL_HANDLE))
+            device = VK_NULL_HANDLE;
+    }
+
+}
 
-        // Now get the handles of VkImage
-        u32 image_count {};
-        vkGetSwapchainImagesKHR(device, swapchain, &image_count, nullptr);
+bool Swapchain::create(VkExtent2D framebuffer_extent, VkSwapchainKHR old_swapchain) noexcept
+{
+    // the current extent changes with the window, so the capabilities have to be queried every time
+    VkSurfaceCapabilitiesKHR capabilities {};
+    if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device.self, surface, &capabilities) != VK_SUCCESS) {
+        Logger::error("Failed to retrieve surface capabilities");
+        return false;
+    }
 
-        if (image_count != 0) [[likely]] {
-            images.resize(image_count);
-            vkGetSwapchainImagesKHR(device, swapchain, &image_count, images.data());
-        }
-        #ifndef NDEBUG
-            else {
-                Logger::error("No images found for swapchain");
-                return;
-            }
-        #endif
+    const auto swap_extent = choose_swap_extent(capabilities, framebuffer_extent);
+    // a maximum image count of 0 means there is no limit (headless surfaces commonly report this)
+    const auto max_image_count = (capabilities.maxImageCount == 0) ? std::numeric_limits<u32>::max() : capabilities.maxImageCount;
+    const auto available_images = std::clamp(capabilities.minImageCount + 1, capabilities.minImageCount, max_image_count);
+
+    Logger::info("Swapchain extent: {}x{}", swap_extent.width, swap_extent.height);
+
+    VkSwapchainCreateInfoKHR swapchain_create_info {};
+    swapchain_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    swapchain_create_info.surface = surface;
+    swapchain_create_info.minImageCount = available_images;
+    swapchain_create_info.imageColorSpace = surface_format.colorSpace;
+    swapchain_create_info.imageFormat = surface_format.format;
+    swapchain_create_info.imageExtent = swap_extent;
+    swapchain_create_info.imageArrayLayers = 1;
+    swapchain_create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // using swapchain for direct rendering, so use color attachment bit
+
+    if (queue_family_indices.get(Queue::GraphicsQueueIndex) != queue_family_indices.get(Queue::PresentationQueueIndex)) {
+        // Images can be used across multiple queue families without explicit ownership transfer
+        swapchain_create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        swapchain_create_info.queueFamilyIndexCount = 2;
+        swapchain_create_info.pQueueFamilyIndices = queue_family_indices.array().data();
     }
+    else {
+        // Ownership must be shared (i.e., transferred) to another queue family in order to be used. This offers the
+        // best performance.
+        swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+        swapchain_create_info.queueFamilyIndexCount = 0;
+        swapchain_create_info.pQueueFamilyIndices = nullptr;
+    }
+
+    swapchain_create_info.preTransform = capabilities.currentTransform; // apply image transform if supported
+    swapchain_create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;  // do not blend with other windows
+    swapchain_create_info.presentMode = present_mode;
+    swapchain_create_info.clipped = VK_TRUE; // don't care if another window gets in the way
+    // lets the driver hand resources of the previous swapchain over to the new one
+    swapchain_create_info.oldSwapchain = old_swapchain;
+
+    VkSwapchainKHR tmp {};
+    if (vkCreateSwapchainKHR(device, &swapchain_create_info, nullptr, &tmp) != VK_SUCCESS) {
+        Logger::error("Failed to create swapchain");
+        return false;
+    }
+    Logger::info("Swapchain successfully created for device {}", physical_device.name);
+
+    // swapchain successfully created
+    swapchain = tmp;
+    image_format = surface_format.format;
+    extent = swap_extent;
+
+    // Now get the handles of VkImage
+    u32 image_count {};
+    vkGetSwapchainImagesKHR(device, swapchain, &image_count, nullptr);
+
+    if (image_count != 0) [[likely]] {
+        images.resize(image_count);
+        vkGetSwapchainImagesKHR(device, swapchain, &image_count, images.data());
+    }
+    else {
+        Logger::error("No images found for swapchain");
+        return false;
+    }
+
+    create_image_views();
+    return true;
+}
+
+Swapchain::Retired Swapchain::recreate(VkExtent2D framebuffer_extent) noexcept
+{
+    Retired retired {.swapchain = swapchain, .image_views = std::move(image_views)};
+    image_views.clear();
+    images.clear();
+
+    if (!create(framebuffer_extent, retired.swapchain))
+        Logger::fatal_error("Failed to recreate swapchain");
+    return retired;
+}
+
+void Swapchain::destroy(Retired &retired) const noexcept
+{
+    for (auto image_view : retired.image_views)
+        vkDestroyImageView(device, image_view, nullptr);
+    vkDestroySwapchainKHR(device, retired.swapchain, nullptr);
+    retired = {};
+}
+
+void Swapchain::create_image_views() noexcept
+{
+    image_views.resize(images.size());
+
+    for (usize i {}; i < images.size(); ++i) {
+        VkImageViewCreateInfo image_view_create_info {};
+        image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_create_info.image = images[i];
+        image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        image_view_create_info.format = image_format;
+        image_view_create_info.components = {
+            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .a = VK_COMPONENT_SWIZZLE_IDENTITY
+        };
+        // swapchain images are only ever used as a single color target, so no mipmapping or layers
+        image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        image_view_create_info.subresourceRange.baseMipLevel = 0;
+        image_view_create_info.subresourceRange.levelCount = 1;
+        image_view_create_info.subresourceRange.baseArrayLayer = 0;
+        image_view_create_info.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &image_view_create_info, nullptr, &image_views[i]) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create swapchain image view");
+    }
+
+    Logger::info("Created {} swapchain image views", image_views.size());
+}
+
+void Swapchain::destroy_image_views() noexcept
+{
+    for (auto &image_view : image_views) {
+        vkDestroyImageView(device, image_view, nullptr);
+        image_view = VK_NULL_HANDLE;
+    }
+    image_views.clear();
+}
+
+VkResult Swapchain::acquire_next_image(VkSemaphore signal, u32 &image_index) const noexcept
+{
+    const auto result = vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<u64>::max(), signal, VK_NULL_HANDLE, &image_index);
+
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) [[unlikely]]
+        Logger::fatal_error("Failed to acquire swapchain image");
+    return result;
+}
+
+VkResult Swapchain::present(VkQueue presentation_queue, VkSemaphore wait, u32 image_index) const noexcept
+{
+    VkPresentInfoKHR present_info {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &wait;
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &swapchain;
+    present_info.pImageIndices = &image_index;
+
+    const auto result = vkQueuePresentKHR(presentation_queue, &present_info);
+
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) [[unlikely]]
+        Logger::fatal_error("Failed to present swapchain image");
+    return result;
 }
 
 inline static VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR> &formats) noexcept
@@ -165,13 +247,11 @@ inline static VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<Vk
 
     // If found
     if (found != formats.end()) {
-        if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("Found SRGB color space support for swapchain");
+        Logger::info("Found SRGB color space support for swapchain");
         return *found;
     }
 
-    if constexpr (Global::IS_DEBUG_BUILD)
-        Logger::info("No SRGB color space support for swapchain, using default");
+    Logger::info("No SRGB color space support for swapchain, using default");
     // If it's not available, just select the first format in the vector
     return formats[0];
 }
@@ -187,20 +267,18 @@ inline static VkPresentModeKHR choose_swap_presentation_mode(const std::vector<V
 
     // If found
     if (found != std::end(presentation_modes)) {
-        if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("VK_PRESENT_MODE_MAILBOX_KHR support found for swapchain");
+        Logger::info("VK_PRESENT_MODE_MAILBOX_KHR support found for swapchain");
         return *found;
     }
 
-    if constexpr (Global::IS_DEBUG_BUILD)
-        Logger::info("VK_PRESENT_MODE_MAILBOX_KHR support not available, using VK_PRESENT_MODE_FIFO_KHR");
+    Logger::info("VK_PRESENT_MODE_MAILBOX_KHR support not available, using VK_PRESENT_MODE_FIFO_KHR");
 
     // guaranteed to be available on every vulkan-supported device
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 inline static VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR &capabilities,
-                                                  GLFWwindow *window) noexcept
+                                                  VkExtent2D framebuffer_extent) noexcept
 {
 
     if (capabilities.currentExtent.width != std::numeric_limits<u32>::max())
@@ -209,12 +287,9 @@ inline static VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR &capa
     // A value of '0xFFFFFFFF' means that the surface size will be determined based on the extent of
     // the swapchain targeting the surface. In which case we select the resolution fits the best between
     // the smallest and largest swapchain value extent.
-    int width {}, height {};
-    glfwGetFramebufferSize(window, &width, &height);
-
     // Values must be between the smallest and largest swapchain value extent supported.
     return {
-        .width = std::clamp(static_cast<u32>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width),
-        .height = std::clamp(static_cast<u32>(height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height)
+        .width = std::clamp(framebuffer_extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width),
+        .height = std::clamp(framebuffer_extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height)
     };
 }
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "mcvk/terrain.hpp"
+#include "mcvk/profiler.hpp"
+#include "mcvk/checksum.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define MCVK_TERRAIN_X86 1
+#else
+    #define MCVK_TERRAIN_X86 0
+#endif
+
+namespace Terrain
+{
+    // Noise values are fixed point numbers with this many fractional bits, roughly in [-ONE, ONE].
+    // Lattice cells are at most 1 << FRACTION_BITS blocks wide, so positions within a cell are exact.
+    static constexpr i32 FRACTION_BITS {12};
+    static constexpr i32 ONE {1 << FRACTION_BITS};
+    static constexpr i32 ROW {World::Section::SIZE};
+
+    // Carved where the cave noise is above this
+    static constexpr i32 CAVE_THRESHOLD {ONE / 2};
+    // blocks of rock kept between a cave and the surface, so caves never flood
+    static constexpr i32 CAVE_ROOF {5};
+
+    // GCC and Clang vector extensions. The kernels below are written once for any lane count, the
+    // target attribute of the entry point they are inlined into decides which instructions they
+    // compile to. Only operations that are exact on integers are used, which is what makes every
+    // path produce the same bits.
+    using I32x4 = i32 __attribute__((vector_size(16)));
+    using I32x8 = i32 __attribute__((vector_size(32)));
+    using U32x4 = u32 __attribute__((vector_size(16)));
+    using U32x8 = u32 __attribute__((vector_size(32)));
+
+    // The kernels return vectors by value, but they are always inlined into an entry point with the
+    // right target, so no call ever crosses the ABI boundary GCC warns about
+    #pragma GCC diagnostic ignored "-Wpsabi"
+
+    template<typename V> struct Lanes;
+    template<> struct Lanes<i32> { using Unsigned = u32; static constexpr i32 COUNT {1}; };
+    template<> struct Lanes<I32x4> { using Unsigned = U32x4; static constexpr i32 COUNT {4}; };
+    template<> struct Lanes<I32x8> { using Unsigned = U32x8; static constexpr i32 COUNT {8}; };
+
+    // Noise of one row of columns (or blocks), indexed by x
+    struct ColumnNoise
+    {
+        std::array<i32, ROW> continents {};
+        std::array<i32, ROW> detail {};
+        std::array<i32, ROW> temperature {};
+    };
+
+    template<typename V>
+    [[gnu::always_inline]] inline V splat(i32 value) noexcept
+    {
+        return V{} + value;
+    }
+
+    template<typename V>
+    [[gnu::always_inline]] inline V lane_offsets() noexcept
+    {
+        if constexpr (Lanes<V>::COUNT == 1) {
+            return 0;
+        }
+        else {
+            V offsets {};
+            for (i32 i {}; i < Lanes<V>::COUNT; ++i)
+                offsets[i] = i;
+            return offsets;
+        }
+    }
+
+    // Hash of a lattice point. Unsigned multiplication wraps the same way in every lane width.
+    template<typename V>
+    [[gnu::always_inline]] inline V hash(const V &x, const V &y, const V &z, u32 seed) noexcept
+    {
+        using U = typename Lanes<V>::Unsigned;
+        U h = (std::bit_cast<U>(x) * 0x9E3779B1u) ^ (std::bit_cast<U>(y) * 0x85EBCA77u) ^ (std::bit_cast<U>(z) * 0xC2B2AE3Du) ^ seed;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        h *= 0x297A2D39u;
+        h ^= h >> 15;
+        return std::bit_cast<V>(h);
+    }
+
+    // Dot product of the offset to a lattice point with one of the gradients (±1, ±1, ±1), picked
+    // by the top bits of the hash. The sign masks negate without a lookup table or a branch.
+    template<typename V>
+    [[gnu::always_inline]] inline V gradient(const V &h, const V &dx, const V &dy, const V &dz) noexcept
+    {
+        const V sx = h >> 31;
+        const V sy = (h << 1) >> 31;
+        const V sz = (h << 2) >> 31;
+        return ((dx ^ sx) - sx) + ((dy ^ sy) - sy) + ((dz ^ sz) - sz);
+    }
+
+    // 6t^5 - 15t^4 + 10t^3, ordered so no intermediate leaves 32 bits for t in [0, ONE]
+    template<typename V>
+    [[gnu::always_inline]] inline V fade(const V &t) noexcept
+    {
+        const V t3 = (((t * t) >> FRACTION_BITS) * t) >> FRACTION_BITS;
+        const V inner = (((t * 6 - 15 * ONE) * t) >> FRACTION_BITS) + 10 * ONE;
+        return (t3 * inner) >> FRACTION_BITS;
+    }
+
+    template<typename V>
+    [[gnu::always_inline]] inline V lerp(const V &a, const V &b, const V &t) noexcept
+    {
+        return a + (((b - a) * t) >> FRACTION_BITS);
+    }
+
+    // Gradient noise on a lattice with '1 << shift' blocks between points, sampled at integer
+    // block coordinates. Arithmetic shifts floor negative coordinates into the right cell.
+    template<typename V>
+    [[gnu::always_inline]] inline V noise2(const V &x, const V &z, i32 shift, u32 seed) noexcept
+    {
+        const i32 mask {(1 << shift) - 1};
+        const V cell_x = x >> shift;
+        const V cell_z = z >> shift;
+        const V fx = (x & mask) << (FRACTION_BITS - shift);
+        const V fz = (z & mask) << (FRACTION_BITS - shift);
+        const V zero {};
+
+        const V n00 = gradient(hash(cell_x, zero, cell_z, seed), fx, zero, fz);
+        const V n10 = gradient(hash(cell_x + 1, zero, cell_z, seed), fx - ONE, zero, fz);
+        const V n01 = gradient(hash(cell_x, zero, cell_z + 1, seed), fx, zero, fz - ONE);
+        const V n11 = gradient(hash(cell_x + 1, zero, cell_z + 1, seed), fx - ONE, zero, fz - ONE);
+
+        const V u = fade(fx);
+        return lerp(lerp(n00, n10, u), lerp(n01, n11, u), fade(fz));
+    }
+
+    // Like 'noise2', but the vertical lattice spacing is separate from the horizontal one
+    template<typename V>
+    [[gnu::always_inline]] inline V noise3(const V &x, const V &y, const V &z, i32 shift, i32 shift_y, u32 seed) noexcept
+    {
+        const i32 mask {(1 << shift) - 1};
+        const i32 mask_y {(1 << shift_y) - 1};
+        const V cell_x = x >> shift;
+        const V cell_y = y >> shift_y;
+        const V cell_z = z >> shift;
+        const V fx = (x & mask) << (FRACTION_BITS - shift);
+        const V fy = (y & mask_y) << (FRACTION_BITS - shift_y);
+        const V fz = (z & mask) << (FRACTION_BITS - shift);
+
+        const auto corner = [&](i32 cx, i32 cy, i32 cz) [[gnu::always_inline]] {
+            return gradient(hash(cell_x + cx, cell_y + cy, cell_z + cz, seed), fx - cx * ONE, fy - cy * ONE, fz - cz * ONE);
+        };
+        const V u = fade(fx);
+        const V v = fade(fy);
+        const V w = fade(fz);
+        const V bottom = lerp(lerp(corner(0, 0, 0), corner(1, 0, 0), u), lerp(corner(0, 0, 1), corner(1, 0, 1), u), w);
+        const V top = lerp(lerp(corner(0, 1, 0), corner(1, 1, 0), u), lerp(corner(0, 1, 1), corner(1, 1, 1), u), w);
+        return lerp(bottom, top, v);
+    }
+
+    template<typename V>
+    [[gnu::always_inline]] inline void sample_columns(u32 continents_seed, u32 detail_seed, u32 temperature_seed,
+                                                      i32 x0, i32 z, ColumnNoise &out) noexcept
+    {
+        const V vz = splat<V>(z);
+        for (i32 i {}; i < ROW; i += Lanes<V>::COUNT) {
+            const V x = splat<V>(x0 + i) + lane_offsets<V>();
+
+            const V continents = noise2(x, vz, 9, continents_seed);
+            // every octave has twice the frequency and half the amplitude of the previous one
+            V detail = noise2(x, vz, 6, detail_seed);
+            detail += noise2(x, vz, 5, detail_seed + 1) >> 1;
+            detail += noise2(x, vz, 4, detail_seed + 2) >> 2;
+            detail += noise2(x, vz, 3, detail_seed + 3) >> 3;
+            const V temperature = noise2(x, vz, 10, temperature_seed);
+
+            std::memcpy(&out.continents[static_cast<usize>(i)], &continents, sizeof(V));
+            std::memcpy(&out.detail[static_cast<usize>(i)], &detail, sizeof(V));
+            std::memcpy(&out.temperature[static_cast<usize>(i)], &temperature, sizeof(V));
+        }
+    }
+
+    template<typename V>
+    [[gnu::always_inline]] inline void sample_caves(u32 seed, i32 x0, i32 y, i32 z, i32 *out) noexcept
+    {
+        const V vy = splat<V>(y);
+        const V vz = splat<V>(z);
+        for (i32 i {}; i < ROW; i += Lanes<V>::COUNT) {
+            const V x = splat<V>(x0 + i) + lane_offsets<V>();
+            // flattened vertically, caves run more along the ground than up and down
+            V caves = noise3(x, vy, vz, 5, 4, seed);
+            caves += noise3(x, vy, vz, 4, 3, seed + 1) >> 1;
+            std::memcpy(out + i, &caves, sizeof(V));
+        }
+    }
+
+    using ColumnsFunction = void (*)(u32, u32, u32, i32, i32, ColumnNoise &) noexcept;
+    using CavesFunction = void (*)(u32, i32, i32, i32, i32 *) noexcept;
+
+    struct Kernels
+    {
+        ColumnsFunction columns {};
+        CavesFunction caves {};
+    };
+
+    static void columns_scalar(u32 continents, u32 detail, u32 temperature, i32 x0, i32 z, ColumnNoise &out) noexcept
+    {
+        sample_columns<i32>(continents, detail, temperature, x0, z, out);
+    }
+
+    static void caves_scalar(u32 seed, i32 x0, i32 y, i32 z, i32 *out) noexcept
+    {
+        sample_caves<i32>(seed, x0, y, z, out);
+    }
+
+    #if MCVK_TERRAIN_X86
+        [[gnu::target("sse4.1")]]
+        static void columns_sse41(u32 continents, u32 detail, u32 temperature, i32 x0, i32 z, ColumnNoise &out) noexcept
+        {
+            sample_columns<I32x4>(continents, detail, temperature, x0, z, out);
+        }
+
+        [[gnu::target("sse4.1")]]
+        static void caves_sse41(u32 seed, i32 x0, i32 y, i32 z, i32 *out) noexcept
+        {
+            sample_caves<I32x4>(seed, x0, y, z, out);
+        }
+
+        [[gnu::target("avx2")]]
+        static void columns_avx2(u32 continents, u32 detail, u32 temperature, i32 x0, i32 z, ColumnNoise &out) noexcept
+        {
+            sample_columns<I32x8>(continents, detail, temperature, x0, z, out);
+        }
+
+        [[gnu::target("avx2")]]
+        static void caves_avx2(u32 seed, i32 x0, i32 y, i32 z, i32 *out) noexcept
+        {
+            sample_caves<I32x8>(seed, x0, y, z, out);
+        }
+    #endif
+
+    static Kernels kernels_for(Isa isa) noexcept
+    {
+        switch (isa) {
+            #if MCVK_TERRAIN_X86
+                case Isa::Avx2:
+                    return {.columns = columns_avx2, .caves = caves_avx2};
+                case Isa::Sse41:
+                    return {.columns = columns_sse41, .caves = caves_sse41};
+            #endif
+            default:
+                return {.columns = columns_scalar, .caves = caves_scalar};
+        }
+    }
+
+    Isa best_isa() noexcept
+    {
+        #if MCVK_TERRAIN_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+                return Isa::Avx2;
+            if (__builtin_cpu_supports("sse4.1"))
+                return Isa::Sse41;
+        #endif
+        return Isa::Scalar;
+    }
+
+    const char *isa_name(Isa isa) noexcept
+    {
+        switch (isa) {
+            case Isa::Avx2:
+                return "avx2";
+            case Isa::Sse41:
+                return "sse4.1";
+            default:
+                return "scalar";
+        }
+    }
+
+    // SplitMix64, spreads a single world seed over the seeds of every layer
+    static u64 next_seed(u64 &state) noexcept
+    {
+        state += 0x9E3779B97F4A7C15ull;
+        auto z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    Generator::Generator(u64 seed, Isa requested_isa) noexcept :
+        isa {std::min(requested_isa, best_isa())}
+    {
+        u64 state {seed};
+        seeds.continents = static_cast<u32>(next_seed(state));
+        seeds.detail = static_cast<u32>(next_seed(state));
+        seeds.temperature = static_cast<u32>(next_seed(state));
+        seeds.caves = static_cast<u32>(next_seed(state));
+    }
+
+    struct Column
+    {
+        i32 height {}; // first block of air (or water) above the surface
+        i32 filler_depth {};
+        World::BlockId top {};
+        World::BlockId filler {};
+    };
+
+    // Oceans, plains and mountains come from the continents layer, which raises the base height
+    // and how far the detail layer may move the surface. Temperature, lowered with altitude,
+    // decides between snow, grass and desert.
+    static Column shape_column(i32 continents, i32 detail, i32 temperature) noexcept
+    {
+        const i32 base {Generator::SEA_LEVEL + 6 + ((continents * 24) >> FRACTION_BITS)};
+        const i32 amplitude {6 + ((std::max(continents, 0) * 48) >> FRACTION_BITS)};
+        const i32 height {std::clamp(base + ((detail * amplitude) >> FRACTION_BITS), 2, World::Chunk::HEIGHT - 2)};
+        const i32 climate {temperature - (height - Generator::SEA_LEVEL) * 24};
+
+        Column column {.height = height, .filler_depth = 4, .top = World::Grass, .filler = World::Dirt};
+        if (height < Generator::SEA_LEVEL - 8)
+            column = {.height = height, .filler_depth = 3, .top = World::Gravel, .filler = World::Gravel};
+        else if (height <= Generator::SEA_LEVEL + 1)
+            column = {.height = height, .filler_depth = 4, .top = World::Sand, .filler = World::Sand};
+        else if (height >= Generator::SNOW_LINE + 12)
+            column = {.height = height, .filler_depth = 1, .top = World::Snow, .filler = World::Stone};
+        else if (height >= Generator::SNOW_LINE || climate < -ONE / 4)
+            column.top = World::Snow;
+        else if (climate > ONE / 4)
+            column = {.height = height, .filler_depth = 5, .top = World::Sand, .filler = World::Sand};
+        return column;
+    }
+
+    static World::BlockId column_block(const Column &column, i32 y) noexcept
+    {
+        if (y == 0)
+            return World::Bedrock;
+        if (y < column.height - column.filler_depth)
+            return World::Stone;
+        if (y < column.height - 1)
+            return column.filler;
+        if (y == column.height - 1)
+            return column.top;
+        return (y < Generator::SEA_LEVEL) ? World::Water : World::Air;
+    }
+
+    void Generator::generate(World::Chunk &chunk) const noexcept
+    {
+        PROFILE_ZONE("generate chunk");
+        const auto kernels = kernels_for(isa);
+        const auto pos = chunk.get_pos();
+        const i32 base_x {pos.x * ROW};
+        const i32 base_z {pos.z * ROW};
+
+        std::array<Column, ROW * ROW> columns {};
+        std::array<i32, ROW> row_heights {}; // highest surface of every row, limits the cave noise
+        ColumnNoise noise {};
+        for (i32 z {}; z < ROW; ++z) {
+            kernels.columns(seeds.continents, seeds.detail, seeds.temperature, base_x, base_z + z, noise);
+            for (i32 x {}; x < ROW; ++x) {
+                const auto i = static_cast<usize>(x);
+                const auto column = shape_column(noise.continents[i], noise.detail[i], noise.temperature[i]);
+                columns[static_cast<usize>(z * ROW + x)] = column;
+                row_heights[static_cast<usize>(z)] = std::max(row_heights[static_cast<usize>(z)], column.height);
+            }
+        }
+
+        const auto highest = std::max(*std::max_element(row_heights.begin(), row_heights.end()), SEA_LEVEL);
+        std::array<World::BlockId, World::Section::VOLUME> blocks; // NOLINT(cppcoreguidelines-pro-type-member-init), filled below
+        std::array<i32, ROW> caves {};
+
+        for (i32 s {}; s < World::Chunk::SECTION_COUNT; ++s) {
+            auto &section = chunk.section(s);
+            if (s * World::Section::SIZE > highest) {
+                section.fill(World::Air);
+                continue;
+            }
+
+            for (i32 local_y {}; local_y < World::Section::SIZE; ++local_y) {
+                const i32 y {s * World::Section::SIZE + local_y};
+                for (i32 z {}; z < ROW; ++z) {
+                    const bool has_caves = y > 0 && y < row_heights[static_cast<usize>(z)] - CAVE_ROOF;
+                    if (has_caves)
+                        kernels.caves(seeds.caves, base_x, y, base_z + z, caves.data());
+
+                    for (i32 x {}; x < ROW; ++x) {
+                        const auto &column = columns[static_cast<usize>(z * ROW + x)];
+                        auto block = column_block(column, y);
+                        if (has_caves && caves[static_cast<usize>(x)] > CAVE_THRESHOLD && y < column.height - CAVE_ROOF)
+                            block = World::Air;
+                        blocks[static_cast<usize>((local_y * ROW + z) * ROW + x)] = block;
+                    }
+                }
+            }
+            section.assign(blocks);
+        }
+    }
+
+    u64 hash_chunk(const World::Chunk &chunk) noexcept
+    {
+        u64 hash {Checksum::FNV1A_BASIS};
+        std::array<World::BlockId, World::Section::VOLUME> blocks; // NOLINT(cppcoreguidelines-pro-type-member-init), filled by 'unpack'
+        for (i32 s {}; s < World::Chunk::SECTION_COUNT; ++s) {
+            chunk.section(s).unpack(blocks);
+            for (const auto block : blocks)
+                hash = Checksum::fnv1a_value(block, hash);
+        }
+        return hash;
+    }
+}
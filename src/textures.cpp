@@ -0,0 +1,399 @@
+#include "mcvk/textures.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <span>
+
+namespace
+{
+    // The repository ships no image files, every texture is drawn from a few patterns
+    enum class Pattern : u8
+    {
+        Noise,
+        GrassSide,  // dirt with a ragged strip of grass along the top
+        Rings,      // the cut end of a log
+        Bark,       // vertical streaks
+        Leaves,     // noise with holes
+        Frame,      // a border around a see-through centre
+        Boards,     // horizontal planks with staggered seams
+        Cobbles     // stones separated by darker mortar
+    };
+
+    struct Recipe
+    {
+        std::array<u8, 3> color {};
+        float variation {}; // brightness varies by up to this fraction in either direction
+        Pattern pattern {Pattern::Noise};
+    };
+
+    // indexed by World::Texture
+    constexpr std::array<Recipe, BlockTextures::LAYER_COUNT> RECIPES {{
+        {.color = {128, 128, 128}, .variation = 0.12f},                             // stone
+        {.color = {135, 97, 66}, .variation = 0.15f},                               // dirt
+        {.color = {92, 153, 66}, .variation = 0.15f},                               // grass top
+        {.color = {135, 97, 66}, .variation = 0.15f, .pattern = Pattern::GrassSide},
+        {.color = {219, 209, 153}, .variation = 0.06f},                             // sand
+        {.color = {140, 133, 128}, .variation = 0.3f},                              // gravel
+        {.color = {51, 89, 204}, .variation = 0.05f},                               // water
+        {.color = {51, 51, 51}, .variation = 0.5f},                                 // bedrock
+        {.color = {160, 130, 80}, .variation = 0.08f, .pattern = Pattern::Rings},   // log top
+        {.color = {102, 77, 46}, .variation = 0.12f, .pattern = Pattern::Bark},     // log side
+        {.color = {51, 115, 38}, .variation = 0.2f, .pattern = Pattern::Leaves},
+        {.color = {204, 230, 242}, .variation = 0.04f, .pattern = Pattern::Frame},  // glass
+        {.color = {179, 140, 89}, .variation = 0.06f, .pattern = Pattern::Boards},  // planks
+        {.color = {115, 115, 115}, .variation = 0.1f, .pattern = Pattern::Cobbles},
+        {.color = {242, 247, 255}, .variation = 0.03f},                             // snow
+        {.color = {230, 190, 110}, .variation = 0.25f},                             // glowstone
+    }};
+
+    // uniform in [0, 1), the same for the same texel of the same texture on every run
+    float noise(u32 layer, u32 x, u32 y) noexcept
+    {
+        u32 h {(layer * 0x9E3779B1u) ^ (x * 0x85EBCA77u) ^ (y * 0xC2B2AE3Du)};
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return static_cast<float>(h >> 8) / static_cast<float>(1u << 24);
+    }
+
+    // Writes the first mip level of a layer, SIZE x SIZE texels with row 0 at the top
+    void draw_texture(u32 layer, std::span<u8> out) noexcept
+    {
+        constexpr auto SIZE = BlockTextures::SIZE;
+        const auto &recipe = RECIPES[layer];
+        for (u32 y {}; y < SIZE; ++y) {
+            for (u32 x {}; x < SIZE; ++x) {
+                auto color = recipe.color;
+                float brightness {1.0f + recipe.variation * (2.0f * noise(layer, x, y) - 1.0f)};
+                u8 alpha {255};
+
+                switch (recipe.pattern) {
+                    case Pattern::Noise:
+                        break;
+                    case Pattern::GrassSide:
+                        // grass reaches 3 or 4 texels down
+                        if (y < 3 + static_cast<u32>(noise(layer, x, 0) < 0.5f))
+                            color = RECIPES[static_cast<usize>(World::Texture::GrassTop)].color;
+                        break;
+                    case Pattern::Rings: {
+                        const auto dx = static_cast<float>(x) - 7.5f, dy = static_cast<float>(y) - 7.5f;
+                        const auto ring = static_cast<u32>(std::sqrt(dx * dx + dy * dy));
+                        if (ring >= 7)
+                            color = RECIPES[static_cast<usize>(World::Texture::LogSide)].color;
+                        else if (ring % 2 == 1)
+                            brightness *= 0.85f;
+                        break;
+                    }
+                    case Pattern::Bark:
+                        brightness *= (noise(layer, x, 0) < 0.3f) ? 0.75f : 1.0f;
+                        break;
+                    case Pattern::Leaves:
+                        if (noise(layer + 1, x, y) < 0.2f)
+                            alpha = 0;
+                        break;
+                    case Pattern::Frame:
+                        if (x != 0 && y != 0 && x != SIZE - 1 && y != SIZE - 1)
+                            alpha = (x + 4 == y || x + 5 == y) ? 255 : 0; // a glint across the pane
+                        break;
+                    case Pattern::Boards: {
+                        // boards are 4 texels tall, seams between board ends alternate by board
+                        const auto board = y / 4;
+                        if (y % 4 == 3 || x == ((board % 2 == 0) ? 3u : 11u))
+                            brightness *= 0.7f;
+                        break;
+                    }
+                    case Pattern::Cobbles:
+                        // mortar along a grid that is offset by half a cell every other row of cells
+                        if (y % 5 == 4 || (x + ((y / 5) % 2) * 3) % 6 == 5)
+                            brightness *= 0.6f;
+                        break;
+                }
+
+                auto *texel = &out[(y * SIZE + x) * BlockTextures::TEXEL_SIZE];
+                for (usize c {}; c < 3; ++c)
+                    texel[c] = static_cast<u8>(std::clamp(static_cast<float>(color[c]) * brightness, 0.0f, 255.0f));
+                texel[3] = alpha;
+            }
+        }
+    }
+
+    // FORMAT is sRGB, so colour channels are averaged in linear space like blits of sRGB images
+    const auto SRGB_TO_LINEAR = [] {
+        std::array<float, 256> table {};
+        for (usize i {}; i < table.size(); ++i) {
+            const auto c = static_cast<float>(i) / 255.0f;
+            table[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+
+    u8 linear_to_srgb(float c) noexcept
+    {
+        const auto s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return static_cast<u8>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    // Averages 2x2 texels of 'source' (a layer of size 'source_size') into every texel of 'out'
+    void box_filter(std::span<const u8> source, u32 source_size, std::span<u8> out) noexcept
+    {
+        constexpr auto TEXEL = BlockTextures::TEXEL_SIZE;
+        const auto size = source_size / 2;
+        for (u32 y {}; y < size; ++y) {
+            for (u32 x {}; x < size; ++x) {
+                std::array<float, 4> sum {};
+                for (const auto &[dx, dy] : {std::pair{0u, 0u}, {1u, 0u}, {0u, 1u}, {1u, 1u}}) {
+                    const auto *texel = &source[((2 * y + dy) * source_size + 2 * x + dx) * TEXEL];
+                    for (usize c {}; c < 3; ++c)
+                        sum[c] += SRGB_TO_LINEAR[texel[c]];
+                    sum[3] += static_cast<float>(texel[3]);
+                }
+                auto *texel = &out[(y * size + x) * TEXEL];
+                for (usize c {}; c < 3; ++c)
+                    texel[c] = linear_to_srgb(sum[c] / 4.0f);
+                texel[3] = static_cast<u8>(sum[3] / 4.0f + 0.5f);
+            }
+        }
+    }
+}
+
+BlockTextures::BlockTextures(const Device::LogicalDevice &logical_device, Uploader &uuploader) noexcept :
+    device {logical_device.get()},
+    allocator {&logical_device.get_allocator()},
+    uploader {&uuploader}
+{
+    PROFILE_ZONE("block textures");
+    // blits may only be recorded on the graphics queue, which is where 'prepare' records them
+    VkFormatProperties format_properties {};
+    vkGetPhysicalDeviceFormatProperties(logical_device.get_physical_device(), FORMAT, &format_properties);
+    static constexpr VkFormatFeatureFlags BLIT_FEATURES {VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                         VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT};
+    gpu_mips = (format_properties.optimalTilingFeatures & BLIT_FEATURES) == BLIT_FEATURES;
+
+    create_image();
+    create_sampler(logical_device);
+    create_descriptors();
+
+    constexpr auto LAST_LEVEL = mip_level(MIP_LEVELS - 1);
+    texels.resize(gpu_mips ? mip_level(0).bytes : LAST_LEVEL.offset + LAST_LEVEL.bytes);
+    const auto layer_texels = [this](u32 level, u32 layer) {
+        const auto mip = mip_level(level);
+        return std::span{texels}.subspan(mip.offset + layer * (mip.bytes / LAYER_COUNT), mip.bytes / LAYER_COUNT);
+    };
+    for (u32 layer {}; layer < LAYER_COUNT; ++layer)
+        draw_texture(layer, layer_texels(0, layer));
+    if (!gpu_mips) {
+        for (u32 level {1}; level < MIP_LEVELS; ++level)
+            for (u32 layer {}; layer < LAYER_COUNT; ++layer)
+                box_filter(layer_texels(level - 1, layer), mip_level(level - 1).size, layer_texels(level, layer));
+    }
+    Logger::info("Block textures: {} layers of {}x{}, mips generated on the {}", LAYER_COUNT, SIZE, SIZE, gpu_mips ? "GPU" : "CPU");
+    stage();
+}
+
+BlockTextures::~BlockTextures() noexcept
+{
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+    vkDestroySampler(device, sampler, nullptr);
+    vkDestroyImageView(device, view, nullptr);
+    vkDestroyImage(device, image, nullptr);
+    allocator->free(allocation);
+}
+
+void BlockTextures::create_image() noexcept
+{
+    VkImageCreateInfo image_create_info {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = FORMAT;
+    image_create_info.extent = {.width = SIZE, .height = SIZE, .depth = 1};
+    image_create_info.mipLevels = MIP_LEVELS;
+    image_create_info.arrayLayers = LAYER_COUNT;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device, &image_create_info, nullptr, &image) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create block texture array");
+
+    allocation = allocator->allocate_image(image, Memory::Usage::GpuOnly);
+    if (!allocation.is_valid())
+        Logger::fatal_error("Failed to allocate memory for the block texture array");
+
+    VkImageViewCreateInfo image_view_create_info {};
+    image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_create_info.image = image;
+    image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    image_view_create_info.format = FORMAT;
+    image_view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_view_create_info.subresourceRange.baseMipLevel = 0;
+    image_view_create_info.subresourceRange.levelCount = MIP_LEVELS;
+    image_view_create_info.subresourceRange.baseArrayLayer = 0;
+    image_view_create_info.subresourceRange.layerCount = LAYER_COUNT;
+
+    if (vkCreateImageView(device, &image_view_create_info, nullptr, &view) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create block texture array view");
+}
+
+void BlockTextures::create_sampler(const Device::LogicalDevice &logical_device) noexcept
+{
+    // Magnified texels stay sharp, distant ones are blended between mips. Merged quads span several
+    // blocks and repeat the texture across them.
+    VkSamplerCreateInfo sampler_create_info {};
+    sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter = VK_FILTER_NEAREST;
+    sampler_create_info.minFilter = VK_FILTER_LINEAR;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    // every supported feature is enabled, see LogicalDevice::get_features
+    sampler_create_info.anisotropyEnable = logical_device.get_features().samplerAnisotropy;
+    sampler_create_info.maxAnisotropy = std::min(8.0f, logical_device.get_limits().maxSamplerAnisotropy);
+    sampler_create_info.minLod = 0.0f;
+    sampler_create_info.maxLod = static_cast<float>(MIP_LEVELS);
+
+    if (vkCreateSampler(device, &sampler_create_info, nullptr, &sampler) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create block texture sampler");
+}
+
+void BlockTextures::create_descriptors() noexcept
+{
+    const VkDescriptorSetLayoutBinding binding {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = &sampler
+    };
+
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info {};
+    descriptor_set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descriptor_set_layout_create_info.bindingCount = 1;
+    descriptor_set_layout_create_info.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(device, &descriptor_set_layout_create_info, nullptr, &descriptor_set_layout) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create block texture descriptor set layout");
+
+    static constexpr VkDescriptorPoolSize POOL_SIZE {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1};
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info {};
+    descriptor_pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.maxSets = 1;
+    descriptor_pool_create_info.poolSizeCount = 1;
+    descriptor_pool_create_info.pPoolSizes = &POOL_SIZE;
+
+    if (vkCreateDescriptorPool(device, &descriptor_pool_create_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create block texture descriptor pool");
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info {};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool = descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts = &descriptor_set_layout;
+
+    if (vkAllocateDescriptorSets(device, &descriptor_set_allocate_info, &descriptor_set) != VK_SUCCESS)
+        Logger::fatal_error("Failed to allocate block texture descriptor set");
+
+    // The set is written once and never changes, which keeps the chunk renderer's cached secondary
+    // command buffers valid. Nothing samples it before 'prepare' has returned true.
+    const VkDescriptorImageInfo image_info {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet write {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptor_set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+// Every level is a single upload of all its layers
+void BlockTextures::stage() noexcept
+{
+    const auto levels = gpu_mips ? 1 : MIP_LEVELS;
+    for (; staged_levels < levels; ++staged_levels) {
+        const auto mip = mip_level(staged_levels);
+        const auto staged = uploader->upload_image(image, {.width = mip.size, .height = mip.size, .depth = 1}, staged_levels,
+                                                   0, LAYER_COUNT, texels.data() + mip.offset, mip.bytes);
+        // the staging ring is shared with the chunk meshes, try again next frame if it is full
+        if (staged == Uploader::INVALID_TICKET)
+            return;
+        ticket = staged;
+    }
+    texels = {};
+}
+
+void BlockTextures::record_mip_generation(VkCommandBuffer command_buffer) const noexcept
+{
+    const auto barrier = [this](u32 level, u32 level_count, VkAccessFlags source_access, VkAccessFlags destination_access,
+                                VkImageLayout old_layout, VkImageLayout new_layout) {
+        VkImageMemoryBarrier image_barrier {};
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        image_barrier.srcAccessMask = source_access;
+        image_barrier.dstAccessMask = destination_access;
+        image_barrier.oldLayout = old_layout;
+        image_barrier.newLayout = new_layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = image;
+        image_barrier.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = level, .levelCount = level_count,
+                                          .baseArrayLayer = 0, .layerCount = LAYER_COUNT};
+        return image_barrier;
+    };
+
+    // the upload left the first level ready for sampling, the other levels have no contents yet
+    const std::array start {
+        barrier(0, 1, 0, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+        barrier(1, MIP_LEVELS - 1, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                         0, nullptr, 0, nullptr, static_cast<u32>(start.size()), start.data());
+
+    for (u32 level {1}; level < MIP_LEVELS; ++level) {
+        const auto source_size = static_cast<i32>(mip_level(level - 1).size);
+        const auto size = static_cast<i32>(mip_level(level).size);
+        VkImageBlit blit {};
+        blit.srcSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level - 1, .baseArrayLayer = 0, .layerCount = LAYER_COUNT};
+        blit.srcOffsets[1] = {.x = source_size, .y = source_size, .z = 1};
+        blit.dstSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .baseArrayLayer = 0, .layerCount = LAYER_COUNT};
+        blit.dstOffsets[1] = {.x = size, .y = size, .z = 1};
+        vkCmdBlitImage(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+
+        // the next level is blitted from this one
+        const auto written = barrier(level, 1, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                             0, nullptr, 0, nullptr, 1, &written);
+    }
+
+    const auto done = barrier(0, MIP_LEVELS, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0x0,
+                         0, nullptr, 0, nullptr, 1, &done);
+}
+
+bool BlockTextures::prepare(VkCommandBuffer command_buffer) noexcept
+{
+    if (ready) [[likely]]
+        return true;
+    if (!texels.empty())
+        stage();
+    if (!texels.empty() || !uploader->is_complete(ticket))
+        return false;
+
+    if (gpu_mips)
+        record_mip_generation(command_buffer);
+    ready = true;
+    return true;
+}
@@ -0,0 +1,53 @@
+#include "mcvk/timer.hpp"
+#include "mcvk/logger.hpp"
+#include <cstdio>
+#include <string>
+
+namespace Timing
+{
+    // initialized before main runs, which is as close to process start as portable code gets
+    static const Clock::time_point PROCESS_START {Clock::now()};
+
+    static std::vector<Record> &records() noexcept
+    {
+        static std::vector<Record> records {};
+        return records;
+    }
+
+    static void add_record(Record record) noexcept
+    {
+        records().push_back(record);
+        Logger::info("{} {} {} ms", record.name, (record.since_start) ? "after" : "took", record.ms);
+    }
+
+    void ScopedTimer::stop() noexcept
+    {
+        if (stopped)
+            return;
+        stopped = true;
+        add_record({.name = name, .ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count()});
+    }
+
+    void mark(const char *name) noexcept
+    {
+        add_record({
+            .name = name,
+            .ms = std::chrono::duration<double, std::milli>(Clock::now() - PROCESS_START).count(),
+            .since_start = true
+        });
+    }
+
+    const std::vector<Record> &get_records() noexcept
+    {
+        return records();
+    }
+
+    void report() noexcept
+    {
+        // NOLINTBEGIN(cppcoreguidelines-pro-type-vararg)
+        fprintf(stdout, "Startup timings\n");
+        for (const auto &record : records())
+            fprintf(stdout, "  %-28s %s %9.3f ms\n", record.name, (record.since_start) ? "at  " : "took", record.ms);
+        // NOLINTEND(cppcoreguidelines-pro-type-vararg)
+    }
+}
@@ -0,0 +1,328 @@
+#include "mcvk/upload.hpp"
+#include "mcvk/logger.hpp"
+#include "mcvk/profiler.hpp"
+#include <limits>
+#include <string>
+#include <thread>
+
+// stages of the graphics queue that may read uploaded data
+static constexpr VkPipelineStageFlags ACQUIRE_STAGES {
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+};
+static constexpr VkAccessFlags BUFFER_ACQUIRE_ACCESS {
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+};
+
+Uploader::Uploader(const Device::LogicalDevice &logical_device, VkDeviceSize staging_buffer_size) noexcept :
+    device {logical_device.get()},
+    allocator {&logical_device.get_allocator()},
+    transfer_queue {logical_device.get_transfer_queue()},
+    transfer_family {logical_device.get_queue_family_indices().get(Queue::TransferQueueIndex)},
+    graphics_family {logical_device.get_queue_family_indices().get(Queue::GraphicsQueueIndex)},
+    staging_size {staging_buffer_size}
+{
+    VkCommandPoolCreateInfo command_pool_create_info {};
+    command_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // each batch's command buffer is re-recorded whenever its slot comes around again
+    command_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    command_pool_create_info.queueFamilyIndex = transfer_family;
+
+    if (vkCreateCommandPool(device, &command_pool_create_info, nullptr, &command_pool) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create upload command pool");
+
+    static constexpr VkFenceCreateInfo FENCE_CREATE_INFO {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0x0
+    };
+
+    for (auto &batch : batches) {
+        VkCommandBufferAllocateInfo command_buffer_allocate_info {};
+        command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_allocate_info.commandPool = command_pool;
+        command_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        command_buffer_allocate_info.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &batch.command_buffer) != VK_SUCCESS)
+            Logger::fatal_error("Failed to allocate upload command buffer");
+        if (vkCreateFence(device, &FENCE_CREATE_INFO, nullptr, &batch.fence) != VK_SUCCESS)
+            Logger::fatal_error("Failed to create upload fence");
+    }
+
+    VkBufferCreateInfo buffer_create_info {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size = staging_size;
+    buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &buffer_create_info, nullptr, &staging_buffer) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create staging buffer");
+
+    staging_allocation = allocator->allocate_buffer(staging_buffer, Memory::Usage::CpuToGpu);
+    if (!staging_allocation.is_valid() || staging_allocation.mapped == nullptr)
+        Logger::fatal_error("Failed to allocate host visible memory for the staging buffer");
+
+    Logger::info("Uploader created with a {} MiB staging ring on {}", staging_size / (1024 * 1024),
+                 has_dedicated_transfer_queue() ? "a dedicated transfer queue" : "the graphics queue");
+}
+
+Uploader::~Uploader() noexcept
+{
+    if (device == VK_NULL_HANDLE)
+        return;
+
+    // the transfer queue may still be reading from the staging buffer
+    for (auto i = completed_batches; i < submitted_batches; ++i)
+        vkWaitForFences(device, 1, &batches[i % MAX_BATCHES_IN_FLIGHT].fence, VK_TRUE, std::numeric_limits<u64>::max());
+
+    for (auto &batch : batches)
+        vkDestroyFence(device, batch.fence, nullptr);
+    vkDestroyCommandPool(device, command_pool, nullptr);
+    vkDestroyBuffer(device, staging_buffer, nullptr);
+    allocator->free(staging_allocation);
+    device = VK_NULL_HANDLE;
+}
+
+bool Uploader::begin_batch_locked() noexcept
+{
+    auto &batch = batches[submitted_batches % MAX_BATCHES_IN_FLIGHT];
+    if (batch.recording)
+        return true;
+
+    // every slot is waiting for the transfer queue, don't block on it
+    if (submitted_batches - completed_batches == MAX_BATCHES_IN_FLIGHT)
+        return false;
+
+    static constexpr VkCommandBufferBeginInfo BEGIN_INFO {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+    if (vkBeginCommandBuffer(batch.command_buffer, &BEGIN_INFO) != VK_SUCCESS)
+        Logger::fatal_error("Failed to begin recording upload command buffer");
+
+    batch.recording = true;
+    batch.buffer_releases.clear();
+    batch.buffer_acquires.clear();
+    batch.image_releases.clear();
+    batch.image_acquires.clear();
+    return true;
+}
+
+Uploader::Staging Uploader::reserve_locked(VkDeviceSize size) noexcept
+{
+    if (size > staging_size) [[unlikely]] {
+        Logger::error("Upload of {} bytes does not fit into the staging ring", size);
+        return {};
+    }
+
+    auto position = (ring_head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    // allocations never wrap around the end of the ring, skip to the start instead
+    if ((position % staging_size) + size > staging_size)
+        position += staging_size - (position % staging_size);
+    if (position + size - ring_tail > staging_size)
+        return {};
+
+    if (!begin_batch_locked())
+        return {};
+
+    auto &batch = batches[submitted_batches % MAX_BATCHES_IN_FLIGHT];
+    ring_head = position + size;
+    batch.ring_end = ring_head;
+
+    const auto offset = position % staging_size;
+    return {
+        .data = static_cast<std::byte *>(staging_allocation.mapped) + offset,
+        .offset = offset,
+        .batch = &batch,
+        .ticket = submitted_batches + 1
+    };
+}
+
+Uploader::Staging Uploader::stage_buffer(VkBuffer destination, VkDeviceSize destination_offset, VkDeviceSize size) noexcept
+{
+    std::lock_guard lock {mtx};
+    const auto staging = reserve_locked(size);
+    if (staging.data == nullptr)
+        return staging;
+
+    const VkBufferCopy region {
+        .srcOffset = staging.offset,
+        .dstOffset = destination_offset,
+        .size = size
+    };
+    // the copy only executes once the batch is submitted, by which point the data has been written
+    vkCmdCopyBuffer(staging.batch->command_buffer, staging_buffer, destination, 1, &region);
+    staging.batch->pending_writes.fetch_add(1, std::memory_order_relaxed);
+
+    if (has_dedicated_transfer_queue()) {
+        VkBufferMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transfer_family;
+        barrier.dstQueueFamilyIndex = graphics_family;
+        barrier.buffer = destination;
+        barrier.offset = destination_offset;
+        barrier.size = size;
+        staging.batch->buffer_releases.push_back(barrier);
+
+        // the acquire has to match the release apart from the access masks
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = BUFFER_ACQUIRE_ACCESS;
+        staging.batch->buffer_acquires.push_back(barrier);
+    }
+    return staging;
+}
+
+Uploader::Ticket Uploader::upload_image(VkImage destination, VkExtent3D extent, u32 mip_level, u32 base_layer, u32 layer_count,
+                                        const void *data, VkDeviceSize size) noexcept
+{
+    std::lock_guard lock {mtx};
+    const auto staging = reserve_locked(size);
+    if (staging.data == nullptr)
+        return INVALID_TICKET;
+    std::memcpy(staging.data, data, size);
+
+    const VkImageSubresourceRange subresource_range {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = mip_level,
+        .levelCount = 1,
+        .baseArrayLayer = base_layer,
+        .layerCount = layer_count
+    };
+
+    VkImageMemoryBarrier to_transfer {};
+    to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer.srcAccessMask = 0;
+    to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    // the previous contents of these layers are replaced entirely
+    to_transfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image = destination;
+    to_transfer.subresourceRange = subresource_range;
+
+    vkCmdPipelineBarrier(staging.batch->command_buffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0x0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    VkBufferImageCopy region {};
+    region.bufferOffset = staging.offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip_level;
+    region.imageSubresource.baseArrayLayer = base_layer;
+    region.imageSubresource.layerCount = layer_count;
+    region.imageExtent = extent;
+    vkCmdCopyBufferToImage(staging.batch->command_buffer, staging_buffer, destination,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // The layout transition to shader read only is part of the release (and has to be repeated
+    // by the acquire). Without a dedicated transfer queue it simply happens at the end of the batch.
+    VkImageMemoryBarrier barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = has_dedicated_transfer_queue() ? transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = has_dedicated_transfer_queue() ? graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = destination;
+    barrier.subresourceRange = subresource_range;
+    staging.batch->image_releases.push_back(barrier);
+
+    if (has_dedicated_transfer_queue()) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        staging.batch->image_acquires.push_back(barrier);
+    }
+    return staging.ticket;
+}
+
+void Uploader::flush() noexcept
+{
+    PROFILE_ZONE("upload flush");
+    std::lock_guard lock {mtx};
+    auto &batch = batches[submitted_batches % MAX_BATCHES_IN_FLIGHT];
+    if (!batch.recording)
+        return;
+
+    // staging space is reserved under the lock but filled outside of it, wait for the writers
+    // that are still copying (these are plain memcpys, so this is short)
+    while (batch.pending_writes.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+    if (!batch.buffer_releases.empty() || !batch.image_releases.empty()) {
+        vkCmdPipelineBarrier(batch.command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0x0,
+                             0, nullptr,
+                             static_cast<u32>(batch.buffer_releases.size()), batch.buffer_releases.data(),
+                             static_cast<u32>(batch.image_releases.size()), batch.image_releases.data());
+    }
+
+    if (vkEndCommandBuffer(batch.command_buffer) != VK_SUCCESS)
+        Logger::fatal_error("Failed to record upload command buffer");
+
+    VkSubmitInfo submit_info {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.command_buffer;
+
+    if (vkQueueSubmit(transfer_queue, 1, &submit_info, batch.fence) != VK_SUCCESS)
+        Logger::fatal_error("Failed to submit upload batch");
+
+    batch.recording = false;
+    ++submitted_batches;
+}
+
+void Uploader::acquire_completed(VkCommandBuffer graphics_command_buffer) noexcept
+{
+    std::lock_guard lock {mtx};
+
+    std::vector<VkBufferMemoryBarrier> buffer_acquires {};
+    std::vector<VkImageMemoryBarrier> image_acquires {};
+    const auto previously_completed = completed_batches;
+
+    // batches run in submission order on the transfer queue, so stop at the first unfinished one
+    while (completed_batches < submitted_batches) {
+        auto &batch = batches[completed_batches % MAX_BATCHES_IN_FLIGHT];
+        if (vkGetFenceStatus(device, batch.fence) != VK_SUCCESS)
+            break;
+
+        vkResetFences(device, 1, &batch.fence);
+        buffer_acquires.insert(buffer_acquires.end(), batch.buffer_acquires.begin(), batch.buffer_acquires.end());
+        image_acquires.insert(image_acquires.end(), batch.image_acquires.begin(), batch.image_acquires.end());
+        ring_tail = batch.ring_end;
+        ++completed_batches;
+    }
+
+    if (completed_batches == previously_completed)
+        return;
+
+    if (has_dedicated_transfer_queue()) {
+        if (!buffer_acquires.empty() || !image_acquires.empty()) {
+            vkCmdPipelineBarrier(graphics_command_buffer,
+                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, ACQUIRE_STAGES, 0x0,
+                                 0, nullptr,
+                                 static_cast<u32>(buffer_acquires.size()), buffer_acquires.data(),
+                                 static_cast<u32>(image_acquires.size()), image_acquires.data());
+        }
+        return;
+    }
+
+    // Same queue family: the fence guarantees the copies have executed, but their writes still
+    // have to be made visible to the stages reading them
+    static constexpr VkMemoryBarrier VISIBILITY_BARRIER {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+        .dstAccessMask = BUFFER_ACQUIRE_ACCESS
+    };
+    vkCmdPipelineBarrier(graphics_command_buffer,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, ACQUIRE_STAGES, 0x0,
+                         1, &VISIBILITY_BARRIER, 0, nullptr, 0, nullptr);
+}
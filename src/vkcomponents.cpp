@@ -1,6 +1,8 @@
 #include "mcvk/vkcomponents.hpp"
+#include "mcvk/logger.hpp"
 #include <GLFW/glfw3.h>
 #include <vector>
+#include <algorithm>
 #include "mcvk/validationlayers.hpp"
 #include <cstring>
 
@@ -29,20 +31,19 @@
         // call the appropriate logging function according to the severity level
         switch (severity) {
             default:
-                Logger::error("Unknown severity level");
-                Logger::error(p_callback_data->pMessage);
+                Logger::error("Unknown severity level: {}", p_callback_data->pMessage);
                 break;
             case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT: // diagnostic message
-                Logger::diagnostic(p_callback_data->pMessage);
+                Logger::diagnostic("{}", p_callback_data->pMessage);
                 break;
             case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT: // informational message
-                Logger::info(p_callback_data->pMessage);
+                Logger::info("{}", p_callback_data->pMessage);
                 break;
             case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: // warning (very likely about a bug)
-                Logger::warning(p_callback_data->pMessage);
+                Logger::warning("{}", p_callback_data->pMessage);
                 break;
             case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: // error
-                Logger::error(p_callback_data->pMessage);
+                Logger::error("{}", p_callback_data->pMessage);
                 break;
         }
 
@@ -55,76 +56,124 @@
 
     }
 
-    VkComponents::VkComponents(bool use_messenger, GLFWwindow *window) noexcept :
-        uses_debug_messenger {use_messenger}
-    {
-        static constexpr VkApplicationInfo app_info {
-            .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
-            .pNext = nullptr,
-            .pApplicationName = "Minecraft",
-            .applicationVersion = VK_API_VERSION_1_0,
-            .pEngineName = "No Engine",
-            .engineVersion = VK_API_VERSION_1_0,
-            .apiVersion = VK_API_VERSION_1_0,
-        };
+#endif
+
+// Checks whether the instance supports 'VK_EXT_headless_surface'. Not every loader/driver
+// combination ships it, so this has to be checked before creating the instance.
+static bool has_headless_surface_support() noexcept
+{
+    u32 count {};
+    vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
 
-        static const std::vector<const char*> glfw_extensions = {[use_messenger](){
+    std::vector<VkExtensionProperties> extensions (count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &count, extensions.data());
+
+    return std::any_of(extensions.begin(), extensions.end(), [](const auto &extension) {
+        return strcmp(extension.extensionName, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME) == 0;
+    });
+}
+
+static void create_headless_surface(VkInstance instance, VkSurfaceKHR &surface) noexcept
+{
+    auto func = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT"));
+    if (func == nullptr)
+        Logger::fatal_error("Failed to load 'vkCreateHeadlessSurfaceEXT' address");
+
+    static constexpr VkHeadlessSurfaceCreateInfoEXT HEADLESS_SURFACE_CREATE_INFO {
+        .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+        .pNext = nullptr,
+        .flags = 0x0
+    };
+
+    if (func(instance, &HEADLESS_SURFACE_CREATE_INFO, nullptr, &surface) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create headless surface");
+}
+
+VkComponents::VkComponents([[maybe_unused]] bool use_messenger, GLFWwindow *window) noexcept :
+    headless {window == nullptr}
+{
+    static constexpr VkApplicationInfo app_info {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pNext = nullptr,
+        .pApplicationName = "Minecraft",
+        .applicationVersion = VK_API_VERSION_1_0,
+        .pEngineName = "No Engine",
+        .engineVersion = VK_API_VERSION_1_0,
+        .apiVersion = VK_API_VERSION_1_0,
+    };
+
+    if (headless && !has_headless_surface_support())
+        Logger::fatal_error("Headless mode requested, but " VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME " is not available");
+
+    const std::vector<const char*> instance_extensions = {[this, use_messenger](){
+        std::vector<const char *> extensions {};
+        if (headless) {
+            // GLFW is never initialized in headless mode, so the surface extensions have to be listed manually
+            extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+        }
+        else {
             uint32_t glfw_extension_count = 0;
             const char **glfw_extensions_ptr = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-            std::vector<const char *> extensions(glfw_extensions_ptr, glfw_extensions_ptr + glfw_extension_count);
-            if (use_messenger)
-                extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-            return extensions;
-        }()};
-
-        #ifndef NDEBUG
-                static constexpr VkDebugUtilsMessengerCreateInfoEXT DEBUG_CREATE_INFO {
-                    .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
-                    .pNext = nullptr,
-                    .flags = 0x0,
-                    .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
-                                       VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
-                    .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-                                   VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
-                    .pfnUserCallback = vk_debug_callback,
-                    .pUserData = nullptr
-                };
-        #endif
-        VkInstanceCreateInfo instance_create_info {};
-        instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-        instance_create_info.pApplicationInfo = &app_info;
-        instance_create_info.enabledExtensionCount = static_cast<u32>(glfw_extensions.size());
-        instance_create_info.ppEnabledExtensionNames = glfw_extensions.data();
-        #ifndef NDEBUG
-            instance_create_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
-            instance_create_info.enabledLayerCount = static_cast<u32>(VALIDATION_LAYERS.size());
-            instance_create_info.pNext = &DEBUG_CREATE_INFO;
-        #endif
-
-        if (vkCreateInstance(&instance_create_info, nullptr, &instance) != VK_SUCCESS)
-            Logger::fatal_error("Failed to initialize vulkan instance");
+            extensions.assign(glfw_extensions_ptr, glfw_extensions_ptr + glfw_extension_count);
+        }
         if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("Created vulkan instance successfully");
-
-        #ifndef NDEBUG
             if (use_messenger)
-                if (CreateDebugUtilsMessengerEXT(instance, &DEBUG_CREATE_INFO, nullptr, &messenger) != VK_SUCCESS)
-                    Logger::fatal_error("Failed to setup debug messenger with instance");
-        #endif
+                extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        return extensions;
+    }()};
 
-        // Create the window surface
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
-            Logger::fatal_error("Failed to create window surface");
-        if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("Created window surface successfully");
+    #ifndef NDEBUG
+        uses_debug_messenger = use_messenger;
+        static constexpr VkDebugUtilsMessengerCreateInfoEXT DEBUG_CREATE_INFO {
+            .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+            .pNext = nullptr,
+            .flags = 0x0,
+            .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+                               VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
+            .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                           VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+            .pfnUserCallback = vk_debug_callback,
+            .pUserData = nullptr
+        };
+    #endif
+    VkInstanceCreateInfo instance_create_info {};
+    instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_create_info.pApplicationInfo = &app_info;
+    instance_create_info.enabledExtensionCount = static_cast<u32>(instance_extensions.size());
+    instance_create_info.ppEnabledExtensionNames = instance_extensions.data();
+    #ifndef NDEBUG
+        instance_create_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
+        instance_create_info.enabledLayerCount = static_cast<u32>(VALIDATION_LAYERS.size());
+        instance_create_info.pNext = &DEBUG_CREATE_INFO;
+    #endif
+
+    if (vkCreateInstance(&instance_create_info, nullptr, &instance) != VK_SUCCESS)
+        Logger::fatal_error("Failed to initialize vulkan instance");
+    Logger::info("Created vulkan instance successfully");
+
+    #ifndef NDEBUG
+        if (use_messenger)
+            if (CreateDebugUtilsMessengerEXT(instance, &DEBUG_CREATE_INFO, nullptr, &messenger) != VK_SUCCESS)
+                Logger::fatal_error("Failed to setup debug messenger with instance");
+    #endif
+
+    if (headless) {
+        create_headless_surface(instance, surface);
+        Logger::info("Created headless surface successfully");
+        return;
     }
-#endif
 
+    // Create the window surface
+    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+        Logger::fatal_error("Failed to create window surface");
+    Logger::info("Created window surface successfully");
+}
 
 VkComponents::~VkComponents() noexcept
 {
     // De-allocate debug messenger
-    if constexpr (Global::IS_DEBUG_BUILD) {
+    #ifndef NDEBUG
         if (messenger != VK_NULL_HANDLE && uses_debug_messenger) {
             Logger::info("De-allocating debug messenger");
             auto func = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT"));
@@ -135,18 +184,16 @@ VkComponents::~VkComponents() noexcept
             else
                 Logger::error("Failed to load 'vkDestroyDebugUtilsMessengerEXT' address");
         }
-    }
+    #endif
 
     if (surface != VK_NULL_HANDLE) {
-        if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("De-allocating VkSurfaceKHR");
+        Logger::info("De-allocating VkSurfaceKHR");
         vkDestroySurfaceKHR(instance, surface, nullptr);
         surface = VK_NULL_HANDLE;
     }
 
     if (instance != VK_NULL_HANDLE) {
-        if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("De-allocating VkInstance");
+        Logger::info("De-allocating VkInstance");
         vkDestroyInstance(instance, nullptr);
         instance = VK_NULL_HANDLE;
     }
@@ -1,33 +1,41 @@
 #include "mcvk/window.hpp"
-#ifndef NDEBUG
-    #include "mcvk/logger.hpp"
-    #include "mcvk/global.hpp"
-#endif
+#include "mcvk/logger.hpp"
+#include "mcvk/global.hpp"
 
 Window::Window(int wwidth, int wheight, const char *wname) noexcept :
     width {wwidth}, height {wheight}, 
     self {[wwidth, wheight, wname](){
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
         return glfwCreateWindow(wwidth, wheight, wname, nullptr, nullptr);
     }()}
 {
+    // windows are neither copyable nor movable, so the pointer stays valid for the window's lifetime
+    glfwSetWindowUserPointer(self, this);
+    glfwSetFramebufferSizeCallback(self, [](GLFWwindow *window, int, int) {
+        static_cast<Window *>(glfwGetWindowUserPointer(window))->framebuffer_resized = true;
+    });
 }
 
 Window::~Window() noexcept
 {
     if (self != nullptr) {
-        if constexpr (Global::IS_DEBUG_BUILD)
-            Logger::info("De-allocating window");
+        Logger::info("De-allocating window");
         glfwDestroyWindow(self);
         self = nullptr;
     }
 }
 
+VkExtent2D Window::get_framebuffer_extent() const noexcept
+{
+    int framebuffer_width {}, framebuffer_height {};
+    glfwGetFramebufferSize(self, &framebuffer_width, &framebuffer_height);
+    return {.width = static_cast<u32>(framebuffer_width), .height = static_cast<u32>(framebuffer_height)};
+}
+
 void Window::create_surface(VkInstance instance, GLFWwindow &window, VkSurfaceKHR surface) noexcept
 {
     if (glfwCreateWindowSurface(instance, &window, nullptr, &surface) != VK_SUCCESS) 
         Logger::fatal_error("Failed to create window surface");
-    if constexpr (Global::IS_DEBUG_BUILD)
-        Logger::info("Window surface created successfully");
+    Logger::info("Window surface created successfully");
 }
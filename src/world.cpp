@@ -0,0 +1,70 @@
+#include "mcvk/world.hpp"
+#include "mcvk/profiler.hpp"
+#include <random>
+
+namespace World
+{
+    Chunk &ChunkStore::create_chunk(ChunkPos pos) noexcept
+    {
+        auto &chunk = chunks[pos];
+        if (chunk == nullptr)
+            chunk = std::make_unique<Chunk>(pos);
+        return *chunk;
+    }
+
+    void ChunkStore::remove_chunk(ChunkPos pos) noexcept
+    {
+        chunks.erase(pos);
+    }
+
+    BlockId ChunkStore::get_block(i32 x, i32 y, i32 z) const noexcept
+    {
+        if (y < 0 || y >= Chunk::HEIGHT)
+            return Air;
+
+        const auto *chunk = get_chunk({.x = to_chunk_coord(x), .z = to_chunk_coord(z)});
+        if (chunk == nullptr)
+            return Air;
+        return chunk->get(to_local_coord(x), y, to_local_coord(z));
+    }
+
+    void ChunkStore::set_block(i32 x, i32 y, i32 z, BlockId id) noexcept
+    {
+        if (y < 0 || y >= Chunk::HEIGHT)
+            return;
+
+        auto *chunk = get_chunk({.x = to_chunk_coord(x), .z = to_chunk_coord(z)});
+        if (chunk != nullptr)
+            chunk->set(to_local_coord(x), y, to_local_coord(z), id);
+    }
+
+    usize ChunkStore::memory_usage() const noexcept
+    {
+        // approximate the node and bucket overhead of the map
+        usize bytes {chunks.bucket_count() * sizeof(void *)};
+        for (const auto &[pos, chunk] : chunks)
+            bytes += sizeof(pos) + sizeof(chunk) + sizeof(void *) + chunk->memory_usage();
+        return bytes;
+    }
+
+    void fill_test_terrain(Chunk &chunk, u32 seed) noexcept
+    {
+        PROFILE_ZONE("generate chunk");
+        std::mt19937 rng {seed ^ static_cast<u32>(ChunkPosHash{}(chunk.get_pos()))};
+        std::uniform_int_distribution<i32> height_distribution {60, 70};
+        std::uniform_int_distribution<i32> ore_distribution {0, 63};
+
+        for (i32 z {}; z < Section::SIZE; ++z) {
+            for (i32 x {}; x < Section::SIZE; ++x) {
+                const auto height = height_distribution(rng);
+                chunk.set(x, 0, z, Bedrock);
+                for (i32 y {1}; y < height - 4; ++y)
+                    chunk.set(x, y, z, (ore_distribution(rng) == 0) ? Gravel : Stone);
+                for (i32 y {height - 4}; y < height - 1; ++y)
+                    chunk.set(x, y, z, Dirt);
+                chunk.set(x, height - 1, z, Grass);
+            }
+        }
+        chunk.compact();
+    }
+}